@@ -4,8 +4,12 @@
  * See kent/LICENSE or http://genome.ucsc.edu/license/ for licensing information. */
 #include "common.h"
 #include "hash.h"
+#include "options.h"
 #include "bed.h"
 
+int maxMem = 1024;	/* Megabytes of memory to sort in. */
+int threads = 1;	/* Number of threads to sort with. */
+char *tempDir = "./";	/* Where to put temporary files. */
 
 void usage()
 /* Explain usage and exit. */
@@ -14,14 +18,36 @@ errAbort(
   "bedSort - Sort a .bed file by chrom,chromStart\n"
   "usage:\n"
   "   bedSort in.bed out.bed\n"
-  "in.bed and out.bed may be the same.");
+  "in.bed and out.bed may be the same.\n"
+  "options:\n"
+  "   -maxMem=N - use about N megabytes of memory, default %d.  Files bigger than\n"
+  "               this are sorted in pieces that are merged at the end.\n"
+  "   -threads=N - number of threads to sort with, default %d\n"
+  "   -tempDir=somedir/ - somedir has space for temporary sorting data, default ./\n"
+  , maxMem, threads);
 }
 
+/* command line option specifications */
+static struct optionSpec optionSpecs[] = {
+    {"maxMem", OPTION_INT},
+    {"threads", OPTION_INT},
+    {"tempDir", OPTION_STRING},
+    {NULL, 0}
+};
+
 int main(int argc, char *argv[])
 /* Process command line. */
 {
+optionInit(&argc, argv, optionSpecs);
 if (argc != 3)
     usage();
-bedSortFile(argv[1], argv[2]);
+maxMem = optionInt("maxMem", maxMem);
+threads = optionInt("threads", threads);
+tempDir = optionVal("tempDir", tempDir);
+if (maxMem < 1)
+    errAbort("-maxMem must be at least 1");
+if (threads < 1 || threads > 256)
+    errAbort("-threads must be between 1 and 256");
+bedSortFileExt(argv[1], argv[2], tempDir, maxMem*1024LL*1024, threads);
 return 0;
 }
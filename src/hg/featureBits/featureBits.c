@@ -9,7 +9,6 @@
 #include "jksql.h"
 #include "hdb.h"
 #include "fa.h"
-#include "bits.h"
 #include "bed.h"
 #include "psl.h"
 #include "portable.h"
@@ -17,6 +16,8 @@
 #include "agpGap.h"
 #include "chain.h"
 #include "chromInfo.h"
+#include "intervalSet.h"
+#include "pthreadDoList.h"
 
 
 static struct optionSpec optionSpecs[] =
@@ -44,6 +45,7 @@ static struct optionSpec optionSpecs[] =
     {"bedRegionIn", OPTION_STRING},
     {"bedRegionOut", OPTION_STRING},
     {"countBlocks", OPTION_BOOLEAN},
+    {"threads", OPTION_INT},
     {NULL, 0}
 };
 
@@ -62,6 +64,7 @@ boolean calcEnrichment = FALSE;	/* Calculate coverage/enrichment? */
 int binSize = 500000;	/* Default bin size. */
 int binOverlap = 250000;	/* Default bin size. */
 boolean countBlocks = FALSE;	/* Count blocks in bed12 rather than extent. */
+int threads = 1;	/* Number of chromosomes to work on at once. */
 
 /* to process chroms without constantly looking up in chromInfo, create
  * this list of them from the chromInfo once.
@@ -104,6 +107,8 @@ errAbort(
   "                     and write to bedRegionsOut\n"
   "   -bedRegionOut=output.bed  Write a bed file of bin counts in specific regions \n"
   "                     from bedRegionIn\n"
+  "   -threads=N        Number of chromosomes to work on in parallel (default 1).\n"
+  "                     Database tables are still read one at a time.\n"
   "   -enrichment       Calculates coverage and enrichment assuming first table\n"
   "                     is reference gene track and second track something else\n"
   "                     Enrichment is the amount of table1 that covers table2 vs. the\n"
@@ -232,40 +237,6 @@ return  !((noRandom && (endsWith(name, "_random")
           || (primaryChroms && (strchr(name, '_') != NULL)));
 }
 
-void bitsToBins(Bits *bits, char *chrom, int chromSize, FILE *binFile, int binSize, int binOverlap)
-/* Write out binned counts of bits. */
-{
-int bin, count;
-
-if (!binFile)
-    return;
-for (bin=0; bin+binSize<chromSize; bin=bin+binOverlap)
-    {
-    count = bitCountRange(bits, bin, binSize);
-    fprintf(binFile, "%s\t%d\t%d\t%d\t%s.%d\n", chrom, bin, bin+binSize, count, chrom, bin/binOverlap+1);
-    }
-count = bitCountRange(bits, bin, chromSize-bin);
-fprintf(binFile, "%s\t%d\t%d\t%d\t%s.%d\n", chrom, bin, chromSize, count, chrom, bin/binOverlap+1);
-}
-
-void bitsToRegions(Bits *bits, char *chrom, int chromSize, struct bed *bedList, 
-		   FILE *bedOutFile)
-/* Write out counts of bits in regions defined by bed elements. */
-{
-struct bed *bl=NULL;
-int count, i=0;
-
-if (!bedOutFile)
-    return;
-for (bl=bedList; bl!=NULL; bl=bl->next)
-    {
-    if(differentString(bl->chrom,chrom))
-	continue;
-    count = bitCountRange(bits, bl->chromStart, bl->chromEnd-bl->chromStart);
-    fprintf(bedOutFile, "%s\t%d\t%d\t%d\t%s.%d\n", chrom, bl->chromStart, bl->chromEnd, count, chrom, ++i);
-    }
-}
-
 void check(struct sqlConnection *conn, char *table)
 /* Check it's as planned. */
 {
@@ -322,9 +293,17 @@ errAbort("Coordinate out of allowed range [%d,%d) for %s near line %d of %s",
 	0, chromSize, chrom, lf->lineIx, lf->fileName);
 }
 
-void setPslBits(struct lineFile *lf, 
-	Bits *bits, struct psl *psl, int winStart, int winEnd)
-/* Set bits that are in psl. */
+static struct hash *chromHash = NULL;	/* chromInfo of included chroms keyed by name. */
+
+static void addClipped(struct intervalSet *set, int start, int end, int chromSize)
+/* Add start to end clipped to chromosome to set. */
+{
+intervalSetAdd(set, max(start, 0), min(end, chromSize));
+}
+
+void setPslRuns(struct lineFile *lf, 
+	struct intervalSet *set, struct psl *psl, int winStart, int winEnd)
+/* Add blocks that are in psl to set. */
 {
 int i, s, e, w, blockCount = psl->blockCount;
 boolean isRev = (psl->strand[1] == '-');
@@ -342,27 +321,24 @@ for (i=0; i<blockCount; ++i)
     /* Clip, and if anything left set it. */
     if (s < winStart) outOfRange(lf, psl->tName, psl->tSize);
     if (e > winEnd) outOfRange(lf, psl->tName, psl->tSize);
-    w = e - s;
-    if (w > 0)
-	bitSetRange(bits, s, w);
+    intervalSetAdd(set, s, e);
     }
 }
 
-void fbOrPsl(Bits *acc, char *track, char *chrom, int chromSize)
-/* Or in bits of psl file that correspond to chrom. */
+void fbReadPsl(char *fileName, struct hash *setHash)
+/* Add blocks of psl file to sets in setHash, which is keyed by chromosome.
+ * Items on chromosomes not in setHash are skipped. */
 {
-struct lineFile *lf;
-char fileName[512];
+struct lineFile *lf = pslFileOpen(fileName);
 struct psl *psl;
-
-chromFileName(track, chrom, fileName);
-if (!fileExists(fileName))
-    return;
-lf = pslFileOpen(fileName);
 while ((psl = pslNext(lf)) != NULL)
     {
-    if (sameString(psl->tName, chrom))
-	setPslBits(lf, acc, psl, 0, chromSize);
+    struct intervalSet *set = hashFindVal(setHash, psl->tName);
+    if (set != NULL)
+        {
+	struct chromInfo *ci = hashMustFindVal(chromHash, psl->tName);
+	setPslRuns(lf, set, psl, 0, ci->size);
+	}
     pslFree(&psl);
     }
 lineFileClose(&lf);
@@ -381,67 +357,86 @@ lineFileClose(&lf);
 return numFields;
 }
 
-static struct bed *cacheBeds(char *fileName)
-/* Read in the beds from this file and keep them in a cache. */
+void fbReadBed(char *fileName, struct hash *setHash)
+/* Add items of bed file to sets in setHash, which is keyed by chromosome.
+ * Items on chromosomes not in setHash are skipped. */
 {
-static char *cachedFile;
-static struct bed *cachedBeds;
-
-if ((cachedFile == NULL) || differentString(cachedFile, fileName))
+unsigned numFields = howManyFields(fileName);
+if (numFields > 12)
+    numFields = 12;
+if (numFields < 3)
+    return;
+struct lineFile *lf = lineFileOpen(fileName, TRUE);
+char *row[numFields];
+while (lineFileRow(lf, row))
     {
-    if (cachedBeds)
-        {
-        bedFreeList(&cachedBeds);
-        freez(&cachedFile);
-        }
-
-    cachedFile = cloneString(fileName);
-    unsigned numFields = howManyFields(cachedFile);
-    cachedBeds = bedLoadNAllChrom(fileName, numFields > 12 ? 12 : numFields, NULL);
+    struct intervalSet *set = hashFindVal(setHash, row[0]);
+    if (set == NULL)
+        continue;
+    struct chromInfo *ci = hashMustFindVal(chromHash, row[0]);
+    struct bed *bed = bedLoadN(row, numFields);
+    if (countBlocks && (bed->blockCount > 0))
+	{
+	int ii;
+	for(ii=0; ii < bed->blockCount; ii++)
+	    {
+	    int s = bed->chromStart + bed->chromStarts[ii];
+	    addClipped(set, s, s + bed->blockSizes[ii], ci->size);
+	    }
+	}
+    else
+	addClipped(set, bed->chromStart, bed->chromEnd, ci->size);
+    bedFree(&bed);
     }
-
-return cachedBeds;
+lineFileClose(&lf);
 }
 
-void fbOrBed(Bits *acc, char *track, char *chrom, int chromSize)
-/* Or in bits of bed file that correspond to chrom. */
+void fbReadChain(char *fileName, struct hash *setHash)
+/* Add blocks of chain file to sets in setHash, which is keyed by chromosome.
+ * Items on chromosomes not in setHash are skipped. */
 {
-char fileName[512];
-
-chromFileName(track, chrom, fileName);
-if (!fileExists(fileName))
-    return;
-struct bed *bed, *beds = cacheBeds(fileName);
-
-for(bed = beds; bed; bed = bed->next)
+struct lineFile *lf = lineFileOpen(fileName, TRUE);
+struct chain *chain;
+struct cBlock *b;
+while ((chain = chainRead(lf)) != NULL)
     {
-    if (sameString(bed->chrom, chrom))
+    struct intervalSet *set = hashFindVal(setHash, chain->tName);
+    if (set != NULL)
         {
-        if (countBlocks && (bed->blockCount > 0))
-            {
-            int ii;
-            for(ii=0; ii < bed->blockCount; ii++)
-                bitSetRange(acc, bed->chromStart + bed->chromStarts[ii], bed->blockSizes[ii]);
-            }
-        else
+	struct chromInfo *ci = hashMustFindVal(chromHash, chain->tName);
+        for (b = chain->blockList; b != NULL; b = b->next)
             {
-            int w;
-            w = bed->chromEnd - bed->chromStart;
-            if (w > 0)
-                bitSetRange(acc, bed->chromStart, w);
+            if (b->tStart < 0) outOfRange(lf, chain->tName, ci->size);
+            if (b->tEnd > ci->size) outOfRange(lf, chain->tName, ci->size);
+            intervalSetAdd(set, b->tStart, b->tEnd);
             }
-	}
+        }
+    chainFree(&chain);
     }
+lineFileClose(&lf);
 }
 
-void fbOrBigBed(Bits *acc, char *track, char *chrom, int chromSize)
-/* Or in a bigBed file. */
+void fbReadFile(char *track, char *fileName, struct hash *setHash)
+/* Add features in a psl, bed or chain file to sets in setHash, which is keyed by
+ * chromosome.  The track's suffix says what sort of file it is. */
 {
-char fileName[512];
-chromFileName(track, chrom, fileName);
-if (!fileExists(fileName))
-    return;
+if (isFileType(track, "psl"))
+    fbReadPsl(fileName, setHash);
+else if (isFileType(track, "bed"))
+    fbReadBed(fileName, setHash);
+else if (isFileType(track, "chain"))
+    fbReadChain(fileName, setHash);
+else  
+    errAbort("can't determine file type of: %s", track);
+struct hashEl *hel, *helList = hashElListHash(setHash);
+for (hel = helList; hel != NULL; hel = hel->next)
+    intervalSetNormalize(hel->val);
+hashElFreeList(&helList);
+}
 
+void fbOrBigBed(struct intervalSet *set, char *fileName, char *chrom, int chromSize)
+/* Or in a bigBed file. */
+{
 struct lm *lm = lmInit(0);
 struct bbiFile *bbi = bigBedFileOpen(fileName);
 unsigned fieldCount = bbi->definedFieldCount;
@@ -457,51 +452,20 @@ for (interval = intervalList; interval != NULL; interval = interval->next)
         struct bed *bed = bedLoadN(bedRow, fieldCount);
         int ii;
         for(ii=0; ii < bed->blockCount; ii++)
-            bitSetRange(acc, bed->chromStart + bed->chromStarts[ii], bed->blockSizes[ii]);
+	    {
+	    int s = bed->chromStart + bed->chromStarts[ii];
+            addClipped(set, s, s + bed->blockSizes[ii], chromSize);
+	    }
         bedFree(&bed);
         }
     else
-        {
-        int w = interval->end - interval->start;
-        if (w > 0)
-            bitSetRange(acc, interval->start, w);
-        }
+        addClipped(set, interval->start, interval->end, chromSize);
     }
     
 lmCleanup(&lm);
 bbiFileClose(&bbi);
 }
 
-void fbOrChain(Bits *acc, char *track, char *chrom, int chromSize)
-/* Or in a chain file. */
-{
-struct lineFile *lf;
-char fileName[512];
-struct chain *chain;
-struct cBlock *b;
-
-chromFileName(track, chrom, fileName);
-if (!fileExists(fileName))
-    return;
-lf = lineFileOpen(fileName, TRUE);
-while ((chain = chainRead(lf)) != NULL)
-    {
-    if (sameString(chrom, chain->tName))
-        {
-        for (b = chain->blockList; b != NULL; b = b->next)
-            {
-            int s = b->tStart, e = b->tEnd;
-            if (s < 0) outOfRange(lf, chrom, chromSize);
-            if (e > chromSize) outOfRange(lf, chrom, chromSize);
-            bitSetRange(acc, b->tStart, b->tEnd - b->tStart);
-            }
-        }
-    chainFree(&chain);
-    }
-lineFileClose(&lf);
-}
-
-
 void isolateTrackPartOfSpec(char *spec, char track[512])
 /* Convert something like track:exon to just track */
 {
@@ -511,122 +475,277 @@ s = strchr(track, ':');
 if (s != NULL) *s = 0;
 }
 
-void orFile(Bits *acc, char *track, char *chrom, int chromSize)
-/* Or some sort of file into bits. */
-{
-if (isFileType(track, "psl"))
+struct fbOperand
+/* Features of one table on one chromosome. */
     {
-    fbOrPsl(acc, track, chrom, chromSize);
-    }
-else if (isFileType(track, "bed"))
-    {
-    fbOrBed(acc, track, chrom, chromSize);
-    }
-else if (isFileType(track, "chain"))
+    struct intervalSet *set;	/* Features, NULL if still to be read from chromFile. */
+    char *chromFile;		/* Chromosome specific file to read in parallel, or NULL. */
+    struct hash *fileSets;	/* If non-NULL set belongs to this whole-genome file cache. */
+    boolean not;		/* Negate features? */
+    };
+
+struct chromJob
+/* Work on one chromosome.  Tables are loaded from the database in order, and
+ * then chromosomes are combined and formatted in parallel. */
     {
-    fbOrChain(acc, track, chrom, chromSize);
-    }
-else if (isFileType(track, "bb"))
+    struct chromJob *next;	/* Next in list. */
+    struct chromInfo *ci;	/* Chromosome. */
+    struct fbOperand *operands;	/* One for each table. */
+    struct intervalSet *result;	/* Result of combining tables. */
+    long long chromBits;	/* Bases in result. */
+    long long firstTableBits, secondTableBits;	/* Bases in first two tables. */
+    char *bedBuf, *binBuf, *regionBuf;	/* Text of bed, bin and region output. */
+    size_t bedSize, binSize, regionSize;	/* Sizes of text. */
+    };
+
+struct chromJobContext
+/* Things chromosome jobs share. */
     {
-    fbOrBigBed(acc, track, chrom, chromSize);
-    }
-else  
-    errAbort("can't determine file type of: %s", track);
+    int tableCount;		/* Number of tables. */
+    char **tables;		/* Table specs. */
+    boolean doBed, doBin;	/* Make bed and bin output? */
+    struct bed *bedRegionList;	/* Regions to count in if non-NULL. */
+    };
+
+static struct hash *fileCache = NULL;	/* Per-chromosome sets of whole-genome files. */
+
+static struct hash *fileSetsNew(char *chrom)
+/* Return a hash with an empty set for chrom, or for all included chroms if
+ * chrom is NULL. */
+{
+struct hash *setHash = hashNew(chrom == NULL ? 10 : 0);
+struct chromInfo *ci;
+for (ci = chromInfoList; ci != NULL; ci = ci->next)
+    if (inclChrom(ci->chrom) && (chrom == NULL || sameString(chrom, ci->chrom)))
+	hashAdd(setHash, ci->chrom, intervalSetNew());
+return setHash;
 }
 
-void orTable(char *database, Bits *acc, char *track, char *chrom, 
-	int chromSize, struct sqlConnection *conn)
-/* Or in table if it exists.  Else do nothing. */
+void loadOperand(struct sqlConnection *conn, char *database, char *track, char *chrom,
+	int chromSize, struct fbOperand *op)
+/* Fill in operand with features of track on chrom, or with what is needed to
+ * read them later in a thread.  Anything using the database or reading a whole
+ * genome file happens here, in the main thread. */
 {
 char t[512], *s;
 char table[HDB_MAX_TABLE_STRING];
 
+if (track[0] == '!')
+    {
+    op->not = TRUE;
+    ++track;
+    }
 isolateTrackPartOfSpec(track, t);
 s = strrchr(t, '.');
 if (s != NULL)
     {
-    orFile(acc, track, chrom, chromSize);
+    char fileName[512];
+    chromFileName(track, chrom, fileName);
+    if (!fileExists(fileName))
+        op->set = intervalSetNew();
+    else if (isFileType(track, "bb"))
+        {
+	op->set = intervalSetNew();
+	fbOrBigBed(op->set, fileName, chrom, chromSize);
+	}
+    else if (sameString(fileName, track))
+        {
+	/* One file covering all chromosomes, read once and kept by chromosome. */
+	if (fileCache == NULL)
+	    fileCache = hashNew(0);
+	struct hash *fileSets = hashFindVal(fileCache, fileName);
+	if (fileSets == NULL)
+	    {
+	    fileSets = fileSetsNew(NULL);
+	    fbReadFile(track, fileName, fileSets);
+	    hashAdd(fileCache, fileName, fileSets);
+	    }
+	op->set = hashFindVal(fileSets, chrom);
+	if (op->set == NULL)
+	    op->set = intervalSetNew();
+	else
+	    op->fileSets = fileSets;
+	}
+    else
+        op->chromFile = cloneString(fileName);
     }
 else
     {
     boolean hasBin;
     int minFeatureSize = optionInt("minFeatureSize", 0);
     boolean isFound = hFindSplitTable(database, chrom, t, table, sizeof table, &hasBin);
-    verbose(3,"orTable: db: %s isFound: %s %s %s %s\n", database,
+    verbose(3,"loadOperand: db: %s isFound: %s %s %s %s\n", database,
 	isFound ? "TRUE" : "FALSE", chrom, t, table );
+    op->set = intervalSetNew();
     if (isFound)
-	fbOrTableBitsQueryMinSize(database, acc, track, chrom, chromSize, conn, where,
+	fbOrTableIntervalsQueryMinSize(database, op->set, track, chrom, chromSize, conn, where,
 		   TRUE, TRUE, minFeatureSize);
+    intervalSetNormalize(op->set);
     }
 }
 
+struct chromJob *chromJobLoad(struct sqlConnection *conn, char *database,
+	struct chromInfo *ci, int tableCount, char *tables[])
+/* Make a job for one chromosome and load what can't be loaded in parallel. */
+{
+struct chromJob *job;
+AllocVar(job);
+job->ci = ci;
+AllocArray(job->operands, tableCount);
+int i;
+for (i=0; i<tableCount; ++i)
+    loadOperand(conn, database, tables[i], ci->chrom, ci->size, &job->operands[i]);
+return job;
+}
+
+static void operandFree(struct fbOperand *op, char *chrom)
+/* Free up operand's set, and if it is from a whole-genome file remove it from the
+ * file's cache as well since chromosome is done. */
+{
+if (op->fileSets != NULL)
+    {
+    if (hashFindVal(op->fileSets, chrom) == op->set)
+	{
+	hashRemove(op->fileSets, chrom);
+	intervalSetFree(&op->set);
+	}
+    }
+else
+    intervalSetFree(&op->set);
+freez(&op->chromFile);
+}
 
-void chromFeatureBits(struct sqlConnection *conn,char *database, 
-	char *chrom, int tableCount, char *tables[],
-	FILE *bedFile, FILE *faFile, FILE *binFile,
-        struct bed *bedRegionList, FILE *bedOutFile,
-	int chromSize, int *retChromBits,
-	int *retFirstTableBits, int *retSecondTableBits)
-/* featureBits - Correlate tables via bitmap projections and booleans
- * on one chromosome. */
+void chromJobFree(struct chromJob **pJob, int tableCount)
+/* Free up a chromosome job. */
 {
+struct chromJob *job = *pJob;
+if (job != NULL)
+    {
+    int i;
+    for (i=0; i<tableCount; ++i)
+	operandFree(&job->operands[i], job->ci->chrom);
+    freeMem(job->operands);
+    intervalSetFree(&job->result);
+    freeMem(job->bedBuf);
+    freeMem(job->binBuf);
+    freeMem(job->regionBuf);
+    freez(pJob);
+    }
+}
+
+static FILE *openJobStream(char **pBuf, size_t *pSize, char *chrom)
+/* Open a memory stream for some output of a chromosome. */
+{
+FILE *f = open_memstream(pBuf, pSize);
+if (f == NULL)
+    errnoAbort("Couldn't open memory stream for %s", chrom);
+return f;
+}
+
+void intervalsToBins(struct intervalSet *set, char *chrom, int chromSize, FILE *binFile,
+	int binSize, int binOverlap)
+/* Write out binned counts of set. */
+{
+int bin;
+long long count;
+
+for (bin=0; bin+binSize<chromSize; bin=bin+binOverlap)
+    {
+    count = intervalSetCountRange(set, bin, binSize);
+    fprintf(binFile, "%s\t%d\t%d\t%lld\t%s.%d\n", chrom, bin, bin+binSize, count, chrom, bin/binOverlap+1);
+    }
+count = intervalSetCountRange(set, bin, chromSize-bin);
+fprintf(binFile, "%s\t%d\t%d\t%lld\t%s.%d\n", chrom, bin, chromSize, count, chrom, bin/binOverlap+1);
+}
+
+void intervalsToRegions(struct intervalSet *set, char *chrom, struct bed *bedList, 
+		   FILE *bedOutFile)
+/* Write out counts of set in regions defined by bed elements. */
+{
+struct bed *bl=NULL;
+int i=0;
+
+for (bl=bedList; bl!=NULL; bl=bl->next)
+    {
+    if(differentString(bl->chrom,chrom))
+	continue;
+    long long count = intervalSetCountRange(set, bl->chromStart, bl->chromEnd-bl->chromStart);
+    fprintf(bedOutFile, "%s\t%d\t%d\t%lld\t%s.%d\n", chrom, bl->chromStart, bl->chromEnd, count, chrom, ++i);
+    }
+}
+
+void chromFeatureBits(void *item, void *context)
+/* featureBits - Correlate tables via interval sets and booleans
+ * on one chromosome.  Called in parallel by pthreadDoList. */
+{
+struct chromJob *job = item;
+struct chromJobContext *cc = context;
+char *chrom = job->ci->chrom;
+int chromSize = job->ci->size;
+struct intervalSet *acc = NULL;
 int i;
-Bits *acc = NULL;
-Bits *bits = NULL;
-char *table;
 
-acc = bitAlloc(chromSize);
-bits = bitAlloc(chromSize);
-for (i=0; i<tableCount; ++i)
+for (i=0; i<cc->tableCount; ++i)
     {
-    boolean not = FALSE;
-    table = tables[i];
-    if (table[0] == '!')
+    struct fbOperand *op = &job->operands[i];
+    struct intervalSet *set;
+    if (op->set == NULL)
         {
-	not = TRUE;
-	++table;
+	struct hash *setHash = fileSetsNew(chrom);
+	fbReadFile(cc->tables[i] + (op->not ? 1 : 0), op->chromFile, setHash);
+	op->set = hashMustFindVal(setHash, chrom);
+	hashFree(&setHash);
 	}
+    if (op->not)
+	set = intervalSetNot(op->set, chromSize);
+    else
+        set = intervalSetClone(op->set);
     if (i == 0)
         {
-	orTable(database, acc, table, chrom, chromSize, conn);
-	if (not)
-	   bitNot(acc, chromSize);
-	if (retFirstTableBits != NULL)
-	   *retFirstTableBits = bitCountRange(acc, 0, chromSize);
+	acc = set;
+	job->firstTableBits = intervalSetTotal(acc);
 	}
     else
 	{
-	bitClear(bits, chromSize);
-	orTable(database, bits, table, chrom, chromSize, conn);
-	if (not)
-	   bitNot(bits, chromSize);
-	if (i == 1 && retSecondTableBits != NULL)
-	   *retSecondTableBits = bitCountRange(bits, 0, chromSize);
+	struct intervalSet *newAcc;
+	if (i == 1)
+	   job->secondTableBits = intervalSetTotal(set);
 	/* feature/bug - the above does not respect minSize */
 	if (orLogic)
-	    bitOr(acc, bits, chromSize);
+	    newAcc = intervalSetOr(acc, set);
 	else
-	    bitAnd(acc, bits, chromSize);
+	    newAcc = intervalSetAnd(acc, set);
+	intervalSetFree(&acc);
+	intervalSetFree(&set);
+	acc = newAcc;
 	}
     }
 if (notResults)
-    bitNot(acc, chromSize);    
-*retChromBits = bitCountRange(acc, 0, chromSize);
-if (bedFile != NULL || faFile != NULL)
     {
-    minSize = optionInt("minSize", minSize);
-    bitsToBed(database, acc, chrom, chromSize, bedFile, faFile, minSize);
+    struct intervalSet *not = intervalSetNot(acc, chromSize);
+    intervalSetFree(&acc);
+    acc = not;
     }
-if (binFile != NULL)
+job->chromBits = intervalSetTotal(acc);
+if (cc->doBed)
     {
-    binSize = optionInt("binSize", binSize);
-    binOverlap = optionInt("binOverlap", binOverlap);
-    bitsToBins(acc, chrom, chromSize, binFile, binSize, binOverlap);
+    FILE *f = openJobStream(&job->bedBuf, &job->bedSize, chrom);
+    intervalsToBed(NULL, acc, chrom, f, NULL, minSize);
+    carefulClose(&f);
     }
-if (bedOutFile != NULL)
-    bitsToRegions(acc, chrom, chromSize, bedRegionList, bedOutFile);
-bitFree(&acc);
-bitFree(&bits);
+if (cc->doBin)
+    {
+    FILE *f = openJobStream(&job->binBuf, &job->binSize, chrom);
+    intervalsToBins(acc, chrom, chromSize, f, binSize, binOverlap);
+    carefulClose(&f);
+    }
+if (cc->bedRegionList != NULL)
+    {
+    FILE *f = openJobStream(&job->regionBuf, &job->regionSize, chrom);
+    intervalsToRegions(acc, chrom, cc->bedRegionList, f);
+    carefulClose(&f);
+    }
+job->result = acc;
 }
 
 void chromFeatureSeq(struct sqlConnection *conn, 
@@ -916,16 +1035,9 @@ checkInputExists(conn, database, chromInfoList, tableCount, tables);
 if (!faIndependent)
     {
     double totalBases = 0, totalBits = 0;
-    int firstTableBits = 0, secondTableBits = 0;
-    int *pFirstTableBits = NULL, *pSecondTableBits = NULL;
     double totalFirstBits = 0, totalSecondBits = 0;
     static int dotClock = 1;
 
-    if (calcEnrichment)
-        {
-	pFirstTableBits = &firstTableBits;
-	pSecondTableBits = &secondTableBits;
-	}
     if (bedRegionInName)
 	{
 	struct lineFile *lf = lineFileOpen(bedRegionInName, TRUE);
@@ -943,21 +1055,48 @@ if (!faIndependent)
 	lineFileClose(&lf);
 	slReverse(&bedRegionList);
 	}
+    struct chromJobContext cc = {tableCount, tables, bedFile != NULL, binFile != NULL,
+        bedRegionList};
+    chromHash = hashNew(0);
     for (cInfo = chromInfoList; cInfo != NULL; cInfo = cInfo->next)
-	{
 	if (inclChrom(cInfo->chrom))
+	    hashAdd(chromHash, cInfo->chrom, cInfo);
+    cInfo = chromInfoList;
+    while (cInfo != NULL)
+	{
+	/* Load a window of chromosomes, combine them in parallel, and write
+	 * them out in order. */
+	struct chromJob *jobList = NULL, *job;
+	int count = 0;
+	for (; cInfo != NULL && count < 8*threads; cInfo = cInfo->next)
+	    {
+	    if (inclChrom(cInfo->chrom))
+		{
+		verbose(3,"chromFeatureBits(%s)\n", cInfo->chrom);
+		slAddHead(&jobList, chromJobLoad(conn, database, cInfo, tableCount, tables));
+		++count;
+		}
+	    }
+	slReverse(&jobList);
+	pthreadDoList(threads, jobList, chromFeatureBits, &cc);
+	while ((job = slPopHead(&jobList)) != NULL)
 	    {
-	    int chromBitSize;
-	    int chromSize = cInfo->size;
-	    verbose(3,"chromFeatureBits(%s)\n", cInfo->chrom);
-	    chromFeatureBits(conn, database, cInfo->chrom, tableCount, tables,
-		bedFile, faFile, binFile, bedRegionList, bedRegionOutFile, 
-		chromSize, &chromBitSize, pFirstTableBits, pSecondTableBits
-		);
-	    totalBases += countBases(conn, cInfo->chrom, chromSize, database);
-	    totalBits += chromBitSize;
-	    totalFirstBits += firstTableBits;
-	    totalSecondBits += secondTableBits;
+	    char *chrom = job->ci->chrom;
+	    if (bedFile != NULL)
+		mustWrite(bedFile, job->bedBuf, job->bedSize);
+	    if (faFile != NULL)
+		intervalsToBed(database, job->result, chrom, NULL, faFile, minSize);
+	    if (binFile != NULL)
+		mustWrite(binFile, job->binBuf, job->binSize);
+	    if (bedRegionOutFile != NULL)
+		mustWrite(bedRegionOutFile, job->regionBuf, job->regionSize);
+	    totalBases += countBases(conn, chrom, job->ci->size, database);
+	    totalBits += job->chromBits;
+	    if (calcEnrichment)
+		{
+		totalFirstBits += job->firstTableBits;
+		totalSecondBits += job->secondTableBits;
+		}
 	    if (dots > 0)
 		{
 		if (--dotClock <= 0)
@@ -967,6 +1106,7 @@ if (!faIndependent)
 		    dotClock = dots;
 		    }
 		}
+	    chromJobFree(&job, tableCount);
 	    }
 	}
 	if (dots > 0)
@@ -1024,6 +1164,12 @@ noHap = optionExists("noHap");
 primaryChroms = optionExists("primaryChroms");
 dots = optionInt("dots", dots);
 where = optionVal("where", NULL);
+minSize = optionInt("minSize", minSize);
+binSize = optionInt("binSize", binSize);
+binOverlap = optionInt("binOverlap", binOverlap);
+threads = optionInt("threads", threads);
+if (threads < 1 || threads > 256)
+    errAbort("-threads must be between 1 and 256");
 calcEnrichment = optionExists("enrichment");
 if (calcEnrichment && argc != 4)
     errAbort("You must specify two tables with -enrichment");
@@ -11431,6 +11431,9 @@ if ((udcLogFile =  cfgOption("udcLog")) != NULL)
     udcSetLog(fp);
     }
 
+// big track images can have their PNG compressed in several strips at once
+mgSetPngEncodeThreads(atoi(cfgOptionDefault("png.encodeThreads", "1")));
+
 initTl();
 
 char *configPageCall = cartCgiUsualString(cart, "hgTracksConfigPage", "notSet");
@@ -8,6 +8,9 @@
 #ifndef BITS_H
 #include "bits.h"
 #endif
+#ifndef INTERVALSET_H
+#include "intervalSet.h"
+#endif
 #include "hdb.h"
 #include "cart.h"
 #include "bed.h"
@@ -60,6 +63,16 @@ void fbOrTableBitsQuery(char *db, Bits *bits, char *trackQualifier, char *chrom,
 	boolean clipToWindow, boolean filterOutNoUTR);
 /* Ors in features matching sqlConstraints in track on chromosome into bits. */
 
+void fbOrIntervals(struct intervalSet *set, int setSize, struct featureBits *fbList,
+	int minSize);
+/* Add features clipped to 0-setSize to set, skipping any not bigger than minSize
+ * if minSize is positive. */
+
+void fbOrTableIntervalsQueryMinSize(char *db, struct intervalSet *set, char *trackQualifier,
+	char *chrom, int chromSize, struct sqlConnection *conn, char *sqlConstraints,
+	boolean clipToWindow, boolean filterOutNoUTR, int minSize);
+/* Like fbOrTableBitsQueryMinSize, but adds features to an interval set rather
+ * than a bitmap as big as the chromosome. */
 
 
 void fbOptions(char *db, char *track);
@@ -91,5 +104,10 @@ void bitsToBed(char *db, Bits *bits, char *chrom, int chromSize, FILE *bed, FILE
 	       int minSize);
 /* Write out runs of bits of at least minSize as items in a bed file. */
 
+void intervalsToBed(char *db, struct intervalSet *set, char *chrom, FILE *bed, FILE *fa,
+	int minSize);
+/* Write out runs in set of at least minSize as items in a bed file and/or
+ * sequence in a fa file, the same way as bitsToBed. */
+
 #endif /* FEATUREBITS_H */
 
@@ -227,6 +227,53 @@ struct sqlResult *sqlGetResult(struct sqlConnection *sc, char *query);
  *     old info, only applies with mysql_store_result not mysql_use_result)
  * Otherwise returns a structure that you can do sqlRow() on. */
 
+#define sqlBatchMinQueries 4	/* Smallest batch sqlGetResultBatch combines. */
+
+struct sqlResult **sqlGetResultBatch(struct sqlConnection *sc, char **queries, int queryCount);
+/* Send queries (each made with sqlSafef, without a trailing semicolon) to the
+ * server together and return an array of queryCount results, in the same order.
+ * Statements are only combined for the batch, which costs two round trips to
+ * turn that on and off again, so this saves queryCount-3 round trips, and
+ * batches smaller than sqlBatchMinQueries are simply run one query at a time.
+ * Queries that can be made into one statement, for instance with union all, are
+ * cheaper still.  The results are stored on the client, so all may be read at
+ * once.  An element is NULL if its query produces no results table.  Free each
+ * result with sqlFreeResult and then the array with freeMem.
+ * Connections with a failover connection run the queries one at a time so that
+ * each query can fail over on its own. */
+
+struct sqlStatement *sqlPrepare(struct sqlConnection *conn, char *query);
+/* Make a statement from query, which should be made with sqlSafef and have a ?
+ * wherever a value will be bound.  A ? inside quotes is left alone.  Bind values
+ * with the sqlBind functions and then run with sqlStatementGetResult or
+ * sqlStatementUpdate, as many times as you like.  Values stay bound between runs.
+ * This is not a server side prepared statement: the bound values are escaped and
+ * substituted into the query on the client, and each run sends the whole query
+ * as text, so it saves no round trips.  It just saves quoting values by hand. */
+
+void sqlBindString(struct sqlStatement *st, int ix, char *value);
+/* Bind string to parameter ix (starting at 0).  The string is escaped and
+ * quoted.  A NULL value is bound as sql NULL. */
+
+void sqlBindInt(struct sqlStatement *st, int ix, int value);
+/* Bind integer to parameter ix (starting at 0). */
+
+void sqlBindLongLong(struct sqlStatement *st, int ix, long long value);
+/* Bind long long to parameter ix (starting at 0). */
+
+void sqlBindDouble(struct sqlStatement *st, int ix, double value);
+/* Bind double to parameter ix (starting at 0). */
+
+struct sqlResult *sqlStatementGetResult(struct sqlStatement *st);
+/* Run statement with the values bound now and return a structure that you can
+ * do sqlNextRow() on. */
+
+void sqlStatementUpdate(struct sqlStatement *st);
+/* Run statement, which should produce no results table, with the values bound now. */
+
+void sqlStatementFree(struct sqlStatement **pSt);
+/* Free up a statement. */
+
 unsigned long sqlEscapeStringFull(char *to, const char* from, long fromLength);
 /* Prepares a string for inclusion in a sql statement.  Output string
  * must be 2*strlen(from)+1. fromLength is the length of the from data.
@@ -281,7 +328,18 @@ boolean sqlDatabaseExists(char *database);
 /* Return TRUE if database exists. */
 
 boolean sqlTableExists(struct sqlConnection *sc, char *table);
-/* Return TRUE if a table exists. */
+/* Return TRUE if a table exists.  In CGIs a table found to exist is memoized
+ * until a query that might change the database is run. */
+
+void sqlTableMemoOn(boolean on);
+/* Turn memoizing of table existence and field lists on or off.  By default it
+ * is on only in CGIs. */
+
+void sqlTableMemoClear(struct sqlConnection *sc);
+/* Forget memoized table existence and field lists of connection.  This happens
+ * automatically when a query that could change tables is run through jksql, but
+ * programs that memoize should call it if other processes may be changing the
+ * database. */
 
 bool sqlColumnExists(struct sqlConnection *conn, char *tableName, char *column);
 /* return TRUE if column exists in table. column can contain sql wildcards  */
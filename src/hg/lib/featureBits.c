@@ -719,6 +719,33 @@ fbOrTableBitsQueryMinSize(db, bits, trackQualifier, chrom, chromSize, conn,
 			  sqlConstraints, clipToWindow, filterOutNoUTR, 0);
 }
 
+void fbOrIntervals(struct intervalSet *set, int setSize, struct featureBits *fbList,
+	int minSize)
+/* Add features clipped to 0-setSize to set, skipping any not bigger than minSize
+ * if minSize is positive. */
+{
+struct featureBits *fb;
+for (fb = fbList; fb != NULL; fb = fb->next)
+    {
+    if (minSize > 0 && fb->end - fb->start <= minSize)
+        continue;
+    intervalSetAdd(set, max(fb->start, 0), min(fb->end, setSize));
+    }
+}
+
+void fbOrTableIntervalsQueryMinSize(char *db, struct intervalSet *set, char *trackQualifier,
+	char *chrom, int chromSize, struct sqlConnection *conn, char *sqlConstraints,
+	boolean clipToWindow, boolean filterOutNoUTR, int minSize)
+/* Like fbOrTableBitsQueryMinSize, but adds features to an interval set rather
+ * than a bitmap as big as the chromosome. */
+{
+struct featureBits *fbList = fbGetRangeQuery(db, trackQualifier, chrom, 0,
+					     chromSize, sqlConstraints,
+					     clipToWindow, filterOutNoUTR);
+fbOrIntervals(set, chromSize, fbList, minSize);
+featureBitsFreeList(&fbList);
+}
+
 struct bed *fbToBedOne(struct featureBits *fb)
 /* Translate a featureBits item into (scoreless) bed 6. */
 {
@@ -746,6 +773,22 @@ for (fb=fbList;  fb != NULL;  fb=fb->next)
 return(bedList);
 }
 
+static void writeBitsRun(char *db, char *chrom, int start, int end, FILE *bed, FILE *fa,
+	int *pId)
+/* Write out one run of set bits as a bed item and/or sequence. */
+{
+if (bed)
+    fprintf(bed, "%s\t%d\t%d\t%s.%d\n", chrom, start, end, chrom, ++(*pId));
+if (fa)
+    {
+    char name[256];
+    struct dnaSeq *seq = hDnaFromSeq(db, chrom, start, end, dnaLower);
+    safef(name, sizeof(name), "%s:%d-%d", chrom, start, end);
+    faWriteNext(fa, name, seq->dna, seq->size);
+    freeDnaSeq(&seq);
+    }
+}
+
 void bitsToBed(char *db, Bits *bits, char *chrom, int chromSize, FILE *bed, FILE *fa, 
 	int minSize)
 /* Write out runs of bits of at least minSize as items in a bed file. */
@@ -766,33 +809,25 @@ for (i=0; i<chromSize; ++i)
     else
         {
 	if (lastBit && i-start >= minSize)
-	    {
-	    if (bed)
-		fprintf(bed, "%s\t%d\t%d\t%s.%d\n", chrom, start, i, chrom, ++id);
-	    if (fa)
-	        {
-		char name[256];
-		struct dnaSeq *seq = hDnaFromSeq(db,chrom, start, i, dnaLower);
-		sprintf(name, "%s:%d-%d", chrom, start, i);
-		faWriteNext(fa, name, seq->dna, seq->size);
-		freeDnaSeq(&seq);
-		}
-	    }
+	    writeBitsRun(db, chrom, start, i, bed, fa, &id);
 	}
     lastBit = thisBit;
     }
 if (lastBit && i-start >= minSize)
+    writeBitsRun(db, chrom, start, i, bed, fa, &id);
+}
+
+void intervalsToBed(char *db, struct intervalSet *set, char *chrom, FILE *bed, FILE *fa,
+	int minSize)
+/* Write out runs in set of at least minSize as items in a bed file and/or
+ * sequence in a fa file, the same way as bitsToBed. */
+{
+int i, id = 0;
+intervalSetNormalize(set);
+for (i=0; i<set->count; ++i)
     {
-    if (bed)
-	fprintf(bed, "%s\t%d\t%d\t%s.%d\n", chrom, start, i, chrom, ++id);
-    if (fa)
-	{
-	char name[256];
-	struct dnaSeq *seq = hDnaFromSeq(db, chrom, start, i, dnaLower);
-	sprintf(name, "%s:%d-%d", chrom, start, i);
-	faWriteNext(fa, name, seq->dna, seq->size);
-	freeDnaSeq(&seq);
-	}
+    struct intervalRun *run = &set->runs[i];
+    if (run->end - run->start >= minSize)
+        writeBitsRun(db, chrom, run->start, run->end, bed, fa, &id);
     }
 }
-
@@ -3848,6 +3848,30 @@ if (tdb->restrictCount > 0 && chrom != NULL)
 return chromOk;
 }
 
+static void addTrackDbRows(char *db, struct trackDb *oneTable, struct trackDb **tdbList,
+	struct hash *loaded)
+/* Add rows of a trackDb table to tdbList, freeing those for tracks already loaded
+ * from an earlier table. */
+{
+struct trackDb *oneRow;
+while ((oneRow = slPopHead(&oneTable)) != NULL)
+    {
+    if (!hashLookup(loaded, oneRow->track))
+        {
+        hashAdd(loaded, oneRow->track, NULL);
+        slAddHead(tdbList, oneRow);
+        // record for use in check available tracks
+        char *profileName = getTrackProfileName(oneRow);
+        if (profileName != NULL)
+            tableListProcessTblProfile(profileName, db);
+        }
+    else
+        {
+        trackDbFree(&oneRow);
+        }
+    }
+}
+
 boolean loadOneTrackDb(char *db, char *where, char *tblSpec,
                               struct trackDb **tdbList, struct hash *loaded)
 /* Load a trackDb table, including handling profiles:tbl. Returns
@@ -3859,28 +3883,66 @@ boolean exists;
 // database doesn't exist in one of servers.
 struct sqlConnection *conn = hAllocConnProfileTblMaybe(db, tblSpec, &tbl);
 if ((exists = ((conn != NULL) && sqlTableExists(conn, tbl))))
+    addTrackDbRows(db, trackDbLoadWhere(conn, tbl, where), tdbList, loaded);
+
+hFreeConn(&conn);
+return exists;
+}
+
+static boolean loadTrackDbBatch(char *db, char *where, struct slName *tableList,
+	struct trackDb **tdbList, struct hash *loaded, boolean *retFoundOne)
+/* Load trackDb tables that are all in db on the default profile, fetching the
+ * ones that exist with a single union query rather than a round trip each.
+ * Return FALSE without loading anything if a table has a profile of its own. */
+{
+struct slName *one;
+for (one = tableList; one != NULL; one = one->next)
+    if (strchr(one->name, ':') != NULL)
+        return FALSE;
+*retFoundOne = FALSE;
+struct sqlConnection *conn = hAllocConnMaybe(db);
+if (conn == NULL)
+    return TRUE;
+/* Each select adds the position of its table after the trackDb columns, so rows
+ * can be given back a table at a time in the order of tableList. */
+struct dyString *query = dyStringNew(0);
+int tableCount = 0, i;
+for (one = tableList; one != NULL; one = one->next)
     {
-    struct trackDb *oneTable = trackDbLoadWhere(conn, tbl, where), *oneRow;
-    while ((oneRow = slPopHead(&oneTable)) != NULL)
+    if (sqlTableExists(conn, one->name))
         {
-        if (!hashLookup(loaded, oneRow->track))
-            {
-            hashAdd(loaded, oneRow->track, NULL);
-            slAddHead(tdbList, oneRow);
-            // record for use in check available tracks
-            char *profileName = getTrackProfileName(oneRow);
-            if (profileName != NULL)
-                tableListProcessTblProfile(profileName, db);
-	    }
-        else
-	    {
-            trackDbFree(&oneRow);
-	    }
+        if (tableCount > 0)
+            sqlDyStringPrintf(query, " union all ");
+        sqlDyStringPrintf(query, "select *, %d from %s", tableCount, one->name);
+        if (where != NULL)
+            sqlDyStringPrintf(query, " where %-s", where);
+        ++tableCount;
         }
     }
-
+if (tableCount > 0)
+    {
+    struct trackDb **tableRows;
+    AllocArray(tableRows, tableCount);
+    struct sqlResult *sr = sqlGetResult(conn, query->string);
+    int ixCol = sqlCountColumns(sr) - 1;
+    char **row;
+    while ((row = sqlNextRow(sr)) != NULL)
+        {
+        int ix = sqlUnsigned(row[ixCol]);
+        slAddHead(&tableRows[ix], trackDbLoad(row));
+        }
+    sqlFreeResult(&sr);
+    for (i=0; i<tableCount; ++i)
+        {
+        slReverse(&tableRows[i]);
+        addTrackDbRows(db, tableRows[i], tdbList, loaded);
+        }
+    freeMem(tableRows);
+    *retFoundOne = TRUE;
+    }
+dyStringFree(&query);
 hFreeConn(&conn);
-return exists;
+return TRUE;
 }
 
 struct trackDb *loadTrackDb(char *db, char *where)
@@ -3894,10 +3956,13 @@ struct trackDb *tdbList = NULL;
 struct slName *tableList = hTrackDbList(), *one;
 boolean foundOne = FALSE;
 struct hash *loaded = hashNew(0);
-for (one = tableList; one != NULL; one = one->next)
+if (!loadTrackDbBatch(db, where, tableList, &tdbList, loaded, &foundOne))
     {
-    if (loadOneTrackDb(db, where, one->name, &tdbList, loaded))
-        foundOne = TRUE;
+    for (one = tableList; one != NULL; one = one->next)
+        {
+        if (loadOneTrackDb(db, where, one->name, &tdbList, loaded))
+            foundOne = TRUE;
+        }
     }
 if (!foundOne)
     errAbort("can not find any trackDb tables for %s, check db.trackDb specification in hg.conf",
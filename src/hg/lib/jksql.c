@@ -88,6 +88,10 @@ struct sqlConnection
                                     /* Can be NULL. */
     char *db;                       /* to be able to connect later (if conn is NULL), we need to  */
                                     /* store the database */
+    char *memoDb;                   /* Database we are in, for memo keys.  NULL if not */
+                                    /* known since a raw use query, "" if there is none. */
+    struct hash *tableMemo;         /* Keys are memoDb and name of tables that exist. */
+    struct hash *fieldsMemo;        /* Values are slName lists of fields, same keys. */
     };
 
 struct sqlResult
@@ -765,6 +769,8 @@ if (sc != NULL)
 	}
    
     freeMem(sc->db);
+    sqlTableMemoClear(sc);
+    freeMem(sc->memoDb);
     // also close failover connection
     if (sc->failoverConn != NULL)
         sqlDisconnect(&sc->failoverConn);
@@ -1002,8 +1008,67 @@ sr = sqlGetResult(conn, query);
 return sr;
 }
 
-struct slName *sqlListFields(struct sqlConnection *conn, char *table)
-/* Return list of fields in table. */
+/* In CGIs table existence and field lists are memoized on each connection, since
+ * pages like hgTracks ask about the same tables many times.  Only tables that
+ * exist are remembered.  Memo keys start with the database the connection is in,
+ * which is known from connecting or changing database through jksql, and is only
+ * asked of the server after a raw "use" query.  The memos on all open connections
+ * are dropped when any query that is not select/show/describe/explain goes
+ * through jksql.  Other programs may run long enough to miss tables changed by
+ * other processes, so don't memoize unless they call sqlTableMemoOn. */
+static int tableMemoOn = -1;	/* TRUE, FALSE, or -1 to decide with cgiIsOnWeb. */
+
+void sqlTableMemoClear(struct sqlConnection *sc)
+/* Forget memoized table existence and field lists of connection. */
+{
+hashFree(&sc->tableMemo);
+hashFreeWithVals(&sc->fieldsMemo, slNameFreeList);
+}
+
+static void sqlTableMemoClearAll()
+/* Forget memoized tables on all open connections. */
+{
+if (sqlOpenConnections != NULL)
+    {
+    struct dlNode *node;
+    for (node = sqlOpenConnections->head; !dlEnd(node); node = node->next)
+        sqlTableMemoClear(node->val);
+    }
+}
+
+void sqlTableMemoOn(boolean on)
+/* Turn memoizing of table existence and field lists on or off.  By default it
+ * is on only in CGIs. */
+{
+tableMemoOn = on;
+if (!on)
+    sqlTableMemoClearAll();
+}
+
+static boolean sqlTableMemoKey(struct sqlConnection *sc, char *table, char *key, int keySize)
+/* Put memo key for table on connection into key and return TRUE, or return FALSE if
+ * connection isn't memoized. */
+{
+if (tableMemoOn < 0)
+    tableMemoOn = cgiIsOnWeb();
+if (!tableMemoOn)
+    return FALSE;
+if (sc->memoDb == NULL)
+    {
+    char query[64];
+    sqlSafef(query, sizeof(query), "select database()");
+    sc->memoDb = sqlQuickString(sc, query);
+    if (sc->memoDb == NULL)
+        sc->memoDb = cloneString("");
+    }
+if (sc->memoDb[0] == 0)
+    return FALSE;
+safef(key, keySize, "%s.%s", sc->memoDb, table);
+return TRUE;
+}
+
+static struct slName *sqlDescribeFields(struct sqlConnection *conn, char *table)
+/* Return list of fields in table from database. */
 {
 char **row;
 struct slName *list = NULL, *el;
@@ -1019,6 +1084,30 @@ slReverse(&list);
 return list;
 }
 
+static struct slName *sqlMemoFields(struct sqlConnection *conn, char *table, char *key)
+/* Return memoized list of fields in table, which has memo key.  Do not free or
+ * change the list; it may be freed by the next query that changes the database. */
+{
+struct hashEl *hel = (conn->fieldsMemo ? hashLookup(conn->fieldsMemo, key) : NULL);
+if (hel == NULL)
+    {
+    struct slName *fields = sqlDescribeFields(conn, table);
+    if (conn->fieldsMemo == NULL)
+	conn->fieldsMemo = hashNew(0);
+    hel = hashAdd(conn->fieldsMemo, key, fields);
+    }
+return hel->val;
+}
+
+struct slName *sqlListFields(struct sqlConnection *conn, char *table)
+/* Return list of fields in table. */
+{
+char key[1024];
+if (!sqlTableMemoKey(conn, table, key, sizeof(key)))
+    return sqlDescribeFields(conn, table);
+return slNameCloneList(sqlMemoFields(conn, table, key));
+}
+
 void sqlAddDatabaseFields(char *database, struct hash *hash)
 /* Add fields from the one database to hash. */
 {
@@ -1204,6 +1293,8 @@ if (((conn->db != NULL) && !sameString(database, conn->db))
    errAbort("apparent mismatch between mysql.h used to compile jksql.c and libmysqlclient");
 
 sc->db=cloneString(database);
+freez(&sc->memoDb);
+sc->memoDb = cloneString(database != NULL ? database : "");
 if (monitorFlags & JKSQL_TRACE)
     monitorPrint(sc, "SQL_CONNECT", "%s %s", sp->host, sp->user);
 
@@ -1474,6 +1565,46 @@ char *sqlHostInfo(struct sqlConnection *sc)
 return (char *) mysql_get_host_info(sc->conn);
 }
 
+static void sqlQueryFirstWord(char *query, char *word, int wordSize)
+/* Put up to wordSize-1 letters of first word of query into word. */
+{
+int i = 0;
+query = skipLeadingSpaces(query);
+while (i < wordSize-1 && isalpha(query[i]))
+    {
+    word[i] = query[i];
+    ++i;
+    }
+word[i] = 0;
+}
+
+static boolean sqlIsReadOnlyQuery(char *query)
+/* Return TRUE if query starts with a word that means it can't change tables. */
+{
+static char *readWords[] = {"select", "show", "describe", "desc", "explain"};
+char word[16];
+sqlQueryFirstWord(query, word, sizeof(word));
+int i;
+for (i=0; i<ArraySize(readWords); ++i)
+    if (sameWord(word, readWords[i]))
+        return TRUE;
+return FALSE;
+}
+
+static void sqlTableMemoCheckQuery(struct sqlConnection *sc, char *query)
+/* Drop memos that query may have made wrong.  A query that changes anything drops
+ * the tables memoized on all connections, and a raw use query leaves the database
+ * of sc to be asked of the server. */
+{
+if (sqlIsReadOnlyQuery(query))
+    return;
+sqlTableMemoClearAll();
+char word[16];
+sqlQueryFirstWord(query, word, sizeof(word));
+if (sameWord(word, "use"))
+    freez(&sc->memoDb);
+}
+
 static struct sqlResult *sqlUseOrStore(struct sqlConnection *sc,
 	char *query, ResGetter *getter, boolean abort)
 /* Returns NULL if result was empty and getter==mysql_use_result.
@@ -1513,6 +1644,8 @@ if (strstr(query, NOSQLINJ ""))
     fixedMultipleNOSQLINJ = TRUE;
     }
 
+sqlTableMemoCheckQuery(sc, query);
+
 if (sqlConnMustUseFailover(sc))
     sc = sc->failoverConn;
 
@@ -1773,12 +1906,8 @@ sqlDisconnect(&conn);
 return exists;
 }
 
-boolean sqlTableExists(struct sqlConnection *sc, char *table)
-/* Return TRUE if a table exists. 
- *
- * If a failover connection is configured in hg.conf, looks up table in the main connection first 
- * Uses a table name cache table, if configured in hg.conf
- */
+static boolean sqlTableExistsUncached(struct sqlConnection *sc, char *table)
+/* Return TRUE if a table exists, asking the database (or table cache) every time. */
 {
 char query[256];
 struct sqlResult *sr;
@@ -1851,6 +1980,30 @@ sqlFreeResult(&sr);
 return TRUE;
 }
 
+boolean sqlTableExists(struct sqlConnection *sc, char *table)
+/* Return TRUE if a table exists. 
+ *
+ * If a failover connection is configured in hg.conf, looks up table in the main connection first 
+ * Uses a table name cache table, if configured in hg.conf
+ * In CGIs a table found to exist is memoized until a query that might change the
+ * database is run.
+ */
+{
+char key[1024];
+if (!sqlTableMemoKey(sc, table, key, sizeof(key)))
+    return sqlTableExistsUncached(sc, table);
+if (sc->tableMemo != NULL && hashLookup(sc->tableMemo, key))
+    return TRUE;
+boolean exists = sqlTableExistsUncached(sc, table);
+if (exists)
+    {
+    if (sc->tableMemo == NULL)
+	sc->tableMemo = hashNew(0);
+    hashAdd(sc->tableMemo, key, NULL);
+    }
+return exists;
+}
+
 // Note: this is copied from hdb.c's hParseDbDotTable.  Normally I abhor copying but I really
 // don't want to make jksql.c depend on hdb.h...
 void sqlParseDbDotTable(char *dbIn, char *dbDotTable, char *dbOut, size_t dbOutSize,
@@ -2049,6 +2202,281 @@ if (res == NULL)
 return res;
 }
 
+struct sqlStatement
+/* A query with ? placeholders for values that are filled in on the client before each run. */
+    {
+    struct sqlConnection *conn;	/* Connection statement runs on. */
+    int paramCount;		/* Number of ? placeholders. */
+    char **pieces;		/* Query text around placeholders, paramCount+1 of them. */
+    char **values;		/* Escaped and quoted values, NULL if not bound yet. */
+    struct dyString *query;	/* Query with values filled in. */
+    };
+
+struct sqlStatement *sqlPrepare(struct sqlConnection *conn, char *query)
+/* Make a statement from query, which should be made with sqlSafef and have a ?
+ * wherever a value will be bound.  A ? inside quotes is left alone.  Bind values
+ * with the sqlBind functions and then run with sqlStatementGetResult or
+ * sqlStatementUpdate, as many times as you like.  Values stay bound between runs.
+ * This is not a server side prepared statement: the bound values are escaped and
+ * substituted into the query on the client, and each run sends the whole query
+ * as text, so it saves no round trips.  It just saves quoting values by hand. */
+{
+if (startsWith(NOSQLINJ "", query))
+    query += NOSQLINJ_SIZE;
+else
+    sqlCheckError("Unvetted query: %s", query);
+struct sqlStatement *st;
+AllocVar(st);
+st->conn = conn;
+st->query = dyStringNew(0);
+struct slName *pieceList = NULL;
+char *s = query, *start = query, quote = 0;
+for (; *s != 0; ++s)
+    {
+    char c = *s;
+    if (quote)
+        {
+	if (c == '\\' && s[1] != 0)
+	    ++s;
+	else if (c == quote)
+	    quote = 0;
+	}
+    else if (c == '\'' || c == '"' || c == '`')
+        quote = c;
+    else if (c == '?')
+        {
+	slAddHead(&pieceList, slNameNewN(start, s - start));
+	start = s + 1;
+	}
+    }
+slAddHead(&pieceList, slNameNew(start));
+slReverse(&pieceList);
+st->paramCount = slCount(pieceList) - 1;
+AllocArray(st->pieces, st->paramCount + 1);
+AllocArray(st->values, st->paramCount + 1);
+struct slName *piece;
+int i = 0;
+for (piece = pieceList; piece != NULL; piece = piece->next)
+    st->pieces[i++] = cloneString(piece->name);
+slFreeList(&pieceList);
+return st;
+}
+
+void sqlStatementFree(struct sqlStatement **pSt)
+/* Free up a statement. */
+{
+struct sqlStatement *st = *pSt;
+if (st != NULL)
+    {
+    int i;
+    for (i=0; i<=st->paramCount; ++i)
+        {
+	freeMem(st->pieces[i]);
+	freeMem(st->values[i]);
+	}
+    freeMem(st->pieces);
+    freeMem(st->values);
+    dyStringFree(&st->query);
+    freez(pSt);
+    }
+}
+
+static void sqlBindValue(struct sqlStatement *st, int ix, char *value)
+/* Set value of parameter ix to value, which has already been escaped and quoted
+ * and is now owned by the statement. */
+{
+if (ix < 0 || ix >= st->paramCount)
+    errAbort("Parameter %d out of range, statement has %d", ix, st->paramCount);
+freeMem(st->values[ix]);
+st->values[ix] = value;
+}
+
+void sqlBindString(struct sqlStatement *st, int ix, char *value)
+/* Bind string to parameter ix (starting at 0).  The string is escaped and
+ * quoted.  A NULL value is bound as sql NULL. */
+{
+if (value == NULL)
+    {
+    sqlBindValue(st, ix, cloneString("NULL"));
+    return;
+    }
+char *quoted = needMem(2*strlen(value) + 3);
+unsigned long len = sqlEscapeString3(quoted+1, value);
+quoted[0] = quoted[len+1] = '\'';
+quoted[len+2] = 0;
+sqlBindValue(st, ix, quoted);
+}
+
+void sqlBindInt(struct sqlStatement *st, int ix, int value)
+/* Bind integer to parameter ix (starting at 0). */
+{
+char buf[32];
+safef(buf, sizeof(buf), "%d", value);
+sqlBindValue(st, ix, cloneString(buf));
+}
+
+void sqlBindLongLong(struct sqlStatement *st, int ix, long long value)
+/* Bind long long to parameter ix (starting at 0). */
+{
+char buf[32];
+safef(buf, sizeof(buf), "%lld", value);
+sqlBindValue(st, ix, cloneString(buf));
+}
+
+void sqlBindDouble(struct sqlStatement *st, int ix, double value)
+/* Bind double to parameter ix (starting at 0). */
+{
+char buf[64];
+safef(buf, sizeof(buf), "%.17g", value);
+sqlBindValue(st, ix, cloneString(buf));
+}
+
+static char *sqlStatementQuery(struct sqlStatement *st)
+/* Return query with bound values filled in.  Aborts if any are missing. */
+{
+struct dyString *dy = st->query;
+dyStringClear(dy);
+dyStringAppend(dy, NOSQLINJ "");
+dyStringAppend(dy, st->pieces[0]);
+int i;
+for (i=0; i<st->paramCount; ++i)
+    {
+    if (st->values[i] == NULL)
+        errAbort("Parameter %d not bound in query: %s", i, dy->string + NOSQLINJ_SIZE);
+    dyStringAppend(dy, st->values[i]);
+    dyStringAppend(dy, st->pieces[i+1]);
+    }
+return dy->string;
+}
+
+struct sqlResult *sqlStatementGetResult(struct sqlStatement *st)
+/* Run statement with the values bound now and return a structure that you can
+ * do sqlNextRow() on. */
+{
+return sqlGetResult(st->conn, sqlStatementQuery(st));
+}
+
+void sqlStatementUpdate(struct sqlStatement *st)
+/* Run statement, which should produce no results table, with the values bound now. */
+{
+sqlUpdate(st->conn, sqlStatementQuery(st));
+}
+
+static struct sqlResult **sqlGetResultEach(struct sqlConnection *sc, char **queries,
+	int queryCount)
+/* Run queries one at a time, storing each result. */
+{
+struct sqlResult **results;
+AllocArray(results, queryCount);
+int i;
+for (i=0; i<queryCount; ++i)
+    results[i] = sqlUseOrStore(sc, queries[i], mysql_store_result, TRUE);
+return results;
+}
+
+struct sqlResult **sqlGetResultBatch(struct sqlConnection *sc, char **queries, int queryCount)
+/* Send queries (each made with sqlSafef, without a trailing semicolon) to the
+ * server together and return an array of queryCount results, in the same order.
+ * Statements are only combined for the batch, which costs two round trips to
+ * turn that on and off again, so this saves queryCount-3 round trips, and
+ * batches smaller than sqlBatchMinQueries are simply run one query at a time.
+ * Queries that can be made into one statement, for instance with union all, are
+ * cheaper still.  The results are stored on the client, so all may be read at
+ * once.  An element is NULL if its query produces no results table.  Free each
+ * result with sqlFreeResult and then the array with freeMem.
+ * Connections with a failover connection run the queries one at a time so that
+ * each query can fail over on its own. */
+{
+if (queryCount <= 0)
+    return NULL;
+if (sqlConnMustUseFailover(sc) || sc->failoverConn != NULL
+    || queryCount < sqlBatchMinQueries)
+    return sqlGetResultEach(sc, queries, queryCount);
+
+struct dyString *dy = dyStringNew(0);
+int i;
+for (i=0; i<queryCount; ++i)
+    {
+    char *query = queries[i];
+    ++sqlTotalQueries;
+    if (monitorFlags & JKSQL_TRACE)
+	monitorPrintQuery(sc, query);
+    if (startsWith(NOSQLINJ "", query))
+	query += NOSQLINJ_SIZE;
+    else
+	sqlCheckError("Unvetted query: %s", query);
+    if (strstr(query, NOSQLINJ ""))
+        errAbort("Multiple occurrences of NOSQLINJ tag in query: %s", query);
+    sqlTableMemoCheckQuery(sc, query);
+    if (i > 0)
+        dyStringAppendC(dy, ';');
+    dyStringAppend(dy, query);
+    }
+
+sqlConnectIfUnconnected(sc, TRUE);
+assert(!sc->isFree);
+struct sqlResult **results;
+AllocArray(results, queryCount);
+monitorEnter();
+if (mysql_set_server_option(sc->conn, MYSQL_OPTION_MULTI_STATEMENTS_ON) != 0)
+    {
+    /* Server won't do it, so do it the slow way. */
+    monitorLeave();
+    dyStringFree(&dy);
+    freeMem(results);
+    sqlTotalQueries -= queryCount;
+    return sqlGetResultEach(sc, queries, queryCount);
+    }
+int status = mysql_real_query(sc->conn, dy->string, dy->stringSize);
+for (i=0; status == 0; ++i)
+    {
+    MYSQL_RES *resSet = mysql_store_result(sc->conn);
+    if (resSet == NULL && mysql_errno(sc->conn) != 0)
+        break;
+    if (i >= queryCount)
+        {
+	/* More statements than queries, one must have had a semicolon in it. */
+	mysql_free_result(resSet);
+	}
+    else if (resSet != NULL)
+        {
+	struct sqlResult *res;
+	AllocVar(res);
+	res->conn = sc;
+	res->result = resSet;
+	res->node = dlAddValTail(sc->resultList, res);
+	results[i] = res;
+	}
+    status = mysql_next_result(sc->conn);
+    }
+boolean ok = (status == -1 && i == queryCount);
+int failIx = i;
+/* Get any results after an error out of the way so connection can be used again. */
+while (mysql_more_results(sc->conn) && mysql_next_result(sc->conn) == 0)
+    mysql_free_result(mysql_store_result(sc->conn));
+unsigned int errNo = mysql_errno(sc->conn);
+char errMsg[512];
+safecpy(errMsg, sizeof(errMsg), mysql_error(sc->conn));
+/* Only let statements be combined here, never in queries run elsewhere. */
+mysql_set_server_option(sc->conn, MYSQL_OPTION_MULTI_STATEMENTS_OFF);
+long deltaTime = monitorLeave();
+if (monitorFlags & JKSQL_TRACE)
+    monitorPrint(sc, "SQL_TIME", "%0.3fs", ((double)deltaTime)/1000.0);
+if (!ok)
+    {
+    for (i=0; i<queryCount; ++i)
+        sqlFreeResult(&results[i]);
+    freeMem(results);
+    if (errNo != 0)
+	errAbort("mySQL error %u in statement %d of batch: %s\n%s", errNo, failIx+1, errMsg,
+		dy->string);
+    errAbort("Batch of %d queries gave different number of results:\n%s", queryCount,
+	    dy->string);
+    }
+dyStringFree(&dy);
+return results;
+}
+
 
 void sqlUpdate(struct sqlConnection *conn, char *query)
 /* Tell database to do something that produces no results table. */
@@ -2609,6 +3037,16 @@ struct sqlResult *sr;
 char **row;
 int i = 0, ix=-1;
 
+char key[1024];
+if (sqlTableMemoKey(conn, table, key, sizeof(key)))
+    {
+    struct slName *el;
+    for (el = sqlMemoFields(conn, table, key); el != NULL; el = el->next, ++i)
+        if (sameString(el->name, field))
+	    return i;
+    return -1;
+    }
+
 /* Read table description into hash. */
 sr = sqlDescribe(conn, table);
 while ((row = sqlNextRow(sr)) != NULL)
@@ -2627,15 +3065,7 @@ return ix;
 struct slName *sqlFieldNames(struct sqlConnection *conn, char *table)
 /* Returns field names from a table. */
 {
-struct slName *list = NULL;
-struct sqlResult *sr;
-char **row;
-sr = sqlDescribe(conn, table);
-while ((row = sqlNextRow(sr)) != NULL)
-    slNameAddHead(&list, row[0]);
-sqlFreeResult(&sr);
-slReverse(&list);
-return list;
+return sqlListFields(conn, table);
 }
 
 unsigned int sqlLastAutoId(struct sqlConnection *conn)
@@ -2777,6 +3207,10 @@ if (sc->conn)
     if (resCode!=0)
         monitorPrint(sc, "SQL_SET_DB_ERROR", "%d", resCode);
     }
+// memo keys are now in the new database, or in one that is not known
+freez(&sc->memoDb);
+if (sc->conn && resCode == 0)
+    sc->memoDb = cloneString(database);
 
 sc->hasTableCache = -1; // -1 = undefined
 return resCode;
@@ -90,6 +90,16 @@ struct chain *chain;
 
 while ((chain = chainRead(lf)) != NULL)
     liftOverAddChainHash(chainHash, chain);
+lineFileClose(&lf);
+
+/* Pack chains into arrays for faster lookups.  More can still be added later. */
+struct hashCookie cookie = hashFirst(chainHash);
+struct hashEl *hel;
+while ((hel = hashNext(&cookie)) != NULL)
+    {
+    struct chromMap *map = hel->val;
+    binKeeperFreeze(map->bk);
+    }
 }
 
 static struct binElement *findRange(struct hash *chainHash, 
@@ -34,6 +34,11 @@
 //#include <curl/curl.h>
 #include <iterator>
 #include <algorithm>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
 #include "zlib.h"
 #include "straw.h"
 extern "C" {
@@ -1089,14 +1094,10 @@ long getNumRecordsInBlock(const string &fileName, indexEntry idx, int32_t versio
     return nRecords;
 }
 
-// this is the meat of reading the data.  takes in the block number and returns the set of contact records corresponding to
-// that block.  the block data is compressed and must be decompressed using the zlib library functions
-vector<contactRecord> readBlock(const string &fileName, indexEntry idx, int32_t version) {
-    if (idx.size <= 0) {
-        vector<contactRecord> v;
-        return v;
-    }
-    char *compressedBytes = readCompressedBytesFromFile(fileName, idx);
+// this is the meat of reading the data.  takes the compressed bytes of one block and returns the set of contact
+// records in it.  the block data is compressed and must be decompressed using the zlib library functions.
+// Frees compressedBytes.  Touches no shared state, so several blocks may be decoded at once.
+vector<contactRecord> decodeBlock(indexEntry idx, char *compressedBytes, int32_t version) {
     char *uncompressedBytes = new char[idx.size * 10]; //biggest seen so far is 3
     int32_t uncompressedSize = decompressBlock(idx, compressedBytes, uncompressedBytes);
 
@@ -1224,6 +1225,110 @@ vector<contactRecord> readBlock(const string &fileName, indexEntry idx, int32_t
     return v;
 }
 
+// Added UCSC: the browser asks for overlapping windows of the same matrix again and again as the user
+// scrolls and zooms, and every straw() call used to re-read and re-inflate each block it touched.
+// Decoded blocks are now kept in a process-wide least-recently-used cache bounded by the number of
+// contact records held.  A block's file offset identifies it uniquely within a file regardless of
+// chromosome pair, unit or resolution, so the key is just (file name, offset).
+typedef shared_ptr<const vector<contactRecord> > blockRecords;
+
+class BlockCache {
+    typedef pair<string, int64_t> blockKey;
+    typedef list<pair<blockKey, blockRecords> > lruList;
+    mutex lock;
+    lruList lru;    // most recently used first
+    map<blockKey, lruList::iterator> index;
+    size_t recordCount = 0;
+    size_t maxRecords;
+
+public:
+    explicit BlockCache(size_t maxRecords) : maxRecords(maxRecords) {}
+
+    blockRecords get(const string &fileName, int64_t position) {
+        lock_guard<mutex> guard(lock);
+        auto it = index.find(blockKey(fileName, position));
+        if (it == index.end()) {
+            return blockRecords();
+        }
+        lru.splice(lru.begin(), lru, it->second);
+        return it->second->second;
+    }
+
+    void put(const string &fileName, int64_t position, const blockRecords &records) {
+        lock_guard<mutex> guard(lock);
+        blockKey key(fileName, position);
+        if (index.count(key) != 0) {
+            return;
+        }
+        lru.emplace_front(key, records);
+        index[key] = lru.begin();
+        recordCount += records->size();
+        // always keep the newest block, even if it alone exceeds the limit
+        while (recordCount > maxRecords && lru.size() > 1) {
+            recordCount -= lru.back().second->size();
+            index.erase(lru.back().first);
+            lru.pop_back();
+        }
+    }
+};
+
+// 8 million records is a little under 100MB
+static BlockCache blockCache(8000000);
+
+// upper limit on threads used to inflate the blocks of one query
+static const unsigned maxInflateThreads = 8;
+
+// returns the decoded records of each of the given blocks, in the same order.  Blocks not already in
+// the cache are read with a single open of the file, then inflated and parsed in parallel.
+vector<blockRecords> readBlocks(const string &fileName, const vector<indexEntry> &entries, int32_t version) {
+    vector<blockRecords> blocks(entries.size());
+    vector<size_t> missing;
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (entries[i].size <= 0) {
+            blocks[i] = make_shared<const vector<contactRecord> >();
+        } else if (!(blocks[i] = blockCache.get(fileName, entries[i].position))) {
+            missing.push_back(i);
+        }
+    }
+    if (missing.empty()) {
+        return blocks;
+    }
+
+    vector<char *> compressed(missing.size());
+    HiCFileStream *stream = new HiCFileStream(fileName);
+    for (size_t i = 0; i < missing.size(); i++) {
+        compressed[i] = stream->readCompressedBytes(entries[missing[i]]);
+    }
+    stream->close();
+    delete stream;
+
+    atomic<size_t> next(0);
+    auto inflateWorker = [&]() {
+        size_t i;
+        while ((i = next++) < missing.size()) {
+            size_t b = missing[i];
+            blocks[b] = make_shared<const vector<contactRecord> >(decodeBlock(entries[b], compressed[i], version));
+        }
+    };
+    unsigned threadCount = min<size_t>(min(thread::hardware_concurrency(), maxInflateThreads), missing.size());
+    if (threadCount <= 1) {
+        inflateWorker();
+    } else {
+        vector<thread> threads;
+        for (unsigned t = 0; t < threadCount; t++) {
+            threads.emplace_back(inflateWorker);
+        }
+        for (thread &t : threads) {
+            t.join();
+        }
+    }
+
+    for (size_t b : missing) {
+        blockCache.put(fileName, entries[b].position, blocks[b]);
+    }
+    return blocks;
+}
+
 // reads the normalization vector from the file at the specified location
 vector<double> readNormalizationVector(istream &bufferin, int32_t version) {
     int64_t nValues;
@@ -1397,13 +1502,15 @@ public:
         convertGenomeToBinPos(origRegionIndices, regionIndices, resolution);
 
         set<int32_t> blockNumbers = getBlockNumbers(regionIndices);
-        vector<contactRecord> records;
+        vector<indexEntry> entries;
         for (int32_t blockNumber : blockNumbers) {
+            entries.push_back(blockMap[blockNumber]);
+        }
+        vector<blockRecords> blocks = readBlocks(fileName, entries, version);
+        vector<contactRecord> records;
+        for (const blockRecords &block : blocks) {
             // get contacts in this block
-            //cout << *it << " -- " << blockMap.size() << endl;
-            //cout << blockMap[*it].size << " " <<  blockMap[*it].position << endl;
-            vector<contactRecord> tmp_records = readBlock(fileName, blockMap[blockNumber], version);
-            for (contactRecord rec : tmp_records) {
+            for (const contactRecord &rec : *block) {
                 int64_t x = rec.binX * resolution;
                 int64_t y = rec.binY * resolution;
 
@@ -18,6 +18,7 @@
 #include "chainBlock.h"
 #include "gapCalc.h"
 #include "chainConnect.h"
+#include "pthreadDoList.h"
 
 
 /* Variables set via command line. */
@@ -26,6 +27,7 @@ char *detailsName = NULL;
 char *gapFileName = NULL;
 struct gapCalc *gapCalc = NULL;	/* Gap scoring scheme to use. */
 struct axtScoreScheme *scoreScheme = NULL;
+int threads = 1;
 
 void usage()
 /* Explain usage and exit. */
@@ -43,6 +45,8 @@ errAbort(
   "                NOTE: will not work with gzipped fasta files\n"
   "   -minScore=N  Minimum score for chain, default %d\n"
   "   -details=fileName Output some additional chain details\n"
+  "   -threads=N Number of sequence pairs to chain at once, default %d.  Output is the\n"
+  "              same as with one thread, but more sequence is held in memory.\n"
   "   -scoreScheme=fileName Read the scoring matrix from a blastz-format file\n"
   "   -linearGap=<medium|loose|filename> Specify type of linearGap to use.\n"
   "              *Must* specify this argument to one of these choices.\n"
@@ -51,7 +55,7 @@ errAbort(
   "              Or specify a piecewise linearGap tab delimited file.\n"
   "   sample linearGap file (loose)\n"
   "%s"
-  , minScore, gapCalcSampleFileContents()
+  , minScore, threads, gapCalcSampleFileContents()
   );
 }
 
@@ -116,58 +120,104 @@ if (tbf == NULL)
 return tbf;
 }
 
-void loadIfNewSeq(char *seqPath, boolean isTwoBit, char *newName, char strand,
-	char **pName, struct dnaSeq **pSeq, char *pStrand)
-/* Load sequence unless it is already loaded.  Reverse complement
- * if necessary. */
+struct cachedSeq
+/* A sequence loaded for chaining, on the strand it is needed on. */
+    {
+    struct dnaSeq *seq;		/* Sequence, reverse complemented if on minus strand. */
+    boolean owned;		/* If TRUE free seq when done, else it belongs to fa hash. */
+    boolean needed;		/* Used to decide what to keep between batches. */
+    };
+
+static void cachedSeqKey(char *name, char strand, char *key, int keySize)
+/* Make up key for sequence cache. */
 {
-struct dnaSeq *seq;
-if (sameString(newName, *pName))
+safef(key, keySize, "%s%c", name, strand);
+}
+
+static void markCachedSeqNeeded(struct hash *cache, char *name, char strand)
+/* Mark sequence as needed if it is already in cache. */
+{
+char key[512];
+cachedSeqKey(name, strand, key, sizeof(key));
+struct cachedSeq *cs = hashFindVal(cache, key);
+if (cs != NULL)
+    cs->needed = TRUE;
+}
+
+static void cachedSeqFree(struct cachedSeq **pCs)
+/* Free up cached sequence and the sequence itself if we own it. */
+{
+struct cachedSeq *cs = *pCs;
+if (cs != NULL)
     {
-    if (strand != *pStrand)
-        {
-	seq = *pSeq;
-	reverseComplement(seq->dna, seq->size);
-	*pStrand = strand;
-	}
+    if (cs->owned)
+        freeDnaSeq(&cs->seq);
+    freez(pCs);
     }
-else
+}
+
+static void pruneSeqCache(struct hash *cache)
+/* Free sequences not marked as needed, and clear needed flag on the rest. */
+{
+struct hashEl *el, *list = hashElListHash(cache);
+for (el = list; el != NULL; el = el->next)
     {
-    char fileName[512];
-    freeDnaSeq(pSeq);
-    if (isTwoBit)
-        {
-	struct twoBitFile *tbf = twoBitOpenCached(seqPath);
-	*pSeq = seq = twoBitReadSeqFrag(tbf, newName, 0, 0);
-	verbose(1, "Loaded %d bases of %s from %s\n", seq->size, newName, seqPath);
-	}
+    struct cachedSeq *cs = el->val;
+    if (cs->needed)
+        cs->needed = FALSE;
     else
-	{
-	snprintf(fileName, sizeof(fileName), "%s/%s.nib", seqPath, newName);
-	*pSeq = seq = nibLoadAllMasked(NIB_MASK_MIXED, fileName);
-	verbose(1, "Loaded %d bases in %s\n", seq->size, fileName);
+        {
+	hashRemove(cache, el->name);
+	cachedSeqFree(&cs);
 	}
-    *pName = newName;
-    *pStrand = strand;
-    if (strand == '-')
-	reverseComplement(seq->dna, seq->size);
     }
+hashElFreeList(&list);
 }
 
-static void loadFaSeq(struct hash *faHash, char *newName,
-	char **pName, struct dnaSeq **pSeq, char *fastaFileName)
-/* retrieve sequence from hash.  Leave reverse complementing (and restoration to original strand)
- * up to caller. */
+static struct dnaSeq *cachedSeqGet(struct hash *cache, char *seqPath, boolean isTwoBit,
+	struct hash *faHash, char *name, char strand)
+/* Return sequence from cache, loading it from a 2bit file, nib directory or the
+ * fa hash if it is not already there.  The sequence is reverse complemented if
+ * strand is '-' and should not be altered by the caller. */
 {
+char key[512];
+cachedSeqKey(name, strand, key, sizeof(key));
+struct cachedSeq *cs = hashFindVal(cache, key);
+if (cs != NULL)
+    return cs->seq;
 struct dnaSeq *seq;
-if (differentString(newName, *pName))
+boolean owned = TRUE;
+if (faHash != NULL)
     {
-    *pName = newName;
-    *pSeq = seq = hashFindVal(faHash, newName);
+    seq = hashFindVal(faHash, name);
     if (NULL == seq)
-        errAbort("ERROR: can not find sequence name '%s' from fasta file '%s'\n", newName, fastaFileName);
-    verbose(1, "Loaded %d bases from %s fa\n", seq->size, newName);
+        errAbort("ERROR: can not find sequence name '%s' from fasta file '%s'\n", name, seqPath);
+    verbose(1, "Loaded %d bases from %s fa\n", seq->size, name);
+    if (strand == '-')
+        seq = cloneDnaSeq(seq);
+    else
+        owned = FALSE;
+    }
+else if (isTwoBit)
+    {
+    struct twoBitFile *tbf = twoBitOpenCached(seqPath);
+    seq = twoBitReadSeqFrag(tbf, name, 0, 0);
+    verbose(1, "Loaded %d bases of %s from %s\n", seq->size, name, seqPath);
     }
+else
+    {
+    char fileName[512];
+    safef(fileName, sizeof(fileName), "%s/%s.nib", seqPath, name);
+    seq = nibLoadAllMasked(NIB_MASK_MIXED, fileName);
+    verbose(1, "Loaded %d bases in %s\n", seq->size, fileName);
+    }
+if (strand == '-')
+    reverseComplement(seq->dna, seq->size);
+AllocVar(cs);
+cs->seq = seq;
+cs->owned = owned;
+hashAdd(cache, key, cs);
+return seq;
 }
 
 void removeExactOverlaps(struct cBlock **pBoxList)
@@ -376,20 +426,48 @@ dyStringFree(&dy);
 return spList;
 }
 
+struct chainJob
+/* Chaining of one sequence pair, which can be done in parallel with others. */
+    {
+    struct chainJob *next;
+    struct seqPair *sp;		/* Blocks to chain. */
+    struct dnaSeq *qSeq;	/* Query sequence on strand of pair, shared with other jobs. */
+    struct dnaSeq *tSeq;	/* Target sequence, shared with other jobs. */
+    struct chain *chainList;	/* Chains over minScore. */
+    char *detailsBuf;		/* Output for -details, or NULL. */
+    size_t detailsSize;		/* Size of detailsBuf. */
+    };
+
+static void chainJobDo(void *item, void *context)
+/* Chain up one sequence pair.  Called in parallel by pthreadDoList. */
+{
+struct chainJob *job = item;
+struct seqPair *sp = job->sp;
+FILE *details = NULL;
+slReverse(&sp->blockList);
+removeExactOverlaps(&sp->blockList);
+verbose(1, "%d blocks after duplicate removal\n", slCount(sp->blockList));
+if (detailsName != NULL)
+    {
+    details = open_memstream(&job->detailsBuf, &job->detailsSize);
+    if (details == NULL)
+        errnoAbort("Couldn't open memory stream for details");
+    }
+chainPair(sp, job->qSeq, job->tSeq, &job->chainList, details);
+carefulClose(&details);
+}
+
 void axtChain(char *axtIn, char *tNibDir, char *qNibDir, char *chainOut)
 /* axtChain - Chain together axt alignments.. */
 {
 struct hash *pairHash = newHash(0);  /* Hash keyed by qSeq<strand>tSeq */
 struct seqPair *spList = NULL, *sp;
 FILE *f = mustOpen(chainOut, "w");
-char *qName = "",  *tName = "";
-struct dnaSeq *qSeq = NULL, *tSeq = NULL;
-char qStrand = 0, tStrand = 0;
 struct chain *chainList = NULL, *chain;
 FILE *details = NULL;
 struct dnaSeq *seq = NULL;
-struct hash *qFaHash = newHash(0);
-struct hash *tFaHash = newHash(0);
+struct hash *qFaHash = NULL;
+struct hash *tFaHash = NULL;
 FILE *faF;
 boolean qIsTwoBit = twoBitIsFile(qNibDir);
 boolean tIsTwoBit = twoBitIsFile(tNibDir);
@@ -408,55 +486,66 @@ else
 
 if (qIsFa)
     {
+    qFaHash = newHash(0);
     faF = mustOpen(qNibDir, "r");
     verbose(1, "reading query fasta sequence from '%s'\n", qNibDir);
     while ( faReadMixedNext(faF, TRUE, NULL, TRUE, NULL, &seq))
         hashAdd(qFaHash, seq->name, seq);
     fclose(faF);
     }
+else if (! qIsTwoBit && ! isDirectory(qNibDir))
+    errAbort("given qNibDir argument: '%s' is not a 2bit file or a directory\n", qNibDir);
 if (tIsFa)
     {
+    tFaHash = newHash(0);
     faF = mustOpen(tNibDir, "r");
     verbose(1, "reading target fasta sequence from '%s'\n", tNibDir);
     while ( faReadMixedNext(faF, TRUE, NULL, TRUE, NULL, &seq))
         hashAdd(tFaHash, seq->name, seq);
     fclose(faF);
     }
-for (sp = spList; sp != NULL; sp = sp->next)
+else if (! tIsTwoBit && ! isDirectory(tNibDir))
+    errAbort("given tNibDir argument: '%s' is not a 2bit file or a directory\n", tNibDir);
+
+/* Chain up sequence pairs a batch at a time.  The sequences for a batch are loaded
+ * here and shared read-only between threads.  Ones still needed by the next batch
+ * are kept, so consecutive pairs on the same target only load it once. */
+struct hash *qCache = newHashExt(0, FALSE), *tCache = newHashExt(0, FALSE);
+while (spList != NULL)
     {
-    slReverse(&sp->blockList);
-    removeExactOverlaps(&sp->blockList);
-    verbose(1, "%d blocks after duplicate removal\n", slCount(sp->blockList));
-    if (qIsFa)
+    struct chainJob *jobList = NULL, *job;
+    int i;
+    for (i=0; i<threads && spList != NULL; ++i)
         {
-        assert (qFaHash != NULL);
-        loadFaSeq(qFaHash, sp->qName, &qName, &qSeq, qNibDir);
-        qStrand = sp->qStrand;
-        if (sp->qStrand == '-')
-            reverseComplement(qSeq->dna, qSeq->size);
-        }
-    else
-	{
-	if (! qIsTwoBit && ! isDirectory(qNibDir))
-	    errAbort("given qNibDir argument: '%s' is not a 2bit file or a directory\n", qNibDir);
-	loadIfNewSeq(qNibDir, qIsTwoBit, sp->qName, sp->qStrand,
-		&qName, &qSeq, &qStrand);
+	AllocVar(job);
+	job->sp = slPopHead(&spList);
+	slAddHead(&jobList, job);
 	}
-    if (tIsFa)
-	{
-	assert (tFaHash != NULL);
-	loadFaSeq(tFaHash, sp->tName, &tName, &tSeq, tNibDir);
+    slReverse(&jobList);
+    for (job = jobList; job != NULL; job = job->next)
+        {
+	markCachedSeqNeeded(qCache, job->sp->qName, job->sp->qStrand);
+	markCachedSeqNeeded(tCache, job->sp->tName, '+');
 	}
-    else
-	{
-	if (! tIsTwoBit && ! isDirectory(tNibDir))
-	    errAbort("given tNibDir argument: '%s' is not a 2bit file or a directory\n", tNibDir);
-	loadIfNewSeq(tNibDir, tIsTwoBit, sp->tName, '+',
-		&tName, &tSeq, &tStrand);
+    pruneSeqCache(qCache);
+    pruneSeqCache(tCache);
+    for (job = jobList; job != NULL; job = job->next)
+        {
+	sp = job->sp;
+	job->qSeq = cachedSeqGet(qCache, qNibDir, qIsTwoBit, qFaHash, sp->qName, sp->qStrand);
+	job->tSeq = cachedSeqGet(tCache, tNibDir, tIsTwoBit, tFaHash, sp->tName, '+');
+	}
+    pthreadDoList(threads, jobList, chainJobDo, NULL);
+
+    /* Collect results in the same order as if chained one pair at a time. */
+    while ((job = slPopHead(&jobList)) != NULL)
+        {
+	chainList = slCat(job->chainList, chainList);
+	if (details != NULL)
+	    mustWrite(details, job->detailsBuf, job->detailsSize);
+	freeMem(job->detailsBuf);
+	freez(&job);
 	}
-    chainPair(sp, qSeq, tSeq, &chainList, details);
-    if (qIsFa && sp->qStrand == '-')
-        reverseComplement(qSeq->dna, qSeq->size);
     }
 slSort(&chainList, chainCmpScore);
 for (chain = chainList; chain != NULL; chain = chain->next)
@@ -466,6 +555,7 @@ for (chain = chainList; chain != NULL; chain = chain->next)
     chainWrite(chain, f);
     }
 
+carefulClose(&details);
 carefulClose(&f);
 }
 
@@ -486,6 +576,9 @@ minScore = optionInt("minScore", minScore);
 detailsName = optionVal("details", NULL);
 gapFileName = optionVal("linearGap", NULL);
 scoreSchemeName = optionVal("scoreScheme", NULL);
+threads = optionInt("threads", threads);
+if (threads < 1 || threads > 256)
+    errAbort("-threads must be between 1 and 256");
 
 if (argc != 5)
     usage();
@@ -6,18 +6,17 @@
 #include "linefile.h"
 #include "hash.h"
 #include "options.h"
-#include "dlist.h"
 #include "chainBlock.h"
 #include "verbose.h"
 #include "portable.h"
-#include "quickHeap.h"
+#include "extSort.h"
 
 
-#define MAXFILES 400
-
 boolean saveId = FALSE;
 char *inputList = NULL;
 char *tempDir = "./";
+int maxMem = 1024;
+int threads = 1;
 
 
 void usage()
@@ -32,7 +31,11 @@ errAbort(
   "   -saveId - keep the existing chain ids.\n"
   "   -inputList=somefile - somefile contains list of input chain files.\n"
   "   -tempDir=somedir/ - somedir has space for temporary sorting data, default ./\n"
-  );
+  "   -maxMem=N - use about N megabytes of memory, default %d.  More chains than\n"
+  "               fit are sorted in pieces in tempDir that are merged at the end.\n"
+  "   -threads=N - number of threads to sort with, default %d\n"
+  "The input files need not be sorted themselves.\n"
+  , maxMem, threads);
 }
 
 /* command line option specifications */
@@ -40,198 +43,104 @@ static struct optionSpec optionSpecs[] = {
     {"saveId"   , OPTION_BOOLEAN},
     {"inputList", OPTION_STRING},
     {"tempDir"  , OPTION_STRING},
+    {"maxMem"   , OPTION_INT},
+    {"threads"  , OPTION_INT},
     {NULL, 0}
 };
 
 
-struct chainFile 
-/* A line file and the current chain from it. */
-    {
-    struct lineFile *lf;
-    struct chain *chain;
-    };
-
-
-static void cfEof(struct chainFile **pCf, int level)
-/* deal with EOF */
+void addChainFile(struct extSort *es, char *fileName, FILE *out)
+/* Add chains in file to sorter, highest score first. */
 {
-struct chainFile *cf = *pCf;
-char fname[PATH_LEN];  /* order important next few lines */
-safef(fname,sizeof(fname),"%s",cf->lf->fileName);
-lineFileClose(&cf->lf);
-if (level > 0)          /* if not original input level, then */
-    remove(fname);      /* remove temp file */
-freez(pCf);
+struct lineFile *lf = lineFileOpen(fileName, TRUE);
+struct chain *chain;
+char *buf = NULL;
+size_t size = 0;
+FILE *f = open_memstream(&buf, &size);
+if (f == NULL)
+    errnoAbort("Couldn't open memory stream for chains");
+lineFileSetMetaDataOutput(lf, out);
+while ((chain = chainRead(lf)) != NULL)
+    {
+    rewind(f);
+    chainWrite(chain, f);
+    fflush(f);
+    extSortAdd(es, "", ~extSortDoubleNum(chain->score), buf, size);
+    chainFree(&chain);
+    }
+carefulClose(&f);
+freeMem(buf);
+lineFileClose(&lf);
 }
 
-static int cmpChainScores(const void *elem1,  const void *elem2)
-/* Compare two chains by score, return elem1-score - elem2-score,
- * where the scores will be positive or 0. 
- * However since the scores are doubles, this is larger than the 
- * return range of int, so return 1, 0, or -1.
- */
+void writeWithId(char *text, int size, int id, FILE *out)
+/* Write out chain text replacing id, which is the last word of first line. */
 {
-struct chainFile *e1 = (struct chainFile *) elem1;
-struct chainFile *e2 = (struct chainFile *) elem2;
-double diff = e1->chain->score - e2->chain->score;
-if (diff > 0.0) 
-    return 1;
-if (diff < 0.0) 
-    return -1;
-return  0;
+char *lineEnd = memchr(text, '\n', size);
+char *idStart;
+if (lineEnd == NULL)
+    errAbort("Missing end of line in chain %.*s", size, text);
+for (idStart = lineEnd; idStart > text && idStart[-1] != ' '; --idStart)
+    ;
+mustWrite(out, text, idStart - text);
+fprintf(out, "%d", id);
+mustWrite(out, lineEnd, size - (lineEnd - text));
 }
 
-void chainMergeSort(int fileCount, char *files[], FILE *out, int level)
+void chainMergeSort(struct slName *fileList, FILE *out)
 /* chainMergeSort - Combine sorted files into larger sorted file. */
 {
-int i;
-struct chainFile *cf;
-int id = 0;
-struct quickHeap *h = NULL;
+struct extSort *es = extSortNew(tempDir, maxMem*1024LL*1024, threads);
+struct slName *file;
+char *text;
+int size, id = 0;
 
-h = newQuickHeap(fileCount, &cmpChainScores);
-
-/* Open up all input files and read first chain. */
-for (i=0; i<fileCount; ++i)
+for (file = fileList; file != NULL; file = file->next)
     {
-    AllocVar(cf);
-    cf->lf = lineFileOpen(files[i], TRUE);
-    lineFileSetMetaDataOutput(cf->lf, out);
-    cf->chain = chainRead(cf->lf);
-    if (cf->chain)
-    	addToQuickHeap(h, cf);
-    else
-	cfEof(&cf,level);  /* deal with EOF */
+    verbose(2, "Reading %s\n", file->name);
+    addChainFile(es, file->name, out);
     }
-
-while (!quickHeapEmpty(h))
+while (extSortNext(es, NULL, NULL, &text, &size))
     {
-    cf = peekQuickHeapTop(h);
-    if (!saveId)
-	cf->chain->id = ++id;		/* We reset id's here. */
-    chainWrite(cf->chain, out);
-    chainFree(&cf->chain);
-    if ((cf->chain = chainRead(cf->lf)))
-	{
-	quickHeapTopChanged(h);
-	}
+    if (saveId)
+	mustWrite(out, text, size);
     else
-	{ /* deal with EOF */
-	if (!removeFromQuickHeapByElem(h, cf))
-	    errAbort("unexpected error: chainFile not found on heap");
-	cfEof(&cf,level);  
-	}
+	writeWithId(text, size, ++id, out);
     }
-
-freeQuickHeap(&h);
-
-}
-
-void hierSort(char *inputList)
-/* Do a hierarchical merge sort so we don't run out of system file handles */
-{
-int level = 0;
-char thisName[PATH_LEN]; 
-char nextName[PATH_LEN]; 
-char sortName[PATH_LEN]; 
-char tmpNameBuf[PATH_LEN]; 
-struct lineFile *thisLf = NULL;
-FILE *nextF = NULL;
-int sortCount = 0;
-FILE *sortF = NULL;
-int fileCount = 0; 
-char *files[MAXFILES];
-boolean more = FALSE;
-int block=0;
-char *line=NULL;
-safef(nextName, sizeof(nextName), "%s", inputList);
-do
-    {
-    block=0;
-    safef(thisName, sizeof(thisName), "%s", nextName);
-    safef(tmpNameBuf, sizeof(tmpNameBuf), "inputList%d-", level+1);
-    safecpy(nextName, sizeof(nextName), rTempName(tempDir, tmpNameBuf, ".tmp"));
-    thisLf = lineFileOpen(thisName,TRUE);
-    if (!thisLf)
-	errAbort("error  lineFileOpen(%s) returned NULL\n",thisName);
-    more = lineFileNext(thisLf, &line, NULL);
-    while (more)
-	{
-	int i=0;
-	fileCount = 0;
-	while (more && fileCount < MAXFILES) 
-	    {
-	    files[fileCount++]=cloneString(line);
-	    more = lineFileNext(thisLf, &line, NULL);
-    	    }
-	if (!more && block==0)
-	    { /* last level */
-	    sortF = stdout;
-	    }
-	else
-	    {
-	    if (!nextF)
-		nextF = mustOpen(nextName,"w");
-	    safef(tmpNameBuf, sizeof(tmpNameBuf), "sort%d-", sortCount++);
-	    safecpy(sortName, sizeof(sortName), rTempName(tempDir, tmpNameBuf, ".tmp"));
-	    fprintf(nextF, "%s\n", sortName);
-	    sortF = mustOpen(sortName,"w");
-	    }
-    	chainMergeSort(fileCount, files, sortF, level);
-	if (sortF != stdout)
-    	    carefulClose(&sortF);
-	for(i=0;i<fileCount;++i)	    
-    	    freez(&files[i]);
-	verboseDot();
-	verbose(2,"block=%d\n",block);
-	++block;
-	}
-    lineFileClose(&thisLf);
-    if (nextF)
-	carefulClose(&nextF);
-    if (level > 0)
-	{
-	remove(thisName);
-	}
-    verbose(1,"\n");
-    verbose(2,"level=%d, block=%d\n",level,block);
-    ++level;
-    } while (block > 1);
+extSortFree(&es);
 }
 
 int main(int argc, char *argv[])
 /* Process command line. */
 {
+struct slName *fileList = NULL;
 optionInit(&argc, argv, optionSpecs);
 saveId = optionExists("saveId");
 inputList = optionVal("inputList",inputList);
 tempDir = optionVal("tempDir",tempDir);
+maxMem = optionInt("maxMem", maxMem);
+threads = optionInt("threads", threads);
 if ((argc < 2 && !inputList) || (argc > 1 && inputList))
     usage();
-if (tempDir[0]!=0 && lastChar(tempDir) != '/')
-    tempDir = addSuffix(tempDir,"/");
-if (argc-1 <= MAXFILES && !inputList)
+if (maxMem < 1)
+    errAbort("-maxMem must be at least 1");
+if (threads < 1 || threads > 256)
+    errAbort("-threads must be between 1 and 256");
+if (inputList)
     {
-    chainMergeSort(argc-1, argv+1, stdout, 0);
+    struct lineFile *lf = lineFileOpen(inputList, TRUE);
+    char *line;
+    while (lineFileNext(lf, &line, NULL))
+	slNameAddHead(&fileList, line);
+    lineFileClose(&lf);
+    slReverse(&fileList);
     }
-else 
+else
     {
-    char inp0[PATH_LEN];
-    safecpy(inp0, sizeof(inp0), rTempName(tempDir, "inputList0-", ".tmp"));
-    if (!inputList)
-	{
-	FILE *f = mustOpen(inp0,"w");
-	int i=0;
-	for (i=1; i<argc; ++i)
-	    {
-	    fprintf(f, "%s\n", argv[i]);
-	    }
-	carefulClose(&f);
-	inputList = inp0;
-	}
-    hierSort(inputList);
-    if (sameString(inputList,inp0))
-	remove(inp0);
+    int i;
+    for (i=1; i<argc; ++i)
+	slNameAddTail(&fileList, argv[i]);
     }
+chainMergeSort(fileList, stdout);
 return 0;
 }
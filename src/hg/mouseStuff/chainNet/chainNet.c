@@ -11,6 +11,7 @@
 #include "rbTree.h"
 #include "chainBlock.h"
 #include "portable.h"
+#include "pthreadDoList.h"
 
 #undef BIGNUM
 #define BIGNUM 0x7fffffff	/* larger than the standard size BIGNUM */
@@ -19,6 +20,9 @@ int minSpace = 25;	/* Minimum gap size to fill. */
 int minFill;		/* Minimum fill to record. */
 double minScore = 2000;	/* Minimum chain score to look at. */
 boolean inclHap = FALSE; /* include haplotype pseudochromosome queries */
+int threads = 1;	/* Number of threads to net with. */
+
+#define chainBatchSize 10000	/* Number of chains to read before adding them to nets. */
 
 /* command line option specifications */
 static struct optionSpec optionSpecs[] = {
@@ -26,6 +30,7 @@ static struct optionSpec optionSpecs[] = {
     {"minFill", OPTION_INT},
     {"minScore", OPTION_DOUBLE},
     {"inclHap", OPTION_BOOLEAN},
+    {"threads", OPTION_INT},
     {NULL, 0}
 };
 
@@ -50,7 +55,9 @@ errAbort(
   "   -inclHap - include query sequences name in the form *_hap*|*_alt*.\n"
   "              Normally these are excluded from nets as being haplotype\n"
   "              pseudochromosomes\n"
-  , minSpace, minScore);
+  "   -threads=N - number of threads to use, default %d.  Chromosomes are divided\n"
+  "                between threads, and output is the same however many are used.\n"
+  , minSpace, minScore, threads);
 }
 
 struct gap
@@ -89,6 +96,28 @@ struct chrom
     int size;		    /* Size of chromosome. */
     struct gap *root;	    /* Root of the gap/chain tree */
     struct rbTree *spaces;  /* Store gaps here for fast lookup. Items are spaces. */
+    struct netPart *part;   /* Part of genome this is in. */
+    };
+
+struct netPart
+/* A share of the chromosomes on one side of the net.  Each part has its own memory
+ * for the space trees, so that different parts can be worked on in parallel. */
+    {
+    struct netPart *next;	    /* Next in list. */
+    boolean isQ;		    /* True if part of query side. */
+    struct lm *lm;		    /* Memory for space trees. */
+    struct rbTreeNode **stack;	    /* Stack for space trees. */
+    long long totalSize;	    /* Total size of chromosomes in part. */
+    struct slRef *chromList;	    /* References to chromosomes in part. */
+    struct slRef *netChainList;	    /* Chains to add in current batch, in score order. */
+    };
+
+struct netChain
+/* A chain waiting to be added to the nets. */
+    {
+    struct chain *chain;	/* The chain. */
+    struct chrom *qChrom, *tChrom;  /* Chromosomes on either side. */
+    boolean used;		/* Set if chain fills some space on either side. */
     };
 
 
@@ -167,8 +196,60 @@ boolean strictlyInside(int minStart, int maxEnd, int start, int end)
 return (minStart < start && start + minSpace <= end && end < maxEnd);
 }
 
-void makeChroms(char *fileName, struct lm *lm, struct rbTreeNode **stack,
-	struct hash **retHash, struct chrom **retList)
+int chromCmpSizeDesc(const void *va, const void *vb)
+/* Compare to sort biggest chromosome first. */
+{
+const struct chrom *a = *((struct chrom **)va);
+const struct chrom *b = *((struct chrom **)vb);
+return b->size - a->size;
+}
+
+struct netPart *makeParts(struct chrom *chromList, int partCount, boolean isQ)
+/* Divide chromosomes into partCount parts of about the same total size,
+ * and make space trees for them in the part's memory. */
+{
+struct netPart *partList = NULL, *part;
+int i, chromCount = slCount(chromList);
+struct chrom **chroms, *chrom;
+
+for (i=0; i<partCount; ++i)
+    {
+    AllocVar(part);
+    part->isQ = isQ;
+    part->lm = lmInit(0);
+    lmAllocArray(part->lm, part->stack, 256);
+    slAddHead(&partList, part);
+    }
+
+/* Put each chromosome, biggest first, in the part with least in it so far. */
+AllocArray(chroms, chromCount);
+for (i=0, chrom = chromList; chrom != NULL; ++i, chrom = chrom->next)
+    chroms[i] = chrom;
+qsort(chroms, chromCount, sizeof(chroms[0]), chromCmpSizeDesc);
+for (i=0; i<chromCount; ++i)
+    {
+    struct netPart *smallest = partList;
+    for (part = partList->next; part != NULL; part = part->next)
+        if (part->totalSize < smallest->totalSize)
+	    smallest = part;
+    chrom = chroms[i];
+    chrom->part = smallest;
+    smallest->totalSize += chrom->size;
+    refAdd(&smallest->chromList, chrom);
+    }
+freeMem(chroms);
+
+for (chrom = chromList; chrom != NULL; chrom = chrom->next)
+    {
+    part = chrom->part;
+    chrom->spaces = rbTreeNewDetailed(spaceCmp, part->lm, part->stack);
+    addSpaceForGap(chrom, chrom->root);
+    }
+return partList;
+}
+
+void makeChroms(char *fileName, int partCount, boolean isQ,
+	struct hash **retHash, struct chrom **retList, struct netPart **retParts)
 /* Read size file and make chromosome structure for each  element. */
 {
 char *row[2];
@@ -185,14 +266,13 @@ while (lineFileRow(lf, row))
     slAddHead(&chromList, chrom);
     hashAddSaveName(hash, name, chrom, &chrom->name);
     chrom->size = lineFileNeedNum(lf, row, 1);
-    chrom->spaces = rbTreeNewDetailed(spaceCmp, lm, stack);
     chrom->root = gapNew(0, chrom->size, 0, 0);
-    addSpaceForGap(chrom, chrom->root);
     }
 lineFileClose(&lf);
 slReverse(&chromList);
 *retHash = hash;
 *retList = chromList;
+*retParts = makeParts(chromList, partCount, isQ);
 }
 
 boolean innerBounds(struct cBlock *startBlock,
@@ -364,25 +444,24 @@ slAddHead(&space->gap->fillList, fill);
 return fill;
 }
 
-static struct slRef *fsList;
-
-void fsAdd(void *item)
-/* Add item to fsList. */
+void fsAdd(void *item, void *context)
+/* Add item to list of spaces in context. */
 {
-refAdd(&fsList, item);
+struct slRef **pList = context;
+refAdd(pList, item);
 }
 
 struct slRef *findSpaces(struct rbTree *tree, int start, int end)
 /* Return a list of spaces that intersect interval between start
  * and end. */
 {
-static struct space space;
+struct space space;
+struct slRef *list = NULL;
 space.start = start;
 space.end = end;
-fsList = NULL;
-rbTreeTraverseRange(tree, &space, &space, fsAdd);
-slReverse(&fsList);
-return fsList;
+rbTreeTraverseRangeWithContext(tree, &space, &space, fsAdd, &list);
+slReverse(&list);
+return list;
 }
 
 
@@ -396,11 +475,12 @@ for (b = *pList; b != NULL; b = b->next)
 }
 
 
-void addChainT(struct chrom *chrom, struct chrom *otherChrom, struct chain *chain)
+boolean addChainT(struct chrom *chrom, struct chrom *otherChrom, struct chain *chain)
 /* Add T side of chain to fill/gap tree of chromosome. 
  * This is the easier case since there are no strand
- * issues to worry about. */
+ * issues to worry about.  Returns TRUE if chain fills anything. */
 {
+boolean used = FALSE;
 struct slRef *spaceList;
 struct slRef *ref;
 struct cBlock *startBlock, *block, *nextBlock;
@@ -425,6 +505,7 @@ for (ref = spaceList; ref != NULL; ref = ref->next)
 	}
     if ((fill = fillSpace(chrom, space, chain, startBlock, FALSE)) != NULL)
 	{
+	used = TRUE;
 	for (block = startBlock; ; block = nextBlock)
 	    {
 	    nextBlock = block->next;
@@ -447,13 +528,15 @@ for (ref = spaceList; ref != NULL; ref = ref->next)
 	}
     }
 slFreeList(&spaceList);
+return used;
 }
 
-void addChainQ(struct chrom *chrom, struct chrom *otherChrom, struct chain *chain)
+boolean addChainQ(struct chrom *chrom, struct chrom *otherChrom, struct chain *chain)
 /* Add Q side of chain to fill/gap tree of chromosome. 
  * For this side we have to cope with reverse strand
- * issues. */
+ * issues.  Returns TRUE if chain fills anything. */
 {
+boolean used = FALSE;
 struct slRef *spaceList;
 struct slRef *ref;
 struct cBlock *startBlock, *block, *nextBlock;
@@ -487,6 +570,7 @@ for (ref = spaceList; ref != NULL; ref = ref->next)
     if ((fill = fillSpace(chrom, space, chain, startBlock, TRUE)) 
     	!= NULL)
 	{
+	used = TRUE;
 	for (block = startBlock; ; block = nextBlock)
 	    {
 	    nextBlock = block->next;
@@ -518,13 +602,59 @@ for (ref = spaceList; ref != NULL; ref = ref->next)
 slFreeList(&spaceList);
 if (isRev)
     reverseBlocksQ(&chain->blockList, chain->qSize);
+return used;
 }
 
-void addChain(struct chrom *qChrom, struct chrom *tChrom, struct chain *chain)
-/* Add as much of chain as possible to chromosomes. */
+void addPartChains(void *item, void *context)
+/* Add chains waiting in one part to its side of the nets.  Called in parallel
+ * by pthreadDoList. Chains that fill something are marked as used. */
 {
-addChainQ(qChrom, tChrom, chain);
-addChainT(tChrom, qChrom, chain);
+struct netPart *part = item;
+struct slRef *ref;
+for (ref = part->netChainList; ref != NULL; ref = ref->next)
+    {
+    struct netChain *nc = ref->val;
+    struct chrom *chrom;
+    if (part->isQ)
+        {
+	chrom = nc->qChrom;
+	if (addChainQ(chrom, nc->tChrom, nc->chain))
+	    nc->used = TRUE;
+	}
+    else
+        {
+	chrom = nc->tChrom;
+	if (addChainT(chrom, nc->qChrom, nc->chain))
+	    nc->used = TRUE;
+	}
+    verbose(3, "%s has %d inserts\n", chrom->name, chrom->spaces->n);
+    }
+slFreeList(&part->netChainList);
+}
+
+void addChains(struct netChain *ncs, int ncCount, struct netPart *qParts,
+	struct netPart *tParts)
+/* Add as much of chains as possible to chromosomes, in order.  Free
+ * the chains that don't fill anything. */
+{
+int i;
+for (i=ncCount-1; i>=0; --i)
+    {
+    struct netChain *nc = &ncs[i];
+    refAdd(&nc->qChrom->part->netChainList, nc);
+    refAdd(&nc->tChrom->part->netChainList, nc);
+    }
+
+/* Adding the query side temporarily reverses the blocks of minus strand
+ * chains, so the target side has to wait for it to finish. */
+pthreadDoList(threads, qParts, addPartChains, NULL);
+pthreadDoList(threads, tParts, addPartChains, NULL);
+for (i=0; i<ncCount; ++i)
+    {
+    struct netChain *nc = &ncs[i];
+    if (!nc->used)
+        chainFree(&nc->chain);
+    }
 }
 
 boolean chromHasData(struct chrom *chrom)
@@ -564,42 +694,50 @@ for (fill = gap->fillList; fill != NULL; fill = fill->next)
     }
 }
 
-void finishNet(struct chrom *chromList, boolean isQ)
+void finishPart(void *item, void *context)
 /* Fill in oStart/oEnd fields of fill structures attatched
- * to chromosomes, sort, and generally spiff up net. */
+ * to chromosomes in part, sort, and generally spiff up net.
+ * Called in parallel by pthreadDoList. */
 {
-struct chrom *chrom;
-for (chrom = chromList; chrom != NULL; chrom = chrom->next)
+struct netPart *part = item;
+struct slRef *ref;
+for (ref = part->chromList; ref != NULL; ref = ref->next)
     {
+    struct chrom *chrom = ref->val;
     if (chromHasData(chrom))
 	{
 	sortNet(chrom->root);
-	rCalcOtherFill(chrom->root, isQ);
+	rCalcOtherFill(chrom->root, part->isQ);
 	}
     }
 }
 
+void finishNet(struct netPart *qParts, struct netPart *tParts)
+/* Finish both sides of net. */
+{
+struct netPart *partList = slCat(qParts, tParts);
+pthreadDoList(threads, partList, finishPart, NULL);
+}
 
-int rOutDepth = 0;
-boolean rOutQ = FALSE;
 
-static void rOutputGap(struct fill *parent, struct gap *gap, FILE *f);
-static void rOutputFill(struct fill *fill, FILE *f);
+static void rOutputGap(struct fill *parent, struct gap *gap, FILE *f,
+	int depth, boolean isQ);
+static void rOutputFill(struct fill *fill, FILE *f, int depth, boolean isQ);
 
-static void rOutputGap(struct fill *parent, struct gap *gap, FILE *f)
+static void rOutputGap(struct fill *parent, struct gap *gap, FILE *f,
+	int depth, boolean isQ)
 /* Recursively output gap and it's fillers. */
 {
 struct fill *fill;
 struct chain *chain = parent->chain;
-char *oChrom = (rOutQ ? chain->tName : chain->qName);
-++rOutDepth;
-spaceOut(f, rOutDepth);
+char *oChrom = (isQ ? chain->tName : chain->qName);
+++depth;
+spaceOut(f, depth);
 fprintf(f, "gap %d %d %s %c %d %d\n", 
 	gap->start, gap->end - gap->start,
 	oChrom, chain->qStrand, gap->oStart, gap->oEnd - gap->oStart);
 for (fill = gap->fillList; fill != NULL; fill = fill->next)
-    rOutputFill(fill, f);
---rOutDepth;
+    rOutputFill(fill, f, depth, isQ);
 }
 
 int chainBaseCount(struct chain *chain)
@@ -685,7 +823,7 @@ fprintf(f, "fill %d %d %s %c %d %d id %d score %1.0f ali %d\n",
 	subScore, subSize);
 }
 
-static void rOutputFill(struct fill *fill, FILE *f)
+static void rOutputFill(struct fill *fill, FILE *f, int depth, boolean isQ)
 /* Recursively output fill and it's gaps. */
 {
 struct gap *gap;
@@ -693,34 +831,70 @@ struct chain *chain = fill->chain;
 int subSize;
 double subScore;
 
-subchainInfo(chain, fill->start, fill->end, rOutQ, &subSize, &subScore);
+subchainInfo(chain, fill->start, fill->end, isQ, &subSize, &subScore);
 if (subScore >= minScore && subSize >= minFill)
     {
-    ++rOutDepth;
-    if (rOutQ)
-	fillOut(f, fill, fill->chain->tName, rOutDepth, subSize, subScore);
+    ++depth;
+    if (isQ)
+	fillOut(f, fill, fill->chain->tName, depth, subSize, subScore);
     else
-	fillOut(f, fill, fill->chain->qName, rOutDepth, subSize, subScore);
+	fillOut(f, fill, fill->chain->qName, depth, subSize, subScore);
     for (gap = fill->gapList; gap != NULL; gap = gap->next)
-	rOutputGap(fill, gap, f);
-    --rOutDepth;
+	rOutputGap(fill, gap, f, depth, isQ);
     }
 }
 
+struct netText
+/* Net of one chromosome as text. */
+    {
+    struct netText *next;	/* Next in list. */
+    struct chrom *chrom;	/* Chromosome. */
+    char *buf;			/* Text of net. */
+    size_t size;		/* Size of text. */
+    };
+
+void formatNet(void *item, void *context)
+/* Write net of one chromosome to memory.  Called in parallel by pthreadDoList. */
+{
+struct netText *text = item;
+boolean *pIsQ = context;
+struct chrom *chrom = text->chrom;
+struct fill *fill;
+FILE *f = open_memstream(&text->buf, &text->size);
+if (f == NULL)
+    errnoAbort("Couldn't open memory stream for net of %s", chrom->name);
+fprintf(f, "net %s %d\n", chrom->name, chrom->size);
+for (fill = chrom->root->fillList; fill != NULL; fill = fill->next)
+    rOutputFill(fill, f, 0, *pIsQ);
+carefulClose(&f);
+}
+
 void outputNetSide(struct chrom *chromList, FILE *f, boolean isQ)
-/* Output one side of net */
+/* Output one side of net.  Chromosomes are formatted a few at a time in
+ * parallel, and written in order. */
 {
-struct chrom *chrom;
-for (chrom = chromList; chrom != NULL; chrom = chrom->next)
+struct chrom *chrom = chromList;
+while (chrom != NULL)
     {
-    rOutDepth = 0;
-    rOutQ = isQ;
-    if (chromHasData(chrom))
-	{
-	struct fill *fill;
-	fprintf(f, "net %s %d\n", chrom->name, chrom->size);
-	for (fill = chrom->root->fillList; fill != NULL; fill = fill->next)
-	    rOutputFill(fill, f);
+    struct netText *textList = NULL, *text;
+    int count = 0;
+    for (; chrom != NULL && count < 8*threads; chrom = chrom->next)
+        {
+	if (chromHasData(chrom))
+	    {
+	    AllocVar(text);
+	    text->chrom = chrom;
+	    slAddHead(&textList, text);
+	    ++count;
+	    }
+	}
+    slReverse(&textList);
+    pthreadDoList(threads, textList, formatNet, &isQ);
+    while ((text = slPopHead(&textList)) != NULL)
+        {
+	mustWrite(f, text->buf, text->size);
+	freeMem(text->buf);
+	freez(&text);
 	}
     }
 }
@@ -753,23 +927,25 @@ void chainNet(char *chainFile, char *tSizes, char *qSizes,
 struct lineFile *lf = lineFileOpen(chainFile, TRUE);
 struct hash *qHash, *tHash;
 struct chrom *qChromList, *tChromList, *tChrom, *qChrom;
+struct netPart *qParts, *tParts;
 struct chain *chain;
 double lastScore = -1;
-struct lm *lm = lmInit(0);
-struct rbTreeNode **rbStack;
 FILE *tNetFile = mustOpen(tNet, "w");
 FILE *qNetFile = mustOpen(qNet, "w");
+struct netChain *ncs;
+int ncCount = 0;
 
 
-lmAllocArray(lm, rbStack, 256);
-makeChroms(qSizes, lm, rbStack, &qHash, &qChromList);
-makeChroms(tSizes, lm, rbStack, &tHash, &tChromList);
+makeChroms(qSizes, threads, TRUE, &qHash, &qChromList, &qParts);
+makeChroms(tSizes, threads, FALSE, &tHash, &tChromList, &tParts);
 verbose(1, "Got %d chroms in %s, %d in %s\n", slCount(tChromList), tSizes,
        slCount(qChromList), qSizes);
 lineFileSetMetaDataOutput(lf, tNetFile);
 lineFileSetMetaDataOutput(lf, qNetFile);
 
-/* Loop through chain file building up net. */
+/* Loop through chain file building up net a batch of chains at a time.  Chains
+ * that don't make it into the net are freed after each batch. */
+AllocArray(ncs, chainBatchSize);
 while ((chain = chainRead(lf)) != NULL)
     {
     /* Make sure that input is really sorted. */
@@ -796,21 +972,32 @@ while ((chain = chainRead(lf)) != NULL)
 		chain->tSize, chainFile,
 		tChrom->size, tSizes);
     if (!inclQuery(chain))
+        {
         verbose(2, "skipping chain on query %s\n", chain->qName);
+	chainFree(&chain);
+	}
     else
         {
-        addChain(qChrom, tChrom, chain);
-        verbose(2, "%s has %d inserts, %s has %d\n", tChrom->name, 
-                tChrom->spaces->n, qChrom->name, qChrom->spaces->n);
+	struct netChain *nc = &ncs[ncCount++];
+	nc->chain = chain;
+	nc->qChrom = qChrom;
+	nc->tChrom = tChrom;
+	nc->used = FALSE;
+	if (ncCount == chainBatchSize)
+	    {
+	    addChains(ncs, ncCount, qParts, tParts);
+	    ncCount = 0;
+	    }
         }
     }
+addChains(ncs, ncCount, qParts, tParts);
+freeMem(ncs);
 /* Build up other side of fills.  It's just for historical 
  * reasons this is not done during the main build up.   
  * It's a little less efficient this way, but to change it
  * some hard reverse strand issues would have to be juggled. */
 verbose(1, "Finishing nets\n");
-finishNet(qChromList, TRUE);
-finishNet(tChromList, FALSE);
+finishNet(qParts, tParts);
 
 /* Write out basic net files. */
 verbose(1, "writing %s\n", tNet);
@@ -842,6 +1029,9 @@ minSpace = optionInt("minSpace", minSpace);
 minFill = optionInt("minFill", minSpace/2);
 minScore = optionInt("minScore", minScore);
 inclHap = optionExists("inclHap");
+threads = optionInt("threads", threads);
+if (threads < 1 || threads > 256)
+    errAbort("-threads must be between 1 and 256");
 chainNet(argv[1], argv[2], argv[3], argv[4], argv[5]);
 return 0;
 }
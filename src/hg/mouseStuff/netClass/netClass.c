@@ -15,6 +15,7 @@
 #include "simpleRepeat.h"
 #include "liftUp.h"
 #include "chainNet.h"
+#include "pthreadDoList.h"
 
 
 /* Command line switches. */
@@ -24,6 +25,7 @@ boolean noAr = FALSE;
 char *qRepeatTable = NULL;
 char *tRepeatTable = NULL;
 char *qSizes = NULL;
+int threads = 1;
 struct hash *liftHashT = NULL;
 struct hash *liftHashQ = NULL;
 
@@ -40,6 +42,7 @@ static struct optionSpec optionSpecs[] = {
     {"liftT", OPTION_STRING},
     {"liftQ", OPTION_STRING},
     {"qSizes", OPTION_STRING},
+    {"threads", OPTION_INT},
     {NULL, 0}
 };
 
@@ -66,7 +69,9 @@ errAbort(
   "                     file.lft (for accessing chrom-level coords in tDb)\n"
   "   -qSizes=chrom.sizes - file with query chrom.sizes instead of reading\n"
   "                   - the chromInfo table from the database\n"
-  );
+  "   -threads=N - number of threads to classify nets with, default %d.\n"
+  "                Repeats are still read from the databases by one thread.\n"
+  , threads);
 }
 
 struct chrom
@@ -104,28 +109,32 @@ else
     return 0;
 }
 
-static int interSize;	/* Size of intersection. */
-static struct simpleRange interRange; /* Range to intersect with. */
+struct interSize
+/* Keep track of size of intersection with a range. */
+    {
+    struct simpleRange range;	/* Range to intersect with. */
+    int size;			/* Size of intersection. */
+    };
 
-void addInterSize(void *item)
-/* Add range to interSize. */
+void addInterSize(void *item, void *context)
+/* Add range to size of intersection in context. */
 {
 struct simpleRange *r = item;
-int size;
-size = rangeIntersection(r->start, r->end, interRange.start, interRange.end);
-interSize += size;
+struct interSize *inter = context;
+inter->size += rangeIntersection(r->start, r->end, inter->range.start, inter->range.end);
 }
 
 int intersectionSize(struct rbTree *tree, int start, int end)
 /* Return total size of things intersecting range start-end. */
 {
+struct interSize inter;
 if (tree == NULL)
     return 0;
-interRange.start = start;
-interRange.end = end;
-interSize = 0;
-rbTreeTraverseRange(tree, &interRange, &interRange, addInterSize);
-return interSize;
+inter.range.start = start;
+inter.range.end = end;
+inter.size = 0;
+rbTreeTraverseRangeWithContext(tree, &inter.range, &inter.range, addInterSize, &inter);
+return inter.size;
 }
 
 void setNGap(char *chr, struct hash *chromHash, struct rbTree *tree)
@@ -887,6 +896,75 @@ for (fill = fillList; fill != NULL; fill = fill->next)
 
 
 
+struct netJob
+/* A net to classify along with what is known of its target chromosome. */
+    {
+    struct netJob *next;	/* Next in list. */
+    struct chainNet *net;	/* Net to add classification to. */
+    struct rbTree *tN;		/* Gaps in target. */
+    struct rbTree *tRepeats;	/* Repeats in target. */
+    struct rbTree *tOldRepeats;	/* Ancient repeats in target. */
+    struct rbTree *tTrf;	/* Simple repeats in target. */
+    struct rbTree *tNewRepeats;	/* Lineage specific repeats in target, may be NULL. */
+    };
+
+struct netJob *netJobLoad(struct sqlConnection *tConn, struct hash *arHash,
+	struct chainNet *net)
+/* Read target side information for net from database. */
+{
+struct netJob *job;
+char *tName = net->name;
+if (liftHashT != NULL)
+    {
+    struct liftSpec *lft = hashMustFindVal(liftHashT, net->name);
+    tName = lft->newName;
+    }
+AllocVar(job);
+job->net = net;
+job->tN = getSeqGaps(tConn, tName);
+if (tRepeatTable)
+    getRepeatsTable(tConn, tRepeatTable, tName, &job->tRepeats, &job->tOldRepeats);
+else
+    getRepeats(tConn, arHash, tName, &job->tRepeats, &job->tOldRepeats);
+job->tTrf = getTrf(tConn, tName);
+if (tNewR)
+    job->tNewRepeats = getNewRepeats(tNewR, tName);
+return job;
+}
+
+void netJobClassify(void *item, void *context)
+/* Add classification info to net in job, and free the target side information.
+ * Called in parallel by pthreadDoList. */
+{
+struct netJob *job = item;
+struct hash *qChromHash = context;
+struct chainNet *net = job->net;
+
+tAddN(net, net->fillList, job->tN);
+qAddN(net, net->fillList, qChromHash);
+
+tAddR(net, net->fillList, job->tRepeats);
+if (!noAr)
+    tAddOldR(net, net->fillList, job->tOldRepeats);
+qAddR(net, net->fillList, qChromHash);
+if (!noAr)
+    qAddOldR(net, net->fillList, qChromHash);
+
+tAddTrf(net, net->fillList, job->tTrf);
+qAddTrf(net, net->fillList, qChromHash);
+
+if (tNewR)
+    tAddNewR(net, net->fillList, job->tNewRepeats);
+if (qNewR)
+    qAddNewR(net, net->fillList, qChromHash);
+
+rbTreeFree(&job->tN);
+rbTreeFree(&job->tRepeats);
+rbTreeFree(&job->tOldRepeats);
+rbTreeFree(&job->tTrf);
+rbTreeFree(&job->tNewRepeats);
+}
+
 void netClass(char *inName, char *tDb, char *qDb, char *outName)
 /* netClass - Add classification info to net. */
 {
@@ -945,50 +1023,28 @@ else
 	}
     }
 
-while ((net = chainNetRead(lf)) != NULL)
+/* Classify nets a batch at a time.  The database is only used from this
+ * thread, and the query side trees are shared read-only between threads.
+ * Only a batch of nets and their target trees are in memory at once. */
+for (;;)
     {
-    struct rbTree *tN, *tRepeats, *tOldRepeats, *tTrf;
-    char *tName = net->name;
-    if (liftHashT != NULL)
-	{
-	struct liftSpec *lft = hashMustFindVal(liftHashT, net->name);
-	tName = lft->newName;
+    struct netJob *jobList = NULL, *job;
+    int i;
+    for (i=0; i<threads && (net = chainNetRead(lf)) != NULL; ++i)
+        {
+	verbose(1, "Processing %s.%s\n", tDb, net->name);
+	slAddHead(&jobList, netJobLoad(tConn, arHash, net));
 	}
-
-    verbose(1, "Processing %s.%s\n", tDb, net->name);
-    tN = getSeqGaps(tConn, tName);
-    tAddN(net, net->fillList, tN);
-    rbTreeFree(&tN);
-    qAddN(net, net->fillList, qChromHash);
-
-    if (tRepeatTable)
-	getRepeatsTable(tConn, tRepeatTable, tName, &tRepeats, &tOldRepeats);
-    else
-	getRepeats(tConn, arHash, tName, &tRepeats, &tOldRepeats);
-    tAddR(net, net->fillList, tRepeats);
-    if (!noAr)
-	tAddOldR(net, net->fillList, tOldRepeats);
-    rbTreeFree(&tRepeats);
-    rbTreeFree(&tOldRepeats);
-    qAddR(net, net->fillList, qChromHash);
-    if (!noAr)
-	qAddOldR(net, net->fillList, qChromHash);
-
-    tTrf = getTrf(tConn, tName);
-    tAddTrf(net, net->fillList, tTrf);
-    rbTreeFree(&tTrf);
-    qAddTrf(net, net->fillList, qChromHash);
-
-    if (tNewR)
+    if (jobList == NULL)
+        break;
+    slReverse(&jobList);
+    pthreadDoList(threads, jobList, netJobClassify, qChromHash);
+    while ((job = slPopHead(&jobList)) != NULL)
         {
-	struct rbTree *tree = getNewRepeats(tNewR, tName);
-	tAddNewR(net, net->fillList, tree);
-	rbTreeFree(&tree);
+	chainNetWrite(job->net, f);
+	chainNetFree(&job->net);
+	freez(&job);
 	}
-    if (qNewR)
-        qAddNewR(net, net->fillList, qChromHash);
-    chainNetWrite(net, f);
-    chainNetFree(&net);
     }
 sqlDisconnect(&tConn);
 sqlDisconnect(&qConn);
@@ -1010,6 +1066,9 @@ tRepeatTable = optionVal("tRepeats", tRepeatTable);
 liftFileQ = optionVal("liftQ", liftFileQ);
 liftFileT = optionVal("liftT", liftFileT);
 qSizes = optionVal("qSizes", qSizes);
+threads = optionInt("threads", threads);
+if (threads < 1 || threads > 256)
+    errAbort("-threads must be between 1 and 256");
 if (liftFileQ != NULL)
     {
     struct liftSpec *lifts = readLifts(liftFileQ);
@@ -0,0 +1,287 @@
+/* testJksql - Check table memos, query batches and bound values in jksql against a
+ * real server. */
+
+/* Copyright (C) 2026 The Regents of the University of California
+ * See kent/LICENSE or http://genome.ucsc.edu/license/ for licensing information. */
+
+#include <sys/wait.h>
+#include "common.h"
+#include "options.h"
+#include "errCatch.h"
+#include "portable.h"
+#include "jksql.h"
+
+
+char *profile = NULL;	/* Login profile from hg.conf. */
+char *database = NULL;	/* Database scratch tables are made in. */
+char *otherDb = NULL;	/* Another database, without the scratch tables. */
+char table[64];		/* Scratch table. */
+int failCount = 0;
+
+void usage()
+/* Explain usage and exit. */
+{
+errAbort(
+  "testJksql - Check table memos, query batches and bound values in jksql against a\n"
+  "real server.\n"
+  "usage:\n"
+  "   testJksql profile database otherDb\n"
+  "Makes and drops scratch tables in database, so the profile needs create and drop\n"
+  "rights there.  otherDb is only read.  Prints a line for each check, and exits\n"
+  "with an error if any failed.\n"
+  );
+}
+
+static struct optionSpec options[] = {
+   {NULL, 0},
+};
+
+void report(char *name, boolean ok)
+/* Print whether a check went ok. */
+{
+printf("%s\t%s\n", name, (ok ? "ok" : "WRONG"));
+if (!ok)
+    ++failCount;
+}
+
+void otherProcessUpdate(char *query)
+/* Run query in another process, which has its own memos, on its own connection. */
+{
+fflush(stdout);
+int pid = mustFork();
+if (pid == 0)
+    {
+    /* Leave without exit(), which would close the parent's connections. */
+    int status = 1;
+    struct errCatch *errCatch = errCatchNew();
+    if (errCatchStart(errCatch))
+        {
+	struct sqlConnection *conn = sqlConnectProfile(profile, database);
+	sqlUpdate(conn, query);
+	status = 0;
+	}
+    errCatchEnd(errCatch);
+    _exit(status);
+    }
+int status;
+if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    errAbort("Query failed in other process: %s", query);
+}
+
+void useDb(struct sqlConnection *conn, char *db)
+/* Change database with a raw use query, as some programs do, rather than through
+ * jksql, which would know the database had changed. */
+{
+char query[256];
+sqlSafef(query, sizeof(query), "use %s", db);
+sqlUpdate(conn, query);
+}
+
+void checkMemo(struct sqlConnection *conn, struct sqlConnection *conn2)
+/* Check that memos don't keep tables that don't exist, and are dropped when
+ * tables or databases may have changed. */
+{
+char query[256];
+sqlTableMemoOn(TRUE);
+
+/* A table that doesn't exist mustn't be remembered as missing. */
+report("missingNotMemoized", !sqlTableExists(conn, table));
+sqlSafef(query, sizeof(query), "create table %s (id int, name varchar(255))", table);
+otherProcessUpdate(query);
+report("createdElsewhere", sqlTableExists(conn, table));
+
+/* One that exists is remembered until the memo is cleared. */
+sqlSafef(query, sizeof(query), "drop table %s", table);
+otherProcessUpdate(query);
+report("existsMemoized", sqlTableExists(conn, table));
+sqlTableMemoClear(conn);
+report("memoClear", !sqlTableExists(conn, table));
+
+/* A change on another connection in this process drops the memo. */
+sqlSafef(query, sizeof(query), "create table %s (id int, name varchar(255))", table);
+sqlUpdate(conn2, query);
+report("createdOnOtherConn", sqlTableExists(conn, table));
+report("fieldsBefore", sqlFieldIndex(conn, table, "extra") == -1);
+sqlSafef(query, sizeof(query), "alter table %s add column extra int", table);
+sqlUpdate(conn2, query);
+report("fieldsAfterAlter", sqlFieldIndex(conn, table, "extra") == 2);
+struct slName *fields = sqlListFields(conn, table);
+report("listFieldsAfterAlter", slCount(fields) == 3);
+slFreeList(&fields);
+
+/* A raw use query moves the memo to the database the server says it is in. */
+useDb(conn, otherDb);
+report("useOtherDb", !sqlTableExists(conn, table));
+useDb(conn, database);
+report("useDbBack", sqlTableExists(conn, table));
+
+/* Looking in another database by name changes database for a moment. */
+char otherTable[256];
+safef(otherTable, sizeof(otherTable), "%s.%s", otherDb, table);
+report("otherDbTable", !sqlTableExists(conn, otherTable));
+report("afterOtherDbTable", sqlTableExists(conn, table));
+}
+
+void checkBatch(struct sqlConnection *conn)
+/* Check that batches give a result per query in order, and that a failed batch
+ * leaves the connection usable.  Batches have at least sqlBatchMinQueries so
+ * that they are combined. */
+{
+char q0[256], q1[256], q2[256], q3[256];
+sqlSafef(q0, sizeof(q0), "select 7");
+sqlSafef(q1, sizeof(q1), "insert into %s values (1, 'one', 10), (2, 'two', 20)", table);
+sqlSafef(q2, sizeof(q2), "select name from %s order by id", table);
+sqlSafef(q3, sizeof(q3), "select count(*) from %s", table);
+char *queries[] = {q0, q1, q2, q3};
+struct sqlResult **results = sqlGetResultBatch(conn, queries, ArraySize(queries));
+char **row;
+boolean ok = (results[1] == NULL);
+ok = ok && (row = sqlNextRow(results[0])) != NULL && sameString(row[0], "7")
+	&& sqlNextRow(results[0]) == NULL;
+ok = ok && (row = sqlNextRow(results[2])) != NULL && sameString(row[0], "one")
+	&& (row = sqlNextRow(results[2])) != NULL && sameString(row[0], "two")
+	&& sqlNextRow(results[2]) == NULL;
+ok = ok && (row = sqlNextRow(results[3])) != NULL && sameString(row[0], "2");
+int i;
+for (i=0; i<ArraySize(queries); ++i)
+    sqlFreeResult(&results[i]);
+freeMem(results);
+report("batchResults", ok);
+
+/* A drop in a batch drops memos too. */
+char query[256];
+safef(query, sizeof(query), "%sB", table);
+char *table2 = cloneString(query);
+sqlSafef(query, sizeof(query), "create table %s (id int)", table2);
+sqlUpdate(conn, query);
+report("batchBeforeDrop", sqlTableExists(conn, table2));
+sqlSafef(q0, sizeof(q0), "drop table %s", table2);
+sqlSafef(q1, sizeof(q1), "select 1");
+char *queries2[] = {q0, q1, q1, q1};
+results = sqlGetResultBatch(conn, queries2, ArraySize(queries2));
+for (i=0; i<ArraySize(queries2); ++i)
+    sqlFreeResult(&results[i]);
+freeMem(results);
+report("batchDrop", !sqlTableExists(conn, table2));
+
+/* A bad query in the middle aborts, and the connection still works after. */
+sqlSafef(q0, sizeof(q0), "select 1");
+sqlSafef(q1, sizeof(q1), "select noSuchField from %s", table);
+sqlSafef(q2, sizeof(q2), "select 2");
+char *queries3[] = {q0, q1, q2, q2};
+struct errCatch *errCatch = errCatchNew();
+if (errCatchStart(errCatch))
+    results = sqlGetResultBatch(conn, queries3, ArraySize(queries3));
+errCatchEnd(errCatch);
+report("batchError", errCatch->gotError);
+errCatchFree(&errCatch);
+sqlSafef(query, sizeof(query), "select 3");
+report("batchErrorRecovers", sqlQuickNum(conn, query) == 3);
+freeMem(table2);
+}
+
+void checkBind(struct sqlConnection *conn)
+/* Check that bound strings come back from the database as they went in. */
+{
+static char *values[] = {
+    "plain",
+    "it's",
+    "\"double\"",
+    "back\\slash",
+    "trailing\\",
+    "question ? mark",
+    "'; drop table x; -- ",
+    "tab\tand\nnewline",
+    "",
+    };
+char query[256];
+sqlSafef(query, sizeof(query), "insert into %s (id, name) values (?, ?)", table);
+struct sqlStatement *insert = sqlPrepare(conn, query);
+sqlSafef(query, sizeof(query), "select name from %s where id = ? and name = ?", table);
+struct sqlStatement *lookup = sqlPrepare(conn, query);
+int i;
+boolean ok = TRUE;
+for (i=0; i<ArraySize(values); ++i)
+    {
+    sqlBindInt(insert, 0, 100 + i);
+    sqlBindString(insert, 1, values[i]);
+    sqlStatementUpdate(insert);
+    sqlBindInt(lookup, 0, 100 + i);
+    sqlBindString(lookup, 1, values[i]);
+    struct sqlResult *sr = sqlStatementGetResult(lookup);
+    char **row = sqlNextRow(sr);
+    if (row == NULL || !sameString(row[0], values[i]) || sqlNextRow(sr) != NULL)
+        {
+	verbose(1, "bound value %d didn't come back: %s\n", i, values[i]);
+	ok = FALSE;
+	}
+    sqlFreeResult(&sr);
+    }
+report("bindString", ok);
+
+sqlBindInt(insert, 0, 200);
+sqlBindString(insert, 1, NULL);
+sqlStatementUpdate(insert);
+sqlSafef(query, sizeof(query), "select count(*) from %s where id = ? and name is null", table);
+struct sqlStatement *countNull = sqlPrepare(conn, query);
+sqlBindLongLong(countNull, 0, 200);
+struct sqlResult *sr = sqlStatementGetResult(countNull);
+char **row = sqlNextRow(sr);
+report("bindNull", row != NULL && sameString(row[0], "1"));
+sqlFreeResult(&sr);
+
+sqlSafef(query, sizeof(query), "select ? + 0.5, '?'");
+struct sqlStatement *expr = sqlPrepare(conn, query);
+sqlBindDouble(expr, 0, 1.25);
+sr = sqlStatementGetResult(expr);
+row = sqlNextRow(sr);
+report("bindDoubleAndQuotedMark", row != NULL && atof(row[0]) == 1.75
+	&& sameString(row[1], "?"));
+sqlFreeResult(&sr);
+
+sqlStatementFree(&insert);
+sqlStatementFree(&lookup);
+sqlStatementFree(&countNull);
+sqlStatementFree(&expr);
+}
+
+void testJksql()
+/* testJksql - Check table memos, query batches and bound values in jksql. */
+{
+safef(table, sizeof(table), "testJksql%d", (int)getpid());
+struct sqlConnection *conn = sqlConnectProfile(profile, database);
+struct sqlConnection *conn2 = sqlConnectProfile(profile, database);
+verbose(1, "sqlVersion=%s, scratch table %s.%s\n", sqlVersion(conn), database, table);
+struct errCatch *errCatch = errCatchNew();
+if (errCatchStart(errCatch))
+    {
+    checkMemo(conn, conn2);
+    checkBatch(conn);
+    checkBind(conn);
+    }
+errCatchEnd(errCatch);
+if (errCatch->gotError)
+    {
+    warn("%s", errCatch->message->string);
+    ++failCount;
+    }
+errCatchFree(&errCatch);
+sqlDropTable(conn2, table);
+sqlDisconnect(&conn2);
+sqlDisconnect(&conn);
+if (failCount > 0)
+    errAbort("%d checks failed", failCount);
+}
+
+int main(int argc, char *argv[])
+/* Process command line. */
+{
+optionInit(&argc, argv, options);
+if (argc != 4)
+    usage();
+profile = argv[1];
+database = argv[2];
+otherDb = argv[3];
+testJksql();
+return 0;
+}
@@ -6,9 +6,13 @@
 #include "localmem.h"
 #include "options.h"
 #include "psl.h"
+#include "quickHeap.h"
+#include "extSort.h"
 
 
 boolean nohead = FALSE; /* No header for psl files?  Command line option. */
+int maxMem = 1024;	/* Megabytes of memory to sort a mid file in. */
+int threads = 1;	/* Number of threads to sort with. */
 
 void usage()
 /* Explain usage and exit. */
@@ -33,8 +37,11 @@ errAbort(
    "\n"
    "options:\n"
    "   -nohead      Do not write psl header.\n"
+   "   -maxMem=N    Use about N megabytes of memory in first pass, default %d.\n"
+   "                More is sorted in pieces in tempDir that are merged.\n"
+   "   -threads=N   Number of threads to sort with in first pass, default %d.\n"
    "   -verbose=N   Set verbosity level, higher for more output. Default is 1.\n"
-   );
+   , maxMem, threads);
 }
 
 void makeMidName(char *tempDir, int ix, char *retName)
@@ -49,8 +56,20 @@ struct midFile
     struct midFile *next;	/* Next in list. */
     struct lineFile *lf;        /* Associated file. */
     struct psl *psl;            /* Current record. */
+    int ix;			/* Position in list, earlier wins ties. */
     };
 
+static int midFileCmp(const void *va, const void *vb)
+/* Compare current records of mid files for quickHeap, which keeps the biggest
+ * on top, so return the opposite of the query order. */
+{
+const struct midFile *a = va, *b = vb;
+int dif = pslCmpQuery(&a->psl, &b->psl);
+if (dif == 0)
+    dif = a->ix - b->ix;
+return -dif;
+}
+
 struct psl *nextPsl(struct lineFile *lf)
 /* Read next line from file and convert it to psl.  Return
  * NULL at eof. */
@@ -121,8 +140,12 @@ struct slName *tmpList, *tmp;
 struct midFile *midList = NULL, *mid;
 int aliCount = 0;
 FILE *f = mustOpen(outFile, "w");
+struct quickHeap *heap;
+int ix = 0;
 
-
+int stdioBufSize = 1024*1024;
+char *stdioBuf = needLargeMem(stdioBufSize);
+setvbuf(f, stdioBuf, _IOFBF, stdioBufSize);
 if (!nohead)
     pslWriteHead(f);
 tmpList = listDir(tempDir, "tmp*.psl");
@@ -135,37 +158,40 @@ for (tmp = tmpList; tmp != NULL; tmp = tmp->next)
     mid->lf = pslFileOpen(fileName);
     slAddHead(&midList, mid);
     }
+heap = newQuickHeap(slCount(midList), midFileCmp);
+for (mid = midList; mid != NULL; mid = mid->next)
+    {
+    mid->ix = ix++;
+    if ((mid->psl = nextPsl(mid->lf)) != NULL)
+        addToQuickHeap(heap, mid);
+    else
+        lineFileClose(&mid->lf);
+    }
 verbose(1, "writing %s", outFile);
 fflush(stdout);
-/* Write out the lowest sorting line from mid list until done. */
-for (;;)
+/* Write out the lowest sorting line from heap of mid files until done. */
+while (!quickHeapEmpty(heap))
     {
-    struct midFile *bestMid = NULL;
     if ( (++aliCount & 0xffff) == 0)
 	{
 	verboseDot();
 	fflush(stdout);
 	}
-    for (mid = midList; mid != NULL; mid = mid->next)
-	{
-	if (mid->lf != NULL && mid->psl == NULL)
-	    {
-	    if ((mid->psl = nextPsl(mid->lf)) == NULL)
-		lineFileClose(&mid->lf);
-	    }
-	if (mid->psl != NULL)
-	    {
-	    if (bestMid == NULL || pslCmpQuery(&mid->psl, &bestMid->psl) < 0)
-		bestMid = mid;
-	    }
+    mid = peekQuickHeapTop(heap);
+    pslTabOut(mid->psl, f);
+    pslFree(&mid->psl);
+    if ((mid->psl = nextPsl(mid->lf)) != NULL)
+        quickHeapTopChanged(heap);
+    else
+        {
+	removeQuickHeapTop(heap);
+	lineFileClose(&mid->lf);
 	}
-    if (bestMid == NULL)
-	break;
-    pslTabOut(bestMid->psl, f);
-    pslFree(&bestMid->psl);
     }
+freeQuickHeap(&heap);
 printf("\n");
-fclose(f);
+carefulClose(&f);
+freeMem(stdioBuf);
 
 /* The followint really shouldn't be necessary.... */
 for (mid = midList; mid != NULL; mid = mid->next)
@@ -253,6 +279,17 @@ if (p->strand[0] == '-')
 return p;
 }
 
+void addPsl(struct extSort *es, struct psl *psl, FILE *textF, char **pText,
+	size_t *pTextSize)
+/* Add psl to sorter by query.  TextF is a memory stream for pText used to
+ * format psl. */
+{
+rewind(textF);
+pslTabOut(psl, textF);
+fflush(textF);
+extSortAdd(es, psl->qName, extSortSignedNum((int)psl->qStart), *pText, *pTextSize);
+}
+
 boolean selfFile(char *path)
 /* Return TRUE if of form XX_XX.psl */
 {
@@ -279,6 +316,9 @@ struct slName *dirDir, *dirFile;
 char fileName[512];
 int fileCount;
 int totalFilesProcessed = 0;
+char *text = NULL;
+size_t textSize = 0;
+FILE *textF = open_memstream(&text, &textSize);
 int filesPerMidFile;
 int midFileCount = 0;
 FILE *f;
@@ -288,6 +328,9 @@ boolean suppressSelf = FALSE;
 boolean firstOnly = endsWith(command, "1");
 boolean secondOnly = endsWith(command, "2");
 
+if (textF == NULL)
+    errnoAbort("Couldn't open memory stream for psls");
+
 if (startsWith("dirs", command))
     ;
 else if (startsWith("g2g", command))
@@ -336,14 +379,19 @@ if (!secondOnly)
     verbose(1, "Got %d files %d files per mid file\n", fileCount, filesPerMidFile);
 
     /* Read in files a group at a time, sort, and write merged, sorted
-     * output of one group. */
+     * output of one group.  Groups too big for memory are sorted in
+     * pieces that are merged as they are written. */
     name = fileList;
     while (totalFilesProcessed < fileCount)
 	{
 	int filesInMidFile = 0;
-	struct psl *pslList = NULL, *psl;
+	struct psl *psl;
 	int lfileCount = 0;
 	struct lm *lm = lmInit(256*1024);
+	struct extSort *es = extSortNew(tempDir, maxMem*1024LL*1024, threads);
+	char *key, *data;
+	bits64 num;
+	int dataSize;
 
 	for (filesInMidFile = 0; filesInMidFile < filesPerMidFile && name != NULL;
 	    ++filesInMidFile, ++totalFilesProcessed, name = name->next)
@@ -363,32 +411,36 @@ if (!secondOnly)
 		    continue;
 		    }
 		++lfileCount;
-		slAddHead(&pslList, psl);
+		addPsl(es, psl, textF, &text, &textSize);
 		if (reflectMe)
 		    {
 		    psl = mirrorLmPsl(psl, lm);
-		    slAddHead(&pslList, psl);
+		    addPsl(es, psl, textF, &text, &textSize);
+		    }
+		if (lmUsed(lm) > 1024*1024)
+		    {
+		    lmCleanup(&lm);
+		    lm = lmInit(256*1024);
 		    }
 		}
 	    lineFileClose(&lf);
 	    }
-	slSort(&pslList, pslCmpQuery);
 	makeMidName(tempDir, midFileCount, fileName);
 	verbose(1, "Writing %s\n", fileName);
 	f = mustOpen(fileName, "w");
 	if (!nohead)
 	    pslWriteHead(f);
-	for (psl = pslList; psl != NULL; psl = psl->next)
-	    {
-	    pslTabOut(psl, f);
-	    }
-	fclose(f);
-	pslList = NULL;
+	while (extSortNext(es, &key, &num, &data, &dataSize))
+	    mustWrite(f, data, dataSize);
+	carefulClose(&f);
+	extSortFree(&es);
 	lmCleanup(&lm);
 	verbose(2, "lfileCount %d\n", lfileCount);
 	++midFileCount;
 	}
     }
+carefulClose(&textF);
+freeMem(text);
 if (!firstOnly)
     pslSort2(outFile, tempDir);
 }
@@ -399,6 +451,12 @@ int main(int argc, char *argv[])
 optionHash(&argc, argv);
 
 nohead = optionExists("nohead");
+maxMem = optionInt("maxMem", maxMem);
+threads = optionInt("threads", threads);
+if (maxMem < 1)
+    errAbort("-maxMem must be at least 1");
+if (threads < 1 || threads > 256)
+    errAbort("-threads must be between 1 and 256");
 
 if (argc < 5)
     usage();
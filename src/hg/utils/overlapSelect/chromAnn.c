@@ -161,6 +161,7 @@ char **rawCols = (car->opts & chromAnnSaveLines) ? rowReaderCloneColumns(rr) : N
 struct bed *bed = bedLoadN(rr->row, min(rr->numCols, rr->maxParsedCols));
 struct chromAnn *ca = chromAnnNew(bed->chrom, bed->strand[0], bed->name, rawCols,
                                   strVectorWrite, strVectorFree);
+ca->sortStart = bed->chromStart;
 
 if ((bed->blockCount == 0) || (car->opts & chromAnnRange))
     {
@@ -237,6 +238,7 @@ char **rawCols = (car->opts & chromAnnSaveLines) ? rowReaderCloneColumns(rr) : N
 struct genePred *gp = genePredLoad(rr->row);
 struct chromAnn* ca = chromAnnNew(gp->chrom, gp->strand[0], gp->name, rawCols,
                                   strVectorWrite, strVectorFree);
+ca->sortStart = gp->txStart;
 
 if (car->opts & chromAnnRange)
     {
@@ -341,11 +343,17 @@ char **rawCols = (car->opts & chromAnnSaveLines) ? rowReaderCloneColumns(rr) : N
 struct psl *psl = pslLoad(rr->row);
 struct chromAnn* ca;
 if (car->opts & chromAnnUseQSide)
+    {
     ca = chromAnnNew(psl->qName, getPslQSideStrand(psl), psl->tName, rawCols,
                      strVectorWrite, strVectorFree);
+    ca->sortStart = psl->qStart;
+    }
 else
+    {
     ca = chromAnnNew(psl->tName, getPslTSideStrand(psl), psl->qName, rawCols,
                      strVectorWrite, strVectorFree);
+    ca->sortStart = psl->tStart;
+    }
 
 if (car->opts & chromAnnRange)
     {
@@ -437,13 +445,19 @@ if (chain == NULL)
 
 struct chromAnn* ca;
 if (car->opts & chromAnnUseQSide)
+    {
     ca = chromAnnNew(chain->qName, '+', chain->tName,
                      ((car->opts & chromAnnSaveLines) ? chain : NULL),
                      chainRecWrite, chainRecFree);
+    ca->sortStart = (chain->qStrand == '-') ? chain->qSize - chain->qEnd : chain->qStart;
+    }
 else
+    {
     ca = chromAnnNew(chain->tName, chain->qStrand, chain->qName,
                      ((car->opts & chromAnnSaveLines) ? chain : NULL),
                      chainRecWrite, chainRecFree);
+    ca->sortStart = chain->tStart;
+    }
 
 if (car->opts & chromAnnRange)
     {
@@ -514,6 +528,7 @@ struct coordColVals colVals = coordColParseRow(&catr->cols, catr->rr);
 
 struct chromAnn *ca = chromAnnNew(colVals.chrom, colVals.strand, colVals.name, rawCols,
                                   strVectorWrite, strVectorFree);
+ca->sortStart = colVals.start;
 chromAnnBlkNew(ca, colVals.start, colVals.end);
 coordColsValsRelease(&colVals);
 return ca;
@@ -29,6 +29,8 @@ struct chromAnn
     int start;       /* start of first block */
     int end;         /* end of last block */
     int totalSize;   /* size of all blocks */
+    int sortStart;   /* start of whole record on positive strand, before any
+                      * CDS or block selection; sorted files are ordered by this */
     void *rec;       /* record that can be used to recreate the data */
     void (*recWrite)(struct chromAnn *ca, FILE *fh, char term); /* write record to file, with term character */
     void (*recFree)(struct chromAnn *ca);  /* free function for rec */
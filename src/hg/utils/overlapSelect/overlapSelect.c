@@ -9,6 +9,7 @@
 #include "chromAnn.h"
 #include "dystring.h"
 #include "options.h"
+#include "obscure.h"
 
 
 /* FIXME:
@@ -46,6 +47,7 @@ static struct optionSpec optionSpecs[] = {
     {"idOutput", OPTION_BOOLEAN},
     {"aggregate", OPTION_BOOLEAN},
     {"tsv", OPTION_BOOLEAN},
+    {"sorted", OPTION_BOOLEAN},
     {NULL, 0}
 };
 
@@ -87,6 +89,7 @@ boolean statsOutput = FALSE;
 boolean outputAll = FALSE;
 boolean outputBoth = FALSE;
 boolean tsvOutput = FALSE;
+boolean sortedInput = FALSE;
 struct overlapCriteria criteria = {0.0, 1.1, 0.0, 1.1, -1};
 
 enum recordFmt parseFormatSpec(char *fmt)
@@ -234,6 +237,15 @@ while ((selCa = chromAnnMapIterNext(&iter)) != NULL)
     }
 }
 
+static FILE *selNotUsedFh = NULL;  /* stats of unused select records when sweeping */
+
+static void recordSelNotUsed(struct chromAnn *selCa)
+/* save stats for a select chromAnn that is dropped from a sweep if it wasn't used */
+{
+if (!selCa->used)
+    fprintf(selNotUsedFh, statsFmt, "", getPrintId(selCa), 0.0, 0.0, 0, 0.0, 0, selCa->totalSize);
+}
+
 static void doItemOverlap(struct chromAnn* inCa, FILE *outFh, FILE *dropFh)
 /* Do individual item overlap process of chromAnn object given the criteria,
  * and if so output */
@@ -328,12 +340,30 @@ selectTableAddRecords(selCar);
 selCar->carFree(&selCar);
 }
 
+void sweepSelectTable(char *selectFile)
+/* set up to sweep through a sorted select file */
+{
+struct chromAnnReader *selCar = createChromAnnReader(selectFile, selectFmt, selectCaOpts, &selectCoordCols);
+if (statsOutput && outputBoth)
+    {
+    selNotUsedFh = tmpfile();
+    if (selNotUsedFh == NULL)
+        errnoAbort("can't create temporary file for unused select records");
+    selectTableSweepStart(selCar, recordSelNotUsed);
+    }
+else
+    selectTableSweepStart(selCar, NULL);
+}
+
 void overlapSelect(char *selectFile, char *inFile, char *outFile, char *dropFile)
 /* select records based on overlap of chromosome ranges */
 {
 struct chromAnnReader *inCar
     = createChromAnnReader(inFile, inFmt, inCaOpts, &inCoordCols);
-loadSelectTable(selectFile);
+if (sortedInput)
+    sweepSelectTable(selectFile);
+else
+    loadSelectTable(selectFile);
 FILE *outFh = mustOpen(outFile, "w");
 FILE *dropFh = NULL;
 if (dropFile != NULL)
@@ -360,7 +390,17 @@ else
     doItemOverlaps(inCar, outFh, dropFh);
 
 inCar->carFree(&inCar);
-if (statsOutput && outputBoth)
+if (sortedInput)
+    {
+    selectTableSweepFinish();
+    if (selNotUsedFh != NULL)
+        {
+        rewind(selNotUsedFh);
+        copyOpenFile(selNotUsedFh, outFh);
+        carefulClose(&selNotUsedFh);
+        }
+    }
+else if (statsOutput && outputBoth)
     outputStatsSelNotUsed(outFh);
 
 carefulClose(&outFh);
@@ -500,6 +540,7 @@ if (mergeOutput)
     }
 dropFile = optionVal("dropped", NULL);
 tsvOutput = optionExists("tsv");
+sortedInput = optionExists("sorted");
 
 /* check for options incompatible with aggregate mode */
 if (useAggregate)
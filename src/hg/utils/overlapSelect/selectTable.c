@@ -15,6 +15,27 @@
 
 static struct chromAnnMap* selectMap = NULL; // select object map
 
+struct sortCheck
+/* last record read from a file that must be sorted */
+{
+    char *desc;     // description of file for errors
+    char *chrom;    // chrom of last record, NULL if none read
+    int start;      // sortStart of last record
+};
+
+struct selectSweep
+/* state of a sweep through a sorted select file, used instead of selectMap */
+{
+    struct chromAnnReader *car;  // reader for select file
+    struct chromAnn *pending;    // next select record, not yet in window
+    struct chromAnn *window;     // records that may overlap current or later inFile
+                                 // records, most recently read first
+    void (*doneFunc)(struct chromAnn *selCa);  // called on records as they are dropped
+    struct sortCheck selCheck;   // sort checking for select file
+    struct sortCheck inCheck;    // sort checking for inFile
+};
+static struct selectSweep *selectSweep = NULL; // non-NULL if sweeping
+
 static void selectMapEnsure()
 /* create select map if it doesn't exist */
 {
@@ -64,6 +85,147 @@ while ((ca = car->caRead(car)) != NULL)
     }
 }
 
+static void sortCheckNext(struct sortCheck *sc, struct chromAnn *ca)
+/* check that a record is in order after the previous one */
+{
+int diff = (sc->chrom == NULL) ? 1 : strcmp(ca->chrom, sc->chrom);
+if ((diff < 0) || ((diff == 0) && (ca->sortStart < sc->start)))
+    errAbort("%s is not sorted by chromosome and start: %s:%d follows %s:%d",
+             sc->desc, ca->chrom, ca->sortStart, sc->chrom, sc->start);
+if (diff != 0)
+    {
+    freeMem(sc->chrom);
+    sc->chrom = cloneString(ca->chrom);
+    }
+sc->start = ca->sortStart;
+}
+
+static void sweepReadPending()
+/* read the next select record into pending */
+{
+struct selectSweep *ss = selectSweep;
+ss->pending = ss->car->caRead(ss->car);
+if (ss->pending != NULL)
+    {
+    selectDumpChromAnn(ss->pending, "select");
+    sortCheckNext(&ss->selCheck, ss->pending);
+    }
+}
+
+static void sweepDrop(struct chromAnn *ca)
+/* done with a select record */
+{
+if (selectSweep->doneFunc != NULL)
+    selectSweep->doneFunc(ca);
+chromAnnFree(&ca);
+}
+
+void selectTableSweepStart(struct chromAnnReader *car,
+                           void (*doneFunc)(struct chromAnn *selCa))
+/* Select from a file sorted by chromosome and start rather than loading it.
+ * The inFile records must be passed in the same order.  Only select records
+ * that can overlap the current inFile record are kept in memory.  Ownership
+ * of car is passed.  If doneFunc is not NULL, it is called on each select record
+ * that could select something when it is no longer needed. */
+{
+struct selectSweep *ss;
+AllocVar(ss);
+ss->car = car;
+ss->doneFunc = doneFunc;
+ss->selCheck.desc = "select file";
+ss->inCheck.desc = "inFile";
+selectSweep = ss;
+sweepReadPending();
+}
+
+void selectTableSweepFinish()
+/* Finish sweep, dropping records left in the select file. */
+{
+struct selectSweep *ss = selectSweep;
+struct chromAnn *ca;
+while ((ca = slPopHead(&ss->window)) != NULL)
+    sweepDrop(ca);
+if (ss->doneFunc != NULL)
+    {
+    // rest of file is only needed by doneFunc
+    while (ss->pending != NULL)
+        {
+        ca = ss->pending;
+        sweepReadPending();
+        if (ca->start < ca->end)
+            sweepDrop(ca);
+        else
+            chromAnnFree(&ca);
+        }
+    }
+chromAnnFree(&ss->pending);
+ss->car->carFree(&ss->car);
+freeMem(ss->selCheck.chrom);
+freeMem(ss->inCheck.chrom);
+freez(&selectSweep);
+}
+
+static struct chromAnnRef *sweepFindOverlap(struct chromAnn *inCa)
+/* advance sweep to inCa and get list of overlaps to it, in the same order as
+ * chromAnnMapFindOverlap */
+{
+struct selectSweep *ss = selectSweep;
+struct chromAnn *ca, *window = NULL;
+sortCheckNext(&ss->inCheck, inCa);
+
+/* drop records that end before this inFile record starts, since later ones
+ * start no earlier */
+while ((ca = slPopHead(&ss->window)) != NULL)
+    {
+    if (differentString(ca->chrom, inCa->chrom) || (ca->end <= inCa->sortStart))
+        sweepDrop(ca);
+    else
+        slAddHead(&window, ca);
+    }
+slReverse(&window);
+
+/* skip records on earlier chromosomes, then add ones that start before this
+ * inFile record ends.  Zero-length records can't select, as with the map. */
+while ((ss->pending != NULL) && (strcmp(ss->pending->chrom, inCa->chrom) < 0))
+    {
+    ca = ss->pending;
+    sweepReadPending();
+    if (ca->start < ca->end)
+        sweepDrop(ca);
+    else
+        chromAnnFree(&ca);
+    }
+while ((ss->pending != NULL) && sameString(ss->pending->chrom, inCa->chrom)
+       && (ss->pending->sortStart < inCa->end))
+    {
+    ca = ss->pending;
+    sweepReadPending();
+    if (ca->start < ca->end)
+        slAddHead(&window, ca);
+    else
+        chromAnnFree(&ca);
+    }
+ss->window = window;
+
+struct chromAnnRef *overlaps = NULL;
+for (ca = window; ca != NULL; ca = ca->next)
+    {
+    if ((ca->start < inCa->end) && (ca->end > inCa->start))
+        slAddHead(&overlaps, chromAnnRefNew(ca));
+    }
+slReverse(&overlaps);
+return overlaps;
+}
+
+static struct chromAnnRef *selectFindOverlap(struct chromAnn *inCa)
+/* get list of select records overlapping inCa, from map or sweep */
+{
+if (selectSweep != NULL)
+    return sweepFindOverlap(inCa);
+selectMapEnsure();
+return chromAnnMapFindOverlap(selectMap, inCa);
+}
+
 static boolean isSelfMatch(unsigned opts, struct chromAnn *inCa, struct chromAnn* selCa)
 /* check if this is a self record */
 {
@@ -262,11 +424,10 @@ boolean selectIsOverlapped(unsigned opts, struct chromAnn *inCa,
 /* Determine if a range is overlapped.  If overlappingRecs is not null, a list
  * of the of selected records is returned.  Free with slFreelList. */
 {
-selectMapEnsure();
 verbose(2, "selectIsOverlapped: enter %s\n", inCa->name);
 selectDumpChromAnn(inCa, "input");
 boolean hit = FALSE;
-struct chromAnnRef *overlapping = chromAnnMapFindOverlap(selectMap, inCa);
+struct chromAnnRef *overlapping = selectFindOverlap(inCa);
 if (overlapping != NULL)
     {
     hit = selectWithOverlapping(opts, inCa, overlapping, criteria, overlappingRecs);
@@ -323,11 +484,10 @@ stats->inOverlap = ((float)stats->inOverBases) / ((float)inCa->totalSize);
 struct overlapAggStats selectAggregateOverlap(unsigned opts, struct chromAnn *inCa)
 /* Compute the aggregate overlap of a chromAnn */
 {
-selectMapEnsure();
 struct overlapAggStats stats;
 ZeroVar(&stats);
 stats.inBases = inCa->totalSize;
-struct chromAnnRef *overlapping = chromAnnMapFindOverlap(selectMap, inCa);
+struct chromAnnRef *overlapping = selectFindOverlap(inCa);
 computeAggregateOverlap(opts, inCa, overlapping, &stats);
 slFreeList(&overlapping);
 verbose(2, "selectAggregateOverlap: %s: %s %d-%d, %c => %0.3g\n", inCa->name, inCa->chrom, inCa->start, inCa->end,
@@ -45,6 +45,17 @@ struct chromAnn;
 void selectTableAddRecords(struct chromAnnReader *car);
 /* add records to the select table */
 
+void selectTableSweepStart(struct chromAnnReader *car,
+                           void (*doneFunc)(struct chromAnn *selCa));
+/* Select from a file sorted by chromosome and start rather than loading it.
+ * The inFile records must be passed in the same order.  Only select records
+ * that can overlap the current inFile record are kept in memory.  Ownership
+ * of car is passed.  If doneFunc is not NULL, it is called on each select record
+ * that could select something when it is no longer needed. */
+
+void selectTableSweepFinish();
+/* Finish sweep, dropping records left in the select file. */
+
 int selectOverlapBases(struct chromAnn *ca1, struct chromAnn *ca2);
 /* determine the number of bases of overlaping in two annotations */
 
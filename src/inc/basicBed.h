@@ -162,6 +162,12 @@ void bedLineFreeList(struct bedLine **pList);
 int bedLineCmp(const void *va, const void *vb);
 /* Compare to sort based on chrom,chromStart. */
 
+void bedSortFileExt(char *inFile, char *outFile, char *tempDir, long long maxMem,
+	int threads);
+/* Sort a bed file by chrom,chromStart.  Uses about maxMem bytes of memory, with the
+ * rest in temporary files in tempDir, and sorts in threads threads.  The input is all
+ * read before output is opened, so inFile and outFile may be the same. */
+
 void bedSortFile(char *inFile, char *outFile);
 /* Sort a bed file (in place, overwrites old file. */
 
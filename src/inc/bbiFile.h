@@ -284,6 +284,32 @@ boolean bbiSummaryArray(struct bbiFile *bbi, char *chrom, bits32 start, bits32 e
  * be 0.0 or nan("") depending on the application.)  Returns FALSE if no data
  * at that position. */
 
+typedef int (*BbiFetchFloats)(struct bbiFile *bbi, char *chrom, bits32 start, bits32 end,
+	float *vals);
+/* A callback function that fills in vals[0] through vals[end-start-1] with one value
+ * per base, NaN where there is no data.  Returns number of bases with data. */
+
+#define bbiMaxFloatSummaryBases (4*1024*1024)
+/* Largest full resolution region summarized through a flat float array rather than
+ * an interval list. */
+
+bits32 bbiSummarizeFloats(float *vals, int count, struct bbiSummaryElement *el);
+/* Add count per-base values in vals, where NaN marks a base without data, to el.
+ * Zero out el before the first call.  Returns number of bases with data in vals. */
+
+boolean bbiFloatSummaryArrayExtended(struct bbiFile *bbi, char *chrom, bits32 start, bits32 end,
+	BbiFetchIntervals fetchIntervals, BbiFetchFloats fetchFloats,
+	int summarySize, struct bbiSummaryElement *summary);
+/* Like bbiSummaryArrayExtended, but when no zoom level is suitable and the region is
+ * no bigger than bbiMaxFloatSummaryBases, fetch the data as a flat array of floats
+ * and summarize that rather than an interval list. */
+
+boolean bbiFloatSummaryArray(struct bbiFile *bbi, char *chrom, bits32 start, bits32 end,
+	BbiFetchIntervals fetchIntervals, BbiFetchFloats fetchFloats,
+	enum bbiSummaryType summaryType, int summarySize, double *summaryValues);
+/* Like bbiSummaryArray, but uses fetchFloats for small full resolution regions as in
+ * bbiFloatSummaryArrayExtended. */
+
 struct bbiSummaryElement bbiTotalSummary(struct bbiFile *bbi);
 /* Return summary of entire file! */
 
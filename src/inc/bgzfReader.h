@@ -0,0 +1,33 @@
+/* bgzfReader - read a BGZF (bgzip) compressed file, inflating blocks in parallel.
+ * BGZF files are a series of gzip members of at most 64k each, so each can be
+ * inflated on its own.  Worker threads take turns reading the next block from
+ * the file and then inflate it at the same time as the other workers inflate
+ * theirs.  Blocks go into a ring and are handed back in file order by
+ * bgzfReaderRead.  Typical use:
+ *    struct bgzfReader *br = bgzfReaderOpen("in.vcf.gz", 4);
+ *    while ((size = bgzfReaderRead(br, buf, sizeof(buf))) > 0)
+ *        doSomething(buf, size);
+ *    bgzfReaderClose(&br); */
+
+/* This file is copyright 2026 UCSC Genome Browser Authors, but license is hereby
+ * granted for all use - public, private or commercial. */
+
+#ifndef BGZFREADER_H
+#define BGZFREADER_H
+
+boolean bgzfReaderIsBgzf(char *fileName);
+/* Return TRUE if fileName can be opened and starts with a BGZF block. */
+
+struct bgzfReader *bgzfReaderOpen(char *fileName, int threadCount);
+/* Open a BGZF file to read with threadCount threads inflating blocks, or die
+ * trying. */
+
+int bgzfReaderRead(struct bgzfReader *br, void *buf, int size);
+/* Read up to size bytes of uncompressed data into buf.  Returns number of bytes
+ * read, which is less than size only at the end of the file.  Aborts if the file
+ * is truncated or corrupt. */
+
+void bgzfReaderClose(struct bgzfReader **pBr);
+/* Stop threads, close file and free up reader. */
+
+#endif /* BGZFREADER_H */
@@ -62,6 +62,22 @@ struct bbiInterval *bigWigIntervalQuery(struct bbiFile *bwf, char *chrom, bits32
 	struct lm *lm);
 /* Get data for interval.  Return list allocated out of lm. */
 
+int bigWigFloatQuery(struct bbiFile *bwf, char *chrom, bits32 start, bits32 end, float *vals);
+/* Fill in vals[0] through vals[end-start-1] with the value at each base of chrom:start-end,
+ * decoding data sections straight into the array rather than building an interval list.
+ * Bases without data are set to NaN.  Returns number of bases with data. */
+
+typedef void (*BigWigItemFunc)(void *context, bits32 start, bits32 end, float val);
+/* Called by bigWigItemSweep on each item with its range and value. */
+
+bits64 bigWigItemSweep(struct bbiFile *bwf, char *chrom, bits32 start, bits32 end,
+	bits64 lastOffset, BigWigItemFunc func, void *context);
+/* Call func on each item in the data blocks that overlap chrom:start-end, in order of
+ * start.  Items are not clipped to start-end, and may not overlap it at all.  Blocks
+ * at file offsets up to lastOffset are skipped.  Returns offset of the last block
+ * read, so that a caller sweeping through a chromosome window by window can pass it
+ * back in to go through each block just once.  Pass 0 for the first window. */
+
 int bigWigIntervalDump(struct bbiFile *bwf, char *chrom, bits32 start, bits32 end, int maxCount,
 	FILE *out);
 /* Print out info on bigWig parts that intersect chrom:start-end.   Set maxCount to 0 if you 
@@ -63,6 +63,11 @@ struct binKeeper
     int maxPos;		/* Maximum position to bin. */
     int binCount;	/* Count of bins. */
     struct binElement **binLists; /* A list for each bin. */
+    struct binElement *frozenEls; /* If frozen, all elements in one array in bin order,
+                                   * sorted by start within each bin. */
+    int *binStarts;	/* If frozen, start of each bin in frozenEls, plus one past end. */
+    int *binMaxSizes;	/* If frozen, size of biggest element in each bin. */
+    boolean isFrozen;	/* TRUE if binKeeperFreeze has been called since last change. */
     };
 
 struct binKeeperCookie
@@ -73,6 +78,19 @@ struct binKeeperCookie
     struct binElement *nextBel; /* next binElement */
     };
 
+struct binKeeperQuery
+/* A range to look up with binKeeperFindBatch. */
+    {
+    int start, end;		/* 0 based, half open range */
+    };
+
+struct binKeeperHit
+/* An item found by binKeeperFindBatch. */
+    {
+    int query;			/* Index of query in array passed in. */
+    struct binElement *el;	/* Item that intersects query. */
+    };
+
 struct binKeeper *binKeeperNew(int minPos, int maxPos);
 /* Create new binKeeper that can cover range. */
 
@@ -108,6 +126,24 @@ struct binElement *binKeeperFindLowest(struct binKeeper *bk, int start, int end)
 void binKeeperRemove(struct binKeeper *bk, int start, int end, void *val);
 /* Remove item from binKeeper. */ 
 
+void binKeeperFreeze(struct binKeeper *bk);
+/* Move all items into one array in bin order, which makes queries faster and
+ * saves memory.  Bin lists are kept in the same order, so the other routines
+ * work and give the same answers as before.  Adding or removing an item after
+ * this moves items back into separate lists, and makes element pointers from
+ * earlier queries invalid. */
+
+int binKeeperFindBatch(struct binKeeper *bk, struct binKeeperQuery *queries, int queryCount,
+	struct binKeeperHit **pHits, int *pHitAlloc);
+/* Find items that intersect each of queries, putting them in *pHits, which is
+ * expanded as need be, and returning the number found.  Hits are grouped by query
+ * in the order of queries.  On a frozen binKeeper each bin is binary searched
+ * rather than scanned, and hits within a bin are in order of start.  The elements
+ * in hits belong to bk, so are not copied or allocated per hit.  Start *pHits out
+ * as NULL and *pHitAlloc as 0, and reuse them between calls, freeing *pHits when
+ * done.  Queries sorted by start are fastest since they look in the same bins one
+ * after another. */
+
 struct binKeeperCookie binKeeperFirst(struct binKeeper *bk);
 /* Return an object to use by binKeeperNext() to traverse the binElements.
  * The first call to binKeeperNext() will return the first entry in the
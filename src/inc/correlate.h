@@ -29,6 +29,10 @@ void correlateNext(struct correlate *c, double x, double y);
 void correlateNextMulti(struct correlate *c, double x, double y, int count);
 /* Do same thing as calling correlateNext with x and y count times. */
 
+void correlateAdd(struct correlate *c, struct correlate *other);
+/* Add all samples that went into other to c.  Handy when collecting
+ * correlations in pieces, for instance in separate threads. */
+
 double correlateResult(struct correlate *c);
 /* Returns correlation (aka R) */
 
@@ -201,6 +201,11 @@ bits16 packDna8(DNA *in);
 UBYTE packDna4(DNA *in);
 /* Pack 4 bases into a UBYTE */
 
+void packDnaBytes(DNA *in, int baseCount, UBYTE *out);
+/* Pack baseCount bases four to a byte into out, which must have room for
+ * (baseCount+3)/4 bytes.  A partial last byte is padded with T's.  Gives the
+ * same result as packDna4 on each four bases, but is faster on long sequences. */
+
 void unpackDna(bits32 *tiles, int tileCount, DNA *out);
 /* Unpack DNA. Expands to 16x tileCount in output. */
 
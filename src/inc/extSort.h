@@ -0,0 +1,36 @@
+/* extSort - sort more records than fit in memory.  Records are added with a key made of
+ * a string and a number, and come back out in key order.  When the records added take
+ * more than a memory limit they are sorted, using several threads, and written to a
+ * temporary file called a run.  At the end the runs are merged.  Used by bedSort,
+ * pslSort and chainMergeSort. */
+/* This file is copyright 2026 UCSC Genome Browser Authors, but license is hereby
+ * granted for all use - public, private or commercial. */
+
+#ifndef EXTSORT_H
+#define EXTSORT_H
+
+#define extSortDefaultMem (1024LL*1024*1024)	/* Default memory limit, a gigabyte. */
+
+struct extSort *extSortNew(char *tempDir, long long maxMem, int threads);
+/* Return a new sorter that keeps about maxMem bytes of records in memory, writes
+ * temporary files to tempDir (NULL for current dir), and sorts in threads threads. */
+
+void extSortFree(struct extSort **pEs);
+/* Free up sorter and remove any temporary files it still has. */
+
+void extSortAdd(struct extSort *es, char *key, bits64 num, void *data, int dataSize);
+/* Add a record to sorter.  Records are ordered by key compared as unsigned bytes,
+ * then by num, then by the order they were added.  Key and data are copied. */
+
+boolean extSortNext(struct extSort *es, char **retKey, bits64 *retNum,
+	char **retData, int *retDataSize);
+/* Return next record in order, or FALSE when there are no more.  No more records can
+ * be added after the first call.  Returned key and data are valid until next call. */
+
+bits64 extSortSignedNum(long long x);
+/* Return number that sorts the same way as signed x. */
+
+bits64 extSortDoubleNum(double x);
+/* Return number that sorts the same way as x. */
+
+#endif /* EXTSORT_H */
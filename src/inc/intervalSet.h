@@ -0,0 +1,58 @@
+/* intervalSet - a set of positions on a sequence kept as a sorted array of runs.
+ * Use it in place of a bitmap when sets are combined with ands, ors and nots and
+ * the number of runs is much smaller than the sequence is long.  Used by featureBits. */
+/* This file is copyright 2026 UCSC Genome Browser Authors, but license is hereby
+ * granted for all use - public, private or commercial. */
+
+#ifndef INTERVALSET_H
+#define INTERVALSET_H
+
+struct intervalRun
+/* A run of positions in a set. */
+    {
+    int start, end;	/* Zero based half open interval. */
+    };
+
+struct intervalSet
+/* A set of positions.  Once normalized the runs are sorted, and neither overlap
+ * nor abut each other. */
+    {
+    struct intervalRun *runs;	/* Array of runs. */
+    int count;			/* Number of runs used. */
+    int alloc;			/* Number of runs allocated. */
+    boolean isNormal;		/* TRUE if runs are sorted and merged. */
+    };
+
+struct intervalSet *intervalSetNew();
+/* Return a new, empty set. */
+
+void intervalSetFree(struct intervalSet **pSet);
+/* Free up set. */
+
+struct intervalSet *intervalSetClone(struct intervalSet *set);
+/* Return a normalized copy of set. */
+
+void intervalSetAdd(struct intervalSet *set, int start, int end);
+/* Add positions start to end to set.  Runs can be added in any order and may
+ * overlap.  Empty runs are ignored. */
+
+void intervalSetNormalize(struct intervalSet *set);
+/* Sort runs and merge any that overlap or abut.  The other routines do this
+ * as needed, but a set should be normalized before it is shared between threads. */
+
+struct intervalSet *intervalSetAnd(struct intervalSet *a, struct intervalSet *b);
+/* Return new set of positions that are in both a and b. */
+
+struct intervalSet *intervalSetOr(struct intervalSet *a, struct intervalSet *b);
+/* Return new set of positions that are in either a or b. */
+
+struct intervalSet *intervalSetNot(struct intervalSet *set, int size);
+/* Return new set of positions between 0 and size that are not in set. */
+
+long long intervalSetTotal(struct intervalSet *set);
+/* Return number of positions in set. */
+
+long long intervalSetCountRange(struct intervalSet *set, int start, int size);
+/* Return number of positions in set between start and start+size. */
+
+#endif /* INTERVALSET_H */
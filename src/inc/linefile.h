@@ -72,8 +72,28 @@ struct lineFile
     void(*checkSupport)(struct lineFile *lf, char *where); // check if operation supported 
     boolean(*nextCallBack)(struct lineFile *lf, char **retStart, int *retSize); // next line callback
     void(*closeCallBack)(struct lineFile *lf);             // close callback
+    char *mapBase;		/* Start of memory mapped file, NULL if not mapped. */
+    size_t mapAlloc;		/* Bytes mapped, 0 if mapping belongs to another lineFile. */
+    off_t mapStart;		/* Offset in file where reading starts. */
+    off_t mapEnd;		/* Offset in file where reading stops. */
+    off_t mapPos;		/* Offset in file of next line. */
+    off_t mapZeroed;		/* Offset up to which zTerm may have zeroed line ends. */
+    struct bgzfReader *bgzf;	/* Reads BGZF file in parallel if non-NULL. */
     };
 
+struct lineFileChunk
+/* A piece of a memory mapped lineFile that starts and ends on line boundaries,
+ * so that the pieces can be parsed in parallel. */
+    {
+    struct lineFileChunk *next;
+    struct lineFile *lf;	/* Reads just the lines of this chunk. */
+    int chunkIx;		/* Position of chunk in file, starting from zero. */
+    void *val;			/* For caller, typically what was parsed from chunk. */
+    };
+
+typedef void LineFileChunkWorker(struct lineFileChunk *chunk, void *context);
+/* Parses one chunk, typically saving results in chunk->val. */
+
 char *getFileNameFromHdrSig(char *m);
 /* Check if header has signature of supported compression stream,
    and return a phoney filename for it, or NULL if no sig found. */
@@ -84,6 +104,11 @@ struct lineFile *lineFileDecompressFd(char *name, bool zTerm, int fd);
 struct lineFile *lineFileDecompressMem(bool zTerm, char *mem, long size);
 /* open a linefile with decompression from a memory stream */
 
+void lineFileSetDecompressThreads(int threadCount);
+/* Set number of threads that inflate BGZF (bgzip) compressed files that are opened
+ * from now on.  With the default of zero they are read through a gzip pipeline
+ * like other .gz files.  Plain gzip files are always read through the pipeline. */
+
 struct lineFile *lineFileMayOpen(char *fileName, bool zTerm);
 /* Try and open up a lineFile. If fileName ends in .gz, .Z, or .bz2,
  * it will be read from a decompress pipeline. */
@@ -98,6 +123,33 @@ struct lineFile *lineFileOpen(char *fileName, bool zTerm);
 struct lineFile *lineFileAttach(char *fileName, bool zTerm, int fd);
 /* Wrap a line file around an open'd file. */
 
+struct lineFile *lineFileMmap(char *fileName, bool zTerm);
+/* Open up a lineFile on a memory mapping of fileName or die trying.  Lines are
+ * returned as pointers straight into the mapping rather than copied into a buffer.
+ * The mapping is private, so with zTerm the line ends are zeroed in memory without
+ * changing the file, though that makes a private copy of every page.  Without
+ * zTerm nothing is copied, and lines are not zero terminated except the last.
+ * Lines stay put until the lineFile is closed or seeks back over them, so they
+ * don't need to be cloned to be kept.  Compressed files, stdin and files that
+ * can't be mapped are read by lineFileOpen instead.  The file must not be
+ * truncated while it is open. */
+
+struct lineFileChunk *lineFileMmapChunks(struct lineFile *lf, int chunkCount);
+/* Split the rest of lf, which must be from lineFileMmap, into up to chunkCount
+ * chunks that each start on a new line.  Each chunk has its own lineFile that
+ * shares lf's mapping, so chunks can be read in separate threads, and must be
+ * freed before lf is closed.  Line numbers in chunks count from the start of the
+ * chunk, and the chunk's fileName says where in the file it starts.  With zTerm a
+ * chunk can't seek back over lines it has read. */
+
+void lineFileChunkDoList(int threadCount, struct lineFileChunk *chunkList,
+	LineFileChunkWorker *worker, void *context);
+/* Call worker(chunk, context) on each chunk with threadCount threads in parallel.
+ * Returns after all chunks are done. */
+
+void lineFileChunkFreeList(struct lineFileChunk **pList);
+/* Close lineFiles of chunks and free list, but not vals. */
+
 struct lineFile *lineFileStdin(bool zTerm);
 /* Wrap a line file around stdin. */
 
@@ -209,7 +209,14 @@ boolean mgSaveToPng(FILE *png_file, struct memGfx *mg, boolean useTransparency);
 /* Save PNG to an already open file.
  * If useTransparency, then the first color in memgfx's colormap/palette is
  * assumed to be the image background color, and pixels of that color
- * are made transparent. */
+ * are made transparent.
+ * Images with no more than 256 distinct colors are written as indexed PNGs.
+ * The pixel data is compressed here rather than by libpng so that horizontal
+ * strips can be compressed in parallel, see mgSetPngEncodeThreads. */
+
+void mgSetPngEncodeThreads(int threadCount);
+/* Set the number of threads mgSaveToPng uses to compress horizontal strips
+ * of large images.  The default is 1. */
 
 typedef void (*TextBlit)(int bitWidth, int bitHeight, int bitX, int bitY,
 	unsigned char *bitData, int bitDataRowBytes, 
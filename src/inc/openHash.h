@@ -0,0 +1,105 @@
+/* openHash - a string keyed hash table that keeps its elements in one array rather
+ * than in chained buckets.  It covers the most used part of the hash.h interface,
+ * and looks names up faster than a struct hash when there are millions of them.
+ * Typical use:
+ *    struct openHash *hash = openHashNew(0);
+ *    openHashAdd(hash, name, value);
+ *    value = openHashFindVal(hash, name);
+ *    openHashFree(&hash);
+ * and to go through all elements:
+ *    struct openHashEl *hel;
+ *    struct openHashCookie cookie = openHashFirst(hash);
+ *    while ((hel = openHashNext(&cookie)) != NULL)
+ *        value = hel->val;
+ *
+ * Unlike struct hash, each name appears only once: adding a name that is already
+ * there replaces its value.  Elements move when the hash grows or an element is
+ * removed, so openHashEl pointers are only good until the next add or remove.
+ * Names are copied into local memory owned by the hash.
+ *
+ * Collisions are resolved with Robin Hood linear probing: an element being added
+ * takes the place of one that is closer to its home slot, which keeps probe
+ * sequences short and lets a failed lookup stop early.  Removal shifts the
+ * following elements back, so no tombstones are needed. */
+/* This file is copyright 2026 UCSC Genome Browser Authors, but license is hereby
+ * granted for all use - public, private or commercial. */
+
+#ifndef OPENHASH_H
+#define OPENHASH_H
+
+struct openHashEl
+/* An element in an open hash. */
+    {
+    char *name;		/* Name, NULL if slot is empty. */
+    void *val;		/* Value associated with name. */
+    bits32 hashVal;	/* Low bits of hash of name. */
+    };
+
+struct openHash
+/* A hash table of elements kept in one array. */
+    {
+    struct openHashEl *slots;	/* Array of slots. */
+    bits32 mask;		/* Size of slots array minus one. */
+    int powerOfTwoSize;		/* Size of slots array as a power of two. */
+    int elCount;		/* Number of elements in hash. */
+    struct lm *lm;		/* Local memory that holds names. */
+    };
+
+struct openHashCookie
+/* Used by openHashFirst/openHashNext to go through all elements. */
+    {
+    struct openHash *hash;	/* Hash being traversed. */
+    bits32 ix;			/* Next slot to look at. */
+    };
+
+bits64 openHashString(char *string, int size);
+/* Return 64 bit hash of the first size bytes of string.  This is MurmurHash64A
+ * by Austin Appleby, which is in the public domain.  It mixes eight bytes at a
+ * time and gives very few collisions on names that differ only slightly. */
+
+struct openHash *openHashNew(int powerOfTwoSize);
+/* Return a new, empty hash with room for about 2^powerOfTwoSize elements before
+ * it has to grow.  Pass 0 for a default size. */
+
+void openHashFree(struct openHash **pHash);
+/* Free up hash and names, but not values. */
+
+void openHashFreeWithVals(struct openHash **pHash, void (freeFunc)());
+/* Free up hash, calling freeFunc on the address of each value first. */
+
+struct openHashEl *openHashLookup(struct openHash *hash, char *name);
+/* Return element with name, or NULL if it isn't in hash. */
+
+void *openHashFindVal(struct openHash *hash, char *name);
+/* Return value associated with name, or NULL if it isn't in hash. */
+
+void *openHashMustFindVal(struct openHash *hash, char *name);
+/* Return value associated with name, aborting if it isn't in hash. */
+
+struct openHashEl *openHashAdd(struct openHash *hash, char *name, void *val);
+/* Add name and value to hash, replacing the value if name is already there.
+ * Returns element, which is only good until the next add or remove. */
+
+struct openHashEl *openHashAddUnique(struct openHash *hash, char *name, void *val);
+/* Add name and value to hash, aborting if name is already there. */
+
+char *openHashStoreName(struct openHash *hash, char *name);
+/* Add name to hash if it isn't there already, and return the copy of name that
+ * the hash keeps.  This is handy for keeping a single copy of strings. */
+
+int openHashIncInt(struct openHash *hash, char *name);
+/* Increment integer value associated with name, adding it with a value of one
+ * if it isn't there, and return new value. */
+
+void *openHashRemove(struct openHash *hash, char *name);
+/* Remove name from hash and return its value, or NULL if it wasn't there.  The
+ * memory for the name is not reclaimed until the hash is freed. */
+
+struct openHashCookie openHashFirst(struct openHash *hash);
+/* Return an object to use with openHashNext to go through all elements. */
+
+struct openHashEl *openHashNext(struct openHashCookie *cookie);
+/* Return next element in hash, or NULL when there are no more.  The hash
+ * must not be added to or removed from during the traversal. */
+
+#endif /* OPENHASH_H */
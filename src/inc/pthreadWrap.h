@@ -41,6 +41,9 @@ void pthreadCondSignal(pthread_cond_t *cond);
 /* Set conditional signal to wake up a sleeping thread, or
  * die trying. */
 
+void pthreadCondBroadcast(pthread_cond_t *cond);
+/* Wake up all threads waiting on conditional, or die trying. */
+
 void pthreadCondWait(pthread_cond_t *cond, pthread_mutex_t *mutex);
 /* Wait for conditional signal. */
 
@@ -0,0 +1,77 @@
+/* rangeIndex - a build once, query many index of ranges (half-open intervals)
+ * that may overlap each other.  Ranges are kept in arrays sorted by start, with
+ * an implicit augmented binary tree laid over the array, so a query is a few
+ * cache friendly array probes instead of a walk through rbTree nodes.  Use it in
+ * place of a rangeTree when all the ranges are known before the first query. */
+/* This file is copyright 2026 UCSC Genome Browser Authors, but license is hereby
+ * granted for all use - public, private or commercial. */
+
+#ifndef RANGEINDEX_H
+#define RANGEINDEX_H
+
+#ifndef RANGETREE_H
+#include "rangeTree.h"
+#endif
+
+struct rangeIndexNode
+/* The part of a range looked at while searching. */
+    {
+    int start, end;	/* Zero based half open interval. */
+    int maxEnd;		/* Largest end in subtree rooted here. */
+    };
+
+struct rangeIndex
+/* An index of ranges.  Add all the ranges, then query. */
+    {
+    struct rangeIndexNode *nodes;	/* Ranges sorted by start once built. */
+    struct range *ranges;		/* Ranges with vals, same order as nodes. */
+    int count;				/* Number of ranges. */
+    int alloc;				/* Number of ranges allocated. */
+    int maxLevel;			/* Level of root of implicit tree. */
+    boolean isBuilt;			/* TRUE if sorted and tree built. */
+    int *hits;				/* Buffer for rangeIndexAllOverlapping. */
+    int hitAlloc;			/* Size of hits buffer. */
+    };
+
+struct rangeIndex *rangeIndexNew();
+/* Return a new, empty range index. */
+
+void rangeIndexFree(struct rangeIndex **pRi);
+/* Free up range index. */
+
+void rangeIndexAdd(struct rangeIndex *ri, int start, int end, void *val);
+/* Add range with associated val to index.  Unlike rangeTreeAdd, ranges are not
+ * merged, each one added is kept. */
+
+void rangeIndexAddTree(struct rangeIndex *ri, struct rbTree *tree);
+/* Add all ranges in a rangeTree, with their vals, to index. */
+
+void rangeIndexBuild(struct rangeIndex *ri);
+/* Sort ranges and build tree.  The query routines do this if need be, but
+ * call it before sharing an index between threads.  No ranges can be added after
+ * this. */
+
+int rangeIndexOverlapIxs(struct rangeIndex *ri, int start, int end, int **pIxs, int *pAlloc);
+/* Find ranges that overlap start-end.  Indexes into ri->ranges of the ranges found
+ * are put in *pIxs in order of range start, and the number found is returned.
+ * *pIxs is expanded as needed and *pAlloc is its size.  Start them out at NULL and
+ * 0, and freeMem *pIxs when done.  Thread safe once index is built. */
+
+boolean rangeIndexOverlaps(struct rangeIndex *ri, int start, int end);
+/* Return TRUE if start-end overlaps anything in index. */
+
+int rangeIndexOverlapSize(struct rangeIndex *ri, int start, int end);
+/* Return number of bases between start and end covered by ranges in index.  Bases
+ * covered by more than one range are counted once, so this is the same as
+ * rangeTreeOverlapSize on a rangeTree with the same ranges added. */
+
+struct range *rangeIndexAllOverlapping(struct rangeIndex *ri, int start, int end);
+/* Return list of all ranges in index that overlap start-end, in order of start.
+ * Do not free this list, it is owned by index, and is only good until the next
+ * call.  Not thread safe, use rangeIndexOverlapIxs for that. */
+
+struct range *rangeIndexMaxOverlapping(struct rangeIndex *ri, int start, int end);
+/* Return range that overlaps most with start-end, or NULL if none do.  Not thread
+ * safe.  Trashes list used by rangeIndexAllOverlapping. */
+
+#endif /* RANGEINDEX_H */
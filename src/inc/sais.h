@@ -0,0 +1,25 @@
+/* sais - build suffix arrays in linear time with the SA-IS induced sorting algorithm
+ * of Nong, Zhang and Chan.  Used by itsaMake, sufaMake and sufxMake. */
+/* This file is copyright 2026 UCSC Genome Browser Authors, but license is hereby
+ * granted for all use - public, private or commercial. */
+
+#ifndef SAIS_H
+#define SAIS_H
+
+#define saisMaxSize 0xFFFFFFFDLL  /* Largest text saisMake can handle. */
+
+void saisMake(UBYTE *text, bits64 size, bits32 *sa);
+/* Fill in sa, which must have room for size+1 elements, with the suffix array of text.
+ * Suffixes are compared as unsigned bytes, so text may contain zeroes, and a suffix
+ * that is a prefix of another sorts first.  On return sa[0] is size (the empty suffix)
+ * and sa[1] through sa[size] are the offsets of the nonempty suffixes in order.  Extra
+ * memory used is about size/8 bytes plus, for very repetitive text, up to 2*size bytes. */
+
+bits64 saisDnaIndex(char *allDna, bits64 dnaSize, int minSize, int nFreeSize, bits32 *sa);
+/* Fill in sa, which must have room for dnaSize+1 elements, with the alphabetical offsets
+ * of the suffixes of allDna to index.  AllDna holds upper case sequences separated by
+ * zeroes.  A suffix is indexed if there are at least minSize bases before the next zero
+ * and there are no N's in the first nFreeSize bytes.  Returns the number of suffixes
+ * indexed, which are in sa[0] through sa[count-1]. */
+
+#endif /* SAIS_H */
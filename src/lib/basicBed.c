@@ -23,6 +23,7 @@
 #include "htmlColor.h"
 #include "basicBed.h"
 #include "memgfx.h"
+#include "extSort.h"
 
 void bedStaticLoad(char **row, struct bed *ret)
 /* Load a row from bed table into ret.  The contents of ret will
@@ -264,14 +265,18 @@ return dif;
 }
 
 
-void bedSortFile(char *inFile, char *outFile)
-/* Sort a bed file (in place, overwrites old file. */
+void bedSortFileExt(char *inFile, char *outFile, char *tempDir, long long maxMem,
+	int threads)
+/* Sort a bed file by chrom,chromStart.  Uses about maxMem bytes of memory, with the
+ * rest in temporary files in tempDir, and sorts in threads threads.  The input is all
+ * read before output is opened, so inFile and outFile may be the same. */
 {
 struct lineFile *lf = NULL;
 FILE *f = NULL;
-struct bedLine *blList = NULL, *bl;
-char *line;
-int lineSize;
+struct extSort *es = extSortNew(tempDir, maxMem, threads);
+char *line, *chrom, *rest;
+int lineSize, restSize;
+bits64 num;
 
 verbose(2, "Reading %s\n", inFile);
 lf = lineFileOpen(inFile, TRUE);
@@ -279,26 +284,33 @@ while (lineFileNext(lf, &line, &lineSize))
     {
     if (line[0] == '#')
         continue;
-    bl = bedLineNew(line);
-    slAddHead(&blList, bl);
+    struct bedLine *bl = bedLineNew(line);
+    extSortAdd(es, bl->chrom, extSortSignedNum(bl->chromStart), bl->line, strlen(bl->line));
+    bedLineFree(&bl);
     }
 lineFileClose(&lf);
 
-verbose(2, "Sorting\n");
-slSort(&blList, bedLineCmp);
-
 verbose(2, "Writing %s\n", outFile);
 f = mustOpen(outFile, "w");
-for (bl = blList; bl != NULL; bl = bl->next)
+while (extSortNext(es, &chrom, &num, &rest, &restSize))
     {
-    fprintf(f, "%s\t%s\n", bl->chrom, bl->line);
+    fprintf(f, "%s\t", chrom);
+    mustWrite(f, rest, restSize);
+    fputc('\n', f);
     if (ferror(f))
         {
 	perror("Writing error\n");
 	errAbort("%s is truncated, sorry.", outFile);
 	}
     }
-fclose(f);
+carefulClose(&f);
+extSortFree(&es);
+}
+
+void bedSortFile(char *inFile, char *outFile)
+/* Sort a bed file (in place, overwrites old file. */
+{
+bedSortFileExt(inFile, outFile, NULL, extSortDefaultMem, 1);
 }
 
 struct bed *bedLoad3(char **row)
@@ -634,6 +634,128 @@ return validCount;
 }
 
 
+bits32 bbiSummarizeFloats(float *vals, int count, struct bbiSummaryElement *el)
+/* Add count per-base values in vals, where NaN marks a base without data, to el.
+ * Zero out el before the first call.  Returns number of bases with data in vals. */
+{
+/* Keep four independent sets of accumulators so that successive bases don't wait on
+ * each other, and the compiler is free to do the lanes in parallel. */
+bits32 validCount[4] = {0, 0, 0, 0};
+double sumData[4] = {0, 0, 0, 0};
+double sumSquares[4] = {0, 0, 0, 0};
+double minVal[4] = {BIGDOUBLE, BIGDOUBLE, BIGDOUBLE, BIGDOUBLE};
+double maxVal[4] = {-BIGDOUBLE, -BIGDOUBLE, -BIGDOUBLE, -BIGDOUBLE};
+int i, lane;
+int quadEnd = count - (count & 3);
+for (i=0; i<quadEnd; i += 4)
+    {
+    for (lane=0; lane<4; ++lane)
+        {
+	float val = vals[i+lane];
+	if (!isnan(val))
+	    {
+	    validCount[lane] += 1;
+	    sumData[lane] += val;
+	    sumSquares[lane] += (double)val*val;
+	    if (minVal[lane] > val)
+		minVal[lane] = val;
+	    if (maxVal[lane] < val)
+		maxVal[lane] = val;
+	    }
+	}
+    }
+for (i=quadEnd; i<count; ++i)
+    {
+    float val = vals[i];
+    if (!isnan(val))
+	{
+	validCount[0] += 1;
+	sumData[0] += val;
+	sumSquares[0] += (double)val*val;
+	if (minVal[0] > val)
+	    minVal[0] = val;
+	if (maxVal[0] < val)
+	    maxVal[0] = val;
+	}
+    }
+
+/* Fold lanes together and then into el. */
+bits32 totalCount = 0;
+for (lane=0; lane<4; ++lane)
+    {
+    if (validCount[lane] == 0)
+        continue;
+    if (el->validCount == 0)
+        {
+	el->minVal = minVal[lane];
+	el->maxVal = maxVal[lane];
+	}
+    else
+        {
+	if (el->minVal > minVal[lane])
+	    el->minVal = minVal[lane];
+	if (el->maxVal < maxVal[lane])
+	    el->maxVal = maxVal[lane];
+	}
+    el->validCount += validCount[lane];
+    el->sumData += sumData[lane];
+    el->sumSquares += sumSquares[lane];
+    totalCount += validCount[lane];
+    }
+return totalCount;
+}
+
+static boolean bbiSummaryArrayFromFloats(struct bbiFile *bbi, 
+	char *chrom, bits32 start, bits32 end, BbiFetchFloats fetchFloats,
+	int summarySize, struct bbiSummaryElement *summary)
+/* Summarize data, not using zoom, from a flat array of per-base values.  Every element
+ * of summary is replaced, so it need not be zeroed beforehand. */
+{
+bits32 baseCount = end - start;
+bzero(summary, summarySize * sizeof(summary[0]));
+float *vals = needLargeMem(baseCount * sizeof(float));
+boolean result = FALSE;
+if ((*fetchFloats)(bbi, chrom, start, end, vals) > 0)
+    {
+    if (baseCount > summarySize)  // more bases than pixels
+        {
+        int i;
+        bits32 baseStart = start, baseEnd;
+        for (i=0; i<summarySize; ++i)
+            {
+            /* Calculate end of this part of summary */
+            baseEnd = start + (bits64)baseCount*(i+1)/summarySize;
+            int end1 = baseEnd;
+            if (end1 == baseStart)
+                end1 = baseStart+1;
+            if (bbiSummarizeFloats(vals + (baseStart - start), end1 - baseStart, &summary[i]))
+                result = TRUE;
+            baseStart = baseEnd;
+            }
+        }
+    else  // more pixels than bases
+        {
+        double pixelsPerBase = (double)summarySize / baseCount;
+        bits32 offset;
+        for (offset = 0; offset < baseCount; ++offset)
+            {
+            struct bbiSummaryElement summaryForBase;
+            ZeroVar(&summaryForBase);
+            if (bbiSummarizeFloats(vals + offset, 1, &summaryForBase))
+                {
+                result = TRUE;
+                unsigned startPos = round(offset * pixelsPerBase);
+                unsigned endPos = round((offset + 1) * pixelsPerBase);
+                for (; startPos < endPos && startPos < summarySize; startPos++)
+                    summary[startPos] = summaryForBase;
+                }
+            }
+        }
+    }
+freeMem(vals);
+return result;
+}
+
 static boolean bbiSummaryArrayFromFull(struct bbiFile *bbi, 
 	char *chrom, bits32 start, bits32 end, BbiFetchIntervals fetchIntervals,
 	int summarySize, struct bbiSummaryElement *summary)
@@ -703,11 +825,12 @@ lmCleanup(&lm);
 return result;
 }
 
-boolean bbiSummaryArrayExtended(struct bbiFile *bbi, char *chrom, bits32 start, bits32 end,
-	BbiFetchIntervals fetchIntervals,
+boolean bbiFloatSummaryArrayExtended(struct bbiFile *bbi, char *chrom, bits32 start, bits32 end,
+	BbiFetchIntervals fetchIntervals, BbiFetchFloats fetchFloats,
 	int summarySize, struct bbiSummaryElement *summary)
-/* Fill in summary with  data from indicated chromosome range in bigWig file. 
- * Returns FALSE if no data at that position. */
+/* Like bbiSummaryArrayExtended, but when no zoom level is suitable and the region is
+ * no bigger than bbiMaxFloatSummaryBases, fetch the data as a flat array of floats
+ * and summarize that rather than an interval list. */
 {
 boolean result = FALSE;
 
@@ -728,24 +851,34 @@ if (zoomLevel < 0)
 struct bbiZoomLevel *zoom = bbiBestZoom(bbi->levelList, zoomLevel);
 if (zoom != NULL)
     result = bbiSummaryArrayFromZoom(zoom, bbi, chrom, start, end, summarySize, summary);
+else if (fetchFloats != NULL && baseSize <= bbiMaxFloatSummaryBases)
+    result = bbiSummaryArrayFromFloats(bbi, chrom, start, end, fetchFloats, 
+    	summarySize, summary);
 else
     result = bbiSummaryArrayFromFull(bbi, chrom, start, end, fetchIntervals, summarySize, summary);
 return result;
 }
 
-boolean bbiSummaryArray(struct bbiFile *bbi, char *chrom, bits32 start, bits32 end,
+boolean bbiSummaryArrayExtended(struct bbiFile *bbi, char *chrom, bits32 start, bits32 end,
 	BbiFetchIntervals fetchIntervals,
+	int summarySize, struct bbiSummaryElement *summary)
+/* Fill in summary with  data from indicated chromosome range in bigWig file. 
+ * Returns FALSE if no data at that position. */
+{
+return bbiFloatSummaryArrayExtended(bbi, chrom, start, end, fetchIntervals, NULL,
+	summarySize, summary);
+}
+
+boolean bbiFloatSummaryArray(struct bbiFile *bbi, char *chrom, bits32 start, bits32 end,
+	BbiFetchIntervals fetchIntervals, BbiFetchFloats fetchFloats,
 	enum bbiSummaryType summaryType, int summarySize, double *summaryValues)
-/* Fill in summaryValues with  data from indicated chromosome range in bigWig file.
- * Be sure to initialize summaryValues to a default value, which will not be touched
- * for regions without data in file.  (Generally you want the default value to either
- * be 0.0 or nan("") depending on the application.)  Returns FALSE if no data
- * at that position. */
+/* Like bbiSummaryArray, but uses fetchFloats for small full resolution regions as in
+ * bbiFloatSummaryArrayExtended. */
 {
 struct bbiSummaryElement *elements;
 AllocArray(elements, summarySize);
-boolean ret = bbiSummaryArrayExtended(bbi, chrom, start, end, 
-	fetchIntervals, summarySize, elements);
+boolean ret = bbiFloatSummaryArrayExtended(bbi, chrom, start, end, 
+	fetchIntervals, fetchFloats, summarySize, elements);
 if (ret)
     {
     int i;
@@ -786,6 +919,19 @@ freeMem(elements);
 return ret;
 }
 
+boolean bbiSummaryArray(struct bbiFile *bbi, char *chrom, bits32 start, bits32 end,
+	BbiFetchIntervals fetchIntervals,
+	enum bbiSummaryType summaryType, int summarySize, double *summaryValues)
+/* Fill in summaryValues with  data from indicated chromosome range in bigWig file.
+ * Be sure to initialize summaryValues to a default value, which will not be touched
+ * for regions without data in file.  (Generally you want the default value to either
+ * be 0.0 or nan("") depending on the application.)  Returns FALSE if no data
+ * at that position. */
+{
+return bbiFloatSummaryArray(bbi, chrom, start, end, fetchIntervals, NULL,
+	summaryType, summarySize, summaryValues);
+}
+
 struct bbiSummaryElement bbiTotalSummary(struct bbiFile *bbi)
 /* Return summary of entire file! */
 {
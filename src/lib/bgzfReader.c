@@ -0,0 +1,293 @@
+/* bgzfReader - read a BGZF (bgzip) compressed file, inflating blocks in parallel.
+ * See bgzfReader.h for how to use it.
+ *
+ * The blocks live in a ring.  A worker may read block number readSeq into the
+ * ring only once the reader has finished with the block that was there, which
+ * is the one blockCount blocks earlier.  Reading from the file is done with the
+ * mutex held, so blocks are read in order, but inflating is done without it.
+ * Errors are saved in the block and reported when the reader gets to it, so
+ * that errAbort is only called in the reader's thread. */
+
+/* This file is copyright 2026 UCSC Genome Browser Authors, but license is hereby
+ * granted for all use - public, private or commercial. */
+
+#include "common.h"
+#include <pthread.h>
+#include <zlib.h>
+#include "pthreadWrap.h"
+#include "bgzfReader.h"
+
+#define bgzfMaxBlockSize 65536		/* Biggest compressed or uncompressed block. */
+#define bgzfHeaderSize 12		/* Fixed part of gzip header before extra field. */
+#define bgzfFooterSize 8		/* CRC32 and uncompressed size. */
+
+struct bgzfBlock
+/* A block on its way through the reader. */
+    {
+    unsigned char comp[bgzfMaxBlockSize];	/* Block as read from file. */
+    char data[bgzfMaxBlockSize];		/* Inflated data. */
+    int compSize;			/* Size of block in file. */
+    int dataSize;			/* Bytes of inflated data. */
+    char *error;			/* Error message if block is bad, else NULL. */
+    boolean ready;			/* Set once block has been inflated. */
+    boolean atEnd;			/* Set if there are no more blocks. */
+    };
+
+struct bgzfReader
+/* Reads a BGZF file with threads inflating blocks in parallel. */
+    {
+    char *fileName;		/* Name of file. */
+    FILE *f;			/* Open file. */
+    int threadCount;		/* Number of worker threads. */
+    pthread_t *threads;		/* Worker threads. */
+    pthread_mutex_t mutex;	/* Protects everything below. */
+    pthread_cond_t readyCond;	/* Broadcast when a block is ready. */
+    pthread_cond_t spaceCond;	/* Broadcast when a block is done with. */
+    struct bgzfBlock *blocks;	/* Ring of blocks. */
+    int blockCount;		/* Size of ring. */
+    long long readSeq;		/* Number of blocks read from file. */
+    long long useSeq;		/* Number of block being read from. */
+    int usePos;			/* Position in data of block being read from. */
+    boolean readDone;		/* Set at end of file or error. */
+    boolean stop;		/* Set to make workers quit. */
+    };
+
+static int bgzfBlockSize(unsigned char *header, int extraSize)
+/* Return size of block from BC subfield of gzip extra field, or 0 if there isn't one. */
+{
+unsigned char *s = header + bgzfHeaderSize, *end = s + extraSize;
+while (s + 4 <= end)
+    {
+    int subSize = s[2] | (s[3] << 8);
+    if (s[0] == 'B' && s[1] == 'C' && subSize == 2 && s + 6 <= end)
+        return (s[4] | (s[5] << 8)) + 1;
+    s += 4 + subSize;
+    }
+return 0;
+}
+
+static boolean isGzipWithExtra(unsigned char *header)
+/* Return TRUE if header starts a gzip member with an extra field. */
+{
+return header[0] == 0x1f && header[1] == 0x8b && header[2] == 8 && (header[3] & 4) != 0;
+}
+
+boolean bgzfReaderIsBgzf(char *fileName)
+/* Return TRUE if fileName can be opened and starts with a BGZF block. */
+{
+FILE *f = fopen(fileName, "rb");
+if (f == NULL)
+    return FALSE;
+unsigned char header[bgzfHeaderSize + 6];
+boolean isBgzf = (fread(header, 1, sizeof(header), f) == sizeof(header)
+	&& isGzipWithExtra(header)
+	&& bgzfBlockSize(header, (header[10] | (header[11] << 8))) > 0);
+fclose(f);
+return isBgzf;
+}
+
+static void readBlock(struct bgzfReader *br, struct bgzfBlock *block)
+/* Read next block from file.  Sets block->atEnd at end of file, and block->error
+ * if block is bad.  Called with mutex held. */
+{
+unsigned char *comp = block->comp;
+block->error = NULL;
+block->atEnd = FALSE;
+block->dataSize = 0;
+size_t got = fread(comp, 1, bgzfHeaderSize, br->f);
+if (got == 0)
+    {
+    block->atEnd = TRUE;
+    return;
+    }
+if (got < bgzfHeaderSize)
+    {
+    block->error = "Truncated block";
+    return;
+    }
+if (!isGzipWithExtra(comp))
+    {
+    block->error = "Block that isn't BGZF";
+    return;
+    }
+int extraSize = comp[10] | (comp[11] << 8);
+if (fread(comp + bgzfHeaderSize, 1, extraSize, br->f) != extraSize)
+    {
+    block->error = "Truncated block";
+    return;
+    }
+int blockSize = bgzfBlockSize(comp, extraSize);
+if (blockSize == 0)
+    {
+    block->error = "Block that isn't BGZF";
+    return;
+    }
+int headerSize = bgzfHeaderSize + extraSize;
+if (blockSize < headerSize + bgzfFooterSize)
+    {
+    block->error = "Corrupt block";
+    return;
+    }
+if (fread(comp + headerSize, 1, blockSize - headerSize, br->f) != blockSize - headerSize)
+    {
+    block->error = "Truncated block";
+    return;
+    }
+block->compSize = blockSize;
+}
+
+static void inflateBlock(z_stream *zs, struct bgzfBlock *block)
+/* Inflate the compressed data in block and check it against the footer. */
+{
+unsigned char *comp = block->comp;
+int headerSize = bgzfHeaderSize + (comp[10] | (comp[11] << 8));
+unsigned char *footer = comp + block->compSize - bgzfFooterSize;
+bits32 crc = footer[0] | (footer[1] << 8) | (footer[2] << 16) | ((bits32)footer[3] << 24);
+bits32 dataSize = footer[4] | (footer[5] << 8) | (footer[6] << 16) | ((bits32)footer[7] << 24);
+if (dataSize > bgzfMaxBlockSize || inflateReset(zs) != Z_OK)
+    {
+    block->error = "Corrupt block";
+    return;
+    }
+zs->next_in = comp + headerSize;
+zs->avail_in = footer - zs->next_in;
+zs->next_out = (unsigned char *)block->data;
+zs->avail_out = bgzfMaxBlockSize;
+if (inflate(zs, Z_FINISH) != Z_STREAM_END || zs->total_out != dataSize)
+    block->error = "Corrupt block";
+else if (crc32(0, (unsigned char *)block->data, dataSize) != crc)
+    block->error = "CRC mismatch in block";
+else
+    block->dataSize = dataSize;
+}
+
+static void *bgzfWorker(void *v)
+/* Read and inflate blocks until end of file or told to stop. */
+{
+struct bgzfReader *br = v;
+z_stream zs;
+zeroBytes(&zs, sizeof(zs));
+boolean zsOk = (inflateInit2(&zs, -MAX_WBITS) == Z_OK);
+for (;;)
+    {
+    pthreadMutexLock(&br->mutex);
+    while (!br->stop && !br->readDone && br->readSeq - br->useSeq >= br->blockCount)
+        pthreadCondWait(&br->spaceCond, &br->mutex);
+    if (br->stop || br->readDone)
+        {
+	pthreadMutexUnlock(&br->mutex);
+	break;
+	}
+    struct bgzfBlock *block = &br->blocks[br->readSeq % br->blockCount];
+    br->readSeq += 1;
+    readBlock(br, block);
+    if (block->atEnd || block->error != NULL)
+        {
+	br->readDone = TRUE;
+	block->ready = TRUE;
+	pthreadCondBroadcast(&br->readyCond);
+	pthreadCondBroadcast(&br->spaceCond);
+	pthreadMutexUnlock(&br->mutex);
+	break;
+	}
+    pthreadMutexUnlock(&br->mutex);
+
+    if (zsOk)
+	inflateBlock(&zs, block);
+    else
+        block->error = "zlib initialization failure";
+
+    pthreadMutexLock(&br->mutex);
+    block->ready = TRUE;
+    pthreadCondBroadcast(&br->readyCond);
+    pthreadMutexUnlock(&br->mutex);
+    }
+if (zsOk)
+    inflateEnd(&zs);
+return NULL;
+}
+
+struct bgzfReader *bgzfReaderOpen(char *fileName, int threadCount)
+/* Open a BGZF file to read with threadCount threads inflating blocks, or die
+ * trying. */
+{
+if (threadCount < 1)
+    threadCount = 1;
+struct bgzfReader *br;
+AllocVar(br);
+br->fileName = cloneString(fileName);
+br->f = mustOpen(fileName, "rb");
+br->threadCount = threadCount;
+/* Enough blocks that workers don't wait for the reader while it works through
+ * blocks they have finished. */
+br->blockCount = 4 * threadCount;
+br->blocks = needHugeZeroedMem(br->blockCount * sizeof(br->blocks[0]));
+pthreadMutexInit(&br->mutex);
+pthreadCondInit(&br->readyCond);
+pthreadCondInit(&br->spaceCond);
+AllocArray(br->threads, threadCount);
+int i;
+for (i=0; i<threadCount; ++i)
+    pthreadCreate(&br->threads[i], NULL, bgzfWorker, br);
+return br;
+}
+
+int bgzfReaderRead(struct bgzfReader *br, void *buf, int size)
+/* Read up to size bytes of uncompressed data into buf.  Returns number of bytes
+ * read, which is less than size only at the end of the file.  Aborts if the file
+ * is truncated or corrupt. */
+{
+char *out = buf;
+int total = 0;
+while (total < size)
+    {
+    struct bgzfBlock *block = &br->blocks[br->useSeq % br->blockCount];
+    pthreadMutexLock(&br->mutex);
+    while (!block->ready)
+        pthreadCondWait(&br->readyCond, &br->mutex);
+    pthreadMutexUnlock(&br->mutex);
+    if (block->error != NULL)
+        errAbort("%s in %s", block->error, br->fileName);
+    if (block->atEnd)
+        break;
+    int oneSize = min(block->dataSize - br->usePos, size - total);
+    memcpy(out + total, block->data + br->usePos, oneSize);
+    total += oneSize;
+    br->usePos += oneSize;
+    if (br->usePos == block->dataSize)
+        {
+	/* Done with this block, so let a worker put a new one here. */
+	pthreadMutexLock(&br->mutex);
+	block->ready = FALSE;
+	br->useSeq += 1;
+	br->usePos = 0;
+	pthreadCondBroadcast(&br->spaceCond);
+	pthreadMutexUnlock(&br->mutex);
+	}
+    }
+return total;
+}
+
+void bgzfReaderClose(struct bgzfReader **pBr)
+/* Stop threads, close file and free up reader. */
+{
+struct bgzfReader *br = *pBr;
+if (br != NULL)
+    {
+    pthreadMutexLock(&br->mutex);
+    br->stop = TRUE;
+    pthreadCondBroadcast(&br->spaceCond);
+    pthreadMutexUnlock(&br->mutex);
+    int i;
+    for (i=0; i<br->threadCount; ++i)
+        pthreadJoin(&br->threads[i], NULL);
+    pthreadCondDestroy(&br->readyCond);
+    pthreadCondDestroy(&br->spaceCond);
+    pthreadMutexDestroy(&br->mutex);
+    carefulClose(&br->f);
+    freeMem(br->threads);
+    freeMem(br->blocks);
+    freeMem(br->fileName);
+    freez(pBr);
+    }
+}
@@ -160,14 +160,126 @@ void binKeeperFree(struct binKeeper **pBk)
 struct binKeeper *bk = *pBk;
 if (bk != NULL)
     {
-    int i;
-    for (i=0; i<bk->binCount; ++i)
-	slFreeList(&bk->binLists[i]);
+    if (bk->isFrozen)
+        {
+	freeMem(bk->frozenEls);
+	freeMem(bk->binStarts);
+	freeMem(bk->binMaxSizes);
+	}
+    else
+        {
+	int i;
+	for (i=0; i<bk->binCount; ++i)
+	    slFreeList(&bk->binLists[i]);
+	}
     freeMem(bk->binLists);
     freez(pBk);
     }
 }
 
+static void binKeeperThaw(struct binKeeper *bk)
+/* Move items from frozen array back into separately allocated lists, keeping
+ * the same order. */
+{
+int i;
+for (i=0; i<bk->binCount; ++i)
+    {
+    struct binElement *list = NULL, *el;
+    for (el = bk->binLists[i]; el != NULL; el = el->next)
+        {
+	struct binElement *newEl = CloneVar(el);
+	slAddHead(&list, newEl);
+	}
+    slReverse(&list);
+    bk->binLists[i] = list;
+    }
+freez(&bk->frozenEls);
+freez(&bk->binStarts);
+freez(&bk->binMaxSizes);
+bk->isFrozen = FALSE;
+}
+
+struct frozenOrder
+/* Where an element is in a bin list, used when sorting a bin. */
+    {
+    int start;		/* Start of element. */
+    int listIx;		/* Position in bin list. */
+    };
+
+static int frozenOrderCmp(const void *va, const void *vb)
+/* Compare by start, then by position in list. */
+{
+const struct frozenOrder *a = va, *b = vb;
+if (a->start != b->start)
+    return (a->start < b->start ? -1 : 1);
+return a->listIx - b->listIx;
+}
+
+static void freezeBin(struct binKeeper *bk, int bin, struct binElement *listEls,
+	struct frozenOrder *order, struct binElement **byListIx)
+/* Move elements of one bin into frozen array sorted by start, and chain them
+ * together in their original list order.  The other parameters are scratch
+ * space big enough to hold the bin. */
+{
+struct binElement *el, *next, *frozen = bk->frozenEls + bk->binStarts[bin];
+int i, count = 0, maxSize = 0;
+for (el = bk->binLists[bin]; el != NULL; el = next)
+    {
+    next = el->next;
+    listEls[count] = *el;
+    order[count].start = el->start;
+    order[count].listIx = count;
+    maxSize = max(maxSize, el->end - el->start);
+    ++count;
+    freeMem(el);
+    }
+qsort(order, count, sizeof(order[0]), frozenOrderCmp);
+for (i=0; i<count; ++i)
+    {
+    frozen[i] = listEls[order[i].listIx];
+    byListIx[order[i].listIx] = &frozen[i];
+    }
+for (i=0; i<count; ++i)
+    byListIx[i]->next = (i+1 < count ? byListIx[i+1] : NULL);
+bk->binLists[bin] = (count > 0 ? byListIx[0] : NULL);
+bk->binMaxSizes[bin] = maxSize;
+}
+
+void binKeeperFreeze(struct binKeeper *bk)
+/* Move all items into one array in bin order, which makes queries faster and
+ * saves memory.  Bin lists are kept in the same order, so the other routines
+ * work and give the same answers as before.  Adding or removing an item after
+ * this moves items back into separate lists, and makes element pointers from
+ * earlier queries invalid. */
+{
+if (bk->isFrozen)
+    return;
+int i, count = 0, maxBinCount = 0;
+AllocArray(bk->binStarts, bk->binCount+1);
+AllocArray(bk->binMaxSizes, bk->binCount);
+for (i=0; i<bk->binCount; ++i)
+    {
+    int binCount = slCount(bk->binLists[i]);
+    bk->binStarts[i] = count;
+    count += binCount;
+    maxBinCount = max(maxBinCount, binCount);
+    }
+bk->binStarts[bk->binCount] = count;
+if (count > 0)
+    {
+    bk->frozenEls = needLargeMem(count * sizeof(bk->frozenEls[0]));
+    struct binElement *listEls = needLargeMem(maxBinCount * sizeof(listEls[0]));
+    struct frozenOrder *order = needLargeMem(maxBinCount * sizeof(order[0]));
+    struct binElement **byListIx = needLargeMem(maxBinCount * sizeof(byListIx[0]));
+    for (i=0; i<bk->binCount; ++i)
+	freezeBin(bk, i, listEls, order, byListIx);
+    freeMem(listEls);
+    freeMem(order);
+    freeMem(byListIx);
+    }
+bk->isFrozen = TRUE;
+}
+
 void binKeeperAdd(struct binKeeper *bk, int start, int end, void *val)
 /* Add item to binKeeper. */ 
 {
@@ -178,6 +290,8 @@ if (start < bk->minPos || end > bk->maxPos || start > end)
     	start, end, bk->minPos, bk->maxPos);
 bin = binFromRangeBinKeeperExtended(start, end);
 assert(bin < bk->binCount);
+if (bk->isFrozen)
+    binKeeperThaw(bk);
 AllocVar(el);
 el->start = start;
 el->end = end;
@@ -226,6 +340,88 @@ for (i=0; i<ArraySize(binOffsetsExtended); ++i)
 return list;
 }
 
+static int frozenBinFirst(struct binKeeper *bk, int bin, int start)
+/* Return index in frozenEls of first element in bin that could end after start.
+ * Frozen bins are sorted by start and no element is bigger than the bin's max
+ * size, so binary search for the first that starts within that size of start. */
+{
+struct binElement *els = bk->frozenEls;
+int lo = bk->binStarts[bin], hi = bk->binStarts[bin+1];
+int minStart = start - bk->binMaxSizes[bin];
+while (lo < hi)
+    {
+    int mid = (lo + hi) / 2;
+    if (els[mid].start <= minStart)
+	lo = mid + 1;
+    else
+	hi = mid;
+    }
+return lo;
+}
+
+static void addHit(struct binKeeperHit **pHits, int *pHitAlloc, int hitCount,
+	int query, struct binElement *el)
+/* Put hit in array at position hitCount, making array bigger if need be. */
+{
+if (hitCount >= *pHitAlloc)
+    {
+    int newAlloc = (*pHitAlloc == 0 ? 64 : *pHitAlloc * 2);
+    *pHits = needLargeMemResize(*pHits, newAlloc * sizeof((*pHits)[0]));
+    *pHitAlloc = newAlloc;
+    }
+struct binKeeperHit *hit = &(*pHits)[hitCount];
+hit->query = query;
+hit->el = el;
+}
+
+int binKeeperFindBatch(struct binKeeper *bk, struct binKeeperQuery *queries, int queryCount,
+	struct binKeeperHit **pHits, int *pHitAlloc)
+/* Find items that intersect each of queries, putting them in *pHits, which is
+ * expanded as need be, and returning the number found.  Hits are grouped by query
+ * in the order of queries.  On a frozen binKeeper each bin is binary searched
+ * rather than scanned, and hits within a bin are in order of start.  The elements
+ * in hits belong to bk, so are not copied or allocated per hit.  Start *pHits out
+ * as NULL and *pHitAlloc as 0, and reuse them between calls, freeing *pHits when
+ * done.  Queries sorted by start are fastest since they look in the same bins one
+ * after another. */
+{
+int hitCount = 0, q;
+for (q=0; q<queryCount; ++q)
+    {
+    int start = max(queries[q].start, bk->minPos);
+    int end = min(queries[q].end, bk->maxPos);
+    if (start >= end)
+        continue;
+    int startBin = (start>>_binFirstShift), endBin = ((end-1)>>_binFirstShift);
+    int i,j;
+    for (i=0; i<ArraySize(binOffsetsExtended); ++i)
+	{
+	int offset = binOffsetsExtended[i];
+	for (j=startBin+offset; j<=endBin+offset; ++j)
+	    {
+	    if (bk->isFrozen)
+	        {
+		struct binElement *els = bk->frozenEls;
+		int k, binEnd = bk->binStarts[j+1];
+		for (k = frozenBinFirst(bk, j, start); k < binEnd && els[k].start < end; ++k)
+		    if (rangeIntersection(els[k].start, els[k].end, start, end) > 0)
+			addHit(pHits, pHitAlloc, hitCount++, q, &els[k]);
+		}
+	    else
+	        {
+		struct binElement *el;
+		for (el=bk->binLists[j]; el != NULL; el = el->next)
+		    if (rangeIntersection(el->start, el->end, start, end) > 0)
+			addHit(pHits, pHitAlloc, hitCount++, q, el);
+		}
+	    }
+	startBin >>= _binNextShift;
+	endBin >>= _binNextShift;
+	}
+    }
+return hitCount;
+}
+
 boolean binKeeperAnyOverlap(struct binKeeper *bk, int start, int end)
 /* Return TRUE if start/end overlaps with any items in binKeeper. */
 {
@@ -243,6 +439,14 @@ for (i=0; i<ArraySize(binOffsetsExtended); ++i)
     int offset = binOffsetsExtended[i];
     for (j=startBin+offset; j<=endBin+offset; ++j)
         {
+	if (bk->isFrozen)
+	    {
+	    int k, binEnd = bk->binStarts[j+1];
+	    for (k = frozenBinFirst(bk, j, start); k < binEnd && bk->frozenEls[k].start < end; ++k)
+		if (rangeIntersection(bk->frozenEls[k].start, bk->frozenEls[k].end, start, end) > 0)
+		    return TRUE;
+	    continue;
+	    }
 	for (el=bk->binLists[j]; el != NULL; el = el->next)
 	    {
 	    if (rangeIntersection(el->start, el->end, start, end) > 0)
@@ -345,6 +549,8 @@ void binKeeperRemove(struct binKeeper *bk, int start, int end, void *val)
 /* Remove item from binKeeper. */ 
 {
 int bin = binFromRangeBinKeeperExtended(start, end);
+if (bk->isFrozen)
+    binKeeperThaw(bk);
 struct binElement **pList = &bk->binLists[bin], *newList = NULL, *el, *next;
 for (el = *pList; el != NULL; el = next)
     {
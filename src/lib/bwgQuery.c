@@ -152,21 +152,17 @@ assert( (maxCount != 0 && outCount >= maxCount) || (blockPt == blockEnd));
 return outCount;
 }
 
-struct bbiInterval *bigWigIntervalQuery(struct bbiFile *bwf, char *chrom, bits32 start, bits32 end,
-	struct lm *lm)
-/* Get data for interval.  Return list allocated out of lm. */
+typedef boolean (*BwgBlockFunc)(boolean isSwapped, char *blockPt, char *blockEnd, 
+	void *context);
+/* Called on each uncompressed data block by bwgForEachBlock.  Returns FALSE to stop. */
+
+static void bwgForEachBlock(struct bbiFile *bwf, struct fileOffsetSize *blockList, 
+	BwgBlockFunc func, void *context)
+/* Read and uncompress each data block in blockList, which is in file order, and call
+ * func on it. */
 {
-if (bwf->typeSig != bigWigSig)
-   errAbort("Trying to do bigWigIntervalQuery on a non big-wig file.");
-bbiAttachUnzoomedCir(bwf);
-struct bbiInterval *el, *list = NULL;
-struct fileOffsetSize *blockList = bbiOverlappingBlocks(bwf, bwf->unzoomedCir, 
-	chrom, start, end, NULL);
 struct fileOffsetSize *block, *beforeGap, *afterGap;
 struct udcFile *udc = bwf->udc;
-boolean isSwapped = bwf->isSwapped;
-float val;
-int i;
 
 /* Set up for uncompression optionally. */
 char *uncompressBuf = NULL;
@@ -202,163 +198,402 @@ for (block = blockList; block != NULL; )
 	    blockPt = blockBuf;
 	    blockEnd = blockPt + block->size;
 	    }
+	if (!func(bwf->isSwapped, blockPt, blockEnd, context))
+	    {
+	    block = NULL;	 // we want to drop out of the outer loop too
+	    break;
+	    }
+	blockBuf += block->size;
+	}
+    freeMem(mergedBuf);
+    }
+freeMem(uncompressBuf);
+}
+
+struct bwgIntervalContext
+/* What bwgBlockToIntervals needs to know. */
+    {
+    bits32 start, end;		/* Range we want. */
+    struct lm *lm;		/* Where to allocate intervals. */
+    struct bbiInterval *list;	/* Intervals so far, in reverse order. */
+    };
 
-	/* Deal with insides of block. */
-	struct bwgSectionHead head;
-	bwgSectionHeadFromMem(&blockPt, &head, isSwapped);
-	switch (head.type)
+static boolean bwgBlockToIntervals(boolean isSwapped, char *blockPt, char *blockEnd, 
+	void *context)
+/* Add parts of block that intersect range to interval list.  A BwgBlockFunc. */
+{
+struct bwgIntervalContext *ic = context;
+bits32 start = ic->start, end = ic->end;
+struct lm *lm = ic->lm;
+struct bbiInterval *el;
+float val;
+int i;
+struct bwgSectionHead head;
+bwgSectionHeadFromMem(&blockPt, &head, isSwapped);
+switch (head.type)
+    {
+    case bwgTypeBedGraph:
+	{
+	for (i=0; i<head.itemCount; ++i)
 	    {
-	    case bwgTypeBedGraph:
+	    bits32 s = memReadBits32(&blockPt, isSwapped);
+	    bits32 e = memReadBits32(&blockPt, isSwapped);
+	    val = memReadFloat(&blockPt, isSwapped);
+	    if (s < start) s = start;
+	    if (e > end) e = end;
+	    if (s < e)
 		{
-		for (i=0; i<head.itemCount; ++i)
-		    {
-		    bits32 s = memReadBits32(&blockPt, isSwapped);
-		    bits32 e = memReadBits32(&blockPt, isSwapped);
-		    val = memReadFloat(&blockPt, isSwapped);
-		    if (s < start) s = start;
-		    if (e > end) e = end;
-		    if (s < e)
-			{
-			lmAllocVar(lm, el);
-			el->start = s;
-			el->end = e;
-			el->val = val;
-			slAddHead(&list, el);
-			}
-		    }
-		break;
+		lmAllocVar(lm, el);
+		el->start = s;
+		el->end = e;
+		el->val = val;
+		slAddHead(&ic->list, el);
+		}
+	    }
+	break;
+	}
+    case bwgTypeVariableStep:
+	{
+	for (i=0; i<head.itemCount; ++i)
+	    {
+	    bits32 s = memReadBits32(&blockPt, isSwapped);
+	    bits32 e = s + head.itemSpan;
+	    val = memReadFloat(&blockPt, isSwapped);
+	    if (s < start) s = start;
+	    if (e > end) e = end;
+	    if (s < e)
+		{
+		lmAllocVar(lm, el);
+		el->start = s;
+		el->end = e;
+		el->val = val;
+		slAddHead(&ic->list, el);
+		}
+	    }
+	break;
+	}
+    case bwgTypeFixedStep:
+	{
+	bits32 s = head.start;
+	bits32 e = s + head.itemSpan;
+	for (i=0; i<head.itemCount; ++i)
+	    {
+	    val = memReadFloat(&blockPt, isSwapped);
+	    bits32 clippedS = s, clippedE = e;
+	    if (clippedS < start) clippedS = start;
+	    if (clippedE > end) clippedE = end;
+	    if (clippedS < clippedE)
+		{
+		lmAllocVar(lm, el);
+		el->start = clippedS;
+		el->end = clippedE;
+		el->val = val;
+		slAddHead(&ic->list, el);
 		}
-	    case bwgTypeVariableStep:
+	    s += head.itemStep;
+	    e += head.itemStep;
+	    }
+	break;
+	}
+    default:
+	internalErr();
+	break;
+    }
+assert(blockPt == blockEnd);
+return TRUE;
+}
+
+struct bbiInterval *bigWigIntervalQuery(struct bbiFile *bwf, char *chrom, bits32 start, bits32 end,
+	struct lm *lm)
+/* Get data for interval.  Return list allocated out of lm. */
+{
+if (bwf->typeSig != bigWigSig)
+   errAbort("Trying to do bigWigIntervalQuery on a non big-wig file.");
+bbiAttachUnzoomedCir(bwf);
+struct fileOffsetSize *blockList = bbiOverlappingBlocks(bwf, bwf->unzoomedCir, 
+	chrom, start, end, NULL);
+struct bwgIntervalContext ic = {start, end, lm, NULL};
+bwgForEachBlock(bwf, blockList, bwgBlockToIntervals, &ic);
+slFreeList(&blockList);
+slReverse(&ic.list);
+return ic.list;
+}
+
+static void bwgFillFloats(float *vals, bits32 s, bits32 e, float val)
+/* Set vals[s] through vals[e-1] to val. */
+{
+bits32 i;
+for (i=s; i<e; ++i)
+    vals[i] = val;
+}
+
+static int bwgBlockToFloatArray(boolean isSwapped, char *blockPt, char *blockEnd, 
+	bits32 start, bits32 end, float *vals)
+/* Copy the parts of a bigWig data block that intersect start-end into vals, which
+ * is indexed from start.  Return number of bases set. */
+{
+struct bwgSectionHead head;
+bwgSectionHeadFromMem(&blockPt, &head, isSwapped);
+int covered = 0;
+bits16 i;
+switch (head.type)
+    {
+    case bwgTypeBedGraph:
+	{
+	for (i=0; i<head.itemCount; ++i)
+	    {
+	    bits32 s = memReadBits32(&blockPt, isSwapped);
+	    bits32 e = memReadBits32(&blockPt, isSwapped);
+	    float val = memReadFloat(&blockPt, isSwapped);
+	    if (s < start) s = start;
+	    if (e > end) e = end;
+	    if (s < e)
+		{
+		bwgFillFloats(vals, s - start, e - start, val);
+		covered += e - s;
+		}
+	    }
+	break;
+	}
+    case bwgTypeVariableStep:
+	{
+	for (i=0; i<head.itemCount; ++i)
+	    {
+	    bits32 s = memReadBits32(&blockPt, isSwapped);
+	    bits32 e = s + head.itemSpan;
+	    float val = memReadFloat(&blockPt, isSwapped);
+	    if (s < start) s = start;
+	    if (e > end) e = end;
+	    if (s < e)
 		{
-		for (i=0; i<head.itemCount; ++i)
+		bwgFillFloats(vals, s - start, e - start, val);
+		covered += e - s;
+		}
+	    }
+	break;
+	}
+    case bwgTypeFixedStep:
+	{
+	if (head.itemStep == 1 && head.itemSpan == 1)
+	    {
+	    /* The common dense case - one value per base - is already laid out just
+	     * like the output array, so just copy over the part we want. */
+	    bits32 s = max(head.start, start);
+	    bits32 e = min(head.start + head.itemCount, end);
+	    if (s < e)
+		{
+		char *pt = blockPt + (s - head.start) * sizeof(float);
+		float *out = vals + (s - start);
+		bits32 n = e - s;
+		if (isSwapped)
 		    {
-		    bits32 s = memReadBits32(&blockPt, isSwapped);
-		    bits32 e = s + head.itemSpan;
-		    val = memReadFloat(&blockPt, isSwapped);
-		    if (s < start) s = start;
-		    if (e > end) e = end;
-		    if (s < e)
-			{
-			lmAllocVar(lm, el);
-			el->start = s;
-			el->end = e;
-			el->val = val;
-			slAddHead(&list, el);
-			}
+		    bits32 j;
+		    for (j=0; j<n; ++j)
+			out[j] = memReadFloat(&pt, isSwapped);
 		    }
-		break;
+		else
+		    memcpy(out, pt, n * sizeof(float));
+		covered += n;
 		}
-	    case bwgTypeFixedStep:
+	    blockPt += head.itemCount * sizeof(float);
+	    }
+	else
+	    {
+	    bits32 s = head.start;
+	    for (i=0; i<head.itemCount; ++i)
 		{
-		bits32 s = head.start;
-		bits32 e = s + head.itemSpan;
-		for (i=0; i<head.itemCount; ++i)
+		float val = memReadFloat(&blockPt, isSwapped);
+		bits32 clippedS = max(s, start);
+		bits32 clippedE = min(s + head.itemSpan, end);
+		if (clippedS < clippedE)
 		    {
-		    val = memReadFloat(&blockPt, isSwapped);
-		    bits32 clippedS = s, clippedE = e;
-		    if (clippedS < start) clippedS = start;
-		    if (clippedE > end) clippedE = end;
-		    if (clippedS < clippedE)
-			{
-			lmAllocVar(lm, el);
-			el->start = clippedS;
-			el->end = clippedE;
-			el->val = val;
-			slAddHead(&list, el);
-			}
-		    s += head.itemStep;
-		    e += head.itemStep;
+		    bwgFillFloats(vals, clippedS - start, clippedE - start, val);
+		    covered += clippedE - clippedS;
 		    }
-		break;
+		s += head.itemStep;
 		}
-	    default:
-		internalErr();
-		break;
 	    }
-	assert(blockPt == blockEnd);
-	blockBuf += block->size;
+	break;
 	}
-    freeMem(mergedBuf);
+    default:
+	internalErr();
+	break;
     }
-freeMem(uncompressBuf);
-slFreeList(&blockList);
-slReverse(&list);
-return list;
+assert(blockPt == blockEnd);
+return covered;
 }
 
-int bigWigIntervalDump(struct bbiFile *bwf, char *chrom, bits32 start, bits32 end, int maxCount,
-	FILE *out)
-/* Print out info on bigWig parts that intersect chrom:start-end.   Set maxCount to 0 if you 
- * don't care how many are printed.  Returns number printed. */
+struct bwgFloatContext
+/* What bwgBlockToFloats needs to know. */
+    {
+    bits32 start, end;		/* Range we want. */
+    float *vals;		/* Values indexed from start. */
+    int covered;		/* Number of bases set so far. */
+    };
+
+static boolean bwgBlockToFloats(boolean isSwapped, char *blockPt, char *blockEnd, 
+	void *context)
+/* Copy parts of block that intersect range into value array.  A BwgBlockFunc. */
+{
+struct bwgFloatContext *fc = context;
+fc->covered += bwgBlockToFloatArray(isSwapped, blockPt, blockEnd, fc->start, fc->end, 
+	fc->vals);
+return TRUE;
+}
+
+int bigWigFloatQuery(struct bbiFile *bwf, char *chrom, bits32 start, bits32 end, float *vals)
+/* Fill in vals[0] through vals[end-start-1] with the value at each base of chrom:start-end,
+ * decoding data sections straight into the array rather than building an interval list.
+ * Bases without data are set to NaN.  Returns number of bases with data. */
 {
 if (bwf->typeSig != bigWigSig)
-   errAbort("Trying to do bigWigIntervalDump on a non big-wig file.");
+   errAbort("Trying to do bigWigFloatQuery on a non big-wig file.");
+if (start >= end)
+    return 0;
+bwgFillFloats(vals, 0, end - start, NAN);
 bbiAttachUnzoomedCir(bwf);
 struct fileOffsetSize *blockList = bbiOverlappingBlocks(bwf, bwf->unzoomedCir, 
 	chrom, start, end, NULL);
-struct fileOffsetSize *block, *beforeGap, *afterGap;
-struct udcFile *udc = bwf->udc;
-int printCount = 0;
-
-/* Set up for uncompression optionally. */
-char *uncompressBuf = NULL;
-if (bwf->uncompressBufSize > 0)
-    uncompressBuf = needLargeMem(bwf->uncompressBufSize);
+struct bwgFloatContext fc = {start, end, vals, 0};
+bwgForEachBlock(bwf, blockList, bwgBlockToFloats, &fc);
+slFreeList(&blockList);
+return fc.covered;
+}
 
-/* This loop is a little complicated because we merge the read requests for efficiency, but we 
- * have to then go back through the data one unmerged block at a time. */
-for (block = blockList; block != NULL; )
+struct bwgItemContext
+/* What bwgBlockToItems needs to know. */
     {
-    /* Find contigious blocks and read them into mergedBuf. */
-    fileOffsetSizeFindGap(block, &beforeGap, &afterGap);
-    bits64 mergedOffset = block->offset;
-    bits64 mergedSize = beforeGap->offset + beforeGap->size - mergedOffset;
-    udcSeek(udc, mergedOffset);
-    char *mergedBuf = needLargeMem(mergedSize);
-    udcMustRead(udc, mergedBuf, mergedSize);
-    char *blockBuf = mergedBuf;
+    BigWigItemFunc func;	/* Function to call on each item. */
+    void *context;		/* Passed to func. */
+    };
 
-    /* Loop through individual blocks within merged section. */
-    for (;block != afterGap; block = block->next)
-        {
-	/* Uncompress if necessary. */
-	char *blockPt, *blockEnd;
-	if (uncompressBuf)
+static boolean bwgBlockToItems(boolean isSwapped, char *blockPt, char *blockEnd, 
+	void *context)
+/* Call function on each item in block.  A BwgBlockFunc. */
+{
+struct bwgItemContext *ic = context;
+struct bwgSectionHead head;
+bwgSectionHeadFromMem(&blockPt, &head, isSwapped);
+bits16 i;
+switch (head.type)
+    {
+    case bwgTypeBedGraph:
+	{
+	for (i=0; i<head.itemCount; ++i)
 	    {
-	    blockPt = uncompressBuf;
-	    int uncSize = zUncompress(blockBuf, block->size, uncompressBuf, bwf->uncompressBufSize);
-	    blockEnd = blockPt + uncSize;
+	    bits32 s = memReadBits32(&blockPt, isSwapped);
+	    bits32 e = memReadBits32(&blockPt, isSwapped);
+	    float val = memReadFloat(&blockPt, isSwapped);
+	    ic->func(ic->context, s, e, val);
 	    }
-	else
+	break;
+	}
+    case bwgTypeVariableStep:
+	{
+	for (i=0; i<head.itemCount; ++i)
 	    {
-	    blockPt = blockBuf;
-	    blockEnd = blockPt + block->size;
+	    bits32 s = memReadBits32(&blockPt, isSwapped);
+	    float val = memReadFloat(&blockPt, isSwapped);
+	    ic->func(ic->context, s, s + head.itemSpan, val);
 	    }
-
-	/* Do the actual dump. */
-	int oneCount = bigWigBlockDumpIntersectingRange(bwf->isSwapped, blockPt, blockEnd, 
-		chrom, start, end, maxCount, out);
-
-	/* Keep track of how many dumped, not exceeding maximum. */
-	printCount += oneCount;
-	if (maxCount != 0)
+	break;
+	}
+    case bwgTypeFixedStep:
+	{
+	bits32 s = head.start;
+	for (i=0; i<head.itemCount; ++i)
 	    {
-	    if (oneCount >= maxCount)
-		{
-		block = NULL;	 // we want to drop out of the outer loop too
-		break;
-		}
-
-	    maxCount -= oneCount;
+	    float val = memReadFloat(&blockPt, isSwapped);
+	    ic->func(ic->context, s, s + head.itemSpan, val);
+	    s += head.itemStep;
 	    }
-	blockBuf += block->size;
+	break;
 	}
-    freeMem(mergedBuf);
+    default:
+	internalErr();
+	break;
     }
-freeMem(uncompressBuf);
+assert(blockPt == blockEnd);
+return TRUE;
+}
+
+bits64 bigWigItemSweep(struct bbiFile *bwf, char *chrom, bits32 start, bits32 end,
+	bits64 lastOffset, BigWigItemFunc func, void *context)
+/* Call func on each item in the data blocks that overlap chrom:start-end, in order of
+ * start.  Items are not clipped to start-end, and may not overlap it at all.  Blocks
+ * at file offsets up to lastOffset are skipped.  Returns offset of the last block
+ * read, so that a caller sweeping through a chromosome window by window can pass it
+ * back in to go through each block just once.  Pass 0 for the first window. */
+{
+if (bwf->typeSig != bigWigSig)
+   errAbort("Trying to do bigWigItemSweep on a non big-wig file.");
+bbiAttachUnzoomedCir(bwf);
+struct fileOffsetSize *blockList = bbiOverlappingBlocks(bwf, bwf->unzoomedCir, 
+	chrom, start, end, NULL);
+
+/* Skip blocks already seen in previous window. */
+struct fileOffsetSize *block;
+while (blockList != NULL && blockList->offset <= lastOffset)
+    {
+    block = blockList;
+    blockList = blockList->next;
+    freeMem(block);
+    }
+if (blockList != NULL)
+    {
+    struct bwgItemContext ic = {func, context};
+    bwgForEachBlock(bwf, blockList, bwgBlockToItems, &ic);
+    struct fileOffsetSize *lastBlock = slLastEl(blockList);
+    lastOffset = lastBlock->offset;
+    }
+slFreeList(&blockList);
+return lastOffset;
+}
+
+struct bwgDumpContext
+/* What bwgBlockToDump needs to know. */
+    {
+    char *chrom;		/* Chromosome name to print. */
+    bits32 start, end;		/* Range we want. */
+    int maxCount;		/* Maximum left to print, 0 for no limit. */
+    int printCount;		/* Number printed so far. */
+    FILE *out;			/* Where to print. */
+    };
 
+static boolean bwgBlockToDump(boolean isSwapped, char *blockPt, char *blockEnd, 
+	void *context)
+/* Print parts of block that intersect range.  A BwgBlockFunc.  Returns FALSE once
+ * maximum is reached. */
+{
+struct bwgDumpContext *dc = context;
+int oneCount = bigWigBlockDumpIntersectingRange(isSwapped, blockPt, blockEnd, 
+	dc->chrom, dc->start, dc->end, dc->maxCount, dc->out);
+
+/* Keep track of how many dumped, not exceeding maximum. */
+dc->printCount += oneCount;
+if (dc->maxCount != 0)
+    {
+    if (oneCount >= dc->maxCount)
+	return FALSE;
+    dc->maxCount -= oneCount;
+    }
+return TRUE;
+}
+
+int bigWigIntervalDump(struct bbiFile *bwf, char *chrom, bits32 start, bits32 end, int maxCount,
+	FILE *out)
+/* Print out info on bigWig parts that intersect chrom:start-end.   Set maxCount to 0 if you 
+ * don't care how many are printed.  Returns number printed. */
+{
+if (bwf->typeSig != bigWigSig)
+   errAbort("Trying to do bigWigIntervalDump on a non big-wig file.");
+bbiAttachUnzoomedCir(bwf);
+struct fileOffsetSize *blockList = bbiOverlappingBlocks(bwf, bwf->unzoomedCir, 
+	chrom, start, end, NULL);
+struct bwgDumpContext dc = {chrom, start, end, maxCount, 0, out};
+bwgForEachBlock(bwf, blockList, bwgBlockToDump, &dc);
 slFreeList(&blockList);
-return printCount;
+return dc.printCount;
 }
 
 boolean bigWigSummaryArray(struct bbiFile *bwf, char *chrom, bits32 start, bits32 end,
@@ -369,8 +604,8 @@ boolean bigWigSummaryArray(struct bbiFile *bwf, char *chrom, bits32 start, bits3
  * be 0.0 or nan("") depending on the application.)  Returns FALSE if no data
  * at that position. */
 {
-boolean ret = bbiSummaryArray(bwf, chrom, start, end, bigWigIntervalQuery,
-	summaryType, summarySize, summaryValues);
+boolean ret = bbiFloatSummaryArray(bwf, chrom, start, end, bigWigIntervalQuery,
+	bigWigFloatQuery, summaryType, summarySize, summaryValues);
 return ret;
 }
 
@@ -379,8 +614,8 @@ boolean bigWigSummaryArrayExtended(struct bbiFile *bwf, char *chrom, bits32 star
 /* Get extended summary information for summarySize evenely spaced elements into
  * the summary array. */
 {
-boolean ret = bbiSummaryArrayExtended(bwf, chrom, start, end, bigWigIntervalQuery,
-	summarySize, summary);
+boolean ret = bbiFloatSummaryArrayExtended(bwf, chrom, start, end, bigWigIntervalQuery,
+	bigWigFloatQuery, summarySize, summary);
 return ret;
 }
 
@@ -9,38 +9,56 @@
 #include "common.h"
 #include "localmem.h"
 #include "linefile.h"
-#include "dlist.h"
 #include "chainBlock.h"
+#include "gapCalc.h"
+#include "chainConnect.h"
 
 
-struct kdBranch
-/* A kd-tree. That is a binary tree which partitions the children
- * into higher and lower one dimension at a time.  We're just doing
- * one in two dimensions, so it alternates between q and t dimensions. */
-    {
-    struct kdBranch *lo;      /* Pointer to children with lower coordinates. */
-    struct kdBranch *hi;      /* Pointer to children with higher coordinates. */
-    struct kdLeaf *leaf;      /* Extra info for leaves on tree. */
-    int cutCoord;	      /* Coordinate (in some dimension) to cut on */
-    double maxScore;	      /* Max score of any leaf below us. */
-    int maxQ;		      /* Maximum qEnd of any leaf below us. */
-    int maxT;		      /* Maximum tEnd of any leaf below us. */
-    };
-
 struct kdLeaf
 /* A leaf in our kdTree. */
     {
     struct kdLeaf *next;	/* Next in list. */
     struct cBlock *cb;	        /* Start position and score from user. */
-    struct kdBranch *bestPred;	/* Best predecessor. */
+    struct kdLeaf *bestPred;	/* Best predecessor. */
     double totalScore;		/* Total score of chain up to here. */
     bool hit;			/* This hit? Used by system internally. */
     };
 
+struct kdBranch
+/* A node in a kd-tree. That is a binary tree which partitions the children
+ * into higher and lower one dimension at a time.  We're just doing
+ * one in two dimensions, so it alternates between q and t dimensions.
+ * Branches are kept in an array, with the two children of a branch next
+ * to each other.  On 64 bit machines a branch is 32 bytes, so with the
+ * array aligned on 64 bytes and children starting at even indexes, the
+ * two children share a cache line. */
+    {
+    double maxScore;	      /* Max score of any leaf below us. */
+    int maxQ;		      /* Maximum qEnd of any leaf below us. */
+    int maxT;		      /* Maximum tEnd of any leaf below us. */
+    struct kdLeaf *leaf;      /* Extra info for leaves on tree, NULL for other branches. */
+    union
+        {
+	struct
+	    {
+	    int cutCoord;     /* Coordinate (in some dimension) to cut on */
+	    int lo;	      /* Index of child with lower coordinates.  Hi is next. */
+	    } split;	      /* Used if leaf is NULL. */
+	struct
+	    {
+	    int qStart, tStart;	/* Start of leaf, saving a trip to the leaf to check. */
+	    } start;	      /* Used if leaf is non-NULL. */
+	} u;
+    };
+
+#define kdRoot 1	/* Index of root, which makes the index of each pair of children even. */
+
 struct kdTree
 /* The whole tree.  */
     {
-    struct kdBranch *root;	/* Pointer to root of kd-tree. */
+    void *mem;			/* Memory allocated for branches. */
+    struct kdBranch *branches;	/* Array of branches, aligned for cache. */
+    int branchCount;		/* Number of branches used, including unused one at start. */
     };
 
 
@@ -71,215 +89,178 @@ else if (diff > 0) return 1;
 else return 0;
 }
 
-static int medianVal(struct dlList *list, int medianIx, int dim)
-/* Return value of median block in list on given dimension 
- * Mark blocks up to median as hit. */
+static int leafCoord(struct kdLeaf *leaf, int dim)
+/* Return start of leaf in given dimension. */
 {
-struct dlNode *node = list->head;
-struct kdLeaf *leaf = NULL;
-int i;
-
-for (i=0; i<medianIx; ++i)
-    {
-    leaf = node->val;
-    leaf->hit = TRUE;  
-    node = node->next;
-    }
 return (dim == 0 ? leaf->cb->qStart : leaf->cb->tStart);
 }
 
-static int splitList(struct dlList *oldList, struct dlList *newList)
-/* Peel off members of oldList that are not hit onto new list. */
+static void kdBuild(struct kdTree *tree, int ix, struct kdLeaf **lists[2], int leafCount,
+	int dim, struct kdLeaf **buf)
+/* Build up kd-tree recursively from leaves, filling in branch at ix.  The leaves
+ * are in lists[0] sorted by query start and in lists[1] sorted by target start.
+ * Buf is scratch space for at least leafCount leaves. */
 {
-struct dlNode *node, *next;
-struct kdLeaf *leaf;
-int newCount = 0;
-dlListInit(newList);
-for (node = oldList->head; !dlEnd(node); node = next)
+struct kdBranch *branch = &tree->branches[ix];
+if (leafCount == 1)
     {
-    next = node->next;
-    leaf = node->val;
-    if (!leaf->hit)
-	{
-	dlRemove(node);
-	dlAddTail(newList, node);
-	++newCount;
-	}
-    }
-return newCount;
-}
-
-static void clearHits(struct dlList *list)
-/* Clear hit flags of all blocks on list. */
-{
-struct dlNode *node;
-for (node = list->head; !dlEnd(node); node = node->next)
-    {
-    struct kdLeaf *leaf = node->val;
-    leaf->hit = FALSE;
-    }
-}
-
-
-static struct kdBranch *kdBuild(int nodeCount, struct dlList *lists[2], int dim,
-	struct lm *lm)
-/* Build up kd-tree recursively. */
-{
-struct kdBranch *branch;
-lmAllocVar(lm, branch);
-if (nodeCount == 1)
-    {
-    struct kdLeaf *leaf = lists[0]->head->val;
+    struct kdLeaf *leaf = lists[0][0];
     branch->leaf = leaf;
+    branch->u.start.qStart = leaf->cb->qStart;
+    branch->u.start.tStart = leaf->cb->tStart;
     branch->maxQ = leaf->cb->qEnd;
     branch->maxT = leaf->cb->tEnd;
     }
 else
     {
-    int newCount;
-    struct dlList *newLists[2];
-    struct dlList newQ, newT;
+    int loCount = leafCount/2;
+    struct kdLeaf **cutList = lists[dim], **otherList = lists[1-dim];
+    int i, otherLo = 0, otherHi = 0;
     int nextDim = 1-dim;
 
-    /* Subdivide lists along median.  */
-    newLists[0] = &newQ;
-    newLists[1] = &newT;
-    clearHits(lists[0]);
-    branch->cutCoord = medianVal(lists[dim], nodeCount/2, dim);
-    newCount = splitList(lists[0], newLists[0]);
-    splitList(lists[1], newLists[1]);
+    /* Subdivide along median.  The first half of the list sorted in this
+     * dimension goes low.  Partition the other list the same way, keeping
+     * each side in order. */
+    for (i=0; i<leafCount; ++i)
+	cutList[i]->hit = (i < loCount);
+    branch->u.split.cutCoord = leafCoord(cutList[loCount-1], dim);
+    for (i=0; i<leafCount; ++i)
+        {
+	struct kdLeaf *leaf = otherList[i];
+	if (leaf->hit)
+	    otherList[otherLo++] = leaf;
+	else
+	    buf[otherHi++] = leaf;
+	}
+    memcpy(otherList + loCount, buf, otherHi * sizeof(buf[0]));
 
     /* Recurse on each side. */
-    branch->lo = kdBuild(nodeCount - newCount, lists, nextDim, lm);
-    branch->hi = kdBuild(newCount, newLists, nextDim, lm);
-    branch->maxQ = max(branch->lo->maxQ, branch->hi->maxQ);
-    branch->maxT = max(branch->lo->maxT, branch->hi->maxT);
+    struct kdLeaf **hiLists[2] = {lists[0] + loCount, lists[1] + loCount};
+    int lo = branch->u.split.lo = tree->branchCount;
+    tree->branchCount += 2;
+    kdBuild(tree, lo, lists, loCount, nextDim, buf);
+    kdBuild(tree, lo+1, hiLists, leafCount - loCount, nextDim, buf);
+    struct kdBranch *loBranch = &tree->branches[lo], *hiBranch = loBranch + 1;
+    branch->maxQ = max(loBranch->maxQ, hiBranch->maxQ);
+    branch->maxT = max(loBranch->maxT, hiBranch->maxT);
     }
-return branch;
 }
 
-static struct kdTree *kdTreeMake(struct kdLeaf *leafList, struct lm *lm)
-/* Make a kd-tree containing leafList. */
+static void kdTreeMake(struct kdTree *tree, struct kdLeaf *leafList, int leafCount)
+/* Make a kd-tree containing leafList, which is sorted by target start. */
 {
-struct kdLeaf *leaf;
-int nodeCount = slCount(leafList);
-struct kdTree *tree;
-struct dlList qList, tList,*lists[2];
-struct dlNode *qNodes, *tNodes;
+struct kdLeaf **qList, **tList, **buf, *leaf;
 int i;
 
-/* Build lists sorted in each dimension. This
- * will let us quickly find medians while constructing
- * the kd-tree. */
-dlListInit(&qList);
-dlListInit(&tList);
-AllocArray(qNodes, nodeCount);
-AllocArray(tNodes, nodeCount);
-for (i=0 , leaf=leafList; leaf != NULL; leaf = leaf->next, ++i)
-    {
-    qNodes[i].val = tNodes[i].val = leaf;
-    dlAddTail(&qList, &qNodes[i]);
-    dlAddTail(&tList, &tNodes[i]);
-    }
-/* Just sort qList since tList is sorted because it was
- * constructed from sorted leafList. */
-dlSort(&qList, kdLeafCmpQ); 
-lists[0] = &qList;
-lists[1] = &tList;
-
-/* Allocate master data structure and call recursive builder. */
-lmAllocVar(lm, tree);
-tree->root = kdBuild(nodeCount, lists, 0, lm);
+/* Build arrays sorted in each dimension. This will let us quickly
+ * find medians while constructing the kd-tree. The tList is sorted
+ * because it was constructed from sorted leafList. */
+AllocArray(qList, leafCount);
+AllocArray(tList, leafCount);
+AllocArray(buf, leafCount);
+for (i=0, leaf=leafList; leaf != NULL; leaf = leaf->next, ++i)
+    qList[i] = tList[i] = leaf;
+qsort(qList, leafCount, sizeof(qList[0]), kdLeafCmpQ);
+
+/* Allocate all branches at once, aligned on a cache line, and call recursive builder.
+ * The two extra branches leave room to move the start up to the next 64 bytes. */
+tree->mem = needHugeZeroedMem((2*leafCount + 2) * sizeof(tree->branches[0]));
+tree->branches = (struct kdBranch *)(((size_t)tree->mem + 63) & ~(size_t)63);
+tree->branchCount = kdRoot + 1;
+struct kdLeaf **lists[2] = {qList, tList};
+kdBuild(tree, kdRoot, lists, leafCount, 0, buf);
 
 /* Clean up and go home. */
-freeMem(qNodes);
-freeMem(tNodes);
-return tree;
+freeMem(qList);
+freeMem(tList);
+freeMem(buf);
 }
 
-struct predScore
-/* Predecessor and score we get merging with it. */
+struct predSearch
+/* Things that stay the same while finding the best predecessor to a leaf,
+ * plus the best found so far. */
     {
-    struct kdBranch *pred;	/* Predecessor. */
-    double score;		/* Score of us plus predecessor. */
+    struct kdBranch *branches;  /* Tree to search. */
+    struct cBlock *lonely;	    /* We're finding this block's predecessor */
+    ConnectCost connectCost;    /* Cost to connect two leafs. */
+    GapCost gapCost;	    /* Lower bound on gap cost. */
+    void *gapData;		    /* Data to pass to Gap/Connect cost */
+    struct gapCalc *gapCalc;    /* Non-NULL if gapCost is chainConnectGapCost. */
+    struct kdLeaf *pred;	    /* Best predecessor so far. */
+    double score;		    /* Score of lonely plus best predecessor. */
     };
 
-static struct predScore bestPredecessor(
-	struct kdLeaf *lonely,	    /* We're finding this leaf's predecessor */
-	ConnectCost connectCost,    /* Cost to connect two leafs. */
-	GapCost gapCost,	    /* Lower bound on gap cost. */
-	void *gapData,		    /* Data to pass to Gap/Connect cost */
-	int dim,		    /* Dimension level of tree splits on. */
-	struct kdBranch *branch,    /* Subtree to explore */
-	struct predScore bestSoFar) /* Best predecessor so far. */
+static void bestPredecessor(struct predSearch *search,
+	int ix,			    /* Index of subtree to explore */
+	int dim)		    /* Dimension level of tree splits on. */
 /* Find the highest scoring predecessor to this leaf, and
  * thus iteratively the highest scoring subchain that ends
  * in this leaf. */
 {
+struct kdBranch *branch = &search->branches[ix];
+struct cBlock *lonely = search->lonely;
 struct kdLeaf *leaf;
-double maxScore = branch->maxScore + lonely->cb->score;
+double maxScore = branch->maxScore + lonely->score;
 
 /* If best score in this branch of tree wouldn't be enough
  * don't bother exploring it. First try without calculating
  * gap score in case gap score is a little expensive to calculate. */
-if (maxScore < bestSoFar.score)
-    return bestSoFar;
-maxScore -= gapCost(lonely->cb->qStart - branch->maxQ, 
-	lonely->cb->tStart - branch->maxT, gapData);
-if (maxScore < bestSoFar.score)
-    return bestSoFar;
-
+if (maxScore < search->score)
+    return;
+int dq = lonely->qStart - branch->maxQ, dt = lonely->tStart - branch->maxT;
+if (search->gapCalc != NULL)
+    maxScore -= gapCalcCost(search->gapCalc, dq, dt);
+else
+    maxScore -= search->gapCost(dq, dt, search->gapData);
+if (maxScore < search->score)
+    return;
 
 /* If it's a terminal branch, then calculate score to connect
  * with it. */
 else if ((leaf = branch->leaf) != NULL)
     {
-    if (leaf->cb->qStart < lonely->cb->qStart 
-     && leaf->cb->tStart < lonely->cb->tStart)
+    if (branch->u.start.qStart < lonely->qStart && branch->u.start.tStart < lonely->tStart)
 	{
-	double score = leaf->totalScore + lonely->cb->score - 
-		connectCost(leaf->cb, lonely->cb, gapData);
-	if (score > bestSoFar.score)
+	double score = leaf->totalScore + lonely->score - 
+		search->connectCost(leaf->cb, lonely, search->gapData);
+	if (score > search->score)
 	   {
-	   bestSoFar.score = score;
-	   bestSoFar.pred = branch;
+	   search->score = score;
+	   search->pred = leaf;
 	   }
 	}
-    return bestSoFar;
     }
 
 /* Otherwise explore sub-trees that could harbor predecessors. */
 else
     {
     int newDim = 1-dim;
-    int dimCoord = (dim == 0 ? lonely->cb->qStart : lonely->cb->tStart);
+    int dimCoord = (dim == 0 ? lonely->qStart : lonely->tStart);
     
     /* Explore hi branch first as it is more likely to have high
      * scores.  However only explore it if it can have things starting
      * before us. */
-    if (dimCoord > branch->cutCoord)
-         bestSoFar = bestPredecessor(lonely, connectCost, gapCost, gapData,
-	 	newDim, branch->hi, bestSoFar);
-    bestSoFar = bestPredecessor(lonely, connectCost, gapCost, gapData,
-    	newDim, branch->lo, bestSoFar);
-    return bestSoFar;
+    if (dimCoord > branch->u.split.cutCoord)
+         bestPredecessor(search, branch->u.split.lo + 1, newDim);
+    bestPredecessor(search, branch->u.split.lo, newDim);
     }
 }
 
-static void updateScoresOnWay(struct kdBranch *branch, 
+static void updateScoresOnWay(struct kdBranch *branches, int ix,
 	int dim, struct kdLeaf *leaf)
 /* Traverse kd-tree to find leaf.  Update all maxScores on the way
  * to reflect leaf->totalScore. */
 {
+struct kdBranch *branch = &branches[ix];
 int newDim = 1-dim;
 int dimCoord = (dim == 0 ? leaf->cb->qStart : leaf->cb->tStart);
 if (branch->maxScore < leaf->totalScore) branch->maxScore = leaf->totalScore;
 if (branch->leaf == NULL)
     {
-    if (dimCoord <= branch->cutCoord)
-	updateScoresOnWay(branch->lo, newDim, leaf);
-    if (dimCoord >= branch->cutCoord)
-	updateScoresOnWay(branch->hi, newDim, leaf);
+    if (dimCoord <= branch->u.split.cutCoord)
+	updateScoresOnWay(branches, branch->u.split.lo, newDim, leaf);
+    if (dimCoord >= branch->u.split.cutCoord)
+	updateScoresOnWay(branches, branch->u.split.lo + 1, newDim, leaf);
     }
 }
 
@@ -287,24 +268,31 @@ static void findBestPredecessors(struct kdTree *tree, struct kdLeaf *leafList,
 	ConnectCost connectCost, GapCost gapCost, void *gapData)
 /* Find best predecessor for each leaf. */
 {
-static struct predScore noBest;
 struct kdLeaf *leaf;
-double bestScore = 0;
+struct predSearch search;
+ZeroVar(&search);
+search.branches = tree->branches;
+search.connectCost = connectCost;
+search.gapCost = gapCost;
+search.gapData = gapData;
+
+/* Most users get gap costs from chainConnect.  Since this is called for
+ * most branches visited, skip the indirection for them. */
+if (gapCost == (GapCost)chainConnectGapCost)
+    search.gapCalc = ((struct chainConnect *)gapData)->gapCalc;
 
 for (leaf = leafList; leaf != NULL; leaf = leaf->next)
     {
-    struct predScore best;
-    best = bestPredecessor(leaf, connectCost, gapCost, gapData, 0, tree->root, noBest);
-    if (best.score > leaf->totalScore)
-        {
-	leaf->totalScore = best.score;
-	leaf->bestPred = best.pred;
-	}
-    updateScoresOnWay(tree->root, 0, leaf);
-    if (bestScore < leaf->totalScore)
+    search.lonely = leaf->cb;
+    search.pred = NULL;
+    search.score = 0;
+    bestPredecessor(&search, kdRoot, 0);
+    if (search.score > leaf->totalScore)
         {
-	bestScore = leaf->totalScore;
+	leaf->totalScore = search.score;
+	leaf->bestPred = search.pred;
 	}
+    updateScoresOnWay(tree->branches, kdRoot, 0, leaf);
     }
 }
 
@@ -374,12 +362,12 @@ for (leaf = leafList; leaf != NULL; leaf = leaf->next)
 		if (details)
 		    {
 		    struct cBlock *b = lf->cb;
-		    struct cBlock *a = lf->bestPred->leaf->cb;
+		    struct cBlock *a = lf->bestPred->cb;
 		    fprintf(details, " gap %d\t%d\n", 
 			b->tStart - a->tEnd, b->qStart - a->qEnd);
 		    }
 		}
-	    lf = lf->bestPred->leaf;
+	    lf = lf->bestPred;
 	    if (lf->hit)
 	        break;
 	    }
@@ -410,8 +398,9 @@ struct chain *chainBlocks(
  * the chains will need some cleanup at the end.  Use the chainConnect
  * module to help with this.  See hg/mouseStuff/axtChain for example usage. */
 {
-struct kdTree *tree;
+struct kdTree tree;
 struct kdLeaf *leafList = NULL, *leaf;
+int leafCount = 0;
 struct cBlock *block;
 struct chain *chainList = NULL, *chain;
 struct lm *lm;
@@ -421,7 +410,7 @@ if (*pBlockList == NULL)
    return NULL;
 
 /* Make a leaf for each block. */
-lm = lmInit(0);  /* Memory for tree, branches and leaves. */
+lm = lmInit(0);  /* Memory for leaves. */
 for (block = *pBlockList; block != NULL; block = block->next)
     {
     /* Watch out for 0-length blocks in input: */
@@ -431,12 +420,21 @@ for (block = *pBlockList; block != NULL; block = block->next)
     leaf->cb = block;
     leaf->totalScore = block->score;
     slAddHead(&leafList, leaf);
+    ++leafCount;
+    }
+
+/* All blocks may have been 0-length. */
+if (leafList == NULL)
+    {
+    lmCleanup(&lm);
+    *pBlockList = NULL;
+    return NULL;
     }
 
 /* Figure out chains. */
 slSort(&leafList, kdLeafCmpT);
-tree = kdTreeMake(leafList, lm);
-findBestPredecessors(tree, leafList, connectCost, gapCost, gapData);
+kdTreeMake(&tree, leafList, leafCount);
+findBestPredecessors(&tree, leafList, connectCost, gapCost, gapData);
 slSort(&leafList, kdLeafCmpTotal);
 chainList = peelChains(qName, qSize, qStrand, tName, tSize, leafList, details);
 
@@ -446,6 +444,7 @@ for (chain = chainList; chain != NULL; chain = chain->next)
 slSort(&chainList,  chainCmpScore);
 
 /* Clean up and go home. */
+freeMem(tree.mem);
 lmCleanup(&lm);
 *pBlockList = NULL;
 return chainList;
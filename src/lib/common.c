@@ -10,6 +10,9 @@
 #include "linefile.h"
 #include "hash.h"
 #include "sqlNum.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 void *cloneMem(void *pt, size_t size)
 /* Allocate a new buffer of given size, and copy pt to it. */
@@ -1699,19 +1702,43 @@ while (--hLen >= 0)
 return NULL;
 }
 
+#ifdef __SSE2__
+static int flipCase16(char *s, int n, char first, char last)
+/* Flip the case of characters from first to last in the 16 byte blocks of s,
+ * and return how many characters were done. */
+{
+__m128i before = _mm_set1_epi8(first-1), after = _mm_set1_epi8(last+1);
+__m128i caseBit = _mm_set1_epi8(0x20);
+int i;
+for (i=0; i + 16 <= n; i += 16)
+    {
+    __m128i x = _mm_loadu_si128((__m128i *)(s+i));
+    __m128i inRange = _mm_and_si128(_mm_cmpgt_epi8(x, before), _mm_cmplt_epi8(x, after));
+    _mm_storeu_si128((__m128i *)(s+i), _mm_xor_si128(x, _mm_and_si128(inRange, caseBit)));
+    }
+return i;
+}
+#endif /* __SSE2__ */
+
 void toUpperN(char *s, int n)
 /* Convert a section of memory to upper case. */
 {
-int i;
-for (i=0; i<n; ++i)
+int i = 0;
+#ifdef __SSE2__
+i = flipCase16(s, n, 'a', 'z');
+#endif
+for (; i<n; ++i)
     s[i] = toupper(s[i]);
 }
 
 void toLowerN(char *s, int n)
 /* Convert a section of memory to lower case. */
 {
-int i;
-for (i=0; i<n; ++i)
+int i = 0;
+#ifdef __SSE2__
+i = flipCase16(s, n, 'A', 'Z');
+#endif
+for (; i<n; ++i)
     s[i] = tolower(s[i]);
 }
 
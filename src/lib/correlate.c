@@ -49,6 +49,18 @@ c->sumYY += cy*y;
 c->n += count;
 }
 
+void correlateAdd(struct correlate *c, struct correlate *other)
+/* Add all samples that went into other to c.  Handy when collecting
+ * correlations in pieces, for instance in separate threads. */
+{
+c->sumX += other->sumX;
+c->sumXX += other->sumXX;
+c->sumXY += other->sumXY;
+c->sumY += other->sumY;
+c->sumYY += other->sumYY;
+c->n += other->n;
+}
+
 double correlateResult(struct correlate *c)
 /* Returns correlation (aka R) */
 {
@@ -14,6 +14,9 @@
 
 #include "common.h"
 #include "dnautil.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 
 struct codonTable
@@ -125,6 +128,9 @@ int ntVal5[256];
 int ntValNoN[256]; /* Like ntVal, but with T_BASE_VAL in place of -1 for nonexistent ones. */
 DNA valToNt[(N_BASE_VAL|MASKED_BASE_BIT)+1];
 
+/* The four bases that each possible packed byte unpacks to. */
+static DNA unpackedBytes[256][4];
+
 /* convert tables for bit-4 indicating masked */
 int ntValMasked[256];
 DNA valToNtMasked[256];
@@ -164,6 +170,12 @@ if (!inittedNtVal)
     valToNt[A_BASE_VAL] = valToNt[A_BASE_VAL|MASKED_BASE_BIT] = 'a';
     valToNt[G_BASE_VAL] = valToNt[G_BASE_VAL|MASKED_BASE_BIT] = 'g';
     valToNt[N_BASE_VAL] = valToNt[N_BASE_VAL|MASKED_BASE_BIT] = 'n';
+    for (i=0; i<ArraySize(unpackedBytes); ++i)
+        {
+	int j;
+	for (j=0; j<4; ++j)
+	    unpackedBytes[i][j] = valToNt[(i >> (6-j-j)) & 3];
+	}
 
     /* masked values */
     ntValMasked['T'] = T_BASE_VAL;
@@ -448,23 +460,95 @@ ntCompTable[')'] = '(';
 inittedCompTable = TRUE;
 }
 
+#ifdef __SSE2__
+static boolean complement16(__m128i x, __m128i *retComp)
+/* If the 16 characters in x are all ACGTN in either case, put their complement
+ * in retComp and return TRUE.  Otherwise return FALSE so the caller can use
+ * ntCompTable.  A and T differ by 0x15 and C and G by 0x04 in both cases. */
+{
+__m128i lower = _mm_or_si128(x, _mm_set1_epi8(0x20));
+__m128i isAT = _mm_or_si128(_mm_cmpeq_epi8(lower, _mm_set1_epi8('a')),
+			    _mm_cmpeq_epi8(lower, _mm_set1_epi8('t')));
+__m128i isCG = _mm_or_si128(_mm_cmpeq_epi8(lower, _mm_set1_epi8('c')),
+			    _mm_cmpeq_epi8(lower, _mm_set1_epi8('g')));
+__m128i isN = _mm_cmpeq_epi8(lower, _mm_set1_epi8('n'));
+if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(isAT, isCG), isN)) != 0xFFFF)
+    return FALSE;
+__m128i flip = _mm_or_si128(_mm_and_si128(isAT, _mm_set1_epi8(0x15)),
+			    _mm_and_si128(isCG, _mm_set1_epi8(0x04)));
+*retComp = _mm_xor_si128(x, flip);
+return TRUE;
+}
+
+static __m128i reverse16(__m128i x)
+/* Return x with its 16 bytes in reverse order. */
+{
+x = _mm_shuffle_epi32(x, _MM_SHUFFLE(0,1,2,3));
+x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(2,3,0,1));
+x = _mm_shufflehi_epi16(x, _MM_SHUFFLE(2,3,0,1));
+return _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+}
+#endif /* __SSE2__ */
+
 /* Complement DNA (not reverse). */
 void complement(DNA *dna, long length)
 {
-int i;
+long i = 0;
 
 if (!inittedCompTable) initNtCompTable();
-for (i=0; i<length; ++i)
+#ifdef __SSE2__
+/* Do 16 bases at a time, using the table for blocks with unusual characters. */
+for (; i + 16 <= length; i += 16)
     {
-    *dna = ntCompTable[(int)*dna];
-    ++dna;
+    __m128i comp;
+    if (complement16(_mm_loadu_si128((__m128i *)(dna+i)), &comp))
+        _mm_storeu_si128((__m128i *)(dna+i), comp);
+    else
+        {
+	int j;
+	for (j=0; j<16; ++j)
+	    dna[i+j] = ntCompTable[(unsigned char)dna[i+j]];
+	}
     }
+#endif /* __SSE2__ */
+for (; i<length; ++i)
+    dna[i] = ntCompTable[(unsigned char)dna[i]];
 }
 
 
 /* Reverse complement DNA. */
 void reverseComplement(DNA *dna, long length)
 {
+#ifdef __SSE2__
+/* Swap and complement 16 bases from each end at a time, then do what is
+ * left in the middle the simple way. */
+DNA *left = dna, *right = dna + length;
+if (!inittedCompTable) initNtCompTable();
+while (right - left >= 32)
+    {
+    right -= 16;
+    __m128i leftComp, rightComp;
+    if (complement16(_mm_loadu_si128((__m128i *)left), &leftComp)
+        && complement16(_mm_loadu_si128((__m128i *)right), &rightComp))
+	{
+	_mm_storeu_si128((__m128i *)left, reverse16(rightComp));
+	_mm_storeu_si128((__m128i *)right, reverse16(leftComp));
+	}
+    else
+        {
+	int i;
+	for (i=0; i<16; ++i)
+	    {
+	    DNA c = left[i];
+	    left[i] = ntCompTable[(unsigned char)right[15-i]];
+	    right[15-i] = ntCompTable[(unsigned char)c];
+	    }
+	}
+    left += 16;
+    }
+dna = left;
+length = right - left;
+#endif /* __SSE2__ */
 reverseBytes(dna, length);
 complement(dna, length);
 }
@@ -790,20 +874,61 @@ while (--count >= 0)
 return out;
 }
 
+void packDnaBytes(DNA *in, int baseCount, UBYTE *out)
+/* Pack baseCount bases four to a byte into out, which must have room for
+ * (baseCount+3)/4 bytes.  A partial last byte is padded with T's.  Gives the
+ * same result as packDna4 on each four bases, but is faster on long sequences. */
+{
+int i = 0;
+#ifdef __SSE2__
+/* Turn 16 bases into 2 bit values in 16 bytes, then gather each group of four
+ * bytes into one, first base in the high bits.  T and anything that isn't
+ * ACG is zero, as in ntValNoN. */
+for (; i + 16 <= baseCount; i += 16)
+    {
+    __m128i x = _mm_loadu_si128((__m128i *)(in+i));
+    __m128i lower = _mm_or_si128(x, _mm_set1_epi8(0x20));
+    __m128i val = _mm_or_si128(
+	    _mm_and_si128(_mm_cmpeq_epi8(lower, _mm_set1_epi8('c')), _mm_set1_epi8(C_BASE_VAL)),
+	    _mm_and_si128(_mm_cmpeq_epi8(lower, _mm_set1_epi8('a')), _mm_set1_epi8(A_BASE_VAL)));
+    val = _mm_or_si128(val,
+	    _mm_and_si128(_mm_cmpeq_epi8(lower, _mm_set1_epi8('g')), _mm_set1_epi8(G_BASE_VAL)));
+    __m128i packed = _mm_or_si128(
+	    _mm_and_si128(_mm_slli_epi32(val, 6), _mm_set1_epi32(0xC0)),
+	    _mm_and_si128(_mm_srli_epi32(val, 4), _mm_set1_epi32(0x30)));
+    packed = _mm_or_si128(packed, _mm_or_si128(
+	    _mm_and_si128(_mm_srli_epi32(val, 14), _mm_set1_epi32(0x0C)),
+	    _mm_srli_epi32(val, 24)));
+    packed = _mm_packs_epi32(packed, packed);
+    packed = _mm_packus_epi16(packed, packed);
+    bits32 four = _mm_cvtsi128_si32(packed);
+    memcpy(out, &four, 4);
+    out += 4;
+    }
+#endif /* __SSE2__ */
+for (; i + 4 <= baseCount; i += 4)
+    *out++ = packDna4(in+i);
+if (i < baseCount)
+    {
+    DNA last4[4] = {'T', 'T', 'T', 'T'};
+    memcpy(last4, in+i, baseCount-i);
+    *out = packDna4(last4);
+    }
+}
+
 void unpackDna(bits32 *tiles, int tileCount, DNA *out)
 /* Unpack DNA. Expands to 16x tileCount in output. */
 {
-int i, j;
+int i;
 bits32 tile;
 
 for (i=0; i<tileCount; ++i)
     {
     tile = tiles[i];
-    for (j=15; j>=0; --j)
-        {
-        out[j] = valToNt[tile & 0x3];
-        tile >>= 2;
-        }
+    memcpy(out, unpackedBytes[tile >> 24], 4);
+    memcpy(out+4, unpackedBytes[(tile >> 16) & 0xff], 4);
+    memcpy(out+8, unpackedBytes[(tile >> 8) & 0xff], 4);
+    memcpy(out+12, unpackedBytes[tile & 0xff], 4);
     out += 16;
     }
 }
@@ -811,17 +936,11 @@ for (i=0; i<tileCount; ++i)
 void unpackDna4(UBYTE *tiles, int byteCount, DNA *out)
 /* Unpack DNA. Expands to 4x byteCount in output. */
 {
-int i, j;
-UBYTE tile;
+int i;
 
 for (i=0; i<byteCount; ++i)
     {
-    tile = tiles[i];
-    for (j=3; j>=0; --j)
-        {
-        out[j] = valToNt[tile & 0x3];
-        tile >>= 2;
-        }
+    memcpy(out, unpackedBytes[tiles[i]], 4);
     out += 4;
     }
 }
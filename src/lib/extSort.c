@@ -0,0 +1,470 @@
+/* extSort - sort more records than fit in memory.  Records are added with a key made of
+ * a string and a number, and come back out in key order.  When the records added take
+ * more than a memory limit they are sorted, using several threads, and written to a
+ * temporary file called a run.  At the end the runs are merged.
+ *
+ * Each record in memory carries the first eight bytes of its key packed into an
+ * integer, so most comparisons don't have to look at the key strings at all.  Runs
+ * are read back through large buffers and merged with a heap, so merging doesn't slow
+ * down as the number of runs grows.  If there are too many runs to have all open at
+ * once they are merged in groups first. */
+/* This file is copyright 2026 UCSC Genome Browser Authors, but license is hereby
+ * granted for all use - public, private or commercial. */
+
+#include "common.h"
+#include "localmem.h"
+#include "portable.h"
+#include "quickHeap.h"
+#include "pthreadDoList.h"
+#include "extSort.h"
+
+#define extSortMaxMerge 256	/* Most runs to merge at once. */
+#define extSortMinSlice 4096	/* Fewest records worth sorting in their own thread. */
+#define extSortWriteBuf (4*1024*1024)	/* Size of buffer for writing runs. */
+
+struct esRec
+/* A record to sort. */
+    {
+    bits64 prefix;	/* First eight bytes of key, big end first, zero padded. */
+    bits64 num;		/* Numerical part of key. */
+    bits64 seq;		/* Order record was added in, to keep sort stable. */
+    char *key;		/* Zero terminated key string. */
+    char *data;		/* Data, not zero terminated. */
+    int dataSize;	/* Size of data. */
+    };
+
+struct esSource
+/* A sorted source of records to merge, either a run file or a slice of memory. */
+    {
+    struct esSource *next;	/* Next in list. */
+    int ix;			/* Position in merge, earlier sources win ties. */
+    struct esRec cur;		/* Current record. */
+    struct esRec *recs;		/* Records of memory slice. */
+    bits64 recCount;		/* Number of records in memory slice. */
+    bits64 recIx;		/* Index of next record in memory slice. */
+    char *fileName;		/* Name of run file. */
+    FILE *f;			/* Open run file or NULL. */
+    char *fBuf;			/* Stdio buffer of f or NULL. */
+    char *buf;			/* Holds key and data of current record from file. */
+    int bufSize;		/* Allocated size of buf. */
+    };
+
+struct extSort
+/* An external sorter. */
+    {
+    char *tempDir;		/* Where to put runs. */
+    long long maxMem;		/* Memory to keep records in. */
+    int threads;		/* Number of threads to sort with. */
+    struct lm *lm;		/* Keys and data of records in memory. */
+    struct esRec *recs;		/* Records in memory. */
+    bits64 recCount;		/* Number of records in memory. */
+    bits64 recAlloc;		/* Allocated size of recs. */
+    long long memUsed;		/* Memory used by records in memory. */
+    bits64 seq;			/* Count of records added. */
+    struct esSource *runList;	/* Runs written so far, in order. */
+    int runCount;		/* Number of runs in list. */
+    boolean merging;		/* Set once final merge has started. */
+    struct esSource *mergeList;	/* Sources of final merge. */
+    struct quickHeap *heap;	/* Heap of final merge. */
+    struct esSource *lastSource;  /* Source of last record returned. */
+    };
+
+bits64 extSortSignedNum(long long x)
+/* Return number that sorts the same way as signed x. */
+{
+return ((bits64)x) ^ 0x8000000000000000ULL;
+}
+
+bits64 extSortDoubleNum(double x)
+/* Return number that sorts the same way as x. */
+{
+bits64 u;
+memcpy(&u, &x, sizeof(u));
+if (u & 0x8000000000000000ULL)
+    return ~u;
+else
+    return u | 0x8000000000000000ULL;
+}
+
+static bits64 keyPrefix(char *key)
+/* Return first eight bytes of key packed into a number that sorts the same way. */
+{
+bits64 prefix = 0;
+int i;
+for (i=0; i<8; ++i)
+    {
+    prefix <<= 8;
+    if (*key != 0)
+        prefix |= (UBYTE)*key++;
+    }
+return prefix;
+}
+
+static int esRecCmp(const struct esRec *a, const struct esRec *b)
+/* Compare two records by key and num. */
+{
+if (a->prefix != b->prefix)
+    return (a->prefix < b->prefix ? -1 : 1);
+if ((a->prefix & 0xFF) != 0)	/* Keys are longer than prefix. */
+    {
+    int diff = strcmp(a->key + 8, b->key + 8);
+    if (diff != 0)
+        return diff;
+    }
+if (a->num != b->num)
+    return (a->num < b->num ? -1 : 1);
+return 0;
+}
+
+static int esRecCmpSeq(const void *va, const void *vb)
+/* Compare two records by key, num, and order added. */
+{
+const struct esRec *a = va, *b = vb;
+int diff = esRecCmp(a, b);
+if (diff == 0)
+    diff = (a->seq < b->seq ? -1 : 1);
+return diff;
+}
+
+static int esSourceCmp(const void *va, const void *vb)
+/* Compare current records of two sources for quickHeap, which keeps the biggest on
+ * top, so return the opposite of the record order. */
+{
+const struct esSource *a = va, *b = vb;
+int diff = esRecCmp(&a->cur, &b->cur);
+if (diff == 0)
+    diff = a->ix - b->ix;
+return -diff;
+}
+
+struct extSort *extSortNew(char *tempDir, long long maxMem, int threads)
+/* Return a new sorter that keeps about maxMem bytes of records in memory, writes
+ * temporary files to tempDir (NULL for current dir), and sorts in threads threads. */
+{
+struct extSort *es;
+if (threads < 1 || threads > 256)
+    errAbort("extSortNew: threads is %d, but must be between 1 and 256", threads);
+AllocVar(es);
+es->tempDir = cloneString(tempDir != NULL ? tempDir : ".");
+es->maxMem = maxMem;
+es->threads = threads;
+es->lm = lmInit(0);
+return es;
+}
+
+static void esSourceClose(struct esSource *source)
+/* Close file of source if open, and free its buffer. */
+{
+carefulClose(&source->f);
+freez(&source->fBuf);
+}
+
+static void esSourceFree(struct esSource **pSource)
+/* Close and remove file of source if any, and free it. */
+{
+struct esSource *source = *pSource;
+if (source != NULL)
+    {
+    esSourceClose(source);
+    if (source->fileName != NULL)
+        {
+	remove(source->fileName);
+	freeMem(source->fileName);
+	}
+    freeMem(source->buf);
+    freez(pSource);
+    }
+}
+
+static void esSourceFreeList(struct esSource **pList)
+/* Free a list of sources. */
+{
+struct esSource *el, *next;
+for (el = *pList; el != NULL; el = next)
+    {
+    next = el->next;
+    esSourceFree(&el);
+    }
+*pList = NULL;
+}
+
+void extSortFree(struct extSort **pEs)
+/* Free up sorter and remove any temporary files it still has. */
+{
+struct extSort *es = *pEs;
+if (es != NULL)
+    {
+    esSourceFreeList(&es->runList);
+    esSourceFreeList(&es->mergeList);
+    freeQuickHeap(&es->heap);
+    lmCleanup(&es->lm);
+    freeMem(es->recs);
+    freeMem(es->tempDir);
+    freez(pEs);
+    }
+}
+
+static boolean esSourceNext(struct esSource *source)
+/* Move source on to next record.  Return FALSE at end. */
+{
+if (source->f == NULL)
+    {
+    if (source->recIx >= source->recCount)
+        return FALSE;
+    source->cur = source->recs[source->recIx++];
+    return TRUE;
+    }
+bits64 num;
+bits32 keySize, dataSize;
+if (fread(&num, sizeof(num), 1, source->f) != 1)
+    {
+    if (ferror(source->f))
+        errnoAbort("Couldn't read %s", source->fileName);
+    return FALSE;
+    }
+mustReadOne(source->f, keySize);
+mustReadOne(source->f, dataSize);
+int size = keySize + 1 + dataSize;
+if (size > source->bufSize)
+    {
+    freeMem(source->buf);
+    source->bufSize = max(size, 2*source->bufSize);
+    source->buf = needLargeMem(source->bufSize);
+    }
+mustRead(source->f, source->buf, keySize);
+source->buf[keySize] = 0;
+mustRead(source->f, source->buf + keySize + 1, dataSize);
+struct esRec *rec = &source->cur;
+rec->key = source->buf;
+rec->prefix = keyPrefix(rec->key);
+rec->num = num;
+rec->data = source->buf + keySize + 1;
+rec->dataSize = dataSize;
+return TRUE;
+}
+
+static void esSourceOpen(struct esSource *source, int bufSize)
+/* Open run file of source for reading with a buffer of bufSize. */
+{
+if (source->fileName != NULL)
+    {
+    source->f = mustOpen(source->fileName, "rb");
+    source->fBuf = needLargeMem(bufSize);
+    setvbuf(source->f, source->fBuf, _IOFBF, bufSize);
+    }
+}
+
+static struct quickHeap *esMergeStart(struct esSource *sourceList, long long maxMem)
+/* Open sources and return heap of the ones that have records. */
+{
+int count = slCount(sourceList);
+long long bufSize = maxMem / (2*count);
+if (bufSize < 64*1024)
+    bufSize = 64*1024;
+if (bufSize > 4*1024*1024)
+    bufSize = 4*1024*1024;
+struct quickHeap *heap = newQuickHeap(count, esSourceCmp);
+struct esSource *source;
+int ix = 0;
+for (source = sourceList; source != NULL; source = source->next)
+    {
+    source->ix = ix++;
+    esSourceOpen(source, bufSize);
+    if (esSourceNext(source))
+        addToQuickHeap(heap, source);
+    }
+return heap;
+}
+
+static void esMergeAdvance(struct quickHeap *heap, struct esSource *source)
+/* Move source at top of heap on to its next record, and rebalance heap. */
+{
+if (esSourceNext(source))
+    quickHeapTopChanged(heap);
+else
+    {
+    removeQuickHeapTop(heap);
+    esSourceClose(source);
+    }
+}
+
+static void esRecWrite(struct esRec *rec, FILE *f)
+/* Write record to run file. */
+{
+bits32 keySize = strlen(rec->key);
+bits32 dataSize = rec->dataSize;
+writeOne(f, rec->num);
+writeOne(f, keySize);
+writeOne(f, dataSize);
+mustWrite(f, rec->key, keySize);
+mustWrite(f, rec->data, dataSize);
+}
+
+static struct esSource *esRunNew(struct extSort *es)
+/* Create a new run file and return source for it, with the file open for writing
+ * in run->f.  Close it with esSourceClose before reading. */
+{
+struct esSource *run;
+AllocVar(run);
+run->fileName = cloneString(rTempName(es->tempDir, "extSort", ".tmp"));
+run->f = mustOpen(run->fileName, "wb");
+run->fBuf = needLargeMem(extSortWriteBuf);
+setvbuf(run->f, run->fBuf, _IOFBF, extSortWriteBuf);
+return run;
+}
+
+static struct esSource *esMergeToRun(struct extSort *es, struct esSource *sourceList)
+/* Merge sources into a new run and return it. */
+{
+struct esSource *run = esRunNew(es);
+struct quickHeap *heap = esMergeStart(sourceList, es->maxMem);
+while (!quickHeapEmpty(heap))
+    {
+    struct esSource *source = peekQuickHeapTop(heap);
+    esRecWrite(&source->cur, run->f);
+    esMergeAdvance(heap, source);
+    }
+freeQuickHeap(&heap);
+esSourceClose(run);
+return run;
+}
+
+static void esSortSlice(void *item, void *context)
+/* Sort records in a memory slice.  Called in parallel by pthreadDoList. */
+{
+struct esSource *slice = item;
+qsort(slice->recs, slice->recCount, sizeof(slice->recs[0]), esRecCmpSeq);
+}
+
+static struct esSource *esSortInMemory(struct extSort *es)
+/* Sort records in memory in parallel a slice per thread, and return list of slices. */
+{
+struct esSource *sliceList = NULL, *slice;
+bits64 sliceCount = es->recCount / extSortMinSlice;
+if (sliceCount > es->threads)
+    sliceCount = es->threads;
+if (sliceCount < 1)
+    sliceCount = 1;
+bits64 i, start = 0;
+for (i=0; i<sliceCount; ++i)
+    {
+    bits64 end = es->recCount * (i+1) / sliceCount;
+    AllocVar(slice);
+    slice->recs = es->recs + start;
+    slice->recCount = end - start;
+    slAddHead(&sliceList, slice);
+    start = end;
+    }
+slReverse(&sliceList);
+pthreadDoList(es->threads, sliceList, esSortSlice, NULL);
+return sliceList;
+}
+
+static void esWriteRun(struct extSort *es)
+/* Sort records in memory, write them to a new run, and empty memory. */
+{
+struct esSource *sliceList = esSortInMemory(es);
+struct esSource *run = esMergeToRun(es, sliceList);
+esSourceFreeList(&sliceList);
+slAddTail(&es->runList, run);
+es->runCount += 1;
+verbose(2, "wrote run %d of %lld records to %s\n", es->runCount, (long long)es->recCount,
+	run->fileName);
+es->recCount = 0;
+es->memUsed = 0;
+lmCleanup(&es->lm);
+es->lm = lmInit(0);
+}
+
+void extSortAdd(struct extSort *es, char *key, bits64 num, void *data, int dataSize)
+/* Add a record to sorter.  Records are ordered by key compared as unsigned bytes,
+ * then by num, then by the order they were added.  Key and data are copied. */
+{
+if (es->merging)
+    errAbort("extSortAdd called after extSortNext");
+int keySize = strlen(key);
+long long recMem = sizeof(struct esRec) + keySize + 1 + dataSize;
+if (es->recCount > 0 && es->memUsed + recMem > es->maxMem)
+    esWriteRun(es);
+if (es->recCount >= es->recAlloc)
+    {
+    es->recAlloc = (es->recAlloc == 0 ? 1024 : 2*es->recAlloc);
+    es->recs = needLargeMemResize(es->recs, es->recAlloc * sizeof(es->recs[0]));
+    }
+char *mem = lmAlloc(es->lm, keySize + 1 + dataSize);
+memcpy(mem, key, keySize + 1);
+memcpy(mem + keySize + 1, data, dataSize);
+struct esRec *rec = &es->recs[es->recCount++];
+rec->prefix = keyPrefix(key);
+rec->num = num;
+rec->seq = es->seq++;
+rec->key = mem;
+rec->data = mem + keySize + 1;
+rec->dataSize = dataSize;
+es->memUsed += recMem;
+}
+
+static void esFinish(struct extSort *es)
+/* Get ready for final merge of runs and records still in memory. */
+{
+struct esSource *sliceList = NULL;
+es->merging = TRUE;
+if (es->runCount > 0 && es->recCount > 0
+    && es->runCount + es->threads > extSortMaxMerge)
+    esWriteRun(es);
+else
+    sliceList = esSortInMemory(es);
+
+/* Merge runs in groups until there are few enough to merge at once.  Groups are
+ * consecutive so earlier records still win ties. */
+while (es->runCount > extSortMaxMerge)
+    {
+    struct esSource *newList = NULL;
+    int newCount = 0;
+    while (es->runList != NULL)
+        {
+	struct esSource *groupList = NULL;
+	int i;
+	for (i=0; i<extSortMaxMerge && es->runList != NULL; ++i)
+	    slAddHead(&groupList, slPopHead(&es->runList));
+	slReverse(&groupList);
+	slAddHead(&newList, esMergeToRun(es, groupList));
+	esSourceFreeList(&groupList);
+	++newCount;
+	}
+    slReverse(&newList);
+    verbose(2, "merged %d runs into %d\n", es->runCount, newCount);
+    es->runList = newList;
+    es->runCount = newCount;
+    }
+es->mergeList = slCat(es->runList, sliceList);
+es->runList = NULL;
+es->heap = esMergeStart(es->mergeList, es->maxMem);
+}
+
+boolean extSortNext(struct extSort *es, char **retKey, bits64 *retNum,
+	char **retData, int *retDataSize)
+/* Return next record in order, or FALSE when there are no more.  No more records can
+ * be added after the first call.  Returned key and data are valid until next call. */
+{
+if (!es->merging)
+    esFinish(es);
+else if (es->lastSource != NULL)
+    esMergeAdvance(es->heap, es->lastSource);
+if (quickHeapEmpty(es->heap))
+    {
+    es->lastSource = NULL;
+    return FALSE;
+    }
+struct esSource *source = es->lastSource = peekQuickHeapTop(es->heap);
+struct esRec *rec = &source->cur;
+if (retKey != NULL)
+    *retKey = rec->key;
+if (retNum != NULL)
+    *retNum = rec->num;
+if (retData != NULL)
+    *retData = rec->data;
+if (retDataSize != NULL)
+    *retDataSize = rec->dataSize;
+return TRUE;
+}
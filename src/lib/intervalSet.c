@@ -0,0 +1,219 @@
+/* intervalSet - a set of positions on a sequence kept as a sorted array of runs.
+ * Use it in place of a bitmap when sets are combined with ands, ors and nots and
+ * the number of runs is much smaller than the sequence is long.  The boolean
+ * operations walk the runs of both sets in step, so they take time proportional
+ * to the number of runs rather than to the size of the sequence. */
+/* This file is copyright 2026 UCSC Genome Browser Authors, but license is hereby
+ * granted for all use - public, private or commercial. */
+
+#include "common.h"
+#include "intervalSet.h"
+
+struct intervalSet *intervalSetNew()
+/* Return a new, empty set. */
+{
+struct intervalSet *set;
+AllocVar(set);
+set->isNormal = TRUE;
+return set;
+}
+
+void intervalSetFree(struct intervalSet **pSet)
+/* Free up set. */
+{
+struct intervalSet *set = *pSet;
+if (set != NULL)
+    {
+    freeMem(set->runs);
+    freez(pSet);
+    }
+}
+
+static void addRun(struct intervalSet *set, int start, int end)
+/* Add run to end of set's array, making the array bigger if need be. */
+{
+if (set->count >= set->alloc)
+    {
+    int newAlloc = (set->alloc == 0 ? 16 : set->alloc * 2);
+    set->runs = needLargeMemResize(set->runs, newAlloc * sizeof(set->runs[0]));
+    set->alloc = newAlloc;
+    }
+struct intervalRun *run = &set->runs[set->count++];
+run->start = start;
+run->end = end;
+}
+
+static void extendRun(struct intervalSet *set, int start, int end)
+/* Add a run that starts at or after the start of the last run in a normal
+ * set, merging it with the last run if they touch. */
+{
+if (set->count > 0)
+    {
+    struct intervalRun *last = &set->runs[set->count-1];
+    if (start <= last->end)
+        {
+	if (end > last->end)
+	    last->end = end;
+	return;
+	}
+    }
+addRun(set, start, end);
+}
+
+void intervalSetAdd(struct intervalSet *set, int start, int end)
+/* Add positions start to end to set.  Runs can be added in any order and may
+ * overlap.  Empty runs are ignored. */
+{
+if (start >= end)
+    return;
+if (set->isNormal && set->count > 0 && start < set->runs[set->count-1].start)
+    set->isNormal = FALSE;
+if (set->isNormal)
+    extendRun(set, start, end);
+else
+    addRun(set, start, end);
+}
+
+static int intervalRunCmp(const void *va, const void *vb)
+/* Compare runs by start. */
+{
+const struct intervalRun *a = va, *b = vb;
+if (a->start != b->start)
+    return (a->start < b->start ? -1 : 1);
+return 0;
+}
+
+void intervalSetNormalize(struct intervalSet *set)
+/* Sort runs and merge any that overlap or abut.  The other routines do this
+ * as needed, but a set should be normalized before it is shared between threads. */
+{
+if (set->isNormal)
+    return;
+qsort(set->runs, set->count, sizeof(set->runs[0]), intervalRunCmp);
+int i, count = 0;
+for (i=0; i<set->count; ++i)
+    {
+    struct intervalRun *run = &set->runs[i];
+    if (count > 0 && run->start <= set->runs[count-1].end)
+        {
+	if (run->end > set->runs[count-1].end)
+	    set->runs[count-1].end = run->end;
+	}
+    else
+        set->runs[count++] = *run;
+    }
+set->count = count;
+set->isNormal = TRUE;
+}
+
+struct intervalSet *intervalSetClone(struct intervalSet *set)
+/* Return a normalized copy of set. */
+{
+intervalSetNormalize(set);
+struct intervalSet *clone = intervalSetNew();
+if (set->count > 0)
+    {
+    clone->runs = needLargeMem(set->count * sizeof(set->runs[0]));
+    CopyArray(set->runs, clone->runs, set->count);
+    clone->count = clone->alloc = set->count;
+    }
+return clone;
+}
+
+struct intervalSet *intervalSetAnd(struct intervalSet *a, struct intervalSet *b)
+/* Return new set of positions that are in both a and b. */
+{
+intervalSetNormalize(a);
+intervalSetNormalize(b);
+struct intervalSet *set = intervalSetNew();
+int i = 0, j = 0;
+while (i < a->count && j < b->count)
+    {
+    struct intervalRun *ra = &a->runs[i], *rb = &b->runs[j];
+    int start = max(ra->start, rb->start);
+    int end = min(ra->end, rb->end);
+    if (start < end)
+        addRun(set, start, end);
+    if (ra->end < rb->end)
+        ++i;
+    else
+        ++j;
+    }
+return set;
+}
+
+struct intervalSet *intervalSetOr(struct intervalSet *a, struct intervalSet *b)
+/* Return new set of positions that are in either a or b. */
+{
+intervalSetNormalize(a);
+intervalSetNormalize(b);
+struct intervalSet *set = intervalSetNew();
+int i = 0, j = 0;
+while (i < a->count || j < b->count)
+    {
+    struct intervalRun *run;
+    if (j >= b->count || (i < a->count && a->runs[i].start <= b->runs[j].start))
+        run = &a->runs[i++];
+    else
+        run = &b->runs[j++];
+    extendRun(set, run->start, run->end);
+    }
+return set;
+}
+
+struct intervalSet *intervalSetNot(struct intervalSet *set, int size)
+/* Return new set of positions between 0 and size that are not in set. */
+{
+intervalSetNormalize(set);
+struct intervalSet *not = intervalSetNew();
+int i, start = 0;
+for (i=0; i<set->count && start < size; ++i)
+    {
+    struct intervalRun *run = &set->runs[i];
+    int end = min(run->start, size);
+    if (start < end)
+        addRun(not, start, end);
+    if (run->end > start)
+        start = run->end;
+    }
+if (start < size)
+    addRun(not, start, size);
+return not;
+}
+
+long long intervalSetTotal(struct intervalSet *set)
+/* Return number of positions in set. */
+{
+intervalSetNormalize(set);
+long long total = 0;
+int i;
+for (i=0; i<set->count; ++i)
+    total += set->runs[i].end - set->runs[i].start;
+return total;
+}
+
+long long intervalSetCountRange(struct intervalSet *set, int start, int size)
+/* Return number of positions in set between start and start+size. */
+{
+intervalSetNormalize(set);
+int end = start + size;
+/* Binary search for first run that ends after start. */
+int lo = 0, hi = set->count;
+while (lo < hi)
+    {
+    int mid = (lo + hi) / 2;
+    if (set->runs[mid].end <= start)
+        lo = mid + 1;
+    else
+        hi = mid;
+    }
+long long total = 0;
+int i;
+for (i=lo; i<set->count && set->runs[i].start < end; ++i)
+    {
+    int s = max(set->runs[i].start, start);
+    int e = min(set->runs[i].end, end);
+    total += e - s;
+    }
+return total;
+}
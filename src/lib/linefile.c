@@ -8,6 +8,8 @@
 #include "hash.h"
 #include <fcntl.h>
 #include <signal.h>
+#include <limits.h>
+#include <sys/mman.h>
 #include "dystring.h"
 #include "errAbort.h"
 #include "linefile.h"
@@ -15,6 +17,8 @@
 #include "localmem.h"
 #include "cheapcgi.h"
 #include "udc.h"
+#include "pthreadDoList.h"
+#include "bgzfReader.h"
 #include "htslib/tbx.h"
 
 char *getFileNameFromHdrSig(char *m)
@@ -350,11 +354,31 @@ struct lineFile *lineFileStdin(bool zTerm)
 return lineFileAttach("stdin", zTerm, fileno(stdin));
 }
 
+static int decompressThreads = 0;	/* Threads to inflate BGZF files, 0 for pipeline. */
+
+void lineFileSetDecompressThreads(int threadCount)
+/* Set number of threads that inflate BGZF (bgzip) compressed files that are opened
+ * from now on.  With the default of zero they are read through a gzip pipeline
+ * like other .gz files. */
+{
+decompressThreads = threadCount;
+}
+
+static struct lineFile *lineFileBgzf(char *fileName, bool zTerm)
+/* Open a lineFile on a BGZF file that is inflated by decompressThreads threads. */
+{
+struct lineFile *lf = lineFileAttach(fileName, zTerm, -1);
+lf->bgzf = bgzfReaderOpen(fileName, decompressThreads);
+return lf;
+}
+
 struct lineFile *lineFileMayOpen(char *fileName, bool zTerm)
 /* Try and open up a lineFile. */
 {
 if (sameString(fileName, "stdin"))
     return lineFileStdin(zTerm);
+else if (decompressThreads > 0 && endsWith(fileName, ".gz") && bgzfReaderIsBgzf(fileName))
+    return lineFileBgzf(fileName, zTerm);
 else if (getDecompressor(fileName) != NULL)
     return lineFileDecompress(fileName, zTerm);
 else
@@ -375,6 +399,150 @@ if (lf == NULL)
 return lf;
 }
 
+struct lineFile *lineFileMmap(char *fileName, bool zTerm)
+/* Open up a lineFile on a memory mapping of fileName or die trying.  Lines are
+ * returned as pointers straight into the mapping rather than copied into a buffer.
+ * The mapping is private, so with zTerm the line ends are zeroed in memory without
+ * changing the file, though that makes a private copy of every page.  Without
+ * zTerm nothing is copied, and lines are not zero terminated except the last.
+ * Lines stay put until the lineFile is closed or seeks back over them, so they
+ * don't need to be cloned to be kept.  Compressed files, stdin and files that
+ * can't be mapped are read by lineFileOpen instead.  The file must not be
+ * truncated while it is open. */
+{
+if (sameString(fileName, "stdin") || getDecompressor(fileName) != NULL)
+    return lineFileOpen(fileName, zTerm);
+int fd = open(fileName, O_RDONLY);
+if (fd == -1)
+    errAbort("Couldn't open %s , %s", fileName, strerror(errno));
+struct stat st;
+if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    return lineFileAttach(fileName, zTerm, fd);
+
+/* Map at least one byte more than the file so there is always a zero after the
+ * last line.  The system zeroes the part of the last page past the end of the
+ * file, and when the file fills its last page exactly the extra byte comes from
+ * the anonymous mapping that the file is mapped on top of. */
+size_t pageSize = sysconf(_SC_PAGESIZE);
+size_t fileSize = st.st_size;
+size_t mapAlloc = (fileSize + pageSize) / pageSize * pageSize;
+char *base = mmap(NULL, mapAlloc, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+if (base == MAP_FAILED)
+    return lineFileAttach(fileName, zTerm, fd);
+int flags = MAP_PRIVATE|MAP_FIXED;
+#ifdef MAP_POPULATE
+/* With zTerm every page gets written and so copied.  Copying them all up front
+ * takes about half as long as taking a fault on each page. */
+if (zTerm)
+    flags |= MAP_POPULATE;
+#endif
+if (fileSize > 0 && mmap(base, fileSize, PROT_READ|PROT_WRITE, flags, fd, 0) == MAP_FAILED)
+    {
+    munmap(base, mapAlloc);
+    return lineFileAttach(fileName, zTerm, fd);
+    }
+madvise(base, mapAlloc, MADV_SEQUENTIAL);
+
+struct lineFile *lf;
+AllocVar(lf);
+lf->fileName = cloneString(fileName);
+lf->fd = fd;
+lf->zTerm = zTerm;
+lf->mapBase = base;
+lf->mapAlloc = mapAlloc;
+lf->mapEnd = fileSize;
+return lf;
+}
+
+static struct lineFile *lineFileOnMapPart(struct lineFile *lf, off_t start, off_t end)
+/* Return a lineFile that reads from start to end of lf's mapping. */
+{
+struct lineFile *part;
+AllocVar(part);
+int nameSize = strlen(lf->fileName) + 64;
+part->fileName = needMem(nameSize);
+safef(part->fileName, nameSize, "%s from byte %lld", lf->fileName, (long long)start);
+part->fd = -1;
+part->zTerm = lf->zTerm;
+part->nlType = lf->nlType;
+part->mapBase = lf->mapBase;
+part->mapStart = part->mapPos = part->bufOffsetInFile = start;
+part->mapEnd = end;
+return part;
+}
+
+struct lineFileChunk *lineFileMmapChunks(struct lineFile *lf, int chunkCount)
+/* Split the rest of lf, which must be from lineFileMmap, into up to chunkCount
+ * chunks that each start on a new line.  Each chunk has its own lineFile that
+ * shares lf's mapping, and must be freed before lf is closed. */
+{
+if (lf->mapBase == NULL)
+    errAbort("lineFileMmapChunks: %s was not opened with lineFileMmap", lf->fileName);
+if (chunkCount < 1)
+    chunkCount = 1;
+if (lf->zTerm)
+    lf->mapZeroed = lf->mapEnd;
+struct lineFileChunk *list = NULL, *chunk;
+off_t start = lf->mapPos, end = lf->mapEnd;
+int chunkIx;
+for (chunkIx = 0; start < end; ++chunkIx)
+    {
+    /* Aim for an even share of what is left, then carry on to the end of the line. */
+    off_t chunkEnd = end;
+    int chunksLeft = chunkCount - chunkIx;
+    if (chunksLeft > 1)
+        {
+	off_t target = start + max((end - start) / chunksLeft, 1);
+	char *nl = memchr(lf->mapBase + target - 1, '\n', end - target + 1);
+	if (nl != NULL)
+	    chunkEnd = nl - lf->mapBase + 1;
+	}
+    AllocVar(chunk);
+    chunk->lf = lineFileOnMapPart(lf, start, chunkEnd);
+    chunk->chunkIx = chunkIx;
+    slAddHead(&list, chunk);
+    start = chunkEnd;
+    }
+slReverse(&list);
+return list;
+}
+
+struct chunkJob
+/* What lineFileChunkDoList passes to each thread. */
+    {
+    LineFileChunkWorker *worker;	/* Function to call on chunk. */
+    void *context;			/* Caller's context for worker. */
+    };
+
+static void chunkDo(void *item, void *context)
+/* Call caller's worker on one chunk. */
+{
+struct chunkJob *job = context;
+job->worker(item, job->context);
+}
+
+void lineFileChunkDoList(int threadCount, struct lineFileChunk *chunkList,
+	LineFileChunkWorker *worker, void *context)
+/* Call worker(chunk, context) on each chunk with threadCount threads in parallel.
+ * Returns after all chunks are done. */
+{
+struct chunkJob job = {worker, context};
+pthreadDoList(threadCount, chunkList, chunkDo, &job);
+}
+
+void lineFileChunkFreeList(struct lineFileChunk **pList)
+/* Close lineFiles of chunks and free list, but not vals. */
+{
+struct lineFileChunk *el, *next;
+for (el = *pList; el != NULL; el = next)
+    {
+    next = el->next;
+    lineFileClose(&el->lf);
+    freeMem(el);
+    }
+*pList = NULL;
+}
+
 void lineFileReuse(struct lineFile *lf)
 /* Reuse current line. */
 {
@@ -388,13 +556,28 @@ if (lf->tabix != NULL)
     lineFileAbort(lf, "%s: not implemented for lineFile opened with lineFileTabixMayOpen.", where);
 }
 
+static void mapRestore(struct lineFile *lf, off_t offset)
+/* Put back line ends that zTerm zeroed from offset on by mapping that part of the
+ * file again, which drops the private copies of the pages. */
+{
+if (lf->mapAlloc == 0)
+    errAbort("Can't seek back in %s, which is a chunk of a file read with zTerm",
+    	lf->fileName);
+size_t pageSize = sysconf(_SC_PAGESIZE);
+off_t start = offset / pageSize * pageSize;
+if (mmap(lf->mapBase + start, lf->mapZeroed - start, PROT_READ|PROT_WRITE,
+	MAP_PRIVATE|MAP_FIXED, lf->fd, start) == MAP_FAILED)
+    errnoAbort("Couldn't map %s again", lf->fileName);
+lf->mapZeroed = offset;
+}
+
 void lineFileSeek(struct lineFile *lf, off_t offset, int whence)
 /* Seek to read next line from given position. */
 {
 noTabixSupport(lf, "lineFileSeek");
 if (lf->checkSupport)
     lf->checkSupport(lf, "lineFileSeek");
-if (lf->pl != NULL)
+if (lf->pl != NULL || lf->bgzf != NULL)
     errnoAbort("Can't lineFileSeek on a compressed file: %s", lf->fileName);
 lf->reuse = FALSE;
 if (lf->udcFile)
@@ -402,6 +585,20 @@ if (lf->udcFile)
     udcSeek(lf->udcFile, offset);
     return;
     }
+if (lf->mapBase != NULL)
+    {
+    if (whence == SEEK_CUR)
+        offset += lf->mapPos;
+    else if (whence == SEEK_END)
+        offset += lf->mapEnd;
+    if (offset < lf->mapStart || offset > lf->mapEnd)
+        errAbort("Couldn't lineFileSeek %s to %lld", lf->fileName, (long long)offset);
+    if (offset < lf->mapZeroed)
+        mapRestore(lf, offset);
+    lf->lineStart = lf->lineEnd = lf->bytesInBuf = 0;
+    lf->mapPos = lf->bufOffsetInFile = offset;
+    return;
+    }
 lf->lineStart = lf->lineEnd = lf->bytesInBuf = 0;
 if ((lf->bufOffsetInFile = lseek(lf->fd, offset, whence)) == -1)
     errnoAbort("Couldn't lineFileSeek %s", lf->fileName);
@@ -410,7 +607,7 @@ if ((lf->bufOffsetInFile = lseek(lf->fd, offset, whence)) == -1)
 void lineFileRewind(struct lineFile *lf)
 /* Return lineFile to start. */
 {
-lineFileSeek(lf, 0, SEEK_SET);
+lineFileSeek(lf, lf->mapStart, SEEK_SET);
 lf->lineIx = 0;
 }
 
@@ -473,14 +670,16 @@ switch (lf->nlType)
     {
     case nlt_unix:
     case nlt_dos:
-        for (endIx = *pEndIx; endIx < bytesInBuf; ++endIx)
+        if (endIx < bytesInBuf)
             {
-            if (buf[endIx] == '\n')
+            char *nl = memchr(buf + endIx, '\n', bytesInBuf - endIx);
+            if (nl != NULL)
                 {
                 gotLf = TRUE;
-                endIx += 1;
-                break;
+                endIx = nl - buf + 1;
                 }
+            else
+                endIx = bytesInBuf;
             }
         break;
     case nlt_mac:
@@ -520,6 +719,46 @@ switch (lf->nlType)
 return gotLf;
 }
 
+static boolean mapNext(struct lineFile *lf, char **retStart, int *retSize)
+/* Fetch next line from a memory mapped file.  The line is left where it is in
+ * the mapping, and lf->buf is pointed at it. */
+{
+off_t sizeLeft = lf->mapEnd - lf->mapPos;
+if (sizeLeft <= 0)
+    return FALSE;
+char *line = lf->mapBase + lf->mapPos;
+int bytesLeft = (sizeLeft > INT_MAX ? INT_MAX : sizeLeft);
+int endIx = 0;
+determineNlType(lf, line, bytesLeft);
+if (findNextNewline(lf, line, bytesLeft, &endIx))
+    {
+    if (lf->zTerm)
+	{
+	line[endIx-1] = 0;
+	if (lf->nlType == nlt_dos && endIx >= 2 && line[endIx-2] == '\r')
+	    line[endIx-2] = 0;
+	}
+    }
+else if (sizeLeft > bytesLeft)
+    errAbort("Line %d of %s is too long", lf->lineIx+1, lf->fileName);
+/* Otherwise this is a last line without a newline, and lineFileMmap made sure
+ * there is a zero after it. */
+lf->buf = line;
+lf->bufSize = lf->bytesInBuf = lf->lineEnd = endIx;
+lf->lineStart = 0;
+lf->bufOffsetInFile = lf->mapPos;
+lf->mapPos += endIx;
+if (lf->zTerm && lf->mapPos > lf->mapZeroed)
+    lf->mapZeroed = lf->mapPos;
+++lf->lineIx;
+if (retSize != NULL)
+    *retSize = endIx;
+*retStart = line;
+if (lf->metaOutput && line[0] == '#')
+    metaDataAdd(lf, line);
+return TRUE;
+}
+
 boolean lineFileNext(struct lineFile *lf, char **retStart, int *retSize)
 /* Fetch next line from file. */
 {
@@ -539,6 +778,9 @@ if (lf->reuse)
 if (lf->nextCallBack)
     return lf->nextCallBack(lf, retStart, retSize);
 
+if (lf->mapBase != NULL)
+    return mapNext(lf, retStart, retSize);
+
 if (lf->udcFile)
     {
     lf->bufOffsetInFile = udcTell(lf->udcFile);
@@ -603,6 +845,8 @@ while (!gotLf)
     lf->bufOffsetInFile += oldEnd;
     if (lf->fd >= 0)
 	readSize = lineFileLongNetRead(lf->fd, buf+sizeLeft, readSize);
+    else if (lf->bgzf != NULL)
+	readSize = bgzfReaderRead(lf->bgzf, buf+sizeLeft, readSize);
     else if (lf->tabix != NULL && readSize > 0)
 	{
         errAbort("bgzf read not supported with htslib (yet)");
@@ -710,6 +954,19 @@ if ((lf = *pLf) != NULL)
         {
         pipelineClose(&lf->pl);
         }
+    else if (lf->bgzf != NULL)
+        {
+	bgzfReaderClose(&lf->bgzf);
+	freeMem(lf->buf);
+	}
+    else if (lf->mapBase != NULL)
+        {
+	if (lf->mapAlloc > 0)
+	    {
+	    munmap(lf->mapBase, lf->mapAlloc);
+	    close(lf->fd);
+	    }
+	}
     else if (lf->fd > 0 && lf->fd != fileno(stdin))
 	{
 	close(lf->fd);
@@ -0,0 +1,329 @@
+/* openHash - a string keyed hash table that keeps its elements in one array rather
+ * than in chained buckets.  See openHash.h for how to use it.
+ *
+ * The table is always a power of two in size, and an element's home slot is the
+ * low bits of the hash of its name.  The distance of an element from its home is
+ * (slot - hashVal) & mask, so it doesn't need to be stored.  When adding, an element
+ * that has come further from home than the one in a slot takes that slot, and the
+ * displaced element carries on looking.  A lookup can stop as soon as it reaches
+ * an element closer to home than it is, since the name would have taken that slot
+ * if it were in the table. */
+/* This file is copyright 2026 UCSC Genome Browser Authors, but license is hereby
+ * granted for all use - public, private or commercial. */
+
+#include "common.h"
+#include "localmem.h"
+#include "obscure.h"
+#include "openHash.h"
+
+#define defaultPowerOfTwoSize 12
+#define maxPowerOfTwoSize 31
+
+bits64 openHashString(char *string, int size)
+/* Return 64 bit hash of the first size bytes of string.  This is MurmurHash64A
+ * by Austin Appleby, which is in the public domain.  It mixes eight bytes at a
+ * time and gives very few collisions on names that differ only slightly. */
+{
+const bits64 m = 0xc6a4a7935bd1e995ULL;
+const int r = 47;
+bits64 h = 0x9747b28cULL ^ (size * m);
+unsigned char *s = (unsigned char *)string;
+unsigned char *end = s + (size & ~7);
+for (; s < end; s += 8)
+    {
+    bits64 k;
+    memcpy(&k, s, sizeof(k));
+    k *= m;
+    k ^= k >> r;
+    k *= m;
+    h ^= k;
+    h *= m;
+    }
+int tail = size & 7;
+if (tail > 0)
+    {
+    int i;
+    for (i=tail-1; i>=0; --i)
+        h ^= (bits64)s[i] << (8*i);
+    h *= m;
+    }
+h ^= h >> r;
+h *= m;
+h ^= h >> r;
+return h;
+}
+
+static bits32 hashName(char *name)
+/* Return the part of the hash of name that is kept in elements. */
+{
+return openHashString(name, strlen(name));
+}
+
+static void allocSlots(struct openHash *hash, int powerOfTwoSize)
+/* Allocate empty slots array for hash. */
+{
+if (powerOfTwoSize > maxPowerOfTwoSize)
+    errAbort("openHash can't grow past 2^%d elements", maxPowerOfTwoSize);
+bits32 size = (1U << powerOfTwoSize);
+hash->slots = needHugeZeroedMem(size * sizeof(hash->slots[0]));
+hash->mask = size - 1;
+hash->powerOfTwoSize = powerOfTwoSize;
+}
+
+struct openHash *openHashNew(int powerOfTwoSize)
+/* Return a new, empty hash with room for about 2^powerOfTwoSize elements before
+ * it has to grow.  Pass 0 for a default size. */
+{
+struct openHash *hash;
+if (powerOfTwoSize == 0)
+    powerOfTwoSize = defaultPowerOfTwoSize;
+if (powerOfTwoSize < 1 || powerOfTwoSize > maxPowerOfTwoSize)
+    errAbort("openHashNew: powerOfTwoSize %d out of range 1 to %d", powerOfTwoSize,
+    	maxPowerOfTwoSize);
+AllocVar(hash);
+/* Leave room to add 2^powerOfTwoSize elements without growing. */
+allocSlots(hash, min(powerOfTwoSize+1, maxPowerOfTwoSize));
+hash->lm = lmInit(0);
+return hash;
+}
+
+void openHashFree(struct openHash **pHash)
+/* Free up hash and names, but not values. */
+{
+struct openHash *hash = *pHash;
+if (hash != NULL)
+    {
+    freeMem(hash->slots);
+    lmCleanup(&hash->lm);
+    freez(pHash);
+    }
+}
+
+void openHashFreeWithVals(struct openHash **pHash, void (freeFunc)())
+/* Free up hash, calling freeFunc on the address of each value first. */
+{
+struct openHash *hash = *pHash;
+if (hash != NULL)
+    {
+    struct openHashCookie cookie = openHashFirst(hash);
+    struct openHashEl *hel;
+    while ((hel = openHashNext(&cookie)) != NULL)
+        freeFunc(&hel->val);
+    openHashFree(pHash);
+    }
+}
+
+static struct openHashEl *findEl(struct openHash *hash, char *name, bits32 hashVal,
+	bits32 *retIx, bits32 *retDist)
+/* Return element with name and hashVal, or NULL if not found.  If not found and
+ * retIx is non-NULL, return the slot where the name would go and how far that is
+ * from its home, so that insertEl can carry on from there. */
+{
+struct openHashEl *slots = hash->slots;
+bits32 mask = hash->mask, ix = hashVal & mask, dist = 0;
+for (;;)
+    {
+    struct openHashEl *el = &slots[ix];
+    if (el->name == NULL || ((ix - el->hashVal) & mask) < dist)
+        break;
+    if (el->hashVal == hashVal && sameString(el->name, name))
+        return el;
+    ix = (ix + 1) & mask;
+    ++dist;
+    }
+if (retIx != NULL)
+    {
+    *retIx = ix;
+    *retDist = dist;
+    }
+return NULL;
+}
+
+static struct openHashEl *insertEl(struct openHash *hash, char *name, void *val, bits32 hashVal,
+	bits32 ix, bits32 dist)
+/* Put a name that isn't in hash yet into it starting at slot ix, which is dist from
+ * the name's home, and return where it ends up.  The hash must have at least one
+ * empty slot. */
+{
+struct openHashEl *slots = hash->slots, *placed = NULL;
+struct openHashEl el;
+bits32 mask = hash->mask;
+el.name = name;
+el.val = val;
+el.hashVal = hashVal;
+for (;;)
+    {
+    struct openHashEl *slot = &slots[ix];
+    if (slot->name == NULL)
+        {
+	*slot = el;
+	return (placed != NULL ? placed : slot);
+	}
+    bits32 slotDist = (ix - slot->hashVal) & mask;
+    if (slotDist < dist)
+        {
+	struct openHashEl displaced = *slot;
+	*slot = el;
+	el = displaced;
+	if (placed == NULL)
+	    placed = slot;
+	dist = slotDist;
+	}
+    ix = (ix + 1) & mask;
+    ++dist;
+    }
+}
+
+static void growHash(struct openHash *hash)
+/* Double the size of the slots array, and put elements back in. */
+{
+struct openHashEl *oldSlots = hash->slots;
+bits32 oldSize = hash->mask + 1, i;
+allocSlots(hash, hash->powerOfTwoSize + 1);
+for (i=0; i<oldSize; ++i)
+    {
+    struct openHashEl *el = &oldSlots[i];
+    if (el->name != NULL)
+        insertEl(hash, el->name, el->val, el->hashVal, el->hashVal & hash->mask, 0);
+    }
+freeMem(oldSlots);
+}
+
+static struct openHashEl *addNew(struct openHash *hash, char *name, void *val, bits32 hashVal,
+	bits32 ix, bits32 dist)
+/* Add a name that findEl didn't find at slot ix, dist from home, growing hash if
+ * it is getting full. */
+{
+/* Robin Hood probing keeps lookups short until the table is about 7/8 full. */
+if (((long long)hash->elCount + 1) * 8 > ((long long)hash->mask + 1) * 7)
+    {
+    growHash(hash);
+    ix = hashVal & hash->mask;
+    dist = 0;
+    }
+hash->elCount += 1;
+return insertEl(hash, lmCloneString(hash->lm, name), val, hashVal, ix, dist);
+}
+
+struct openHashEl *openHashLookup(struct openHash *hash, char *name)
+/* Return element with name, or NULL if it isn't in hash. */
+{
+return findEl(hash, name, hashName(name), NULL, NULL);
+}
+
+void *openHashFindVal(struct openHash *hash, char *name)
+/* Return value associated with name, or NULL if it isn't in hash. */
+{
+struct openHashEl *el = findEl(hash, name, hashName(name), NULL, NULL);
+return (el == NULL ? NULL : el->val);
+}
+
+void *openHashMustFindVal(struct openHash *hash, char *name)
+/* Return value associated with name, aborting if it isn't in hash. */
+{
+struct openHashEl *el = findEl(hash, name, hashName(name), NULL, NULL);
+if (el == NULL)
+    errAbort("openHashMustFindVal: '%s' not found", name);
+return el->val;
+}
+
+struct openHashEl *openHashAdd(struct openHash *hash, char *name, void *val)
+/* Add name and value to hash, replacing the value if name is already there.
+ * Returns element, which is only good until the next add or remove. */
+{
+bits32 hashVal = hashName(name);
+bits32 ix, dist;
+struct openHashEl *el = findEl(hash, name, hashVal, &ix, &dist);
+if (el != NULL)
+    {
+    el->val = val;
+    return el;
+    }
+return addNew(hash, name, val, hashVal, ix, dist);
+}
+
+struct openHashEl *openHashAddUnique(struct openHash *hash, char *name, void *val)
+/* Add name and value to hash, aborting if name is already there. */
+{
+bits32 hashVal = hashName(name);
+bits32 ix, dist;
+if (findEl(hash, name, hashVal, &ix, &dist) != NULL)
+    errAbort("%s duplicated, aborting", name);
+return addNew(hash, name, val, hashVal, ix, dist);
+}
+
+char *openHashStoreName(struct openHash *hash, char *name)
+/* Add name to hash if it isn't there already, and return the copy of name that
+ * the hash keeps.  This is handy for keeping a single copy of strings. */
+{
+bits32 hashVal = hashName(name);
+bits32 ix, dist;
+struct openHashEl *el = findEl(hash, name, hashVal, &ix, &dist);
+if (el == NULL)
+    el = addNew(hash, name, NULL, hashVal, ix, dist);
+return el->name;
+}
+
+int openHashIncInt(struct openHash *hash, char *name)
+/* Increment integer value associated with name, adding it with a value of one
+ * if it isn't there, and return new value. */
+{
+bits32 hashVal = hashName(name);
+bits32 ix, dist;
+struct openHashEl *el = findEl(hash, name, hashVal, &ix, &dist);
+if (el == NULL)
+    el = addNew(hash, name, NULL, hashVal, ix, dist);
+int count = ptToInt(el->val) + 1;
+el->val = intToPt(count);
+return count;
+}
+
+void *openHashRemove(struct openHash *hash, char *name)
+/* Remove name from hash and return its value, or NULL if it wasn't there.  The
+ * memory for the name is not reclaimed until the hash is freed. */
+{
+struct openHashEl *el = findEl(hash, name, hashName(name), NULL, NULL);
+if (el == NULL)
+    return NULL;
+void *val = el->val;
+struct openHashEl *slots = hash->slots;
+bits32 mask = hash->mask, ix = el - slots;
+/* Shift following elements that aren't in their home slot back by one. */
+for (;;)
+    {
+    bits32 nextIx = (ix + 1) & mask;
+    struct openHashEl *next = &slots[nextIx];
+    if (next->name == NULL || ((nextIx - next->hashVal) & mask) == 0)
+        break;
+    slots[ix] = *next;
+    ix = nextIx;
+    }
+slots[ix].name = NULL;
+slots[ix].val = NULL;
+hash->elCount -= 1;
+return val;
+}
+
+struct openHashCookie openHashFirst(struct openHash *hash)
+/* Return an object to use with openHashNext to go through all elements. */
+{
+struct openHashCookie cookie;
+cookie.hash = hash;
+cookie.ix = 0;
+return cookie;
+}
+
+struct openHashEl *openHashNext(struct openHashCookie *cookie)
+/* Return next element in hash, or NULL when there are no more.  The hash
+ * must not be added to or removed from during the traversal. */
+{
+struct openHash *hash = cookie->hash;
+bits32 size = hash->mask + 1;
+while (cookie->ix < size)
+    {
+    struct openHashEl *el = &hash->slots[cookie->ix++];
+    if (el->name != NULL)
+        return el;
+    }
+return NULL;
+}
@@ -5,8 +5,10 @@
 
 
 #include "png.h"   // MUST come before common.h, due to setjmp checking  in pngconf.h 
+#include <zlib.h>
 #include "common.h"
 #include "memgfx.h"
+#include "pthreadDoList.h"
 
 
 static void pngAbort(png_structp png, png_const_charp errorMessage)
@@ -21,11 +23,150 @@ static void pngWarn(png_structp png, png_const_charp warningMessage)
 warn("%s", (char *)warningMessage);
 }
 
+static int pngEncodeThreads = 1;	/* Number of strips compressed at once. */
+
+#define pngCompressLevel 6	/* Levels below 4 skip lazy matching and lose badly on track images. */
+#define pngMinStripRows 64	/* Don't cut the image into strips shorter than this. */
+
+void mgSetPngEncodeThreads(int threadCount)
+/* Set the number of threads mgSaveToPng uses to compress horizontal strips
+ * of large images.  The default is 1. */
+{
+pngEncodeThreads = max(threadCount, 1);
+}
+
+static int mgFindPalette(struct memGfx *mg, Color palette[256], UBYTE *indexes)
+/* Try to map each pixel of mg onto a palette of at most 256 colors.  If they fit,
+ * fill in palette, write one palette index per pixel into indexes, and return the
+ * number of colors.  Otherwise return 0. */
+{
+#define slotCount 1024	/* Power of two, well over twice the 256 colors we'll hold. */
+Color slotColor[slotCount];
+int slotIndex[slotCount];
+int colorCount = 0;
+memset(slotIndex, -1, sizeof(slotIndex));
+Color *pt = mg->pixels;
+long pixelCount = (long)mg->width * mg->height, i;
+Color lastColor = 0;
+int lastIndex = -1;
+for (i = 0; i < pixelCount; ++i)
+    {
+    Color c = pt[i];
+    if (c != lastColor || lastIndex < 0)
+        {
+        /* Fibonacci hash down to 10 bits, then probe linearly. */
+        bits32 slot = ((bits32)c * 2654435761U) >> 22;
+        while (slotIndex[slot] >= 0 && slotColor[slot] != c)
+            slot = (slot + 1) & (slotCount - 1);
+        if (slotIndex[slot] < 0)
+            {
+            if (colorCount >= 256)
+                return 0;
+            slotColor[slot] = c;
+            slotIndex[slot] = colorCount;
+            palette[colorCount++] = c;
+            }
+        lastColor = c;
+        lastIndex = slotIndex[slot];
+        }
+    indexes[i] = lastIndex;
+    }
+return colorCount;
+#undef slotCount
+}
+
+struct pngStrip
+/* A horizontal band of the image, compressed on its own so bands can be done in parallel.
+ * Each band ends in a zlib sync flush, so the bands just concatenate into one stream. */
+    {
+    struct pngStrip *next;
+    UBYTE *pixels;	/* First pixel byte of first row. */
+    int rowCount;	/* Number of rows. */
+    boolean isFirst, isLast;	/* First and last strips carry the zlib header and trailer. */
+    UBYTE *out;		/* Compressed output, including header/trailer if any. */
+    size_t outSize;	/* Bytes used in out. */
+    bits32 adler;	/* Adler32 checksum of the filtered rows in this strip. */
+    size_t rawSize;	/* Size of filtered rows in this strip. */
+    };
+
+struct pngStripContext
+/* What is the same for all strips. */
+    {
+    int rowBytes;	/* Bytes of pixels in a row, not counting filter byte. */
+    int pixelBytes;	/* 1 for indexed, 4 for RGBA. */
+    };
+
+static void pngCompressStrip(void *item, void *context)
+/* Filter and deflate one strip.  Indexed rows are left unfiltered.  RGBA rows use
+ * the Up filter: at four bytes a pixel a wide row is past the reach of zlib's 32k
+ * window, and track images repeat a lot from one row to the next. */
+{
+struct pngStrip *strip = item;
+struct pngStripContext *sc = context;
+int rowBytes = sc->rowBytes, bpp = sc->pixelBytes;
+size_t lineSize = rowBytes + 1;
+strip->rawSize = lineSize * strip->rowCount;
+UBYTE *raw = needHugeMem(strip->rawSize);
+int row;
+for (row = 0; row < strip->rowCount; ++row)
+    {
+    UBYTE *in = strip->pixels + (size_t)row * rowBytes;
+    UBYTE *line = raw + row * lineSize;
+    if (bpp == 1)
+        {
+        line[0] = PNG_FILTER_VALUE_NONE;
+        memcpy(line+1, in, rowBytes);
+        }
+    else
+        {
+        line[0] = PNG_FILTER_VALUE_UP;
+        UBYTE *filtered = line+1;
+        int i;
+        if (row == 0 && strip->isFirst)
+            memcpy(filtered, in, rowBytes);
+        else
+            {
+            UBYTE *above = in - rowBytes;
+            for (i = 0; i < rowBytes; ++i)
+                filtered[i] = in[i] - above[i];
+            }
+        }
+    }
+strip->adler = adler32(adler32(0L, Z_NULL, 0), raw, strip->rawSize);
+
+z_stream z;
+ZeroVar(&z);
+if (deflateInit2(&z, pngCompressLevel, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    errAbort("pngCompressStrip: deflateInit2 failed");
+/* Room for the deflate output plus the 2 byte zlib header, 4 byte adler32 and sync flush. */
+size_t outAlloc = deflateBound(&z, strip->rawSize) + 16;
+strip->out = needHugeMem(outAlloc);
+int headSize = (strip->isFirst ? 2 : 0);
+if (strip->isFirst)
+    {
+    strip->out[0] = 0x78;	/* Deflate, 32k window. */
+    strip->out[1] = 0x01;	/* No dictionary, header check bits. */
+    }
+z.next_in = raw;
+z.avail_in = strip->rawSize;
+z.next_out = strip->out + headSize;
+z.avail_out = outAlloc - headSize - 4;
+int err = deflate(&z, strip->isLast ? Z_FINISH : Z_SYNC_FLUSH);
+if (err != (strip->isLast ? Z_STREAM_END : Z_OK) || z.avail_in != 0)
+    errAbort("pngCompressStrip: deflate failed (%d)", err);
+strip->outSize = headSize + z.total_out;
+deflateEnd(&z);
+freeMem(raw);
+}
+
 boolean mgSaveToPng(FILE *png_file, struct memGfx *mg, boolean useTransparency)
 /* Save PNG to an already open file.
  * If useTransparency, then the first color in memgfx's colormap/palette is
  * assumed to be the image background color, and pixels of that color
- * are made transparent. */
+ * are made transparent.
+ * Images with no more than 256 distinct colors are written as indexed PNGs.
+ * The pixel data is compressed here rather than by libpng so that horizontal
+ * strips can be compressed in parallel, see mgSetPngEncodeThreads. */
 /* Reference: http://libpng.org/pub/png/libpng-1.2.5-manual.html */
 {
 if (!png_file || !mg)
@@ -57,24 +198,98 @@ if (setjmp(png_jmpbuf(png)))
     return FALSE;
     }
 
+// Browser images rarely have more than a handful of colors; if they fit in a
+// palette, write one byte per pixel instead of four.
+long pixelCount = (long)mg->width * mg->height;
+Color palette[256];
+UBYTE *indexes = needHugeMem(pixelCount > 0 ? pixelCount : 1);
+int colorCount = mgFindPalette(mg, palette, indexes);
+
 // Configure PNG output params:
 png_init_io(png, png_file);
-png_set_IHDR(png, info, mg->width, mg->height, 8, // 8=bit_depth
-             PNG_COLOR_TYPE_RGBA, PNG_INTERLACE_NONE,
-             PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
-
-// Write header/params, write pixels, close and clean up.
-// PNG wants a 2D array of pointers to byte offsets into palette/colorMap.
-// mg has a 1D array of byte offsets.  Make row pointers for PNG:
-
-png_byte **row_pointers = needMem(mg->height * sizeof(png_byte *));
-int i;
-for (i = 0;  i < mg->height;  i++)
-    row_pointers[i] = (unsigned char *)&(mg->pixels[i*mg->width]);
-png_set_rows(png, info, row_pointers);
-png_write_png(png, info, PNG_TRANSFORM_IDENTITY, // no transform
-	      NULL); // unused as of PNG 1.2
+struct pngStripContext sc;
+UBYTE *pixels;
+if (colorCount > 0)
+    {
+    png_color plte[256];
+    png_byte trans[256];
+    int i, transCount = 0;
+    for (i = 0; i < colorCount; ++i)
+        {
+        plte[i].red = COLOR_32_RED(palette[i]);
+        plte[i].green = COLOR_32_GREEN(palette[i]);
+        plte[i].blue = COLOR_32_BLUE(palette[i]);
+        trans[i] = COLOR_32_ALPHA(palette[i]);
+        if (trans[i] != 0xff)
+            transCount = i+1;
+        }
+    png_set_IHDR(png, info, mg->width, mg->height, 8, // 8=bit_depth
+		 PNG_COLOR_TYPE_PALETTE, PNG_INTERLACE_NONE,
+		 PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    png_set_PLTE(png, info, plte, colorCount);
+    if (transCount > 0)
+        png_set_tRNS(png, info, trans, transCount, NULL);
+    sc.pixelBytes = 1;
+    pixels = indexes;
+    }
+else
+    {
+    png_set_IHDR(png, info, mg->width, mg->height, 8, // 8=bit_depth
+		 PNG_COLOR_TYPE_RGBA, PNG_INTERLACE_NONE,
+		 PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    sc.pixelBytes = 4;
+    pixels = (UBYTE *)mg->pixels;
+    }
+sc.rowBytes = mg->width * sc.pixelBytes;
+
+// Cut the image into one strip per thread, unless that makes strips too thin.
+int stripCount = min(pngEncodeThreads, mg->height / pngMinStripRows);
+if (stripCount < 1)
+    stripCount = 1;
+struct pngStrip *strips, *strip;
+AllocArray(strips, stripCount);
+int i, startRow = 0;
+for (i = 0; i < stripCount; ++i)
+    {
+    int endRow = (long)mg->height * (i+1) / stripCount;
+    strip = &strips[i];
+    strip->next = (i+1 < stripCount ? &strips[i+1] : NULL);
+    strip->pixels = pixels + (size_t)startRow * sc.rowBytes;
+    strip->rowCount = endRow - startRow;
+    strip->isFirst = (i == 0);
+    strip->isLast = (i == stripCount-1);
+    startRow = endRow;
+    }
+if (stripCount > 1)
+    pthreadDoList(stripCount, strips, pngCompressStrip, &sc);
+else
+    pngCompressStrip(strips, &sc);
+
+// The zlib stream ends with the adler32 of all the filtered rows.
+bits32 adler = strips[0].adler;
+for (i = 1; i < stripCount; ++i)
+    adler = adler32_combine(adler, strips[i].adler, strips[i].rawSize);
+strip = &strips[stripCount-1];
+UBYTE *tail = strip->out + strip->outSize;
+tail[0] = adler >> 24;
+tail[1] = adler >> 16;
+tail[2] = adler >> 8;
+tail[3] = adler;
+strip->outSize += 4;
+
+// Write header/params, one IDAT chunk per strip, and the end chunk, then clean up.
+png_write_info(png, info);
+for (i = 0; i < stripCount; ++i)
+    {
+    strip = &strips[i];
+    png_write_chunk(png, (png_const_bytep)"IDAT", strip->out, strip->outSize);
+    freeMem(strip->out);
+    }
+png_write_chunk(png, (png_const_bytep)"IEND", NULL, 0);
+png_write_flush(png);
 png_destroy_write_struct(&png, &info);
+freeMem(strips);
+freeMem(indexes);
 return TRUE;
 }
 
@@ -103,6 +103,13 @@ int err = pthread_cond_signal(cond);
 perr("pthread_cond_signal", err);
 }
 
+void pthreadCondBroadcast(pthread_cond_t *cond)
+/* Wake up all threads waiting on conditional, or die trying. */
+{
+int err = pthread_cond_broadcast(cond);
+perr("pthread_cond_broadcast", err);
+}
+
 void pthreadCondWait(pthread_cond_t *cond, pthread_mutex_t *mutex)
 /* Wait for conditional signal. */
 {
@@ -0,0 +1,324 @@
+/* rangeIndex - a build once, query many index of ranges (half-open intervals)
+ * that may overlap each other.  Ranges are sorted by start into an array, and an
+ * implicit binary tree is laid over the array: leaves are at even indexes, and a
+ * node at level k has index with its low k bits set and bit k clear, with children
+ * 2^(k-1) to either side.  Each node keeps the largest end in its subtree, which
+ * lets a query skip subtrees that end before it starts.  Small subtrees near the
+ * bottom are just scanned, which is faster than walking them. */
+/* This file is copyright 2026 UCSC Genome Browser Authors, but license is hereby
+ * granted for all use - public, private or commercial. */
+
+#include "common.h"
+#include "rangeTree.h"
+#include "rangeIndex.h"
+
+struct rangeIndex *rangeIndexNew()
+/* Return a new, empty range index. */
+{
+struct rangeIndex *ri;
+AllocVar(ri);
+return ri;
+}
+
+void rangeIndexFree(struct rangeIndex **pRi)
+/* Free up range index. */
+{
+struct rangeIndex *ri = *pRi;
+if (ri != NULL)
+    {
+    freeMem(ri->nodes);
+    freeMem(ri->ranges);
+    freeMem(ri->hits);
+    freez(pRi);
+    }
+}
+
+void rangeIndexAdd(struct rangeIndex *ri, int start, int end, void *val)
+/* Add range with associated val to index.  Unlike rangeTreeAdd, ranges are not
+ * merged, each one added is kept. */
+{
+if (ri->isBuilt)
+    errAbort("can't add to a rangeIndex after it is built");
+if (ri->count >= ri->alloc)
+    {
+    int newAlloc = (ri->alloc == 0 ? 64 : ri->alloc * 2);
+    ri->nodes = needLargeMemResize(ri->nodes, newAlloc * sizeof(ri->nodes[0]));
+    ri->ranges = needLargeMemResize(ri->ranges, newAlloc * sizeof(ri->ranges[0]));
+    ri->alloc = newAlloc;
+    }
+struct rangeIndexNode *node = &ri->nodes[ri->count];
+node->start = node->end = node->maxEnd = 0;
+struct range *range = &ri->ranges[ri->count];
+range->next = NULL;
+range->start = start;
+range->end = end;
+range->val = val;
+ri->count += 1;
+}
+
+void rangeIndexAddTree(struct rangeIndex *ri, struct rbTree *tree)
+/* Add all ranges in a rangeTree, with their vals, to index. */
+{
+struct range *range;
+for (range = rangeTreeList(tree); range != NULL; range = range->next)
+    rangeIndexAdd(ri, range->start, range->end, range->val);
+}
+
+struct sortRange
+/* A range and the order it was added, used to sort stably. */
+    {
+    int start, end;
+    int ix;
+    };
+
+static int sortRangeCmp(const void *va, const void *vb)
+/* Compare by start, end, then order added. */
+{
+const struct sortRange *a = va, *b = vb;
+if (a->start != b->start)
+    return (a->start < b->start ? -1 : 1);
+if (a->end != b->end)
+    return (a->end < b->end ? -1 : 1);
+return a->ix - b->ix;
+}
+
+static void sortRanges(struct rangeIndex *ri)
+/* Sort ranges by start, keeping ranges that are the same in the order added,
+ * and fill in nodes to match. */
+{
+struct sortRange *order = needLargeMem(ri->count * sizeof(order[0]));
+int i;
+for (i=0; i<ri->count; ++i)
+    {
+    order[i].start = ri->ranges[i].start;
+    order[i].end = ri->ranges[i].end;
+    order[i].ix = i;
+    }
+qsort(order, ri->count, sizeof(order[0]), sortRangeCmp);
+struct range *ranges = needLargeMem(ri->count * sizeof(ranges[0]));
+for (i=0; i<ri->count; ++i)
+    {
+    ranges[i] = ri->ranges[order[i].ix];
+    ri->nodes[i].start = ranges[i].start;
+    ri->nodes[i].end = ri->nodes[i].maxEnd = ranges[i].end;
+    }
+freeMem(ri->ranges);
+ri->ranges = ranges;
+freeMem(order);
+}
+
+static int buildTree(struct rangeIndexNode *nodes, int n)
+/* Fill in maxEnd for all nodes that aren't leaves and return the level of
+ * the root.  A node near the end of the array may have a right subtree whose root
+ * is past the end, in which case the largest end of the part of that subtree
+ * that is in the array, tracked in lastMax, is used instead. */
+{
+if (n == 0)
+    return -1;
+int lastIx = (n-1) & ~1;	/* Root of rightmost subtree at current level. */
+int lastMax = nodes[lastIx].maxEnd;
+int level;
+for (level = 1; (1LL << level) <= n; ++level)
+    {
+    long long half = 1LL << (level-1), step = half << 2;
+    long long i;
+    for (i = (half << 1) - 1; i < n; i += step)
+        {
+	int maxEnd = nodes[i].end;
+	int leftMax = nodes[i - half].maxEnd;
+	int rightMax = (i + half < n ? nodes[i + half].maxEnd : lastMax);
+	if (leftMax > maxEnd)
+	    maxEnd = leftMax;
+	if (rightMax > maxEnd)
+	    maxEnd = rightMax;
+	nodes[i].maxEnd = maxEnd;
+	}
+    /* Move up to the parent of the rightmost subtree. */
+    if ((lastIx >> level) & 1)
+        lastIx -= half;
+    else
+        lastIx += half;
+    if (lastIx < n && nodes[lastIx].maxEnd > lastMax)
+        lastMax = nodes[lastIx].maxEnd;
+    }
+return level - 1;
+}
+
+void rangeIndexBuild(struct rangeIndex *ri)
+/* Sort ranges and build tree.  The query routines do this if need be, but
+ * call it before sharing an index between threads.  No ranges can be added after
+ * this. */
+{
+if (ri->isBuilt)
+    return;
+if (ri->count > 0)
+    sortRanges(ri);
+ri->maxLevel = buildTree(ri->nodes, ri->count);
+ri->isBuilt = TRUE;
+}
+
+struct searchFrame
+/* A node on the search stack. */
+    {
+    long long ix;	/* Index of node, may be past end of array. */
+    int level;		/* Level of node in tree. */
+    boolean leftDone;	/* TRUE if left subtree already searched. */
+    };
+
+static void addHit(int **pIxs, int *pAlloc, int hitCount, int ix)
+/* Put ix in hit array at position hitCount, making array bigger if need be. */
+{
+if (hitCount >= *pAlloc)
+    {
+    int newAlloc = (*pAlloc == 0 ? 64 : *pAlloc * 2);
+    *pIxs = needLargeMemResize(*pIxs, newAlloc * sizeof((*pIxs)[0]));
+    *pAlloc = newAlloc;
+    }
+(*pIxs)[hitCount] = ix;
+}
+
+static int search(struct rangeIndex *ri, int start, int end, int maxHits,
+	int **pIxs, int *pAlloc)
+/* Put indexes of up to maxHits ranges overlapping start-end in *pIxs, in
+ * order of start, and return number found.  If maxHits is zero, find all. */
+{
+rangeIndexBuild(ri);
+struct rangeIndexNode *nodes = ri->nodes;
+int n = ri->count, hitCount = 0;
+struct searchFrame stack[64];
+int depth = 0;
+if (n == 0)
+    return 0;
+stack[depth].ix = (1LL << ri->maxLevel) - 1;
+stack[depth].level = ri->maxLevel;
+stack[depth++].leftDone = FALSE;
+while (depth > 0)
+    {
+    struct searchFrame frame = stack[--depth];
+    long long hitIx = -1;
+    if (frame.level <= 3)
+        {
+	/* Scan whole small subtree in order. */
+	long long i = (frame.ix >> frame.level) << frame.level;
+	long long iEnd = i + (1LL << (frame.level+1)) - 1;
+	if (iEnd > n)
+	    iEnd = n;
+	for (; i < iEnd && nodes[i].start < end; ++i)
+	    {
+	    if (start < nodes[i].end)
+	        {
+		addHit(pIxs, pAlloc, hitCount++, i);
+		if (hitCount == maxHits)
+		    return hitCount;
+		}
+	    }
+	continue;
+	}
+    long long half = 1LL << (frame.level-1);
+    if (!frame.leftDone)
+        {
+	/* Come back to this node after its left subtree, which is only searched
+	 * if something in it may end after start. */
+	long long left = frame.ix - half;
+	stack[depth].ix = frame.ix;
+	stack[depth].level = frame.level;
+	stack[depth++].leftDone = TRUE;
+	if (left >= n || nodes[left].maxEnd > start)
+	    {
+	    stack[depth].ix = left;
+	    stack[depth].level = frame.level - 1;
+	    stack[depth++].leftDone = FALSE;
+	    }
+	}
+    else if (frame.ix < n && nodes[frame.ix].start < end)
+        {
+	/* Check node itself, then search right subtree. */
+	if (start < nodes[frame.ix].end)
+	    hitIx = frame.ix;
+	stack[depth].ix = frame.ix + half;
+	stack[depth].level = frame.level - 1;
+	stack[depth++].leftDone = FALSE;
+	}
+    if (hitIx >= 0)
+        {
+	addHit(pIxs, pAlloc, hitCount++, hitIx);
+	if (hitCount == maxHits)
+	    return hitCount;
+	}
+    }
+return hitCount;
+}
+
+int rangeIndexOverlapIxs(struct rangeIndex *ri, int start, int end, int **pIxs, int *pAlloc)
+/* Find ranges that overlap start-end.  Indexes into ri->ranges of the ranges found
+ * are put in *pIxs in order of range start, and the number found is returned.
+ * *pIxs is expanded as needed and *pAlloc is its size.  Start them out at NULL and
+ * 0, and freeMem *pIxs when done.  Thread safe once index is built. */
+{
+return search(ri, start, end, 0, pIxs, pAlloc);
+}
+
+boolean rangeIndexOverlaps(struct rangeIndex *ri, int start, int end)
+/* Return TRUE if start-end overlaps anything in index. */
+{
+int hit, *hits = &hit, hitAlloc = 1;
+return search(ri, start, end, 1, &hits, &hitAlloc) > 0;
+}
+
+int rangeIndexOverlapSize(struct rangeIndex *ri, int start, int end)
+/* Return number of bases between start and end covered by ranges in index.  Bases
+ * covered by more than one range are counted once, so this is the same as
+ * rangeTreeOverlapSize on a rangeTree with the same ranges added. */
+{
+int hitCount = search(ri, start, end, 0, &ri->hits, &ri->hitAlloc);
+int i, total = 0, coveredTo = start;
+for (i=0; i<hitCount; ++i)
+    {
+    struct rangeIndexNode *node = &ri->nodes[ri->hits[i]];
+    int s = max(node->start, coveredTo);
+    int e = min(node->end, end);
+    if (s < e)
+        {
+	total += e - s;
+	coveredTo = e;
+	}
+    }
+return total;
+}
+
+struct range *rangeIndexAllOverlapping(struct rangeIndex *ri, int start, int end)
+/* Return list of all ranges in index that overlap start-end, in order of start.
+ * Do not free this list, it is owned by index, and is only good until the next
+ * call.  Not thread safe, use rangeIndexOverlapIxs for that. */
+{
+int hitCount = search(ri, start, end, 0, &ri->hits, &ri->hitAlloc);
+struct range *list = NULL;
+int i;
+for (i=hitCount-1; i>=0; --i)
+    {
+    struct range *range = &ri->ranges[ri->hits[i]];
+    range->next = list;
+    list = range;
+    }
+return list;
+}
+
+struct range *rangeIndexMaxOverlapping(struct rangeIndex *ri, int start, int end)
+/* Return range that overlaps most with start-end, or NULL if none do.  Not thread
+ * safe.  Trashes list used by rangeIndexAllOverlapping. */
+{
+struct range *range, *best = NULL;
+int bestOverlap = 0;
+for (range = rangeIndexAllOverlapping(ri, start, end); range != NULL; range = range->next)
+    {
+    int overlap = rangeIntersection(range->start, range->end, start, end);
+    if (overlap > bestOverlap)
+        {
+	bestOverlap = overlap;
+	best = range;
+	}
+    }
+if (best)
+    best->next = NULL;
+return best;
+}
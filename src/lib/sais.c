@@ -0,0 +1,254 @@
+/* sais - build suffix arrays in linear time with the SA-IS induced sorting algorithm
+ * of Nong, Zhang and Chan (Two Efficient Algorithms for Linear Time Suffix Array
+ * Construction, IEEE Transactions on Computers 60:1471, 2011).
+ *
+ * The idea is to classify each suffix as S (smaller than the suffix after it) or
+ * L (larger).  Suffixes that are S but follow an L are "left-most S" or LMS.  Once
+ * the LMS suffixes are in order, a left to right pass puts the L suffixes in place,
+ * and a right to left pass the S suffixes.  The LMS suffixes themselves are put in
+ * order by giving each substring between neighboring LMS positions a name, and
+ * recursively sorting the string of names, which is at most half as long.  Unlike
+ * bucketing by a prefix and comparing strings, the time taken doesn't depend on how
+ * repetitive the text is. */
+/* This file is copyright 2026 UCSC Genome Browser Authors, but license is hereby
+ * granted for all use - public, private or commercial. */
+
+#include "common.h"
+#include "bits.h"
+#include "sais.h"
+
+#define saisEmpty 0xFFFFFFFF	/* Marks unused slot in suffix array. */
+
+struct saisText
+/* The text being sorted at one level of recursion.  The top level is bytes, with one
+ * added to each so that a zero can serve as a virtual sentinel past the end.  Lower
+ * levels are arrays of names where the last name is already a zero sentinel. */
+    {
+    UBYTE *bytes;	/* Top level text, or NULL. */
+    bits32 *names;	/* Text at lower levels, or NULL. */
+    bits64 size;	/* Size including sentinel. */
+    };
+
+#define saisChar(t, i) ((t)->names != NULL ? (t)->names[i] : \
+	((i) == (t)->size - 1 ? 0 : (t)->bytes[i] + 1))
+/* Return character at position i in text. */
+
+#define typeIsS(types, i) (((types)[(i)>>3] >> ((i)&7)) & 1)
+/* Return TRUE if suffix i is S type. */
+
+#define isLms(types, i) ((i) > 0 && typeIsS(types, i) && !typeIsS(types, (i)-1))
+/* Return TRUE if suffix i is left-most S type. */
+
+static void getBuckets(struct saisText *text, bits32 *bkt, bits64 alphaSize, boolean atEnd)
+/* Fill in bkt with the start, or if atEnd the end, of each character's bucket in
+ * the suffix array. */
+{
+bits64 i, sum = 0;
+memset(bkt, 0, alphaSize * sizeof(bkt[0]));
+for (i=0; i<text->size; ++i)
+    bkt[saisChar(text, i)] += 1;
+for (i=0; i<alphaSize; ++i)
+    {
+    sum += bkt[i];
+    bkt[i] = (atEnd ? sum : sum - bkt[i]);
+    }
+}
+
+static void induceL(struct saisText *text, UBYTE *types, bits32 *sa,
+	bits32 *bkt, bits64 alphaSize)
+/* Scan left to right putting L suffixes at the start of their buckets. */
+{
+bits64 i, n = text->size;
+getBuckets(text, bkt, alphaSize, FALSE);
+for (i=0; i<n; ++i)
+    {
+    bits32 pos = sa[i];
+    if (pos != saisEmpty && pos > 0 && !typeIsS(types, pos-1))
+	sa[bkt[saisChar(text, pos-1)]++] = pos-1;
+    }
+}
+
+static void induceS(struct saisText *text, UBYTE *types, bits32 *sa,
+	bits32 *bkt, bits64 alphaSize)
+/* Scan right to left putting S suffixes at the end of their buckets. */
+{
+bits64 i, n = text->size;
+getBuckets(text, bkt, alphaSize, TRUE);
+for (i=n; i>0; )
+    {
+    --i;
+    bits32 pos = sa[i];
+    if (pos != saisEmpty && pos > 0 && typeIsS(types, pos-1))
+	sa[--bkt[saisChar(text, pos-1)]] = pos-1;
+    }
+}
+
+static boolean lmsSubstringsDiffer(struct saisText *text, UBYTE *types, bits64 a, bits64 b)
+/* Return TRUE if the LMS substrings starting at a and b differ. */
+{
+bits64 d;
+for (d=0; ; ++d)
+    {
+    if (saisChar(text, a+d) != saisChar(text, b+d)
+        || typeIsS(types, a+d) != typeIsS(types, b+d))
+	return TRUE;
+    if (d > 0 && (isLms(types, a+d) || isLms(types, b+d)))
+	return FALSE;
+    }
+}
+
+static void saisRecurse(struct saisText *text, bits32 *sa, bits64 alphaSize)
+/* Fill in sa with suffix array of text, whose characters are all less than alphaSize,
+ * and whose last character is a unique zero. */
+{
+bits64 n = text->size;
+bits64 i, j;
+if (n == 1)
+    {
+    sa[0] = 0;
+    return;
+    }
+
+/* Classify suffixes as S or L.  The sentinel is S, and the one before it L. */
+UBYTE *types = needHugeZeroedMem(n/8 + 1);
+types[(n-1)>>3] |= 1 << ((n-1)&7);
+for (i=n-1; i>0; )
+    {
+    --i;
+    bits32 c = saisChar(text, i), nextC = saisChar(text, i+1);
+    if (c < nextC || (c == nextC && typeIsS(types, i+1)))
+	types[i>>3] |= 1 << (i&7);
+    }
+
+/* Put LMS substrings in order by inducing from LMS positions in arbitrary order. */
+bits32 *bkt = needHugeMem(alphaSize * sizeof(bkt[0]));
+getBuckets(text, bkt, alphaSize, TRUE);
+for (i=0; i<n; ++i)
+    sa[i] = saisEmpty;
+for (i=1; i<n; ++i)
+    if (isLms(types, i))
+	sa[--bkt[saisChar(text, i)]] = i;
+induceL(text, types, sa, bkt, alphaSize);
+induceS(text, types, sa, bkt, alphaSize);
+freez(&bkt);
+
+/* Move sorted LMS positions to start of sa. There are at most n/2 of them. */
+bits64 lmsCount = 0;
+for (i=0; i<n; ++i)
+    {
+    bits32 pos = sa[i];
+    if (pos != saisEmpty && isLms(types, pos))
+	sa[lmsCount++] = pos;
+    }
+
+/* Name LMS substrings, storing name at lmsCount + pos/2, which is free and unique
+ * since LMS positions are at least two apart. */
+for (i=lmsCount; i<n; ++i)
+    sa[i] = saisEmpty;
+bits64 nameCount = 0, prev = 0;
+for (i=0; i<lmsCount; ++i)
+    {
+    bits64 pos = sa[i];
+    if (nameCount == 0 || lmsSubstringsDiffer(text, types, pos, prev))
+	{
+	++nameCount;
+	prev = pos;
+	}
+    sa[lmsCount + pos/2] = nameCount - 1;
+    }
+
+/* Pack the names into the end of sa to make the reduced text. */
+for (i=n, j=n; i>lmsCount; )
+    {
+    --i;
+    if (sa[i] != saisEmpty)
+	sa[--j] = sa[i];
+    }
+bits32 *reduced = sa + n - lmsCount;
+
+/* Sort the reduced text into the start of sa, recursing unless names are unique. */
+if (nameCount < lmsCount)
+    {
+    struct saisText sub = {NULL, reduced, lmsCount};
+    saisRecurse(&sub, sa, nameCount);
+    }
+else
+    {
+    for (i=0; i<lmsCount; ++i)
+	sa[reduced[i]] = i;
+    }
+
+/* Convert positions in reduced text back to positions in text, and put them at the
+ * ends of their buckets in order. */
+for (i=1, j=0; i<n; ++i)
+    if (isLms(types, i))
+	reduced[j++] = i;
+for (i=0; i<lmsCount; ++i)
+    sa[i] = reduced[sa[i]];
+for (i=lmsCount; i<n; ++i)
+    sa[i] = saisEmpty;
+bkt = needHugeMem(alphaSize * sizeof(bkt[0]));
+getBuckets(text, bkt, alphaSize, TRUE);
+for (i=lmsCount; i>0; )
+    {
+    --i;
+    bits32 pos = sa[i];
+    sa[i] = saisEmpty;
+    sa[--bkt[saisChar(text, pos)]] = pos;
+    }
+
+/* And induce the rest of the suffixes from them. */
+induceL(text, types, sa, bkt, alphaSize);
+induceS(text, types, sa, bkt, alphaSize);
+freez(&bkt);
+freez(&types);
+}
+
+void saisMake(UBYTE *text, bits64 size, bits32 *sa)
+/* Fill in sa, which must have room for size+1 elements, with the suffix array of text.
+ * Suffixes are compared as unsigned bytes, so text may contain zeroes, and a suffix
+ * that is a prefix of another sorts first.  On return sa[0] is size (the empty suffix)
+ * and sa[1] through sa[size] are the offsets of the nonempty suffixes in order.  Extra
+ * memory used is about size/8 bytes plus, for very repetitive text, up to 2*size bytes. */
+{
+if (size > saisMaxSize)
+    errAbort("Can't make suffix array of %lld bytes, limit is %lld", size, saisMaxSize);
+struct saisText top = {text, NULL, size+1};
+saisRecurse(&top, sa, 257);
+}
+
+bits64 saisDnaIndex(char *allDna, bits64 dnaSize, int minSize, int nFreeSize, bits32 *sa)
+/* Fill in sa, which must have room for dnaSize+1 elements, with the alphabetical offsets
+ * of the suffixes of allDna to index.  AllDna holds upper case sequences separated by
+ * zeroes.  A suffix is indexed if there are at least minSize bases before the next zero
+ * and there are no N's in the first nFreeSize bytes.  Returns the number of suffixes
+ * indexed, which are in sa[0] through sa[count-1]. */
+{
+saisMake((UBYTE *)allDna, dnaSize, sa);
+
+/* Scan backwards keeping track of next zero and N to see which suffixes to keep. */
+Bits *keep = bitAlloc(dnaSize);
+bits64 i, nextZero = dnaSize, nextN = dnaSize + nFreeSize;
+for (i=dnaSize; i>0; )
+    {
+    --i;
+    char c = allDna[i];
+    if (c == 0)
+        nextZero = i;
+    else if (c == 'N')
+        nextN = i;
+    if (nextZero - i >= minSize && nextN - i >= nFreeSize)
+        bitSetOne(keep, i);
+    }
+
+/* Squeeze out the ones we don't keep, along with the empty suffix at start. */
+bits64 count = 0;
+for (i=1; i<=dnaSize; ++i)
+    {
+    bits32 pos = sa[i];
+    if (bitReadOne(keep, pos))
+        sa[count++] = pos;
+    }
+bitFree(&keep);
+return count;
+}
@@ -0,0 +1,149 @@
+/* bbiSummaryTest - Check summaries made from flat float arrays replace what was in the
+ * summary array before rather than adding to it. */
+
+/* Copyright (C) 2026 The Regents of the University of California
+ * See kent/LICENSE or http://genome.ucsc.edu/license/ for licensing information. */
+
+#include "common.h"
+#include "bbiFile.h"
+
+void usage()
+/* Explain usage and exit. */
+{
+errAbort(
+  "bbiSummaryTest - Check summaries made from flat float arrays replace what was in the\n"
+  "summary array before rather than adding to it.\n"
+  "usage:\n"
+  "  bbiSummaryTest out.txt\n"
+  "Writes a line for each thing tested saying whether the answers matched.\n"
+  );
+}
+
+static float valAt(bits32 pos)
+/* Return made up value at pos, NaN for some bases.  Values are small integers so that
+ * sums are exact whatever order they are done in. */
+{
+if (pos % 7 == 0 || (pos / 1000) % 3 == 1)
+    return NAN;
+return (float)((pos * 2654435761u >> 16) % 13) - 4;
+}
+
+static int fetchMadeUp(struct bbiFile *bbi, char *chrom, bits32 start, bits32 end,
+	float *vals)
+/* Fill in vals with made up data.  A BbiFetchFloats callback. */
+{
+int count = 0;
+bits32 pos;
+for (pos = start; pos < end; ++pos)
+    {
+    vals[pos-start] = valAt(pos);
+    if (!isnan(vals[pos-start]))
+        ++count;
+    }
+return count;
+}
+
+static void summarizeSlow(bits32 start, bits32 end, struct bbiSummaryElement *el)
+/* Summarize made up data from start to end into el one base at a time. */
+{
+ZeroVar(el);
+bits32 pos;
+for (pos = start; pos < end; ++pos)
+    {
+    float val = valAt(pos);
+    if (isnan(val))
+        continue;
+    if (el->validCount == 0 || el->minVal > val)
+        el->minVal = val;
+    if (el->validCount == 0 || el->maxVal < val)
+        el->maxVal = val;
+    el->validCount += 1;
+    el->sumData += val;
+    el->sumSquares += (double)val*val;
+    }
+}
+
+static boolean sameElement(struct bbiSummaryElement *a, struct bbiSummaryElement *b)
+/* Return TRUE if a and b are the same. */
+{
+if (a->validCount != b->validCount)
+    return FALSE;
+if (a->validCount == 0)
+    return TRUE;
+return a->minVal == b->minVal && a->maxVal == b->maxVal && a->sumData == b->sumData
+	&& a->sumSquares == b->sumSquares;
+}
+
+static boolean summaryMatches(struct bbiFile *bbi, bits32 start, bits32 end,
+	int summarySize, struct bbiSummaryElement *summary)
+/* Summarize start to end into summary, which may hold anything beforehand, and return
+ * TRUE if the answer is the same as doing it slowly. */
+{
+bbiFloatSummaryArrayExtended(bbi, "chr1", start, end, NULL, fetchMadeUp,
+	summarySize, summary);
+bits32 baseCount = end - start;
+int i;
+for (i=0; i<summarySize; ++i)
+    {
+    struct bbiSummaryElement expected;
+    if (baseCount > summarySize)
+        {
+	bits32 baseStart = start + (bits64)baseCount*i/summarySize;
+	bits32 baseEnd = start + (bits64)baseCount*(i+1)/summarySize;
+	if (baseEnd == baseStart)
+	    baseEnd = baseStart + 1;
+	summarizeSlow(baseStart, baseEnd, &expected);
+	}
+    else
+        {
+	/* Find the base that covers this pixel, if any. */
+	double pixelsPerBase = (double)summarySize / baseCount;
+	bits32 offset;
+	ZeroVar(&expected);
+	for (offset = 0; offset < baseCount; ++offset)
+	    if (round(offset * pixelsPerBase) <= i && i < round((offset+1) * pixelsPerBase))
+	        summarizeSlow(start + offset, start + offset + 1, &expected);
+	}
+    if (!sameElement(&summary[i], &expected))
+        return FALSE;
+    }
+return TRUE;
+}
+
+void bbiSummaryTest(char *outFile)
+/* Summarize regions of made up data into reused and uninitialized arrays. */
+{
+FILE *f = mustOpen(outFile, "w");
+struct bbiFile *bbi;
+AllocVar(bbi);	/* No zoom levels, so summaries come from the flat array. */
+int summarySize = 700;
+struct bbiSummaryElement *summary;
+AllocArray(summary, summarySize);
+
+/* Same array, first a region with lots of data and then one with less. */
+boolean reuseOk = summaryMatches(bbi, 0, 100000, summarySize, summary)
+	&& summaryMatches(bbi, 1500, 2900, summarySize, summary)
+	&& summaryMatches(bbi, 20000, 20350, summarySize, summary)
+	&& summaryMatches(bbi, 3000, 90000, summarySize, summary);
+fprintf(f, "reuse\t%s\n", (reuseOk ? "ok" : "WRONG"));
+
+/* Array full of junk, as with an uninitialized array on the stack. */
+memset(summary, 0x5a, summarySize * sizeof(summary[0]));
+boolean junkOk = summaryMatches(bbi, 500, 70500, summarySize, summary);
+memset(summary, 0x5a, summarySize * sizeof(summary[0]));
+junkOk = junkOk && summaryMatches(bbi, 12345, 12700, summarySize, summary);
+fprintf(f, "junk\t%s\n", (junkOk ? "ok" : "WRONG"));
+
+freeMem(summary);
+freeMem(bbi);
+carefulClose(&f);
+}
+
+int main(int argc, char *argv[])
+/* Process command line. */
+{
+if (argc != 2)
+    usage();
+bbiSummaryTest(argv[1]);
+return 0;
+}
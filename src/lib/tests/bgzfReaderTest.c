@@ -0,0 +1,283 @@
+/* bgzfReaderTest - Check lineFile reads BGZF files the same with threads inflating blocks as
+ * through a gzip pipeline, and optionally time the two against each other. */
+
+/* Copyright (C) 2026 The Regents of the University of California
+ * See kent/LICENSE or http://genome.ucsc.edu/license/ for licensing information. */
+
+#include "common.h"
+#include "options.h"
+#include "portable.h"
+#include "errCatch.h"
+#include "linefile.h"
+#include "bgzfReader.h"
+#include "htslib/bgzf.h"
+#include "testUtil.h"
+#include <zlib.h>
+
+void usage()
+/* Explain usage and exit. */
+{
+errAbort(
+  "bgzfReaderTest - Check lineFile reads BGZF files the same with threads inflating blocks as\n"
+  "through a gzip pipeline, and optionally time the two against each other.\n"
+  "usage:\n"
+  "  bgzfReaderTest out.txt\n"
+  "Writes a line for each thing tested saying whether the answers matched.  Scratch\n"
+  "files are written next to out.txt.\n"
+  "options:\n"
+  "  -bench=N - instead of testing, time reading a BGZF file of N lines with the gzip\n"
+  "             pipeline and with 1, 2 and 4 threads, and write the times to out.txt\n"
+  );
+}
+
+static struct optionSpec options[] = {
+    {"bench", OPTION_INT},
+    {NULL, 0},
+};
+
+static struct dyString *randomText(int lineCount)
+/* Return lineCount lines of tab separated text that looks a bit like a bed file. */
+{
+struct dyString *dy = dyStringNew(0);
+int i;
+for (i=0; i<lineCount; ++i)
+    {
+    int start = testRandom() * 1000 + testRandom();
+    dyStringPrintf(dy, "chr%d\t%d\t%d\tname%d\t%d\t%c", 1 + testRandom() % 22, start,
+    	start + testRandom() % 5000, i, testRandom() % 1000, (testRandom() & 1 ? '+' : '-'));
+    int extra = testRandom() % 100, j;
+    for (j=0; j<extra; ++j)
+        dyStringAppendC(dy, "ACGT"[testRandom() & 3]);
+    dyStringAppendC(dy, '\n');
+    }
+return dy;
+}
+
+static void writeBgzf(char *fileName, struct dyString *text)
+/* Write text to fileName compressed with BGZF. */
+{
+BGZF *bgzf = bgzf_open(fileName, "w");
+if (bgzf == NULL)
+    errAbort("Couldn't open %s", fileName);
+if (text->stringSize > 0 && bgzf_write(bgzf, text->string, text->stringSize) < 0)
+    errAbort("Couldn't write %s", fileName);
+if (bgzf_close(bgzf) < 0)
+    errAbort("Couldn't close %s", fileName);
+}
+
+static void writeGzip(char *fileName, struct dyString *text)
+/* Write text to fileName compressed with plain gzip. */
+{
+gzFile gz = gzopen(fileName, "wb");
+if (gz == NULL || gzwrite(gz, text->string, text->stringSize) != text->stringSize
+    || gzclose(gz) != Z_OK)
+    errAbort("Couldn't write %s", fileName);
+}
+
+static boolean linesMatch(char *fileName, struct dyString *text, boolean expectBgzf)
+/* Return TRUE if reading fileName line by line gives back text, and it was read with
+ * a bgzfReader if expectBgzf. */
+{
+struct lineFile *lf = lineFileOpen(fileName, TRUE);
+boolean same = ((lf->bgzf != NULL) == expectBgzf);
+char *s = text->string, *end = s + text->stringSize;
+char *line;
+int size;
+while (same && lineFileNext(lf, &line, &size))
+    {
+    char *e = strchr(s, '\n');
+    if (e == NULL || e - s + 1 != size || memcmp(s, line, size-1) != 0)
+        same = FALSE;
+    else
+	s = e + 1;
+    }
+lineFileClose(&lf);
+return same && s == end;
+}
+
+static boolean readsMatch(char *fileName, struct dyString *text, int threadCount)
+/* Return TRUE if reading fileName in pieces of assorted sizes gives back text. */
+{
+struct bgzfReader *br = bgzfReaderOpen(fileName, threadCount);
+int bufSize = 200000;
+char *buf = needMem(bufSize);
+boolean same = TRUE;
+int pos = 0, readSize;
+do
+    {
+    int pieceSize = 1 + testRandom() % (testRandom() & 1 ? 16 : bufSize-1);
+    readSize = bgzfReaderRead(br, buf, pieceSize);
+    if (readSize > pieceSize || (readSize < pieceSize && pos + readSize != text->stringSize)
+        || memcmp(buf, text->string + pos, readSize) != 0)
+	same = FALSE;
+    pos += readSize;
+    }
+while (readSize > 0 && same);
+freeMem(buf);
+bgzfReaderClose(&br);
+return same && pos == text->stringSize;
+}
+
+static boolean catchesError(char *fileName, char *expected)
+/* Return TRUE if reading fileName aborts with an error message starting with expected. */
+{
+struct bgzfReader *br = bgzfReaderOpen(fileName, 3);
+char buf[4096];
+struct errCatch *errCatch = errCatchNew();
+if (errCatchStart(errCatch))
+    {
+    while (bgzfReaderRead(br, buf, sizeof(buf)) > 0)
+        ;
+    }
+errCatchEnd(errCatch);
+boolean ok = (errCatch->gotError && startsWith(expected, errCatch->message->string));
+errCatchFree(&errCatch);
+bgzfReaderClose(&br);
+return ok;
+}
+
+static void chopFile(char *fileName, long long size)
+/* Truncate file to size. */
+{
+if (truncate(fileName, size) != 0)
+    errnoAbort("Couldn't truncate %s", fileName);
+}
+
+static void flipByte(char *fileName, long long offset)
+/* Change the byte at offset in file. */
+{
+FILE *f = mustOpen(fileName, "r+b");
+fseek(f, offset, SEEK_SET);
+int c = fgetc(f);
+fseek(f, offset, SEEK_SET);
+fputc(c ^ 0x55, f);
+carefulClose(&f);
+}
+
+void bgzfReaderTest(char *outFile)
+/* Write text as BGZF and as gzip, read it back different ways and compare. */
+{
+FILE *f = mustOpen(outFile, "w");
+char bgzfName[PATH_LEN], gzipName[PATH_LEN];
+safef(bgzfName, sizeof(bgzfName), "%s.bgzf.gz", outFile);
+safef(gzipName, sizeof(gzipName), "%s.gzip.gz", outFile);
+boolean isBgzfOk = TRUE, pipelineOk = TRUE, threadsOk = TRUE, gzipOk = TRUE, readOk = TRUE,
+	emptyOk = TRUE, errorOk = TRUE;
+
+int lineCounts[] = {1, 10, 3000, 40000};
+int i;
+for (i=0; i<ArraySize(lineCounts); ++i)
+    {
+    struct dyString *text = randomText(lineCounts[i]);
+    writeBgzf(bgzfName, text);
+    writeGzip(gzipName, text);
+    if (!bgzfReaderIsBgzf(bgzfName) || bgzfReaderIsBgzf(gzipName))
+        isBgzfOk = FALSE;
+    lineFileSetDecompressThreads(0);
+    if (!linesMatch(bgzfName, text, FALSE))
+        pipelineOk = FALSE;
+    int threadCount;
+    for (threadCount = 1; threadCount <= 5; threadCount += 2)
+        {
+	lineFileSetDecompressThreads(threadCount);
+	if (!linesMatch(bgzfName, text, TRUE))
+	    threadsOk = FALSE;
+	if (!readsMatch(bgzfName, text, threadCount))
+	    readOk = FALSE;
+	}
+    if (!linesMatch(gzipName, text, FALSE))
+        gzipOk = FALSE;
+    dyStringFree(&text);
+    }
+
+struct dyString *text = dyStringNew(0);
+writeBgzf(bgzfName, text);
+if (!linesMatch(bgzfName, text, TRUE) || !readsMatch(bgzfName, text, 2))
+    emptyOk = FALSE;
+dyStringFree(&text);
+
+/* Damaged files should give errors rather than wrong answers. */
+text = randomText(20000);
+writeBgzf(bgzfName, text);
+long long size = fileSize(bgzfName);
+chopFile(bgzfName, size/2);
+if (!catchesError(bgzfName, "Truncated block"))
+    errorOk = FALSE;
+writeBgzf(bgzfName, text);
+flipByte(bgzfName, size/2);
+if (!catchesError(bgzfName, "Corrupt block") && !catchesError(bgzfName, "CRC mismatch"))
+    errorOk = FALSE;
+dyStringFree(&text);
+lineFileSetDecompressThreads(0);
+remove(bgzfName);
+remove(gzipName);
+
+testReport(f, "isBgzf", isBgzfOk);
+testReport(f, "pipeline", pipelineOk);
+testReport(f, "threads", threadsOk);
+testReport(f, "gzip", gzipOk);
+testReport(f, "read", readOk);
+testReport(f, "empty", emptyOk);
+testReport(f, "errors", errorOk);
+carefulClose(&f);
+}
+
+static long timeRead(char *fileName, int threadCount, long long *retBytes)
+/* Return milliseconds taken to read fileName line by line with threadCount threads. */
+{
+long startTime = clock1000();
+lineFileSetDecompressThreads(threadCount);
+struct lineFile *lf = lineFileOpen(fileName, TRUE);
+char *line;
+int size;
+long long bytes = 0;
+while (lineFileNext(lf, &line, &size))
+    bytes += size;
+lineFileClose(&lf);
+*retBytes = bytes;
+return clock1000() - startTime;
+}
+
+static void bgzfReaderBench(char *outFile, int lineCount)
+/* Time reading a BGZF file of lineCount lines through the gzip pipeline and with
+ * 1, 2 and 4 threads. */
+{
+char bgzfName[PATH_LEN];
+safef(bgzfName, sizeof(bgzfName), "%s.bgzf.gz", outFile);
+struct dyString *text = randomText(lineCount);
+writeBgzf(bgzfName, text);
+FILE *f = mustOpen(outFile, "w");
+fprintf(f, "%d lines, %lld bytes compressed to %lld, times in milliseconds\n",
+	lineCount, (long long)text->stringSize, (long long)fileSize(bgzfName));
+int threadCounts[] = {0, 1, 2, 4};
+int i;
+for (i=0; i<ArraySize(threadCounts); ++i)
+    {
+    long long bytes;
+    long time = timeRead(bgzfName, threadCounts[i], &bytes);
+    if (bytes != text->stringSize)
+        errAbort("Read %lld bytes from %s, expected %lld", bytes, bgzfName,
+		(long long)text->stringSize);
+    if (threadCounts[i] == 0)
+	fprintf(f, "gzip pipeline\t%ld\n", time);
+    else
+	fprintf(f, "%d threads\t%ld\n", threadCounts[i], time);
+    }
+carefulClose(&f);
+remove(bgzfName);
+dyStringFree(&text);
+}
+
+int main(int argc, char *argv[])
+/* Process command line. */
+{
+optionInit(&argc, argv, options);
+if (argc != 2)
+    usage();
+int benchCount = optionInt("bench", 0);
+if (benchCount > 0)
+    bgzfReaderBench(argv[1], benchCount);
+else
+    bgzfReaderTest(argv[1]);
+return 0;
+}
@@ -0,0 +1,199 @@
+/* binKeeperTest - Check frozen binKeepers and batch queries give the same answers as
+ * the original lists. */
+
+/* Copyright (C) 2026 The Regents of the University of California
+ * See kent/LICENSE or http://genome.ucsc.edu/license/ for licensing information. */
+
+#include "common.h"
+#include "options.h"
+#include "obscure.h"
+#include "binRange.h"
+#include "testUtil.h"
+
+void usage()
+/* Explain usage and exit. */
+{
+errAbort(
+  "binKeeperTest - Check frozen binKeepers and batch queries give the same answers as\n"
+  "the original lists.\n"
+  "usage:\n"
+  "  binKeeperTest out.txt\n"
+  "Writes a line for each thing tested saying whether the answers matched.\n"
+  );
+}
+
+static struct optionSpec options[] = {
+    {NULL, 0},
+};
+
+static void randomRange(int seqSize, int *retStart, int *retEnd)
+/* Return a random range that is sometimes small and sometimes spans many bins. */
+{
+int maxSize = ((testRandom() & 7) == 0 ? seqSize/4 : 5000);
+int start = testRandomInt(seqSize);
+int end = start + testRandomInt(maxSize);
+*retStart = start;
+*retEnd = min(end, seqSize);
+}
+
+static boolean sameLists(struct binElement *a, struct binElement *b)
+/* Return TRUE if lists have the same elements in the same order. */
+{
+for (; a != NULL && b != NULL; a = a->next, b = b->next)
+    if (a->start != b->start || a->end != b->end || a->val != b->val)
+        return FALSE;
+return a == NULL && b == NULL;
+}
+
+static int intCmp(const void *va, const void *vb)
+/* Compare two ints. */
+{
+const int *a = va, *b = vb;
+return *a - *b;
+}
+
+static boolean batchMatches(struct binKeeper *bk, struct binKeeperQuery *queries, int queryCount,
+	struct binKeeperHit **pHits, int *pHitAlloc)
+/* Return TRUE if binKeeperFindBatch finds the same elements as binKeeperFind
+ * for each query.  Order within a query may differ on a frozen binKeeper, so
+ * compare the vals, which are unique, after sorting. */
+{
+int hitCount = binKeeperFindBatch(bk, queries, queryCount, pHits, pHitAlloc);
+struct binKeeperHit *hits = *pHits;
+int q, h = 0;
+boolean same = TRUE;
+for (q=0; q<queryCount && same; ++q)
+    {
+    struct binElement *list = binKeeperFind(bk, queries[q].start, queries[q].end), *el;
+    int count = slCount(list), i;
+    int *found, *expected;
+    AllocArray(found, count+1);	/* Plus one since AllocArray can't do zero. */
+    AllocArray(expected, count+1);
+    for (el = list, i = 0; el != NULL; el = el->next, ++i)
+        expected[i] = ptToInt(el->val);
+    for (i=0; i<count; ++i, ++h)
+        {
+	if (h >= hitCount || hits[h].query != q
+	    || rangeIntersection(hits[h].el->start, hits[h].el->end,
+	    	queries[q].start, queries[q].end) <= 0)
+	    {
+	    same = FALSE;
+	    break;
+	    }
+	found[i] = ptToInt(hits[h].el->val);
+	}
+    if (same)
+        {
+	qsort(found, count, sizeof(found[0]), intCmp);
+	qsort(expected, count, sizeof(expected[0]), intCmp);
+	same = (memcmp(found, expected, count * sizeof(found[0])) == 0);
+	}
+    freeMem(found);
+    freeMem(expected);
+    slFreeList(&list);
+    }
+return same && h == hitCount;
+}
+
+void binKeeperTest(char *outFile)
+/* binKeeperTest - Check frozen binKeepers and batch queries give the same answers as
+ * the original lists. */
+{
+FILE *f = mustOpen(outFile, "w");
+boolean findOk = TRUE, anyOk = TRUE, lowestOk = TRUE, traverseOk = TRUE, batchOk = TRUE, changeOk = TRUE;
+int trial;
+struct binKeeperHit *hits = NULL;
+int hitAlloc = 0;
+for (trial = 0; trial < 20; ++trial)
+    {
+    int seqSize = 1000 + testRandomInt(700000000);
+    int count = trial * trial * 10, i;
+    struct binKeeper *lists = binKeeperNew(0, seqSize);
+    struct binKeeper *frozen = binKeeperNew(0, seqSize);
+    for (i=0; i<count; ++i)
+        {
+	int start, end;
+	randomRange(seqSize, &start, &end);
+	binKeeperAdd(lists, start, end, intToPt(i+1));
+	binKeeperAdd(frozen, start, end, intToPt(i+1));
+	}
+    binKeeperFreeze(frozen);
+
+    int queryCount = 200;
+    struct binKeeperQuery *queries;
+    AllocArray(queries, queryCount);
+    for (i=0; i<queryCount; ++i)
+        {
+	randomRange(seqSize, &queries[i].start, &queries[i].end);
+	struct binElement *a = binKeeperFind(lists, queries[i].start, queries[i].end);
+	struct binElement *b = binKeeperFind(frozen, queries[i].start, queries[i].end);
+	if (!sameLists(a, b))
+	    findOk = FALSE;
+	slFreeList(&a);
+	slFreeList(&b);
+	if (binKeeperAnyOverlap(lists, queries[i].start, queries[i].end)
+	    != binKeeperAnyOverlap(frozen, queries[i].start, queries[i].end))
+	    anyOk = FALSE;
+	struct binElement *la = binKeeperFindLowest(lists, queries[i].start, queries[i].end);
+	struct binElement *lb = binKeeperFindLowest(frozen, queries[i].start, queries[i].end);
+	if ((la == NULL) != (lb == NULL) || (la != NULL && la->val != lb->val))
+	    lowestOk = FALSE;
+	}
+
+    struct binKeeperCookie ca = binKeeperFirst(lists), cb = binKeeperFirst(frozen);
+    struct binElement *ea, *eb;
+    do
+	{
+	ea = binKeeperNext(&ca);
+	eb = binKeeperNext(&cb);
+	if ((ea == NULL) != (eb == NULL) || (ea != NULL && ea->val != eb->val))
+	    traverseOk = FALSE;
+	}
+    while (ea != NULL && eb != NULL);
+
+    if (!batchMatches(lists, queries, queryCount, &hits, &hitAlloc)
+        || !batchMatches(frozen, queries, queryCount, &hits, &hitAlloc))
+	batchOk = FALSE;
+
+    /* Adding and removing after a freeze should work like it does on lists. */
+    for (i=0; i<10; ++i)
+        {
+	int start, end;
+	randomRange(seqSize, &start, &end);
+	binKeeperAdd(lists, start, end, intToPt(count+i+1));
+	binKeeperAdd(frozen, start, end, intToPt(count+i+1));
+	binKeeperRemove(lists, start, end, intToPt(count+i+1));
+	binKeeperRemove(frozen, start, end, intToPt(count+i+1));
+	binKeeperFreeze(frozen);
+	binKeeperAdd(lists, start, end, intToPt(count+i+1));
+	binKeeperAdd(frozen, start, end, intToPt(count+i+1));
+	}
+    struct binElement *a = binKeeperFindAll(lists), *b = binKeeperFindAll(frozen);
+    if (!sameLists(a, b))
+        changeOk = FALSE;
+    slFreeList(&a);
+    slFreeList(&b);
+
+    freeMem(queries);
+    binKeeperFree(&lists);
+    binKeeperFree(&frozen);
+    }
+freeMem(hits);
+fprintf(f, "find\t%s\n", (findOk ? "ok" : "WRONG"));
+fprintf(f, "anyOverlap\t%s\n", (anyOk ? "ok" : "WRONG"));
+fprintf(f, "findLowest\t%s\n", (lowestOk ? "ok" : "WRONG"));
+fprintf(f, "traverse\t%s\n", (traverseOk ? "ok" : "WRONG"));
+fprintf(f, "batch\t%s\n", (batchOk ? "ok" : "WRONG"));
+fprintf(f, "change\t%s\n", (changeOk ? "ok" : "WRONG"));
+carefulClose(&f);
+}
+
+int main(int argc, char *argv[])
+/* Process command line. */
+{
+optionInit(&argc, argv, options);
+if (argc != 2)
+    usage();
+binKeeperTest(argv[1]);
+return 0;
+}
@@ -0,0 +1,357 @@
+/* dnaKernelTest - Check the block at a time DNA routines in dnautil, common and twoBit
+ * give the same answers as simple one base at a time versions, and optionally time
+ * the two against each other. */
+
+/* Copyright (C) 2026 The Regents of the University of California
+ * See kent/LICENSE or http://genome.ucsc.edu/license/ for licensing information. */
+
+#include "common.h"
+#include "options.h"
+#include "portable.h"
+#include "dnautil.h"
+#include "dnaseq.h"
+#include "twoBit.h"
+#include "testUtil.h"
+
+void usage()
+/* Explain usage and exit. */
+{
+errAbort(
+  "dnaKernelTest - Check the block at a time DNA routines in dnautil, common and twoBit\n"
+  "give the same answers as simple one base at a time versions, and optionally time\n"
+  "the two against each other.\n"
+  "usage:\n"
+  "  dnaKernelTest out.txt\n"
+  "Writes a line for each routine tested saying whether the answers matched.  A\n"
+  "scratch .2bit file is written next to out.txt.\n"
+  "options:\n"
+  "  -bench=N - instead of testing, time both versions on N bases and write the\n"
+  "             times to out.txt\n"
+  );
+}
+
+static struct optionSpec options[] = {
+    {"bench", OPTION_INT},
+    {NULL, 0},
+};
+
+static void randomDna(DNA *dna, int size)
+/* Fill dna with runs of upper and lower case bases and N's, with the odd
+ * ambiguity code or other character thrown in. */
+{
+static char *plain = "ACGTacgt", *odd = "RYMKSWBDHVXUu-.*\t";
+int i = 0;
+while (i < size)
+    {
+    int runSize = 1 + testRandomInt((testRandom() & 1) ? 8 : 100);
+    runSize = min(runSize, size - i);
+    int kind = testRandom() % 10;
+    boolean isLower = testRandom() & 1;
+    int j;
+    for (j=0; j<runSize; ++j, ++i)
+        {
+	if (kind < 7)
+	    dna[i] = plain[(testRandom() & 3) + (isLower ? 4 : 0)];
+	else if (kind < 9)
+	    dna[i] = (isLower ? 'n' : 'N');
+	else
+	    dna[i] = odd[testRandom() % strlen(odd)];
+	}
+    }
+dna[size] = 0;
+}
+
+static void simpleReverseComplement(DNA *dna, int size)
+/* Reverse complement one base at a time. */
+{
+int i;
+for (i=0; i<size/2; ++i)
+    {
+    DNA c = dna[i];
+    dna[i] = dna[size-1-i];
+    dna[size-1-i] = c;
+    }
+for (i=0; i<size; ++i)
+    dna[i] = ntCompTable[(unsigned char)dna[i]];
+}
+
+static void simpleToUpper(char *s, int size)
+/* Upper case one character at a time. */
+{
+int i;
+for (i=0; i<size; ++i)
+    s[i] = toupper(s[i]);
+}
+
+static void simplePack(DNA *dna, int size, UBYTE *packed)
+/* Pack bases with packDna4, padding with T's. */
+{
+int i;
+for (i=0; i+4 <= size; i += 4)
+    *packed++ = packDna4(dna+i);
+if (i < size)
+    {
+    DNA last4[4] = {'T', 'T', 'T', 'T'};
+    memcpy(last4, dna+i, size-i);
+    *packed = packDna4(last4);
+    }
+}
+
+static void simpleUnpack(UBYTE *packed, int byteCount, DNA *dna)
+/* Unpack bases one at a time. */
+{
+int i, j;
+for (i=0; i<byteCount; ++i)
+    for (j=0; j<4; ++j)
+        *dna++ = valToNt[(packed[i] >> (6-j-j)) & 3];
+}
+
+static int simpleBlocks(DNA *dna, int size, boolean isLower, bits32 *starts, bits32 *sizes)
+/* Find blocks of N's or lower case letters one character at a time. */
+{
+int count = 0, i;
+boolean inBlock = FALSE;
+for (i=0; i<size; ++i)
+    {
+    boolean in = (isLower ? islower(dna[i]) : (dna[i] == 'n' || dna[i] == 'N'));
+    if (in && !inBlock)
+        starts[count] = i;
+    if (!in && inBlock)
+        {
+	sizes[count] = i - starts[count];
+	++count;
+	}
+    inBlock = in;
+    }
+if (inBlock)
+    {
+    sizes[count] = size - starts[count];
+    ++count;
+    }
+return count;
+}
+
+static boolean sameBlocks(int count, bits32 *starts, bits32 *sizes,
+	int expCount, bits32 *expStarts, bits32 *expSizes)
+/* Return TRUE if two lists of blocks are the same. */
+{
+if (count != expCount)
+    return FALSE;
+return count == 0 || (memcmp(starts, expStarts, count * sizeof(starts[0])) == 0
+	&& memcmp(sizes, expSizes, count * sizeof(sizes[0])) == 0);
+}
+
+static void expectedFromTwoBit(DNA *dna, int size, DNA *expected)
+/* Put what reading dna back from a masked twoBit file should give in expected. */
+{
+int i;
+for (i=0; i<size; ++i)
+    {
+    DNA c = dna[i];
+    if (c == 'n' || c == 'N')
+        expected[i] = 'n';
+    else
+        expected[i] = valToNt[ntValNoN[(unsigned char)c]];
+    if (!islower(c))
+        expected[i] = toupper(expected[i]);
+    }
+expected[size] = 0;
+}
+
+static void dnaKernelTest(char *outFile)
+/* Compare block at a time routines to simple ones on random sequence. */
+{
+FILE *f = mustOpen(outFile, "w");
+boolean compOk = TRUE, revCompOk = TRUE, caseOk = TRUE, packOk = TRUE, unpackOk = TRUE,
+	blocksOk = TRUE, twoBitOk = TRUE;
+int maxSize = 2000;	/* Sizes go up to and include this. */
+DNA *dna = needMem(maxSize+4), *a = needMem(maxSize+4), *b = needMem(maxSize+4);
+UBYTE *packedA = needMem(maxSize/4+1), *packedB = needMem(maxSize/4+1);
+bits32 *starts = needMem(maxSize * sizeof(bits32)), *sizes = needMem(maxSize * sizeof(bits32));
+struct dnaSeq *seqList = NULL;
+int trial, i;
+for (trial = 0; trial < 400; ++trial)
+    {
+    int size = (trial < 100 ? trial + 1 : 1 + testRandomInt(maxSize));
+    randomDna(dna, size);
+
+    memcpy(a, dna, size+1);
+    memcpy(b, dna, size+1);
+    complement(a, size);
+    for (i=0; i<size; ++i)
+        b[i] = ntCompTable[(unsigned char)b[i]];
+    if (memcmp(a, b, size) != 0)
+        compOk = FALSE;
+
+    memcpy(a, dna, size+1);
+    memcpy(b, dna, size+1);
+    reverseComplement(a, size);
+    simpleReverseComplement(b, size);
+    if (memcmp(a, b, size) != 0)
+        revCompOk = FALSE;
+
+    memcpy(a, dna, size+1);
+    memcpy(b, dna, size+1);
+    toUpperN(a, size);
+    simpleToUpper(b, size);
+    toLowerN(a, size);
+    for (i=0; i<size; ++i)
+        b[i] = tolower(b[i]);
+    if (memcmp(a, b, size) != 0)
+        caseOk = FALSE;
+
+    int byteCount = (size + 3)/4;
+    packDnaBytes(dna, size, packedA);
+    simplePack(dna, size, packedB);
+    if (memcmp(packedA, packedB, byteCount) != 0)
+        packOk = FALSE;
+
+    unpackDna4(packedA, byteCount, a);
+    simpleUnpack(packedA, byteCount, b);
+    if (memcmp(a, b, 4*byteCount) != 0)
+        unpackOk = FALSE;
+
+    struct dnaSeq *seq = newDnaSeq(cloneMem(dna, size+1), size, NULL);
+    char name[32];
+    safef(name, sizeof(name), "seq%d", trial);
+    seq->name = cloneString(name);
+    struct twoBit *twoBit = twoBitFromDnaSeq(seq, TRUE);
+    int expCount = simpleBlocks(dna, size, FALSE, starts, sizes);
+    if (!sameBlocks(twoBit->nBlockCount, twoBit->nStarts, twoBit->nSizes,
+    	expCount, starts, sizes))
+	blocksOk = FALSE;
+    expCount = simpleBlocks(dna, size, TRUE, starts, sizes);
+    if (!sameBlocks(twoBit->maskBlockCount, twoBit->maskStarts, twoBit->maskSizes,
+    	expCount, starts, sizes))
+	blocksOk = FALSE;
+    twoBitFree(&twoBit);
+    slAddHead(&seqList, seq);
+    }
+
+/* Write sequences to a .2bit file and read them back, whole and in pieces. */
+slReverse(&seqList);
+char twoBitName[PATH_LEN];
+safef(twoBitName, sizeof(twoBitName), "%s.2bit", outFile);
+struct twoBit *twoBitList = NULL, *twoBit;
+struct dnaSeq *seq;
+for (seq = seqList; seq != NULL; seq = seq->next)
+    slAddHead(&twoBitList, twoBitFromDnaSeq(seq, TRUE));
+slReverse(&twoBitList);
+FILE *tf = mustOpen(twoBitName, "wb");
+twoBitWriteHeader(twoBitList, tf);
+for (twoBit = twoBitList; twoBit != NULL; twoBit = twoBit->next)
+    twoBitWriteOne(twoBit, tf);
+carefulClose(&tf);
+twoBitFreeList(&twoBitList);
+struct twoBitFile *tbf = twoBitOpen(twoBitName);
+for (seq = seqList; seq != NULL; seq = seq->next)
+    {
+    expectedFromTwoBit(seq->dna, seq->size, a);
+    int start = testRandomInt(seq->size), end = start + 1 + testRandomInt(seq->size - start);
+    struct dnaSeq *whole = twoBitReadSeqFragExt(tbf, seq->name, 0, 0, TRUE, NULL);
+    struct dnaSeq *part = twoBitReadSeqFragExt(tbf, seq->name, start, end, TRUE, NULL);
+    if (whole->size != seq->size || memcmp(whole->dna, a, seq->size) != 0
+        || part->size != end - start || memcmp(part->dna, a + start, end - start) != 0)
+	twoBitOk = FALSE;
+    dnaSeqFree(&whole);
+    dnaSeqFree(&part);
+    }
+twoBitClose(&tbf);
+remove(twoBitName);
+dnaSeqFreeList(&seqList);
+
+testReport(f, "complement", compOk);
+testReport(f, "reverseComplement", revCompOk);
+testReport(f, "case", caseOk);
+testReport(f, "pack", packOk);
+testReport(f, "unpack", unpackOk);
+testReport(f, "blocks", blocksOk);
+testReport(f, "twoBit", twoBitOk);
+carefulClose(&f);
+freeMem(dna);
+freeMem(a);
+freeMem(b);
+freeMem(packedA);
+freeMem(packedB);
+freeMem(starts);
+freeMem(sizes);
+}
+
+static void dnaKernelBench(char *outFile, int size)
+/* Time simple and block at a time routines on size bases. */
+{
+FILE *f = mustOpen(outFile, "w");
+DNA *dna = needHugeMem(size+1);
+UBYTE *packed = needHugeMem(size/4+1);
+bits32 *starts = needHugeMem((size/2 + 1) * sizeof(bits32));
+bits32 *sizes = needHugeMem((size/2 + 1) * sizeof(bits32));
+randomDna(dna, size);
+int byteCount = (size+3)/4;
+fprintf(f, "%d bases, times in milliseconds\n", size);
+fprintf(f, "operation\tsimple\tblock\n");
+
+long startTime = clock1000();
+simpleReverseComplement(dna, size);
+long simpleTime = clock1000() - startTime;
+startTime = clock1000();
+reverseComplement(dna, size);
+fprintf(f, "reverseComplement\t%ld\t%ld\n", simpleTime, clock1000() - startTime);
+
+startTime = clock1000();
+simpleToUpper(dna, size);
+simpleTime = clock1000() - startTime;
+startTime = clock1000();
+toUpperN(dna, size);
+fprintf(f, "toUpperN\t%ld\t%ld\n", simpleTime, clock1000() - startTime);
+randomDna(dna, size);
+
+startTime = clock1000();
+simplePack(dna, size, packed);
+simpleTime = clock1000() - startTime;
+startTime = clock1000();
+packDnaBytes(dna, size, packed);
+fprintf(f, "pack\t%ld\t%ld\n", simpleTime, clock1000() - startTime);
+
+startTime = clock1000();
+int blockCount = simpleBlocks(dna, size, FALSE, starts, sizes);
+blockCount += simpleBlocks(dna, size, TRUE, starts, sizes);
+simpleTime = clock1000() - startTime;
+struct dnaSeq seq;
+ZeroVar(&seq);
+seq.name = "bench";
+seq.dna = dna;
+seq.size = size;
+startTime = clock1000();
+struct twoBit *twoBit = twoBitFromDnaSeq(&seq, TRUE);
+fprintf(f, "twoBitFromDnaSeq\t%ld\t%ld\n", simpleTime, clock1000() - startTime);
+if (blockCount != twoBit->nBlockCount + twoBit->maskBlockCount)
+    errAbort("block counts differ");
+twoBitFree(&twoBit);
+
+startTime = clock1000();
+simpleUnpack(packed, byteCount, dna);
+simpleTime = clock1000() - startTime;
+startTime = clock1000();
+unpackDna4(packed, byteCount, dna);
+fprintf(f, "unpack\t%ld\t%ld\n", simpleTime, clock1000() - startTime);
+carefulClose(&f);
+freeMem(dna);
+freeMem(packed);
+freeMem(starts);
+freeMem(sizes);
+}
+
+int main(int argc, char *argv[])
+/* Process command line. */
+{
+optionInit(&argc, argv, options);
+if (argc != 2)
+    usage();
+dnaUtilOpen();
+int benchSize = optionInt("bench", 0);
+if (benchSize > 0)
+    dnaKernelBench(argv[1], benchSize);
+else
+    dnaKernelTest(argv[1]);
+return 0;
+}
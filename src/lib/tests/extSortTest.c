@@ -0,0 +1,141 @@
+/* extSortTest - Check records come out of extSort in the same order as a simple sort. */
+
+/* Copyright (C) 2026 The Regents of the University of California
+ * See kent/LICENSE or http://genome.ucsc.edu/license/ for licensing information. */
+
+#include "common.h"
+#include "options.h"
+#include "portable.h"
+#include "extSort.h"
+#include "testUtil.h"
+
+void usage()
+/* Explain usage and exit. */
+{
+errAbort(
+  "extSortTest - Check records come out of extSort in the same order as a simple sort.\n"
+  "usage:\n"
+  "  extSortTest tempDir out.txt\n"
+  "Writes a line for each way of sorting tested saying whether the order was right.\n"
+  );
+}
+
+static struct optionSpec options[] = {
+    {NULL, 0},
+};
+
+static char *keys[] = {"", "chr1", "chr10", "chr2", "chr1_random", "chr1_randon",
+    "chrUn_gl000220", "chrUn_gl000211", "scaffold_12345678", "scaffold_1234567", "\xe9t\xe9"};
+
+struct testRec
+/* A record and where it started. */
+    {
+    char *key;
+    int num;
+    int ix;	/* Order added. */
+    };
+
+static int testRecCmp(const void *va, const void *vb)
+/* Compare by key as unsigned bytes, then num, then order added. */
+{
+const struct testRec *a = va, *b = vb;
+int diff = strcmp(a->key, b->key);
+if (diff == 0)
+    diff = a->num - b->num;
+if (diff == 0)
+    diff = a->ix - b->ix;
+return diff;
+}
+
+static boolean sortMatches(char *tempDir, int count, long long maxMem, int threads)
+/* Return TRUE if extSort puts count random records in same order as qsort. */
+{
+struct testRec *recs;
+AllocArray(recs, count+1);	/* Plus one since AllocArray can't do zero. */
+struct extSort *es = extSortNew(tempDir, maxMem, threads);
+int i;
+for (i=0; i<count; ++i)
+    {
+    struct testRec *rec = &recs[i];
+    char data[16];
+    rec->key = keys[testRandom() % ArraySize(keys)];
+    rec->num = (int)(testRandom() % 200) - 100;
+    rec->ix = i;
+    safef(data, sizeof(data), "%d", i);
+    extSortAdd(es, rec->key, extSortSignedNum(rec->num), data, strlen(data));
+    }
+qsort(recs, count, sizeof(recs[0]), testRecCmp);
+boolean same = TRUE;
+char *key, *data;
+bits64 num;
+int dataSize;
+for (i=0; extSortNext(es, &key, &num, &data, &dataSize); ++i)
+    {
+    char buf[16];
+    if (i >= count)
+        {
+	same = FALSE;
+	continue;
+	}
+    safef(buf, sizeof(buf), "%d", recs[i].ix);
+    if (!sameString(key, recs[i].key)
+        || num != extSortSignedNum(recs[i].num)
+	|| dataSize != strlen(buf) || memcmp(data, buf, dataSize) != 0)
+	same = FALSE;
+    }
+if (i != count)
+    same = FALSE;
+extSortFree(&es);
+freeMem(recs);
+return same;
+}
+
+static boolean numsSortRight()
+/* Return TRUE if the numbers made from doubles and signed numbers sort right. */
+{
+double doubles[] = {-1e300, -2.5, -1, -0.0, 0.0, 1e-300, 1, 2.5, 3e10, 1e300};
+long long longs[] = {-9000000000LL, -2, -1, 0, 1, 2, 9000000000LL};
+int i;
+for (i=1; i<ArraySize(doubles); ++i)
+    if (extSortDoubleNum(doubles[i-1]) > extSortDoubleNum(doubles[i]))
+        return FALSE;
+for (i=1; i<ArraySize(longs); ++i)
+    if (extSortSignedNum(longs[i-1]) >= extSortSignedNum(longs[i]))
+        return FALSE;
+return TRUE;
+}
+
+static int countTempFiles(char *tempDir)
+/* Return number of temporary files extSort left in tempDir. */
+{
+struct slName *list = listDir(tempDir, "extSort*");
+int count = slCount(list);
+slFreeList(&list);
+return count;
+}
+
+void extSortTest(char *tempDir, char *outFile)
+/* extSortTest - Check records come out of extSort in the same order as a simple sort. */
+{
+FILE *f = mustOpen(outFile, "w");
+makeDirsOnPath(tempDir);
+testReport(f, "nums", numsSortRight());
+testReport(f, "empty", sortMatches(tempDir, 0, extSortDefaultMem, 1));
+testReport(f, "inMemory", sortMatches(tempDir, 50000, extSortDefaultMem, 1));
+testReport(f, "inMemoryThreads", sortMatches(tempDir, 50000, extSortDefaultMem, 4));
+testReport(f, "runs", sortMatches(tempDir, 50000, 200000, 1));
+testReport(f, "runsThreads", sortMatches(tempDir, 50000, 200000, 3));
+testReport(f, "manyRuns", sortMatches(tempDir, 30000, 2000, 2));
+testReport(f, "tempFilesRemoved", countTempFiles(tempDir) == 0);
+carefulClose(&f);
+}
+
+int main(int argc, char *argv[])
+/* Process command line. */
+{
+optionInit(&argc, argv, options);
+if (argc != 3)
+    usage();
+extSortTest(argv[1], argv[2]);
+return 0;
+}
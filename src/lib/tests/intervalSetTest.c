@@ -0,0 +1,141 @@
+/* intervalSetTest - Check interval set operations give the same answers as bitmaps. */
+
+/* Copyright (C) 2026 The Regents of the University of California
+ * See kent/LICENSE or http://genome.ucsc.edu/license/ for licensing information. */
+
+#include "common.h"
+#include "options.h"
+#include "bits.h"
+#include "intervalSet.h"
+#include "testUtil.h"
+
+void usage()
+/* Explain usage and exit. */
+{
+errAbort(
+  "intervalSetTest - Check interval set operations give the same answers as bitmaps.\n"
+  "usage:\n"
+  "  intervalSetTest out.txt\n"
+  "Writes a line for each operation tested saying whether the answers matched.\n"
+  );
+}
+
+static struct optionSpec options[] = {
+    {NULL, 0},
+};
+
+#define testSize 10000	/* Size of sequence sets are on. */
+
+static struct intervalSet *randomSet(Bits *bits, int runCount, int maxRun)
+/* Make a set of runCount random runs added in random order, and set the same
+ * positions in bits. */
+{
+struct intervalSet *set = intervalSetNew();
+bitClear(bits, testSize);
+int i;
+for (i=0; i<runCount; ++i)
+    {
+    int start = testRandom() % testSize;
+    int end = start + testRandom() % maxRun;
+    if (end > testSize)
+        end = testSize;
+    intervalSetAdd(set, start, end);
+    if (end > start)
+        bitSetRange(bits, start, end - start);
+    }
+return set;
+}
+
+static boolean sameAsBits(struct intervalSet *set, Bits *bits)
+/* Return TRUE if set is normal and has the same positions as bits. */
+{
+intervalSetNormalize(set);
+int i, pos = 0;
+for (i=0; i<set->count; ++i)
+    {
+    struct intervalRun *run = &set->runs[i];
+    if (run->start >= run->end)
+        return FALSE;
+    if (i > 0 && run->start <= set->runs[i-1].end)
+        return FALSE;
+    if (bitFindSet(bits, pos, testSize) != run->start)
+        return FALSE;
+    if (bitFindClear(bits, run->start, testSize) != run->end)
+        return FALSE;
+    pos = run->end;
+    }
+return bitFindSet(bits, pos, testSize) == testSize
+    && intervalSetTotal(set) == bitCountRange(bits, 0, testSize);
+}
+
+void intervalSetTest(char *outFile)
+/* intervalSetTest - Check interval set operations give the same answers as bitmaps. */
+{
+FILE *f = mustOpen(outFile, "w");
+Bits *aBits = bitAlloc(testSize), *bBits = bitAlloc(testSize);
+Bits *bits = bitAlloc(testSize);
+boolean addOk = TRUE, andOk = TRUE, orOk = TRUE, notOk = TRUE, countOk = TRUE;
+int trial;
+for (trial = 0; trial < 200; ++trial)
+    {
+    int maxRun = 1 + trial * 10;
+    struct intervalSet *a = randomSet(aBits, trial % 50, maxRun);
+    struct intervalSet *b = randomSet(bBits, (trial * 7) % 50, maxRun);
+    if (!sameAsBits(a, aBits) || !sameAsBits(b, bBits))
+        addOk = FALSE;
+
+    struct intervalSet *set = intervalSetAnd(a, b);
+    bitClear(bits, testSize);
+    bitOr(bits, aBits, testSize);
+    bitAnd(bits, bBits, testSize);
+    if (!sameAsBits(set, bits))
+        andOk = FALSE;
+    intervalSetFree(&set);
+
+    set = intervalSetOr(a, b);
+    bitClear(bits, testSize);
+    bitOr(bits, aBits, testSize);
+    bitOr(bits, bBits, testSize);
+    if (!sameAsBits(set, bits))
+        orOk = FALSE;
+    intervalSetFree(&set);
+
+    set = intervalSetNot(a, testSize);
+    bitClear(bits, testSize);
+    bitOr(bits, aBits, testSize);
+    bitNot(bits, testSize);
+    if (!sameAsBits(set, bits))
+        notOk = FALSE;
+    intervalSetFree(&set);
+
+    int i;
+    for (i=0; i<20; ++i)
+        {
+	int start = testRandom() % testSize;
+	int size = testRandom() % (testSize - start);
+	if (intervalSetCountRange(a, start, size) != bitCountRange(aBits, start, size))
+	    countOk = FALSE;
+	}
+    intervalSetFree(&a);
+    intervalSetFree(&b);
+    }
+testReport(f, "add", addOk);
+testReport(f, "and", andOk);
+testReport(f, "or", orOk);
+testReport(f, "not", notOk);
+testReport(f, "countRange", countOk);
+bitFree(&aBits);
+bitFree(&bBits);
+bitFree(&bits);
+carefulClose(&f);
+}
+
+int main(int argc, char *argv[])
+/* Process command line. */
+{
+optionInit(&argc, argv, options);
+if (argc != 2)
+    usage();
+intervalSetTest(argv[1]);
+return 0;
+}
@@ -0,0 +1,393 @@
+/* lineFileMmapTest - Check lineFileMmap and its chunks give the same lines as lineFileOpen,
+ * and optionally time the two against each other. */
+
+/* Copyright (C) 2026 The Regents of the University of California
+ * See kent/LICENSE or http://genome.ucsc.edu/license/ for licensing information. */
+
+#include "common.h"
+#include "options.h"
+#include "portable.h"
+#include "linefile.h"
+#include "testUtil.h"
+
+void usage()
+/* Explain usage and exit. */
+{
+errAbort(
+  "lineFileMmapTest - Check lineFileMmap and its chunks give the same lines as lineFileOpen,\n"
+  "and optionally time the two against each other.\n"
+  "usage:\n"
+  "  lineFileMmapTest out.txt\n"
+  "Writes a line for each thing tested saying whether the answers matched.  Scratch\n"
+  "text files are written next to out.txt.\n"
+  "options:\n"
+  "  -bench=N - instead of testing, time reading a file of N lines each way, and\n"
+  "             write the times to out.txt\n"
+  "  -threads=N - number of threads to read chunks with when benchmarking, default 4\n"
+  );
+}
+
+static struct optionSpec options[] = {
+    {"bench", OPTION_INT},
+    {"threads", OPTION_INT},
+    {NULL, 0},
+};
+
+static void writeLines(char *fileName, int lineCount, char *newline, boolean lastNewline)
+/* Write a file of lineCount random lines ending in newline, or in a random mix of
+ * newlines if newline is NULL.  Some lines are empty and some are comments. */
+{
+static char *mix[] = {"\n", "\r\n", "\r"};
+FILE *f = mustOpen(fileName, "w");
+int i;
+for (i=0; i<lineCount; ++i)
+    {
+    int size = testRandom() % 300;
+    if (size < 30)
+        size = 0;
+    else if (size < 40)
+        fputc('#', f);
+    int j;
+    for (j=0; j<size; ++j)
+        fputc((j % 7 == 6 ? '\t' : 'a' + testRandom() % 26), f);
+    if (i < lineCount-1 || lastNewline)
+        fputs((newline != NULL ? newline : mix[testRandom() % 3]), f);
+    }
+carefulClose(&f);
+}
+
+static void writeSize(char *fileName, int fileSize, boolean lastNewline)
+/* Write a file of exactly fileSize bytes of 99 byte lines. */
+{
+FILE *f = mustOpen(fileName, "w");
+int i;
+for (i=0; i<fileSize; ++i)
+    {
+    boolean isNewline = (i % 100 == 99 || (i == fileSize-1 && lastNewline));
+    fputc((isNewline ? '\n' : 'A' + i % 100 % 26), f);
+    }
+carefulClose(&f);
+}
+
+struct lineCopy
+/* A copy of a line read from a file. */
+    {
+    struct lineCopy *next;
+    char *text;		/* Bytes of line, including any newline. */
+    int size;		/* Size returned by lineFileNext. */
+    off_t offset;	/* lineFileTell after reading line. */
+    int lineIx;		/* lf->lineIx after reading line. */
+    };
+
+static struct lineCopy *readAll(struct lineFile *lf, boolean careful, boolean lineIxToo)
+/* Return list of copies of the rest of the lines in lf, and close it. */
+{
+struct lineCopy *list = NULL, *copy;
+char *line;
+int size;
+if (careful)
+    lineFileCarefulNewlines(lf);
+while (lineFileNext(lf, &line, &size))
+    {
+    AllocVar(copy);
+    copy->text = cloneMem(line, size);
+    copy->size = size;
+    copy->offset = lineFileTell(lf);
+    copy->lineIx = (lineIxToo ? lf->lineIx : 0);
+    slAddHead(&list, copy);
+    }
+lineFileClose(&lf);
+slReverse(&list);
+return list;
+}
+
+static void lineCopyFreeList(struct lineCopy **pList)
+/* Free list of line copies. */
+{
+struct lineCopy *el;
+for (el = *pList; el != NULL; el = el->next)
+    freeMem(el->text);
+slFreeList(pList);
+}
+
+static boolean sameLines(struct lineCopy *a, struct lineCopy *b)
+/* Return TRUE if lists have the same lines. */
+{
+for (; a != NULL && b != NULL; a = a->next, b = b->next)
+    if (a->size != b->size || memcmp(a->text, b->text, a->size) != 0
+        || a->offset != b->offset || a->lineIx != b->lineIx)
+	return FALSE;
+return a == NULL && b == NULL;
+}
+
+static void readChunk(struct lineFileChunk *chunk, void *context)
+/* Copy lines of chunk into chunk->val. */
+{
+boolean *careful = context;
+chunk->val = readAll(chunk->lf, *careful, FALSE);
+chunk->lf = NULL;
+}
+
+static boolean chunksMatch(char *fileName, boolean zTerm, boolean careful,
+	struct lineCopy *expected)
+/* Return TRUE if the lines read from chunks of fileName in parallel, strung back
+ * together, are the expected ones. */
+{
+struct lineFile *lf = lineFileMmap(fileName, zTerm);
+if (careful)
+    lineFileCarefulNewlines(lf);
+int chunkCount;
+boolean same = TRUE;
+for (chunkCount = 1; chunkCount <= 9 && same; chunkCount += 4)
+    {
+    struct lineFileChunk *chunks = lineFileMmapChunks(lf, chunkCount), *chunk;
+    if (slCount(chunks) > chunkCount)
+        same = FALSE;
+    lineFileChunkDoList(3, chunks, readChunk, &careful);
+    struct lineCopy *e = expected;
+    int chunkIx = 0;
+    for (chunk = chunks; chunk != NULL; chunk = chunk->next, ++chunkIx)
+        {
+	struct lineCopy *c, *lines = chunk->val;
+	if (chunk->chunkIx != chunkIx)
+	    same = FALSE;
+	for (c = lines; c != NULL && e != NULL && same; c = c->next, e = e->next)
+	    if (c->size != e->size || memcmp(c->text, e->text, c->size) != 0
+	        || c->offset != e->offset)
+		same = FALSE;
+	if (c != NULL)
+	    same = FALSE;
+	lineCopyFreeList(&lines);
+	}
+    if (e != NULL)
+        same = FALSE;
+    lineFileChunkFreeList(&chunks);
+    lineFileRewind(lf);
+    }
+lineFileClose(&lf);
+return same;
+}
+
+static boolean seekMatches(char *fileName, boolean zTerm, struct lineCopy *expected)
+/* Return TRUE if seeking back to lines in a mapped file and rewinding it gets
+ * the expected lines again. */
+{
+struct lineFile *lf = lineFileMmap(fileName, zTerm);
+boolean same = TRUE;
+struct lineCopy *e;
+char *line;
+int size;
+for (e = expected; e != NULL; e = e->next)
+    {
+    if (!lineFileNext(lf, &line, &size))
+        return FALSE;
+    if (e->lineIx % 3 == 0)
+        {
+	lineFileSeek(lf, lineFileTell(lf), SEEK_SET);
+	if (!lineFileNext(lf, &line, &size) || size != e->size
+	    || memcmp(line, e->text, size) != 0)
+	    same = FALSE;
+	lineFileReuse(lf);
+	if (!lineFileNext(lf, &line, &size) || size != e->size)
+	    same = FALSE;
+	}
+    }
+lineFileRewind(lf);
+if (expected != NULL)
+    {
+    if (!lineFileNext(lf, &line, &size) || size != expected->size
+        || memcmp(line, expected->text, size) != 0 || lf->lineIx != 1)
+	same = FALSE;
+    }
+lineFileClose(&lf);
+return same;
+}
+
+void lineFileMmapTest(char *outFile)
+/* Read files with different newlines, sizes and endings both ways and compare. */
+{
+FILE *f = mustOpen(outFile, "w");
+char fileName[PATH_LEN];
+safef(fileName, sizeof(fileName), "%s.txt", outFile);
+boolean nextOk = TRUE, zTermOk = TRUE, carefulOk = TRUE, edgeOk = TRUE, seekOk = TRUE,
+	chunkOk = TRUE;
+int trial;
+for (trial = 0; trial < 24; ++trial)
+    {
+    static char *newlines[] = {"\n", "\r\n", "\r", NULL};
+    char *newline = newlines[trial % 4];
+    boolean careful = (newline == NULL);
+    int lineCount = (trial < 4 ? 0 : (trial < 8 ? 1 : 2000 + testRandom() % 3000));
+    writeLines(fileName, lineCount, newline, trial % 8 < 4);
+    boolean zTerm;
+    for (zTerm = FALSE; zTerm <= TRUE; ++zTerm)
+        {
+	struct lineCopy *expected = readAll(lineFileOpen(fileName, zTerm), careful, TRUE);
+	struct lineCopy *mapped = readAll(lineFileMmap(fileName, zTerm), careful, TRUE);
+	if (!sameLines(expected, mapped))
+	    {
+	    if (careful)
+	        carefulOk = FALSE;
+	    else if (zTerm)
+	        zTermOk = FALSE;
+	    else
+	        nextOk = FALSE;
+	    }
+	if (!careful && !seekMatches(fileName, zTerm, expected))
+	    seekOk = FALSE;
+	if (newline == NULL || newline[0] == '\n')
+	    {
+	    if (!chunksMatch(fileName, zTerm, careful, expected))
+		chunkOk = FALSE;
+	    }
+	lineCopyFreeList(&expected);
+	lineCopyFreeList(&mapped);
+	}
+    }
+
+/* Files that end right at or next to the end of a page. */
+int pageSize = sysconf(_SC_PAGESIZE);
+int sizes[] = {pageSize-1, pageSize, pageSize+1, 2*pageSize};
+int i;
+for (i=0; i<ArraySize(sizes)*2; ++i)
+    {
+    writeSize(fileName, sizes[i/2], i % 2);
+    struct lineCopy *expected = readAll(lineFileOpen(fileName, TRUE), FALSE, TRUE);
+    struct lineFile *lf = lineFileMmap(fileName, TRUE);
+    struct lineCopy *mapped = NULL, *copy;
+    char *line;
+    int size;
+    while (lineFileNext(lf, &line, &size))
+        {
+	if (line[size-1] != 0 && line[size] != 0)
+	    edgeOk = FALSE;
+	AllocVar(copy);
+	copy->text = cloneMem(line, size);
+	copy->size = size;
+	copy->offset = lineFileTell(lf);
+	copy->lineIx = lf->lineIx;
+	slAddHead(&mapped, copy);
+	}
+    lineFileClose(&lf);
+    slReverse(&mapped);
+    if (!sameLines(expected, mapped))
+        edgeOk = FALSE;
+    lineCopyFreeList(&expected);
+    lineCopyFreeList(&mapped);
+    }
+remove(fileName);
+
+testReport(f, "next", nextOk);
+testReport(f, "zTerm", zTermOk);
+testReport(f, "carefulNewlines", carefulOk);
+testReport(f, "pageEdges", edgeOk);
+testReport(f, "seek", seekOk);
+testReport(f, "chunks", chunkOk);
+carefulClose(&f);
+}
+
+struct benchCount
+/* Totals from reading a file in the benchmark. */
+    {
+    long long lines;	/* Number of lines. */
+    long long fields;	/* Number of tab separated fields. */
+    };
+
+static void countLines(struct lineFile *lf, struct benchCount *count)
+/* Count lines and fields in rest of lf, which need not be zero terminated. */
+{
+char *line;
+int size;
+while (lineFileNext(lf, &line, &size))
+    {
+    count->lines += 1;
+    count->fields += 1;
+    char *end = line + size, *tab = line;
+    while ((tab = memchr(tab, '\t', end - tab)) != NULL)
+        {
+	count->fields += 1;
+	tab += 1;
+	}
+    }
+}
+
+static void countChunk(struct lineFileChunk *chunk, void *context)
+/* Count lines and fields of chunk into chunk->val. */
+{
+struct benchCount *count;
+AllocVar(count);
+countLines(chunk->lf, count);
+chunk->val = count;
+}
+
+static void lineFileMmapBench(char *outFile, int lineCount, int threads)
+/* Time counting the fields of a file of lineCount lines with lineFileOpen, with
+ * lineFileMmap with and without zTerm, and with lineFileMmap chunks in parallel. */
+{
+char fileName[PATH_LEN];
+safef(fileName, sizeof(fileName), "%s.txt", outFile);
+writeLines(fileName, lineCount, "\n", TRUE);
+long times[4];
+struct benchCount counts[4];
+zeroBytes(counts, sizeof(counts));
+
+long startTime = clock1000();
+struct lineFile *lf = lineFileOpen(fileName, TRUE);
+countLines(lf, &counts[0]);
+lineFileClose(&lf);
+times[0] = clock1000() - startTime;
+
+startTime = clock1000();
+lf = lineFileMmap(fileName, TRUE);
+countLines(lf, &counts[1]);
+lineFileClose(&lf);
+times[1] = clock1000() - startTime;
+
+startTime = clock1000();
+lf = lineFileMmap(fileName, FALSE);
+countLines(lf, &counts[2]);
+lineFileClose(&lf);
+times[2] = clock1000() - startTime;
+
+startTime = clock1000();
+lf = lineFileMmap(fileName, FALSE);
+struct lineFileChunk *chunks = lineFileMmapChunks(lf, threads*4), *chunk;
+lineFileChunkDoList(threads, chunks, countChunk, NULL);
+for (chunk = chunks; chunk != NULL; chunk = chunk->next)
+    {
+    struct benchCount *count = chunk->val;
+    counts[3].lines += count->lines;
+    counts[3].fields += count->fields;
+    freeMem(count);
+    }
+lineFileChunkFreeList(&chunks);
+lineFileClose(&lf);
+times[3] = clock1000() - startTime;
+remove(fileName);
+
+int i;
+for (i=1; i<4; ++i)
+    if (counts[i].lines != counts[0].lines || counts[i].fields != counts[0].fields)
+        errAbort("Reading %s different ways gave different counts", fileName);
+FILE *f = mustOpen(outFile, "w");
+fprintf(f, "%d lines, times in milliseconds\n", lineCount);
+fprintf(f, "lineFileOpen\t%ld\n", times[0]);
+fprintf(f, "lineFileMmap\t%ld\n", times[1]);
+fprintf(f, "lineFileMmap without zTerm\t%ld\n", times[2]);
+fprintf(f, "chunks in %d threads without zTerm\t%ld\n", threads, times[3]);
+carefulClose(&f);
+}
+
+int main(int argc, char *argv[])
+/* Process command line. */
+{
+optionInit(&argc, argv, options);
+if (argc != 2)
+    usage();
+int benchCount = optionInt("bench", 0);
+if (benchCount > 0)
+    lineFileMmapBench(argv[1], benchCount, optionInt("threads", 4));
+else
+    lineFileMmapTest(argv[1]);
+return 0;
+}
@@ -0,0 +1,247 @@
+/* openHashTest - Check openHash gives the same answers as struct hash, and optionally
+ * time the two against each other. */
+
+/* Copyright (C) 2026 The Regents of the University of California
+ * See kent/LICENSE or http://genome.ucsc.edu/license/ for licensing information. */
+
+#include "common.h"
+#include "options.h"
+#include "obscure.h"
+#include "portable.h"
+#include "memalloc.h"
+#include "hash.h"
+#include "openHash.h"
+#include "testUtil.h"
+
+void usage()
+/* Explain usage and exit. */
+{
+errAbort(
+  "openHashTest - Check openHash gives the same answers as struct hash, and optionally\n"
+  "time the two against each other.\n"
+  "usage:\n"
+  "  openHashTest out.txt\n"
+  "Writes a line for each operation tested saying whether the answers matched.\n"
+  "options:\n"
+  "  -bench=N - instead of testing, time adding and finding N names in a struct hash\n"
+  "             and an openHash, and write times and memory used to out.txt\n"
+  );
+}
+
+static struct optionSpec options[] = {
+    {"bench", OPTION_INT},
+    {NULL, 0},
+};
+
+static void makeName(int id, char *buf, int bufSize)
+/* Make a name that looks like an accession or read name from id. */
+{
+if (id % 3 == 0)
+    safef(buf, bufSize, "NM_%06d.%d", id, id % 7);
+else if (id % 3 == 1)
+    safef(buf, bufSize, "SRR%d.%d/1", id / 100, id);
+else
+    safef(buf, bufSize, "%d", id);
+}
+
+static boolean sameContents(struct openHash *oh, struct hash *hash)
+/* Return TRUE if traversing oh finds the same names and values as hash has. */
+{
+if (oh->elCount != hash->elCount)
+    return FALSE;
+struct openHashCookie cookie = openHashFirst(oh);
+struct openHashEl *el;
+int count = 0;
+while ((el = openHashNext(&cookie)) != NULL)
+    {
+    struct hashEl *hel = hashLookup(hash, el->name);
+    if (hel == NULL || hel->val != el->val)
+        return FALSE;
+    ++count;
+    }
+return count == hash->elCount;
+}
+
+static void openHashTest(char *outFile)
+/* Do random adds, removes and lookups on an openHash and a struct hash and compare. */
+{
+FILE *f = mustOpen(outFile, "w");
+boolean addOk = TRUE, findOk = TRUE, removeOk = TRUE, traverseOk = TRUE, storeOk = TRUE,
+	incOk = TRUE;
+int round;
+for (round = 0; round < 4; ++round)
+    {
+    struct openHash *oh = openHashNew(round == 0 ? 1 : 0);
+    struct hash *hash = hashNew(0);
+    int idRange = 1000 << (2*round), ops = idRange * 4, i;
+    char name[64];
+    for (i=0; i<ops; ++i)
+        {
+	int id = testRandomInt(idRange);
+	makeName(id, name, sizeof(name));
+	int op = testRandom() % 10;
+	if (op < 5)
+	    {
+	    void *val = intToPt(i+1);
+	    struct openHashEl *el = openHashAdd(oh, name, val);
+	    if (!sameString(el->name, name) || el->val != val)
+	        addOk = FALSE;
+	    hashRemove(hash, name);
+	    hashAdd(hash, name, val);
+	    }
+	else if (op < 7)
+	    {
+	    if (openHashRemove(oh, name) != hashRemove(hash, name))
+	        removeOk = FALSE;
+	    }
+	else
+	    {
+	    if (openHashFindVal(oh, name) != hashFindVal(hash, name))
+	        findOk = FALSE;
+	    if ((openHashLookup(oh, name) == NULL) != (hashLookup(hash, name) == NULL))
+	        findOk = FALSE;
+	    }
+	}
+    if (!sameContents(oh, hash))
+        traverseOk = FALSE;
+    freeHash(&hash);
+    openHashFree(&oh);
+    }
+
+/* Stored names should be shared, and counts should add up. */
+struct openHash *oh = openHashNew(0);
+char *a = openHashStoreName(oh, "chr1");
+char *b = openHashStoreName(oh, "chr1");
+if (a != b || !sameString(a, "chr1") || oh->elCount != 1)
+    storeOk = FALSE;
+int i;
+for (i=0; i<100; ++i)
+    openHashIncInt(oh, (i % 2 ? "odd" : "even"));
+if (ptToInt(openHashFindVal(oh, "odd")) != 50 || openHashIncInt(oh, "even") != 51)
+    incOk = FALSE;
+openHashFree(&oh);
+
+testReport(f, "add", addOk);
+testReport(f, "find", findOk);
+testReport(f, "remove", removeOk);
+testReport(f, "traverse", traverseOk);
+testReport(f, "storeName", storeOk);
+testReport(f, "incInt", incOk);
+carefulClose(&f);
+}
+
+static void openHashBench(char *outFile, int count)
+/* Time adding count names to a struct hash and an openHash, then finding each of
+ * them and as many names that aren't there.  Then measure memory used by each. */
+{
+FILE *f = mustOpen(outFile, "w");
+char **names, **missing;
+AllocArray(names, count);
+AllocArray(missing, count);
+int i;
+for (i=0; i<count; ++i)
+    {
+    char name[64];
+    makeName(2*i, name, sizeof(name));
+    names[i] = cloneString(name);
+    makeName(2*i+1, name, sizeof(name));
+    missing[i] = cloneString(name);
+    }
+/* Look names up in a different order than they were added, so that neither
+ * hash gets help from names being next to each other in memory. */
+char **lookups;
+AllocArray(lookups, count);
+for (i=0; i<count; ++i)
+    lookups[i] = names[i];
+for (i=count-1; i>0; --i)
+    {
+    int j = testRandomInt(i+1);
+    char *swap = lookups[i];
+    lookups[i] = lookups[j];
+    lookups[j] = swap;
+    j = testRandomInt(i+1);
+    swap = missing[i];
+    missing[i] = missing[j];
+    missing[j] = swap;
+    }
+long hashTimes[3], openTimes[3];
+long long found = 0;
+
+long startTime = clock1000();
+struct hash *hash = hashNew(0);
+for (i=0; i<count; ++i)
+    hashAdd(hash, names[i], names[i]);
+hashTimes[0] = clock1000() - startTime;
+startTime = clock1000();
+for (i=0; i<count; ++i)
+    found += (hashFindVal(hash, lookups[i]) != NULL);
+hashTimes[1] = clock1000() - startTime;
+startTime = clock1000();
+for (i=0; i<count; ++i)
+    found += (hashFindVal(hash, missing[i]) != NULL);
+hashTimes[2] = clock1000() - startTime;
+freeHash(&hash);
+
+startTime = clock1000();
+struct openHash *oh = openHashNew(0);
+for (i=0; i<count; ++i)
+    openHashAdd(oh, names[i], names[i]);
+openTimes[0] = clock1000() - startTime;
+startTime = clock1000();
+for (i=0; i<count; ++i)
+    found -= (openHashFindVal(oh, lookups[i]) != NULL);
+openTimes[1] = clock1000() - startTime;
+startTime = clock1000();
+for (i=0; i<count; ++i)
+    found -= (openHashFindVal(oh, missing[i]) != NULL);
+openTimes[2] = clock1000() - startTime;
+openHashFree(&oh);
+if (found != 0)
+    errAbort("struct hash and openHash found different numbers of names");
+
+/* Measure memory with the careful allocator, which is too slow to time with. */
+pushCarefulMemHandler(16LL*1024*1024*1024);
+size_t baseMem = carefulTotalAllocated();
+hash = hashNew(0);
+for (i=0; i<count; ++i)
+    hashAdd(hash, names[i], names[i]);
+size_t hashMem = carefulTotalAllocated() - baseMem;
+freeHash(&hash);
+baseMem = carefulTotalAllocated();
+oh = openHashNew(0);
+for (i=0; i<count; ++i)
+    openHashAdd(oh, names[i], names[i]);
+size_t openMem = carefulTotalAllocated() - baseMem;
+openHashFree(&oh);
+popMemHandler();
+
+fprintf(f, "%d names, times in milliseconds\n", count);
+fprintf(f, "operation\tstructHash\topenHash\n");
+fprintf(f, "add\t%ld\t%ld\n", hashTimes[0], openTimes[0]);
+fprintf(f, "findPresent\t%ld\t%ld\n", hashTimes[1], openTimes[1]);
+fprintf(f, "findMissing\t%ld\t%ld\n", hashTimes[2], openTimes[2]);
+fprintf(f, "megabytes\t%0.1f\t%0.1f\n", hashMem/(1024.0*1024), openMem/(1024.0*1024));
+carefulClose(&f);
+for (i=0; i<count; ++i)
+    {
+    freeMem(names[i]);
+    freeMem(missing[i]);
+    }
+freeMem(names);
+freeMem(missing);
+freeMem(lookups);
+}
+
+int main(int argc, char *argv[])
+/* Process command line. */
+{
+optionInit(&argc, argv, options);
+if (argc != 2)
+    usage();
+int benchCount = optionInt("bench", 0);
+if (benchCount > 0)
+    openHashBench(argv[1], benchCount);
+else
+    openHashTest(argv[1]);
+return 0;
+}
@@ -0,0 +1,236 @@
+/* rangeIndexTest - Check rangeIndex queries give the same answers as rangeTree and a
+ * simple scan, and optionally time the two against each other. */
+
+/* Copyright (C) 2026 The Regents of the University of California
+ * See kent/LICENSE or http://genome.ucsc.edu/license/ for licensing information. */
+
+#include "common.h"
+#include "options.h"
+#include "portable.h"
+#include "rangeTree.h"
+#include "rangeIndex.h"
+#include "testUtil.h"
+
+void usage()
+/* Explain usage and exit. */
+{
+errAbort(
+  "rangeIndexTest - Check rangeIndex queries give the same answers as rangeTree and a\n"
+  "simple scan, and optionally time the two against each other.\n"
+  "usage:\n"
+  "  rangeIndexTest out.txt\n"
+  "Writes a line for each query tested saying whether the answers matched.\n"
+  "options:\n"
+  "  -bench=N - instead of testing, time building and querying a rangeTree and a\n"
+  "             rangeIndex of N ranges and write the times to out.txt\n"
+  );
+}
+
+static struct optionSpec options[] = {
+    {"bench", OPTION_INT},
+    {NULL, 0},
+};
+
+struct testRange
+/* A range added to both structures. */
+    {
+    int start, end;
+    };
+
+static struct testRange *randomRanges(int count, int seqSize, int maxSize)
+/* Return array of count random ranges. */
+{
+struct testRange *ranges;
+AllocArray(ranges, count+1);	/* Plus one since AllocArray can't do zero. */
+int i;
+for (i=0; i<count; ++i)
+    {
+    ranges[i].start = testRandomInt(seqSize);
+    ranges[i].end = ranges[i].start + testRandomInt(maxSize);
+    }
+return ranges;
+}
+
+static boolean allOverlappingMatches(struct rangeIndex *ri, struct testRange *ranges,
+	int count, int start, int end)
+/* Return TRUE if rangeIndexAllOverlapping finds the same ranges, in order of start,
+ * as a scan of the ranges added. */
+{
+struct range *list = rangeIndexAllOverlapping(ri, start, end), *range;
+int i, found = 0, prevStart = -1;
+for (range = list; range != NULL; range = range->next)
+    {
+    if (range->start < prevStart || !(range->start < end && start < range->end))
+        return FALSE;
+    struct testRange *added = range->val;
+    if (added->start != range->start || added->end != range->end)
+        return FALSE;
+    prevStart = range->start;
+    ++found;
+    }
+for (i=0; i<count; ++i)
+    if (ranges[i].start < end && start < ranges[i].end)
+        --found;
+return found == 0;
+}
+
+static void rangeIndexTest(char *outFile)
+/* Compare rangeIndex and rangeTree on sets of random ranges of many sizes. */
+{
+FILE *f = mustOpen(outFile, "w");
+boolean overlapsOk = TRUE, overlapSizeOk = TRUE, allOk = TRUE, maxOk = TRUE, treeOk = TRUE;
+int count;
+for (count = 0; count < 600; count += 1 + count/8)
+    {
+    int seqSize = 10 + count * 20, maxSize = 1 + count % 300;
+    struct testRange *ranges = randomRanges(count, seqSize, maxSize);
+    struct rbTree *tree = rangeTreeNew();
+    struct rangeIndex *ri = rangeIndexNew();
+    int i;
+    for (i=0; i<count; ++i)
+        {
+	rangeTreeAdd(tree, ranges[i].start, ranges[i].end);
+	rangeIndexAdd(ri, ranges[i].start, ranges[i].end, &ranges[i]);
+	}
+    for (i=0; i<200; ++i)
+        {
+	int start = testRandomInt(seqSize + maxSize) - maxSize/2;
+	int end = start + testRandomInt(maxSize * 2);
+	if (rangeIndexOverlaps(ri, start, end) != rangeTreeOverlaps(tree, start, end))
+	    overlapsOk = FALSE;
+	if (rangeIndexOverlapSize(ri, start, end) != rangeTreeOverlapSize(tree, start, end))
+	    overlapSizeOk = FALSE;
+	if (!allOverlappingMatches(ri, ranges, count, start, end))
+	    allOk = FALSE;
+	struct range *best = rangeIndexMaxOverlapping(ri, start, end);
+	int bestOverlap = (best == NULL ? 0 : rangeIntersection(best->start, best->end, start, end));
+	int j;
+	for (j=0; j<count; ++j)
+	    if (rangeIntersection(ranges[j].start, ranges[j].end, start, end) > bestOverlap)
+	        maxOk = FALSE;
+	}
+
+    /* An index of the merged ranges in the tree should agree with the tree. */
+    struct rangeIndex *merged = rangeIndexNew();
+    rangeIndexAddTree(merged, tree);
+    struct range *list = rangeTreeList(tree);
+    if (merged->count != slCount(list))
+        treeOk = FALSE;
+    for (i=0; i<100; ++i)
+        {
+	int start = testRandomInt(seqSize), end = start + testRandomInt(maxSize * 2);
+	if (rangeIndexOverlapSize(merged, start, end) != rangeTreeOverlapSize(tree, start, end))
+	    treeOk = FALSE;
+	}
+    rangeIndexFree(&merged);
+    rangeIndexFree(&ri);
+    rangeTreeFree(&tree);
+    freeMem(ranges);
+    }
+testReport(f, "overlaps", overlapsOk);
+testReport(f, "overlapSize", overlapSizeOk);
+testReport(f, "allOverlapping", allOk);
+testReport(f, "maxOverlapping", maxOk);
+testReport(f, "addTree", treeOk);
+carefulClose(&f);
+}
+
+#define benchOps 4	/* Number of operations timed. */
+static char *benchOpNames[benchOps] = {"build", "overlaps", "overlapSize", "allOverlapping"};
+
+static void benchIndex(struct rangeIndex *ri, struct testRange *queries, int queryCount,
+	long times[benchOps], long long totals[benchOps])
+/* Time queries on index, filling in all times and totals but the build ones. */
+{
+int i;
+long startTime = clock1000();
+for (i=0, totals[1]=0; i<queryCount; ++i)
+    totals[1] += rangeIndexOverlaps(ri, queries[i].start, queries[i].end);
+times[1] = clock1000() - startTime;
+startTime = clock1000();
+for (i=0, totals[2]=0; i<queryCount; ++i)
+    totals[2] += rangeIndexOverlapSize(ri, queries[i].start, queries[i].end);
+times[2] = clock1000() - startTime;
+startTime = clock1000();
+for (i=0, totals[3]=0; i<queryCount; ++i)
+    totals[3] += slCount(rangeIndexAllOverlapping(ri, queries[i].start, queries[i].end));
+times[3] = clock1000() - startTime;
+}
+
+static void rangeIndexBench(char *outFile, int count)
+/* Time rangeTree and rangeIndex building and queries on count random ranges
+ * spread over a chromosome sized sequence.  The rangeTree merges overlapping
+ * ranges, so an index of the merged ranges is timed as well as one of all of them. */
+{
+FILE *f = mustOpen(outFile, "w");
+int seqSize = 250000000, maxSize = 5000, queryCount = 1000000;
+struct testRange *ranges = randomRanges(count, seqSize, maxSize);
+struct testRange *queries = randomRanges(queryCount, seqSize, maxSize);
+long treeTimes[benchOps], mergedTimes[benchOps], allTimes[benchOps];
+long long treeTotals[benchOps], mergedTotals[benchOps], allTotals[benchOps];
+int i;
+
+long startTime = clock1000();
+struct rbTree *tree = rangeTreeNew();
+for (i=0; i<count; ++i)
+    rangeTreeAdd(tree, ranges[i].start, ranges[i].end);
+treeTimes[0] = clock1000() - startTime;
+startTime = clock1000();
+for (i=0, treeTotals[1]=0; i<queryCount; ++i)
+    treeTotals[1] += rangeTreeOverlaps(tree, queries[i].start, queries[i].end);
+treeTimes[1] = clock1000() - startTime;
+startTime = clock1000();
+for (i=0, treeTotals[2]=0; i<queryCount; ++i)
+    treeTotals[2] += rangeTreeOverlapSize(tree, queries[i].start, queries[i].end);
+treeTimes[2] = clock1000() - startTime;
+startTime = clock1000();
+for (i=0, treeTotals[3]=0; i<queryCount; ++i)
+    treeTotals[3] += slCount(rangeTreeAllOverlapping(tree, queries[i].start, queries[i].end));
+treeTimes[3] = clock1000() - startTime;
+
+startTime = clock1000();
+struct rangeIndex *merged = rangeIndexNew();
+rangeIndexAddTree(merged, tree);
+rangeIndexBuild(merged);
+mergedTimes[0] = clock1000() - startTime;
+benchIndex(merged, queries, queryCount, mergedTimes, mergedTotals);
+
+startTime = clock1000();
+struct rangeIndex *all = rangeIndexNew();
+for (i=0; i<count; ++i)
+    rangeIndexAdd(all, ranges[i].start, ranges[i].end, NULL);
+rangeIndexBuild(all);
+allTimes[0] = clock1000() - startTime;
+benchIndex(all, queries, queryCount, allTimes, allTotals);
+
+for (i=1; i<benchOps; ++i)
+    {
+    if (mergedTotals[i] != treeTotals[i] || (i < 3 && allTotals[i] != treeTotals[i]))
+        errAbort("rangeTree and rangeIndex disagree on %s", benchOpNames[i]);
+    }
+fprintf(f, "%d ranges, %d merged, %d queries, times in milliseconds\n",
+	count, merged->count, queryCount);
+fprintf(f, "operation\trangeTree\tmergedIndex\tallIndex\n");
+for (i=0; i<benchOps; ++i)
+    fprintf(f, "%s\t%ld\t%ld\t%ld\n", benchOpNames[i], treeTimes[i], mergedTimes[i], allTimes[i]);
+carefulClose(&f);
+rangeIndexFree(&all);
+rangeIndexFree(&merged);
+rangeTreeFree(&tree);
+freeMem(queries);
+freeMem(ranges);
+}
+
+int main(int argc, char *argv[])
+/* Process command line. */
+{
+optionInit(&argc, argv, options);
+if (argc != 2)
+    usage();
+int benchCount = optionInt("bench", 0);
+if (benchCount > 0)
+    rangeIndexBench(argv[1], benchCount);
+else
+    rangeIndexTest(argv[1]);
+return 0;
+}
@@ -0,0 +1,176 @@
+/* saisTest - Check suffix arrays from saisMake against a simple sort on various texts. */
+
+/* Copyright (C) 2026 The Regents of the University of California
+ * See kent/LICENSE or http://genome.ucsc.edu/license/ for licensing information. */
+
+#include "common.h"
+#include "options.h"
+#include "sais.h"
+#include "testUtil.h"
+
+void usage()
+/* Explain usage and exit. */
+{
+errAbort(
+  "saisTest - Check suffix arrays from saisMake against a simple sort on various texts.\n"
+  "usage:\n"
+  "  saisTest out.txt\n"
+  "Writes a line for each text tested saying whether the suffix array was right.\n"
+  );
+}
+
+static struct optionSpec options[] = {
+    {NULL, 0},
+};
+
+static UBYTE *globalText;
+static bits64 globalSize;
+
+static int cmpSuffix(const void *va, const void *vb)
+/* Compare two suffixes of globalText as unsigned bytes, shorter first if one is a
+ * prefix of the other. */
+{
+bits32 a = *((bits32 *)va);
+bits32 b = *((bits32 *)vb);
+bits64 aLeft = globalSize - a, bLeft = globalSize - b;
+bits64 minLeft = min(aLeft, bLeft);
+int diff = memcmp(globalText + a, globalText + b, minLeft);
+if (diff != 0)
+    return diff;
+if (aLeft < bLeft)
+    return -1;
+return (aLeft > bLeft);
+}
+
+static boolean saMatchesSort(UBYTE *text, bits64 size)
+/* Return TRUE if saisMake agrees with qsort on text. */
+{
+bits32 *sa, *expected;
+AllocArray(sa, size+1);
+AllocArray(expected, size+1);
+saisMake(text, size, sa);
+bits64 i;
+expected[0] = size;
+for (i=0; i<size; ++i)
+    expected[i+1] = i;
+globalText = text;
+globalSize = size;
+qsort(expected+1, size, sizeof(expected[0]), cmpSuffix);
+boolean same = (memcmp(sa, expected, (size+1)*sizeof(sa[0])) == 0);
+freeMem(sa);
+freeMem(expected);
+return same;
+}
+
+static boolean dnaIndexMatchesSort(char *dna, bits64 size, int minSize, int nFreeSize)
+/* Return TRUE if saisDnaIndex agrees with sorting the suffixes it should keep. */
+{
+bits32 *sa, *expected;
+AllocArray(sa, size+1);
+AllocArray(expected, size+1);
+bits64 count = saisDnaIndex(dna, size, minSize, nFreeSize, sa);
+bits64 i, expectedCount = 0;
+for (i=0; i<size; ++i)
+    {
+    int j;
+    boolean keep = TRUE;
+    for (j=0; j<minSize && keep; ++j)
+        if (i+j >= size || dna[i+j] == 0)
+	    keep = FALSE;
+    for (j=0; j<nFreeSize && keep; ++j)
+        if (i+j < size && dna[i+j] == 'N')
+	    keep = FALSE;
+    if (keep)
+        expected[expectedCount++] = i;
+    }
+globalText = (UBYTE *)dna;
+globalSize = size;
+qsort(expected, expectedCount, sizeof(expected[0]), cmpSuffix);
+boolean same = (count == expectedCount
+	&& memcmp(sa, expected, count*sizeof(sa[0])) == 0);
+freeMem(sa);
+freeMem(expected);
+return same;
+}
+
+static void randomText(UBYTE *text, bits64 size, char *alphabet)
+/* Fill text with random letters from alphabet mixed with zeroes. */
+{
+int alphaSize = strlen(alphabet) + 1;
+bits64 i;
+for (i=0; i<size; ++i)
+    text[i] = alphabet[testRandom() % alphaSize];
+}
+
+static void report(FILE *f, char *name, bits64 size, boolean ok)
+/* Write one line of output. */
+{
+fprintf(f, "%s\t%lld\t%s\n", name, size, (ok ? "ok" : "WRONG"));
+}
+
+void saisTest(char *outFile)
+/* saisTest - Check suffix arrays from saisMake against a simple sort on various texts. */
+{
+FILE *f = mustOpen(outFile, "w");
+int maxSize = 20000;
+UBYTE *text = needMem(maxSize);
+bits64 size;
+
+/* Every small size with random DNA including separators. */
+boolean allOk = TRUE;
+for (size=0; size<=64; ++size)
+    {
+    randomText(text, size, "ACGTN");
+    allOk &= saMatchesSort(text, size);
+    }
+report(f, "randomSmall", 64, allOk);
+
+/* Random bytes. */
+for (size=0; size<maxSize; ++size)
+    text[size] = testRandom();
+report(f, "randomBytes", maxSize, saMatchesSort(text, maxSize));
+
+/* A single repeated letter, the worst case for prefix bucketing. */
+memset(text, 'A', maxSize);
+report(f, "allA", maxSize, saMatchesSort(text, maxSize));
+
+/* Short tandem repeat. */
+for (size=0; size<maxSize; ++size)
+    text[size] = "CAG"[size%3];
+report(f, "tandemCAG", maxSize, saMatchesSort(text, maxSize));
+
+/* Long repeats with a few differences, like a genome full of segmental duplications. */
+randomText(text, 1000, "ACGT");
+for (size=1000; size<maxSize; ++size)
+    text[size] = text[size%1000];
+for (size=0; size<20; ++size)
+    text[testRandom() % maxSize] = "ACGT"[testRandom()%4];
+report(f, "segDups", maxSize, saMatchesSort(text, maxSize));
+
+/* Sequences separated by zeroes with N runs, indexed the ways the tools do. */
+for (size=0; size<maxSize; ++size)
+    {
+    if (size % 2500 == 0)
+	text[size] = 0;
+    else if (size % 1700 < 40)
+        text[size] = 'N';
+    else
+        text[size] = "ACGT"[testRandom()%4];
+    }
+text[maxSize-1] = 0;
+report(f, "dnaIndex17", maxSize, dnaIndexMatchesSort((char *)text, maxSize, 13, 17));
+report(f, "dnaIndex16", maxSize, dnaIndexMatchesSort((char *)text, maxSize, 12, 16));
+report(f, "dnaIndex24", maxSize, dnaIndexMatchesSort((char *)text, maxSize, 24, 24));
+freeMem(text);
+carefulClose(&f);
+}
+
+int main(int argc, char *argv[])
+/* Process command line. */
+{
+optionInit(&argc, argv, options);
+if (argc != 2)
+    usage();
+saisTest(argv[1]);
+return 0;
+}
@@ -0,0 +1,29 @@
+/* testUtil - Helpers shared by the library tests here. */
+
+/* Copyright (C) 2026 The Regents of the University of California
+ * See kent/LICENSE or http://genome.ucsc.edu/license/ for licensing information. */
+
+#include "common.h"
+#include "testUtil.h"
+
+static bits32 seed = 12345;
+
+bits32 testRandom()
+/* Return next value, from 0 to 32767, from a small deterministic random number
+ * generator so that test input is the same everywhere. */
+{
+seed = seed * 1103515245 + 12345;
+return (seed >> 16) & 0x7FFF;
+}
+
+int testRandomInt(int size)
+/* Return random number from 0 to size-1, size may be bigger than 32k. */
+{
+return ((testRandom() << 15) | testRandom()) % size;
+}
+
+void testReport(FILE *f, char *name, boolean ok)
+/* Write a line with name and ok or WRONG to f. */
+{
+fprintf(f, "%s\t%s\n", name, (ok ? "ok" : "WRONG"));
+}
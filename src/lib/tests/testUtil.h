@@ -0,0 +1,19 @@
+/* testUtil - Helpers shared by the library tests here. */
+
+/* Copyright (C) 2026 The Regents of the University of California
+ * See kent/LICENSE or http://genome.ucsc.edu/license/ for licensing information. */
+
+#ifndef TESTUTIL_H
+#define TESTUTIL_H
+
+bits32 testRandom();
+/* Return next value, from 0 to 32767, from a small deterministic random number
+ * generator so that test input is the same everywhere. */
+
+int testRandomInt(int size);
+/* Return random number from 0 to size-1, size may be bigger than 32k. */
+
+void testReport(FILE *f, char *name, boolean ok);
+/* Write a line with name and ok or WRONG to f. */
+
+#endif /* TESTUTIL_H */
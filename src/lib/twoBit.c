@@ -15,6 +15,9 @@
 #include "net.h"
 #include "portable.h"
 #include <limits.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 /* following are the wrap functions for the UDC and stdio functoins
  * that read twoBit files.   All of these are to get around the C compiler
@@ -132,106 +135,73 @@ else
     }
 }
 
-static int countBlocksOfN(char *s, int size)
-/* Count number of blocks of N's (or n's) in s. */
+static bits32 blockMask(char *s, int n, boolean isLower)
+/* Return mask with bit i set if s[i] is an N (or n), or a lower case letter
+ * if isLower, for the first n characters of s.  n must be 16 or less. */
 {
+bits32 mask = 0;
 int i;
-boolean isN, lastIsN = FALSE;
-char c;
-int blockCount = 0;
-
-for (i=0; i<size; ++i)
+#ifdef __SSE2__
+if (n == 16)
     {
-    c = s[i];
-    isN = (c == 'n' || c == 'N');
-    if (isN && !lastIsN)
-	++blockCount;
-    lastIsN = isN;
+    __m128i x = _mm_loadu_si128((__m128i *)s), in;
+    if (isLower)
+        in = _mm_and_si128(_mm_cmpgt_epi8(x, _mm_set1_epi8('a'-1)),
+			   _mm_cmplt_epi8(x, _mm_set1_epi8('z'+1)));
+    else
+        in = _mm_cmpeq_epi8(_mm_or_si128(x, _mm_set1_epi8(0x20)), _mm_set1_epi8('n'));
+    return _mm_movemask_epi8(in);
     }
-return blockCount;
-}
-
-static int countBlocksOfLower(char *s, int size)
-/* Count number of blocks of lower case letters. */
-{
-int i;
-boolean isLower, lastIsLower = FALSE;
-int blockCount = 0;
-
-for (i=0; i<size; ++i)
+#endif /* __SSE2__ */
+for (i=0; i<n; ++i)
     {
-    isLower = islower(s[i]);
-    if (isLower && !lastIsLower)
-	++blockCount;
-    lastIsLower = isLower;
+    char c = s[i];
+    if (isLower ? islower(c) : (c == 'n' || c == 'N'))
+        mask |= (1U << i);
     }
-return blockCount;
+return mask;
 }
 
-static void storeBlocksOfN(char *s, int size, bits32 *starts, bits32 *sizes)
-/* Store starts and sizes of blocks of N's. */
+static int findBlocks(char *s, int size, boolean isLower, bits32 *starts, bits32 *sizes)
+/* Find blocks of N's, or of lower case letters if isLower, in s, 16 characters
+ * at a time.  Return the number of blocks, and if starts is non-NULL store the
+ * start and size of each block in starts and sizes. */
 {
-int i;
-boolean isN, lastIsN = FALSE;
-int startN = 0;
-char c;
-
-for (i=0; i<size; ++i)
+int blockCount = 0, blockStart = 0, i;
+bits32 inBlock = 0;	/* 1 if the character before the current 16 is in a block. */
+for (i=0; i<size; i += 16)
     {
-    c = s[i];
-    isN = (c == 'n' || c == 'N');
-    if (isN)
-        {
-	if (!lastIsN)
-	    startN = i;
-	}
-    else
+    int n = min(16, size - i), bit;
+    bits32 mask = blockMask(s+i, n, isLower);
+    bits32 changes = (mask ^ ((mask << 1) | inBlock)) & ((1U << n) - 1);
+    for (bit = 0; changes != 0; ++bit, changes >>= 1)
         {
-	if (lastIsN)
+	if ((changes & 1) == 0)
+	    continue;
+	if ((mask >> bit) & 1)
+	    blockStart = i + bit;
+	else
 	    {
-	    *starts++ = startN;
-	    *sizes++ = i - startN;
+	    if (starts != NULL)
+	        {
+		starts[blockCount] = blockStart;
+		sizes[blockCount] = i + bit - blockStart;
+		}
+	    ++blockCount;
 	    }
 	}
-    lastIsN = isN;
+    inBlock = (mask >> (n-1)) & 1;
     }
-if (lastIsN)
+if (inBlock)
     {
-    *starts = startN;
-    *sizes = i - startN;
-    }
-}
-
-static void storeBlocksOfLower(char *s, int size, bits32 *starts, bits32 *sizes)
-/* Store starts and sizes of blocks of lower case letters. */
-{
-int i;
-boolean isLower, lastIsLower = FALSE;
-int startLower = 0;
-
-for (i=0; i<size; ++i)
-    {
-    isLower = islower(s[i]);
-    if (isLower)
+    if (starts != NULL)
         {
-	if (!lastIsLower)
-	    startLower = i;
-	}
-    else
-        {
-	if (lastIsLower)
-	    {
-	    *starts++ = startLower;
-	    *sizes++ = i - startLower;
-	    }
+	starts[blockCount] = blockStart;
+	sizes[blockCount] = size - blockStart;
 	}
-    lastIsLower = isLower;
-    }
-if (lastIsLower)
-    {
-    *starts = startLower;
-    *sizes = i - startLower;
+    ++blockCount;
     }
+return blockCount;
 }
 
 static int packedSize(int unpackedSize)
@@ -245,50 +215,37 @@ struct twoBit *twoBitFromDnaSeq(struct dnaSeq *seq, boolean doMask)
  * If doMask is true interpret lower-case letters as masked. */
 {
 int ubyteSize = packedSize(seq->size);
-UBYTE *pt;
 struct twoBit *twoBit;
-DNA last4[4];	/* Holds few bases. */
 DNA *dna;
-int i, end;
 
 /* Allocate structure and fill in name. */
 AllocVar(twoBit);
-pt = AllocArray(twoBit->data, ubyteSize);
+AllocArray(twoBit->data, ubyteSize);
 twoBit->name = cloneString(seq->name);
 twoBit->size = seq->size;
 
 /* Convert to 4-bases per byte representation. */
 dna = seq->dna;
-end = seq->size - 4;
-for (i=0; i<end; i += 4)
-    {
-    *pt++ = packDna4(dna+i);
-    }
-
-/* Take care of conversion of last few bases. */
-last4[0] = last4[1] = last4[2] = last4[3] = 'T';
-memcpy(last4, dna+i, seq->size-i);
-*pt = packDna4(last4);
+packDnaBytes(dna, seq->size, twoBit->data);
 
 /* Deal with blocks of N. */
-twoBit->nBlockCount = countBlocksOfN(dna, seq->size);
+twoBit->nBlockCount = findBlocks(dna, seq->size, FALSE, NULL, NULL);
 if (twoBit->nBlockCount > 0)
     {
     AllocArray(twoBit->nStarts, twoBit->nBlockCount);
     AllocArray(twoBit->nSizes, twoBit->nBlockCount);
-    storeBlocksOfN(dna, seq->size, twoBit->nStarts, twoBit->nSizes);
+    findBlocks(dna, seq->size, FALSE, twoBit->nStarts, twoBit->nSizes);
     }
 
 /* Deal with masking */
 if (doMask)
     {
-    twoBit->maskBlockCount = countBlocksOfLower(dna, seq->size);
+    twoBit->maskBlockCount = findBlocks(dna, seq->size, TRUE, NULL, NULL);
     if (twoBit->maskBlockCount > 0)
         {
 	AllocArray(twoBit->maskStarts, twoBit->maskBlockCount);
 	AllocArray(twoBit->maskSizes, twoBit->maskBlockCount);
-	storeBlocksOfLower(dna, seq->size, 
-		twoBit->maskStarts, twoBit->maskSizes);
+	findBlocks(dna, seq->size, TRUE, twoBit->maskStarts, twoBit->maskSizes);
 	}
     }
 return twoBit;
@@ -824,18 +781,10 @@ else
     /* Handle middle bytes. */
     remainder = fragEnd&3;
     midEnd = fragEnd - remainder;
-    for (i=midStart; i<midEnd; i += 4)
-        {
-	UBYTE b = *packed++;
-	dna[3] = valToNt[b&3];
-	b >>= 2;
-	dna[2] = valToNt[b&3];
-	b >>= 2;
-	dna[1] = valToNt[b&3];
-	b >>= 2;
-	dna[0] = valToNt[b&3];
-	dna += 4;
-	}
+    int midBytes = (midEnd - midStart) >> 2;
+    unpackDna4(packed, midBytes, dna);
+    packed += midBytes;
+    dna += (midBytes << 2);
 
     if (remainder >0)
 	{
@@ -891,35 +891,129 @@ jobDbFree(&db);
 freeHash(&hash);
 }
 
-boolean submitJob(struct job *job)
-/* Attempt to submit job. */
+void addSubmission(struct job *job, char *jobId)
+/* Record that job has been queued by hub under jobId. */
 {
-struct dyString *cmd = dyStringNew(1024);
 struct submission *sub;
-char *jobId = NULL;
+AllocVar(sub);
+slAddHead(&job->submissionList, sub);
+job->submissionCount += 1;
+sub->submitTime = time(NULL);
+sub->host = cloneString("n/a");
+sub->id = cloneString(jobId);
+sub->inQueue = TRUE;
+sub->errFile = cloneString("n/a");
+}
+
+#define maxJobsPerBundle 100	/* Keeps list of job IDs in reply within one message. */
+
+struct jobBundle
+/* Jobs that go to the hub together in a single addJobs message. */
+    {
+    struct dyString *message;	/* Message so far. */
+    int headerSize;		/* Size of message before first job. */
+    struct job *jobs[maxJobsPerBundle];	/* Jobs in message. */
+    int jobCount;		/* Number of jobs in message. */
+    };
+
+struct jobBundle *jobBundleNew()
+/* Make a new empty job bundle. */
+{
+struct jobBundle *bundle;
+AllocVar(bundle);
+bundle->message = dyStringNew(rudpMaxSize);
+dyStringPrintf(bundle->message, "addJobs2 %s %s /dev/null /dev/null %s\n",
+	       getUser(), jobCwd, resultsName);
+bundle->headerSize = bundle->message->stringSize;
+return bundle;
+}
 
-dyStringPrintf(cmd, "addJob2 %s %s /dev/null /dev/null %s %f %lld %s",
-               getUser(), jobCwd, resultsName, job->cpusUsed, job->ramUsed, job->command);
-pmCheckCommandSize(cmd->string, cmd->stringSize);
-jobId = hubSingleLineQuery(cmd->string);
-if (sameString(jobId,"0"))
+void jobBundleFree(struct jobBundle **pBundle)
+/* Free up job bundle. */
+{
+struct jobBundle *bundle = *pBundle;
+if (bundle != NULL)
+    {
+    dyStringFree(&bundle->message);
+    freez(pBundle);
+    }
+}
+
+boolean jobBundleSend(struct jobBundle *bundle)
+/* Send jobs in bundle to hub and record their submissions.  Return FALSE 
+ * if hub refused any of them.  Leaves bundle empty. */
+{
+boolean ok = TRUE;
+if (bundle->jobCount == 0)
+    return ok;
+char *reply = hubSingleLineQuery(bundle->message->string);
+char *s = reply, *jobId;
+int i;
+for (i = 0; i < bundle->jobCount; ++i)
     {
+    jobId = nextWord(&s);
+    if (jobId == NULL || sameString(jobId, "0"))
+	ok = FALSE;
+    else
+	addSubmission(bundle->jobs[i], jobId);
+    }
+if (!ok)
     warn("addJob failed - if batch is bad, correct problem and run para clearSickNodes.");
-    freez(&jobId);
+freez(&reply);
+dyStringResize(bundle->message, bundle->headerSize);
+bundle->jobCount = 0;
+return ok;
+}
+
+void jobInputs(struct job *job, int maxSize, struct dyString *dy)
+/* Append files from job's 'check in' clauses to dy as a comma separated 
+ * list of absolute paths, which the hub uses to place the job where its
+ * inputs already are.  Appends "-" if there are none or they would take
+ * more than maxSize. */
+{
+int start = dy->stringSize;
+struct check *check;
+for (check = job->checkList; check != NULL; check = check->next)
+    {
+    if (!sameWord(check->when, "in") || check->file[0] == 0)
+        continue;
+    if (dy->stringSize > start)
+        dyStringAppendC(dy, ',');
+    if (check->file[0] != '/')
+	dyStringPrintf(dy, "%s/", jobCwd);
+    dyStringAppend(dy, check->file);
     }
-if (jobId != NULL)
+if (dy->stringSize == start || dy->stringSize - start > maxSize)
     {
-    AllocVar(sub);
-    slAddHead(&job->submissionList, sub);
-    job->submissionCount += 1;
-    sub->submitTime = time(NULL);
-    sub->host = cloneString("n/a");
-    sub->id = jobId;
-    sub->inQueue = TRUE;
-    sub->errFile = cloneString("n/a");
+    dyStringResize(dy, start);
+    dyStringAppendC(dy, '-');
     }
-dyStringFree(&cmd);
-return jobId != NULL;
+}
+
+boolean jobBundleAdd(struct jobBundle *bundle, struct job *job)
+/* Add job to bundle, first sending what's already there to the hub if 
+ * the job won't fit.  Return FALSE if hub refused any jobs sent. */
+{
+struct dyString *jobLine = dyStringNew(0);
+int commandSize = strlen(job->command);
+dyStringPrintf(jobLine, "%f %lld ", job->cpusUsed, job->ramUsed);
+jobInputs(job, rudpMaxSize - bundle->headerSize - jobLine->stringSize - commandSize - 2, 
+	jobLine);
+dyStringPrintf(jobLine, " %s\n", job->command);
+if (bundle->jobCount >= maxJobsPerBundle 
+ || bundle->message->stringSize + jobLine->stringSize >= rudpMaxSize)
+    {
+    if (!jobBundleSend(bundle))
+        {
+	dyStringFree(&jobLine);
+	return FALSE;
+	}
+    }
+dyStringAppendN(bundle->message, jobLine->string, jobLine->stringSize);
+pmCheckCommandSize(bundle->message->string, bundle->message->stringSize);
+bundle->jobs[bundle->jobCount++] = job;
+dyStringFree(&jobLine);
+return TRUE;
 }
 
 boolean killJob(char *jobId)
@@ -1226,6 +1320,7 @@ int pushCount = 0, retryCount = 0;
 int tryCount;
 boolean finished = FALSE;
 long time = clock1000();
+struct jobBundle *bundle = jobBundleNew();
 
 queueSize = markQueuedJobs(db);
 
@@ -1240,7 +1335,7 @@ if (!sickBatch)
 	    if (job->submissionCount < tryCount && 
 	       (job->submissionList == NULL || needsRerun(job->submissionList)))
 		{
-		if (!submitJob(job))
+		if (!jobBundleAdd(bundle, job))
 		    {
 		    finished = TRUE;
 		    break;
@@ -1249,6 +1344,11 @@ if (!sickBatch)
 		// occassionalSleep();
 		if (delayTime > 0)
 		    {
+		    if (!jobBundleSend(bundle))
+		        {
+			finished = TRUE;
+			break;
+			}
 		    atomicWriteBatch(db, batch);
 		    sleep(delayTime);
 		    }
@@ -1267,7 +1367,11 @@ if (!sickBatch)
 		    }
 		}
 	    }
+	/* Jobs have to be on the hub before the next try looks at their submissions. */
+	if (!jobBundleSend(bundle))
+	    finished = TRUE;
 	}
+jobBundleFree(&bundle);
 endHappy();
 atomicWriteBatch(db, batch);
 verbose(1, "updated job database on disk\n");
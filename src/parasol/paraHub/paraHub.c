@@ -81,6 +81,8 @@
 #include "internet.h"
 
 
+#ifndef PARASIM	/* paraSim has its own options, usage and main */
+
 /* command line option specifications */
 static struct optionSpec optionSpecs[] = {
     {"spokes", OPTION_INT},
@@ -95,9 +97,13 @@ static struct optionSpec optionSpecs[] = {
     {"noResume", OPTION_BOOLEAN},
     {"ramUnit", OPTION_STRING},
     {"defaultJobRam", OPTION_INT},
+    {"localityWindow", OPTION_INT},
+    {"cachedFiles", OPTION_INT},
     {NULL, 0}
 };
 
+#endif /* PARASIM */
+
 char *version = PARA_VERSION;	/* Version number. */
 
 /* Some command-line configurable quantities and their defaults. */
@@ -106,6 +112,8 @@ int machineCheckPeriod = 20;  /* Minutes between checking dead machines. */
 int assumeDeadPeriod = 60;    /* If haven't heard from job in this long assume
                                  * machine running it is dead. */
 int initialSpokes = 30;		/* Number of spokes to start with. */
+int localityWindow = 64;	/* Queued jobs to look at for inputs cached on machine. */
+int machineCachedFiles = 1000;	/* Input files remembered as cached per machine. */
 struct cidr *hubSubnet = NULL;   /* Subnet to check. */
 struct cidr *localHostSubnet = NULL;
 int nextJobId = 0;		/* Next free job id. */
@@ -116,6 +124,7 @@ int sickNodeThreshold = 3;          /* Treat node as sick if this number of fail
 int sickBatchThreshold = 25;        /* Auto-chill sick batch if this number of continuous failures */
 
 
+#ifndef PARASIM
 
 void usage()
 /* Explain usage and exit. */
@@ -152,11 +161,18 @@ errAbort("paraHub - parasol hub server version %s\n"
          "      e.g. 4g = 4 Gigabytes.\n"
 	 "   -defaultJobRam=N Number of ram units in a job has no specified ram usage.\n"
 	 "      Defaults to 1.\n"
+	 "   -localityWindow=N  Number of queued jobs in a batch to look through for one\n"
+	 "      whose input files are already on a machine - default %d.  0 to disable.\n"
+	 "   -cachedFiles=N  Number of recently used input files to remember per machine\n"
+	 "      - default %d.\n"
 	               ,
-	 version, initialSpokes, jobCheckPeriod, machineCheckPeriod
+	 version, initialSpokes, jobCheckPeriod, machineCheckPeriod,
+	 localityWindow, machineCachedFiles
 	 );
 }
 
+#endif /* PARASIM */
+
 struct spoke *spokeList;	/* List of all spokes. */
 struct dlList *freeSpokes;      /* List of free spokes. */
 struct dlList *busySpokes;	/* List of busy spokes. */
@@ -178,7 +194,8 @@ struct batch *batchList;	/* List of all batches. */
 struct dlList *queuedUsers;	/* Users with jobs in queue. */
 struct dlList *unqueuedUsers;   /* Users with no jobs in queue. */
 
-struct hash *machineHash;	/* Find if machine exists already */
+struct hash *machineHash;	/* Machines keyed by name. */
+struct hash *jobIdHash;		/* Running and waiting jobs keyed by ascii job id. */
 
 struct hash *stringHash;	/* Unique strings throughout system go here
                                  * including directory names and results file
@@ -207,6 +224,7 @@ int defaultJobRam = 1;        /* number of ramUnits in default job usage */
 int maxCpuInCluster = 0;      /* node with largest number of cpu units */
 int maxRamInCluster = 0;      /* node with largest number of ram units */
 struct slRef ***perCpu = NULL;  /* an array of resources sharing the same cpu units free units count */
+bits64 **perCpuBits = NULL;   /* per cpu count, bitmap of ram counts that have machines in perCpu */
 boolean needsPlanning = FALSE;  /* remember if situation changed, need new plan */  
 
 
@@ -228,6 +246,7 @@ deadSpokes = newDlList();
 queuedUsers = newDlList();
 unqueuedUsers = newDlList();
 userHash = newHash(6);
+jobIdHash = newHashExt(16, FALSE);
 }
 
 void lookupIp(char *host, char *ipStr, int ipStrSize)
@@ -395,18 +414,10 @@ for (node = user->curBatches->head; !dlEnd(node); node = node->next)
     }
 }
 
-struct batch *findBatchInList(struct dlList *list,  char *nameString)
-/* Find a batch of jobs in list or return NULL. 
- * nameString must be from stringHash. */
+struct batch *findUserBatch(struct user *user,  char *name)
+/* Find one of user's current or old batches or return NULL. */
 {
-struct dlNode *node;
-for (node = list->head; !dlEnd(node); node = node->next)
-    {
-    struct batch *batch = node->val;
-    if (nameString == batch->name)
-        return batch;
-    }
-return NULL;
+return hashFindVal(user->batchHash, name);
 }
 
 struct batch *newBatch(char *nameString, struct user *user)
@@ -419,6 +430,7 @@ AllocVar(batch->node);
 batch->node->val = batch;
 batch->name = nameString;
 batch->user = user;
+hashAdd(user->batchHash, nameString, batch);
 batch->jobQueue = newDlList();
 batch->priority = NORMAL_PRIORITY;
 batch->maxJob = -1;
@@ -435,21 +447,24 @@ return batch;
 struct batch *findBatch(struct user *user, char *name, boolean holding)
 /* Find batch of jobs.  If no such batch yet make it. */
 {
-struct batch *batch;
-name = hashStoreName(stringHash, name);
-batch = findBatchInList(user->curBatches, name);
-if (batch == NULL)
+struct batch *batch = findUserBatch(user, name);
+if (batch == NULL || !batch->isCurrent)
     {
-    batch = findBatchInList(user->oldBatches, name);
     if (batch != NULL)
 	dlRemove(batch->node);
     else
-	batch = newBatch(name, user);
+	batch = newBatch(hashStoreName(stringHash, name), user);
     if (holding && dlEmpty(batch->jobQueue)) 
         /* setPriority must not release batch if jobs not yet pushed */
+	{
     	dlAddTail(user->oldBatches, batch->node);
+	batch->isCurrent = FALSE;
+	}
     else
+	{
 	dlAddTail(user->curBatches, batch->node);
+	batch->isCurrent = TRUE;
+	}
 
     needsPlanning = TRUE;
 
@@ -476,6 +491,7 @@ if (user == NULL)
     dlAddTail(unqueuedUsers, user->node);
     user->curBatches = newDlList();
     user->oldBatches = newDlList();
+    user->batchHash = newHashExt(8, FALSE);
     user->sickNodes = newHashExt(6, FALSE);
     }
 return user;
@@ -593,10 +609,12 @@ if (dlEmpty(batch->jobQueue))
     batch->queuedCount = 0;
     dlRemove(batch->node);
     dlAddTail(user->oldBatches, batch->node);
+    batch->isCurrent = FALSE;
 
     batch->planCount = 0;   /* use as a signal that it's not active any more */
 
-    needsPlanning = TRUE;  /* remember if situation changed, need new plan */  
+    /* No new plan needed, its machines hand its share to the remaining 
+     * batches as they come up in runNextJob. */
 
     updateUserPriority(user);
     updateUserMaxJob (user);
@@ -696,7 +714,7 @@ user->planScore += cost * user->priority;
 refAdd(&mach->plannedBatches, batch);
 
 /* maxJob handling */
-if ((batch->maxJob!=-1) && (batch->planCount >= batch->maxJob))
+if (batch->planning && (batch->maxJob!=-1) && (batch->planCount >= batch->maxJob))
     {
     /* remove batch from the allocating */
     batch->planning = FALSE;
@@ -705,6 +723,71 @@ if ((batch->maxJob!=-1) && (batch->planCount >= batch->maxJob))
 }
 
 
+void resourceClassAdd(struct slRef *el, int c, int r)
+/* Add machine reference to the resource array at c cpu and r ram units free. */
+{
+slAddHead(&perCpu[c][r], el);
+perCpuBits[c][r>>6] |= (1ULL << (r&63));
+}
+
+int nextResourceClass(bits64 *bits, int r)
+/* Return first ram count >= r that has machines in this cpu row, 
+ * or maxRamInCluster+1 if none.  Lets the planner skip empty classes
+ * a word at a time rather than one ram unit at a time. */
+{
+int words = (maxRamInCluster >> 6) + 1;
+int w = r >> 6;
+if (w >= words)
+    return maxRamInCluster+1;
+bits64 word = bits[w] & (~0ULL << (r&63));
+for (;;)
+    {
+    if (word)
+	return (w << 6) + __builtin_ctzll(word);
+    if (++w >= words)
+	return maxRamInCluster+1;
+    word = bits[w];
+    }
+}
+
+struct slRef *resourceClassExtract(struct batch *batch, int *pC, int *pR)
+/* Find the machine with the fewest cpu then ram units free that can still
+ * fit batch and is not sick for it.  Remove it from the resource array
+ * and return its reference, with its free units in *pC and *pR.  
+ * Returns NULL if no such machine. */
+{
+int c, r;
+for (c = batch->cpu; c <= maxCpuInCluster; ++c)
+    {
+    /* an array of resources sharing the same cpu and ram free units count */
+    struct slRef **perRam = perCpu[c];
+    for (r = nextResourceClass(perCpuBits[c], batch->ram); r <= maxRamInCluster; 
+	r = nextResourceClass(perCpuBits[c], r+1))
+	{
+	/* avoid any machine in the sickNodes */
+	/* extract from list if found */
+	struct slRef **listPt = &perRam[r];
+	struct slRef *el;
+	for (el = perRam[r]; el != NULL; el = el->next)
+	    {
+	    struct machine *mach = el->val;
+	    if (hashIntValDefault(batch->sickNodes, mach->name, 0) < sickNodeThreshold)
+		{
+		*listPt = el->next;
+		el->next = NULL;
+		if (perRam[r] == NULL)
+		    perCpuBits[c][r>>6] &= ~(1ULL << (r&63));
+		*pC = c;
+		*pR = r;
+		return el;
+		}
+	    listPt = &el->next;
+	    }
+	}
+    }
+return NULL;
+}
+
 void plan(struct paraMessage *pm) 
 /* Make a new plan allocating resources to batches */
 {
@@ -732,8 +815,12 @@ if (pm)
 int c = 0, r = 0;
 /*  +1 to allow for zero slot simplifies the code */
 AllocArray(perCpu, maxCpuInCluster+1);  
+AllocArray(perCpuBits, maxCpuInCluster+1);  
 for (c = 1; c <= maxCpuInCluster; ++c)
-  AllocArray(perCpu[c], maxRamInCluster+1);  
+    {
+    AllocArray(perCpu[c], maxRamInCluster+1);  
+    AllocArray(perCpuBits[c], (maxRamInCluster >> 6) + 1);
+    }
 
 //if (pm) pmSendString(pm, rudpOut, "about to add machines resources to cpu/ram arrays");
 
@@ -803,7 +890,7 @@ for (mach = machineList; mach != NULL; mach = mach->next)
 		pmSend(pm, rudpOut);
 		} 
 
-	    refAdd(&perCpu[c][r], mach); 
+	    resourceClassAdd(slRefNew(mach), c, r); 
 	    }
 	}
      }
@@ -834,43 +921,10 @@ while(TRUE)
 	}
      
     /* find machine with adequate resources in resource array (if any) */
-    boolean found = FALSE;
-    struct slRef **perRam = NULL; 
-    struct slRef *el = NULL;
-    for (c = batch->cpu; c <= maxCpuInCluster; ++c)
-	{
-	/* an array of resources sharing the same cpu and ram free units count */
-	perRam = perCpu[c];      
-	for (r = batch->ram; r <= maxRamInCluster; ++r)
-	    {
-	    if (perRam[r])
-		{
-		/* avoid any machine in the sickNodes */
-		/* extract from list if found */
-		el = perRam[r];
-		struct slRef **listPt = &perRam[r];
-		while (el)
-		    {
-		    mach = (struct machine *) el->val;
-		    if (hashIntValDefault(batch->sickNodes, mach->name, 0) < sickNodeThreshold)
-			{
-			found = TRUE;
-			*listPt = el->next;
-			el->next = NULL;
-			break;
-			}
-		    listPt = &el->next;
-		    el = el->next;
-		    }
-		}
-	    if (found)
-		break;  // preserve value of r
-	    }
-	if (found)
-	    break;  // preserve value of c
-	}
-    if (found)
+    struct slRef *el = resourceClassExtract(batch, &c, &r);
+    if (el != NULL)
 	{
+	mach = el->val;
 
 	/* allocate plan, reduce resources, calc new resources and pos.
 	 *   move machine from old array pos to new pos. (slPopHead, slAddHead)
@@ -898,7 +952,7 @@ while(TRUE)
 	if (c < 1 || r < 1)
 	    freeMem(el);  /* this node has insufficient resources remaining */
 	else
-	    slAddHead(&perCpu[c][r], el);
+	    resourceClassAdd(el, c, r);
 
 	}
     else
@@ -929,8 +983,10 @@ for (c = 1; c <= maxCpuInCluster; ++c)
 	slFreeList(&perCpu[c][r]);
 	}
     freeMem(perCpu[c]);
+    freeMem(perCpuBits[c]);
     }
-freeMem(perCpu);
+freez(&perCpu);
+freez(&perCpuBits);
 
 
 /* allocate machines to busy, ready, free lists */
@@ -999,6 +1055,166 @@ logDebug("plan finished");
 }
 
 
+void jobSetInputs(struct job *job, char *inputList)
+/* Set the input files job reads from a comma separated list, or "-" for none. */
+{
+if (inputList == NULL || sameString(inputList, "-"))
+    return;
+int count = chopByChar(inputList, ',', NULL, 0);
+char **words;
+AllocArray(words, count);
+chopByChar(inputList, ',', words, count);
+AllocArray(job->inputs, count);
+int i;
+for (i = 0; i < count; ++i)
+    if (words[i][0] != 0)
+	job->inputs[job->inputCount++] = cloneString(words[i]);
+freeMem(words);
+}
+
+void machineCacheFile(struct machine *mach, char *fileName)
+/* Remember that machine has read fileName recently, forgetting the least
+ * recently used file if it now knows of too many. */
+{
+if (machineCachedFiles <= 0)
+    return;
+if (mach->cachedFiles == NULL)
+    {
+    mach->cachedFiles = newHashExt(8, FALSE);
+    mach->cachedOrder = newDlList();
+    }
+struct dlNode *node = hashFindVal(mach->cachedFiles, fileName);
+if (node != NULL)
+    {
+    dlRemove(node);
+    dlAddTail(mach->cachedOrder, node);
+    return;
+    }
+node = dlAddValTail(mach->cachedOrder, cloneString(fileName));
+hashAdd(mach->cachedFiles, fileName, node);
+if (mach->cachedFiles->elCount > machineCachedFiles)
+    {
+    struct dlNode *oldest = dlPopHead(mach->cachedOrder);
+    hashRemove(mach->cachedFiles, oldest->val);
+    freeMem(oldest->val);
+    freeMem(oldest);
+    }
+}
+
+struct dlNode *pickJobForMachine(struct batch *batch, struct machine *mach)
+/* Pick the queued job near the front of batch with the most input files 
+ * already cached on machine.  Looks at up to localityWindow jobs.  Takes 
+ * the first job if none have inputs there, or if it has already been 
+ * passed over localityWindow times. */
+{
+struct dlNode *node = batch->jobQueue->head, *best = node;
+struct job *first = node->val;
+if (mach->cachedFiles == NULL || localityWindow <= 1 || first->skipCount >= localityWindow)
+    return best;
+int bestScore = 0, i;
+for (i = 0; i < localityWindow && !dlEnd(node); ++i, node = node->next)
+    {
+    struct job *job = node->val;
+    int score = 0, j;
+    for (j = 0; j < job->inputCount; ++j)
+	if (hashLookup(mach->cachedFiles, job->inputs[j]))
+	    ++score;
+    if (score > bestScore)
+	{
+	bestScore = score;
+	best = node;
+	if (score == job->inputCount)
+	    break;
+	}
+    }
+if (best != batch->jobQueue->head)
+    ++first->skipCount;
+return best;
+}
+
+struct batch *findMachineBatch(struct machine *mach, int c, int r)
+/* Find the batch that gets the next c cpu and r ram units free on 
+ * machine between full plans.  Same rule as planning: lowest 
+ * scoring user, then that user's lowest scoring batch. */
+{
+struct batch *minBatch = NULL;
+struct dlNode *uNode, *bNode;
+for (uNode = queuedUsers->head; !dlEnd(uNode); uNode = uNode->next)
+    {
+    struct user *user = uNode->val;
+    if (minBatch != NULL && user->planScore >= minBatch->user->planScore)
+	continue;
+    struct batch *userMin = NULL;
+    for (bNode = user->curBatches->head; !dlEnd(bNode); bNode = bNode->next)
+	{
+	struct batch *batch = bNode->val;
+	if (batch->queuedCount == 0)
+	    continue;
+	if (batch->maxJob != -1 && batch->planCount >= batch->maxJob)
+	    continue;
+	if (batch->cpu > c || batch->ram > r)
+	    continue;
+	if (hashIntValDefault(batch->sickNodes, mach->name, 0) >= sickNodeThreshold)
+	    continue;
+	if (userMin == NULL || batch->planScore < userMin->planScore)
+	    userMin = batch;
+	}
+    if (userMin != NULL)
+	minBatch = userMin;
+    }
+return minBatch;
+}
+
+void planMachine(struct machine *mach)
+/* Allocate whatever resources machine has that are neither running 
+ * jobs nor already planned, leaving the rest of the plan alone.
+ * Cheap compared to a full plan, so used when a machine joins or
+ * comes back, and when batches planned on it run dry.  Does nothing
+ * if a full plan is already due. */
+{
+if (needsPlanning || mach->isDead)
+    return;
+int c = 0, r = 0;
+readRemainingMachineResources(mach, &c, &r);
+struct slRef *el;
+for (el = mach->plannedBatches; el != NULL; el = el->next)
+    {
+    struct batch *batch = el->val;
+    c -= batch->cpu;
+    r -= batch->ram;
+    }
+while (c >= 1 && r >= 1)
+    {
+    struct batch *batch = findMachineBatch(mach, c, r);
+    if (batch == NULL)
+	break;
+    allocateResourcesToMachine(mach, batch, batch->user, &c, &r);
+    }
+}
+
+boolean pruneDrainedBatches(struct machine *mach)
+/* Remove batches with nothing left queued from machine's plan.
+ * Returns TRUE if any were removed. */
+{
+boolean pruned = FALSE;
+struct slRef *el, *next, *list = NULL;
+for (el = mach->plannedBatches; el != NULL; el = next)
+    {
+    struct batch *batch = el->val;
+    next = el->next;
+    if (batch->queuedCount == 0)
+	{
+	freeMem(el);
+	pruned = TRUE;
+	}
+    else
+	slAddHead(&list, el);
+    }
+slReverse(&list);
+mach->plannedBatches = list;
+return pruned;
+}
+
 boolean runNextJob()
 /* Assign next job in pending queue if any to a machine. */
 {
@@ -1026,6 +1242,11 @@ while(TRUE)
     mNode = dlPopHead(readyMachines);
     machine = mNode->val;
 
+    /* Batches that ran dry or were chilled give their share 
+     * of this machine to whoever is still queued. */
+    if (pruneDrainedBatches(machine))
+	planMachine(machine);
+
     if (!machine->plannedBatches) /* anything to do for this machine? */
 	{
 	struct dlNode *jobNode = machine->jobs->head;
@@ -1063,7 +1284,6 @@ while(TRUE)
     if (batch->queuedCount == 0)
 	{
 	/* probably the batch has been chilled */
-	/* needsPlanning=TRUE and a new plan will come along soon. */
 	/* just put it back on the ready list, it will get looked at again */
 	/* this has the effect of removing the batch from this machine's plannedBatches */
 	dlAddTail(readyMachines, mNode);  
@@ -1085,9 +1305,13 @@ while(TRUE)
     /* Get active batch from user and take job off of it.
      * If it's the last job in the batch move batch to
      * finished list. */
-    jNode = dlPopHead(batch->jobQueue);
+    jNode = pickJobForMachine(batch, machine);
+    dlRemove(jNode);
     dlAddTail(runningJobs, jNode);
     job = jNode->val;
+    int i;
+    for (i = 0; i < job->inputCount; ++i)
+	machineCacheFile(machine, job->inputs[i]);
     dlAddTail(hangJobs, job->hangNode);
     ++batch->runningCount;
     --batch->queuedCount;
@@ -1140,6 +1364,8 @@ if (mach != NULL)
     freeMem(mach->tempDir);
     machSpecFree(&mach->machSpec);
     freeDlList(&mach->jobs);
+    hashFree(&mach->cachedFiles);
+    freeDlListAndVals(&mach->cachedOrder);
     freez(pMach);
     }
 }
@@ -1153,7 +1379,8 @@ mach = machineNew(name, tempDir, m);
 safecpy(mach->ipStr, sizeof mach->ipStr, ipStr);
 dlAddTail(freeMachines, mach->node);
 slAddHead(&machineList, mach);
-needsPlanning = TRUE;  
+hashAdd(machineHash, name, mach);
+planMachine(mach);
 return mach;
 }
 
@@ -1199,57 +1426,94 @@ else
 	}
     }
 
-doAddMachine(name, m->tempDir, "0", m);  // "0" means no ipStr here
+struct machine *mach = doAddMachine(name, m->tempDir, "0", m);  // "0" means no ipStr here
+int c = 0, r = 0;
+readTotalMachineResources(mach, &c, &r);
+maxCpuInCluster = max(maxCpuInCluster, c);
+maxRamInCluster = max(maxRamInCluster, r);
+if (mach->plannedBatches)
+    {
+    dlRemove(mach->node);
+    dlAddTail(readyMachines, mach->node);
+    }
 runner(1);
 }
 
 struct machine *findMachine(char *name)
 /* Find named machine. */
 {
-struct machine *mach;
-for (mach = machineList; mach != NULL; mach = mach->next)
-     {
-     if (sameString(mach->name, name))
-         return mach;
-     }
-return NULL;
+return hashFindVal(machineHash, name);
+}
+
+void addCachedFiles(char *line)
+/* Process message listing files a machine already holds locally. 
+ * Format is <machine> <file> ... */
+{
+char *name = nextWord(&line), *fileName;
+struct machine *mach = findMachine(name);
+if (mach == NULL)
+    {
+    warn("addCachedFiles: no machine %s", naForNull(name));
+    return;
+    }
+while ((fileName = nextWord(&line)) != NULL)
+    machineCacheFile(mach, fileName);
+}
+
+void jobIdHashAdd(struct job *job)
+/* Index job by its id. */
+{
+char idString[16];
+safef(idString, sizeof(idString), "%d", job->id);
+hashAdd(jobIdHash, idString, job);
 }
 
-struct job *jobFind(struct dlList *list, int id)
-/* Find node of job with given id on list.  Return NULL if
+void jobIdHashRemove(struct job *job)
+/* Remove job from id index. */
+{
+char idString[16];
+safef(idString, sizeof(idString), "%d", job->id);
+struct hashEl *first = hashLookup(jobIdHash, idString), *hel;
+for (hel = first; hel != NULL; hel = hashLookupNext(hel))
+    {
+    if (hel->val == job)
+        {
+	/* hashRemove takes out the first element with the name, so in the
+	 * rare case of duplicate ids move that one's job here first. */
+	hel->val = first->val;
+	hashRemove(jobIdHash, idString);
+	break;
+	}
+    }
+}
+
+struct job *jobFind(int id, boolean running)
+/* Find running or waiting job with given id.  Return NULL if
  * not found. */
 {
-struct dlNode *el;
-struct job *job;
-for (el = list->head; !dlEnd(el); el = el->next)
+char idString[16];
+safef(idString, sizeof(idString), "%d", id);
+struct hashEl *hel;
+for (hel = hashLookup(jobIdHash, idString); hel != NULL; hel = hashLookupNext(hel))
     {
-    job = el->val;
-    if (job->id == id)
+    struct job *job = hel->val;
+    if ((job->machine != NULL) == running)
         return job;
     }
 return NULL;
 }
 
+struct job *findRunningJob(int id)
+/* Find job that's running.  Return NULL if it can't be found. */
+{
+return jobFind(id, TRUE);
+}
+
 struct job *findWaitingJob(int id)
 /* Find job that's waiting (as opposed to running).  Return
  * NULL if it can't be found. */
 {
-/* If it's not running look in user job queues. */
-struct user *user;
-struct job *job = NULL;
-for (user = userList; user != NULL; user = user->next)
-    {
-    struct dlNode *node;
-    for (node = user->curBatches->head; !dlEnd(node); node = node->next)
-	{
-	struct batch *batch = node->val;
-	if ((job = jobFind(batch->jobQueue, id)) != NULL)
-	    break;
-	}
-    if (job != NULL)
-	break;
-    }
-return job;
+return jobFind(id, FALSE);
 }
 
 
@@ -1270,6 +1534,7 @@ batch->queuedCount += 1;
 user->runningCount -= 1;
 dlRemove(batch->node);
 dlAddHead(user->curBatches, batch->node);
+batch->isCurrent = TRUE;
 dlRemove(user->node);
 dlAddHead(queuedUsers, user->node);
 
@@ -1340,6 +1605,13 @@ pmSendString(pm, rudpOut, "");
 
 
 
+void recycleMachine(struct machine *mach)
+/* Recycle machine into free list. */
+{
+dlRemove(mach->node);
+dlAddTail(readyMachines, mach->node);
+}
+
 void machineDown(struct machine *mach)
 /* Mark machine as down and move it to dead list. */
 {
@@ -1424,6 +1696,7 @@ job->jobNode->val = job;
 AllocVar(job->node);
 job->node->val = job;
 job->id = ++nextJobId;
+jobIdHashAdd(job);
 job->exe = cloneString(exeFromCommand(cmd));
 job->cmd = cloneString(cmd);
 job->batch = batch;
@@ -1443,6 +1716,7 @@ void jobFree(struct job **pJob)
 struct job *job = *pJob;
 if (job != NULL)
     {
+    jobIdHashRemove(job);
     freeMem(job->jobNode);
     freeMem(job->node);
     freeMem(job->exe);
@@ -1450,6 +1724,10 @@ if (job != NULL)
     freeMem(job->in);
     freeMem(job->out);
     freeMem(job->err);
+    int i;
+    for (i = 0; i < job->inputCount; ++i)
+	freeMem(job->inputs[i]);
+    freeMem(job->inputs);
     freeMem(job->hangNode);
     freez(pJob);
     }
@@ -1618,11 +1896,8 @@ if (rq->f != NULL)
     }
 }
 
-void writeJobResults(struct job *job, char *status,
-	char *uTime, char *sTime)
-/* Write out job results to output queue.  This
- * will create the output queue if it doesn't yet
- * exist. */
+void tallyJobResult(struct job *job, char *status)
+/* Update batch, user and sick node counts for job finishing with status. */
 {
 struct batch *batch = job->batch;
 if (sameString(status, "0"))
@@ -1645,8 +1920,16 @@ else
     hashIncInt(batch->sickNodes, job->machine->name);
     updateUserSickNode(batch->user, job->machine->name);  
     }
+}
 
-
+void writeJobResults(struct job *job, char *status,
+	char *uTime, char *sTime)
+/* Write out job results to output queue.  This
+ * will create the output queue if it doesn't yet
+ * exist. */
+{
+struct batch *batch = job->batch;
+tallyJobResult(job, status);
 writeResults(batch->name, batch->user->name, job->machine->name,
 	job->id, job->exe, job->submitTime, 
 	job->startTime, job->err, job->cmd,
@@ -1690,8 +1973,10 @@ flushResults(NULL);
 }
 
 void saveJobId()
-/* Save job ID. */
+/* Save job ID, if there's a job ID file (paraSim has none). */
 {
+if (jobIdFile == NULL)
+    return;
 rewind(jobIdFile);
 writeOne(jobIdFile, nextJobId);
 fflush(jobIdFile);
@@ -1765,99 +2050,86 @@ void nodeAlive(char *line)
 {
 char *name = nextWord(&line), *jobIdString;
 int jobId;
-struct machine *mach;
-struct dlNode *node;
-boolean hostFound = FALSE;
-for (node = deadMachines->head; !dlEnd(node); node = node->next)
+struct machine *mach = findMachine(name);
+if (mach != NULL && mach->isDead)
     {
-    mach = node->val;
-    if (sameString(mach->name, name) && mach->isDead)
-        {
-	hostFound = TRUE;
-	dlRemove(node);
-	dlAddTail(freeMachines, node);
-	needsPlanning = TRUE;
-	mach->isDead = FALSE;
+    dlRemove(mach->node);
+    dlAddTail(freeMachines, mach->node);
+    mach->isDead = FALSE;
 
-	if (mach->deadJobIds != NULL)
+    if (mach->deadJobIds != NULL)
+	{
+	struct dyString *dy = dyStringNew(0);
+	struct slInt *i = mach->deadJobIds;
+	dyStringPrintf(dy, "hub: node %s assigned ", name); 
+	for(i = mach->deadJobIds; i; i = i->next)
+	    dyStringPrintf(dy, "%d ", i->val);
+	dyStringPrintf(dy, "came back.");
+	logWarn("%s", dy->string);
+	dyStringFree(&dy);
+	while ((jobIdString = nextWord(&line)) != NULL)
 	    {
-	    struct dyString *dy = dyStringNew(0);
-	    struct slInt *i = mach->deadJobIds;
-	    dyStringPrintf(dy, "hub: node %s assigned ", name); 
-	    for(i = mach->deadJobIds; i; i = i->next)
-		dyStringPrintf(dy, "%d ", i->val);
-	    dyStringPrintf(dy, "came back.");
-	    logWarn("%s", dy->string);
-	    dyStringFree(&dy);
-	    while ((jobIdString = nextWord(&line)) != NULL)
-	        {
-		jobId = atoi(jobIdString);
-                if ((i = slIntFind(mach->deadJobIds, jobId)))
+	    jobId = atoi(jobIdString);
+	    if ((i = slIntFind(mach->deadJobIds, jobId)))
+		{
+		struct job *job;
+		warn("hub: Looks like %s is still keeping track of %d", name, jobId);
+		if ((job = findWaitingJob(jobId)) != NULL)
+		    {
+		    warn("hub: Luckily rerun of job %d has not yet happened.", 
+			 jobId);
+		    job->machine = mach;
+		    dlAddTail(mach->jobs, job->jobNode);
+		    job->lastChecked = mach->lastChecked = job->lastClockIn = now;
+		    dlRemove(job->node);
+		    dlAddTail(runningJobs, job->node);
+		    dlRemove(mach->node);
+		    dlAddTail(busyMachines, mach->node);
+		    dlAddTail(hangJobs, job->hangNode);
+		    struct batch *batch = job->batch;
+		    struct user *user = batch->user;
+		    batch->runningCount += 1;
+		    batch->queuedCount -= 1;
+		    user->runningCount += 1;
+		    }
+		else if ((job = findRunningJob(jobId)) != NULL)
+		    {
+		    /* Job is running on resurrected machine and another.
+		     * Kill it on both since the output it created could
+		     * be corrupt at this point.  Then add it back to job
+		     * queue. */
+		    warn("hub: Job %d is running on %s as well.", jobId,
+			 job->machine->name);
+		    sendKillJobMessage(mach, job->id);
+		    sendKillJobMessage(job->machine, job->id);
+		    requeueJob(job);
+		    }
+		else
 		    {
-		    struct job *job;
-		    warn("hub: Looks like %s is still keeping track of %d", name, jobId);
-		    if ((job = findWaitingJob(jobId)) != NULL)
-			{
-			warn("hub: Luckily rerun of job %d has not yet happened.", 
-                             jobId);
-			job->machine = mach;
-			dlAddTail(mach->jobs, job->jobNode);
-			job->lastChecked = mach->lastChecked = job->lastClockIn = now;
-			dlRemove(job->node);
-			dlAddTail(runningJobs, job->node);
-			dlRemove(mach->node);
-			dlAddTail(busyMachines, mach->node);
-			dlAddTail(hangJobs, job->hangNode);
-			struct batch *batch = job->batch;
-			struct user *user = batch->user;
-			batch->runningCount += 1;
-			batch->queuedCount -= 1;
-			user->runningCount += 1;
-			}
-		    else if ((job = jobFind(runningJobs, jobId)) != NULL)
-		        {
-			/* Job is running on resurrected machine and another.
-			 * Kill it on both since the output it created could
-			 * be corrupt at this point.  Then add it back to job
-			 * queue. */
-			warn("hub: Job %d is running on %s as well.", jobId,
-                             job->machine->name);
-			sendKillJobMessage(mach, job->id);
-			sendKillJobMessage(job->machine, job->id);
-			requeueJob(job);
-			}
-		    else
-		        {
-			/* This case should be very rare.  It should happen when
-			 * a node is out of touch for 2 hours, but when it comes
-			 * back is running a job that we reran to completion
-			 * on another node. */
-			warn("hub: Job %d has finished running, there is a conflict. "
-			     "Data may be corrupted, and it will take a lot of logic to fix.", 
-                             jobId);
-			}
+		    /* This case should be very rare.  It should happen when
+		     * a node is out of touch for 2 hours, but when it comes
+		     * back is running a job that we reran to completion
+		     * on another node. */
+		    warn("hub: Job %d has finished running, there is a conflict. "
+			 "Data may be corrupted, and it will take a lot of logic to fix.", 
+			 jobId);
 		    }
 		}
 	    }
-	slFreeList(&mach->deadJobIds);
-	runner(1);
-	break;
 	}
+    slFreeList(&mach->deadJobIds);
+    planMachine(mach);
+    if (mach->plannedBatches)
+	recycleMachine(mach);
+    runner(1);
     }
-if (!hostFound)
+else
     {
     warn("hub 'alive $HOST' msg handler: unable to resurrect host %s, "
 	 "not find in deadMachines list.",  name);
     }
 }
 
-void recycleMachine(struct machine *mach)
-/* Recycle machine into free list. */
-{
-dlRemove(mach->node);
-dlAddTail(readyMachines, mach->node);
-}
-
 void recycleJob(struct job *job)
 /* Remove job from lists and free up memory associated with it. */
 {
@@ -1874,7 +2146,7 @@ char *status = nextWord(&line);
 int jobId = atoi(jobIdString);
 if (status != NULL)
     {
-    struct job *job = jobFind(runningJobs, jobId);
+    struct job *job = findRunningJob(jobId);
     if (job != NULL)
 	{
         job->lastClockIn = now;
@@ -2029,6 +2301,51 @@ pmSend(pm, rudpOut);
 runner(1);
 }
 
+void addJobsAcknowledge(char *line, struct paraMessage *pm, int addJobsVersion)
+/* Add several jobs from the same batch in one go.  First line of message is
+ * <user> <dir> <stdin> <stdout> <results>, then each further line is
+ * <cpus> <ram> <command> for one job.  In version 2 each job line is
+ * <cpus> <ram> <inputs> <command> where inputs is a comma separated list
+ * of the files the job reads, or "-".  Send back the job IDs separated
+ * by spaces, with 0 for any job that couldn't be added. */
+{
+struct dyString *ids = dyStringNew(0);
+char *header = line, *jobLine = strchr(line, '\n');
+char *userName, *dir, *in, *out, *results;
+int jobCount = 0;
+if (jobLine != NULL)
+    *jobLine++ = 0;
+if ((userName = nextWord(&header)) != NULL && (dir = nextWord(&header)) != NULL
+ && (in = nextWord(&header)) != NULL && (out = nextWord(&header)) != NULL
+ && (results = nextWord(&header)) != NULL)
+    {
+    while (jobLine != NULL)
+	{
+	char *nextLine = strchr(jobLine, '\n');
+	if (nextLine != NULL)
+	    *nextLine++ = 0;
+	char *cpus = nextWord(&jobLine);
+	char *ram = nextWord(&jobLine);
+	char *inputs = (addJobsVersion >= 2 ? nextWord(&jobLine) : NULL);
+	char *command = (jobLine != NULL ? skipLeadingSpaces(jobLine) : NULL);
+	int id = 0;
+	if (ram != NULL && command != NULL && command[0] != 0)
+	    id = addJob(userName, dir, in, out, results, sqlFloat(cpus), sqlLongLong(ram), 
+	    	command);
+	if (id != 0 && inputs != NULL)
+	    jobSetInputs(findWaitingJob(id), inputs);
+	dyStringPrintf(ids, "%s%d", (jobCount > 0 ? " " : ""), id);
+	++jobCount;
+	jobLine = nextLine;
+	}
+    }
+pmClear(pm);
+pmPrintf(pm, "%s", ids->string);
+pmSend(pm, rudpOut);
+dyStringFree(&ids);
+runner(jobCount);
+}
+
 int setMaxJob(char *userName, char *dir, int maxJob)
 /* Set new maxJob for batch */
 {
@@ -2115,9 +2432,7 @@ if (user == NULL) return -3;
 struct hashEl *hel = hashLookup(stringHash, batchName);
 if (hel == NULL) return -2;
 char *name = hel->name;
-struct batch *batch = findBatchInList(user->curBatches, name);
-if (batch == NULL)
-    batch = findBatchInList(user->oldBatches, name);
+struct batch *batch = findUserBatch(user, name);
 if (batch == NULL) return -2;
 /* make sure nothing running and queue empty */
 if (batch->runningCount > 0) return -1;
@@ -2128,6 +2443,7 @@ logDebug("paraHub: User %s freed batch %s", userName, batchName);
 slRemoveEl(&batchList, batch);
 /* remove from user cur/old batches */
 dlRemove(batch->node);
+hashRemove(user->batchHash, name);
 /* free batch and its members */
 freeMem(batch->node);
 hashRemove(stringHash, name);
@@ -2167,9 +2483,7 @@ if (user == NULL) return -3;
 struct hashEl *hel = hashLookup(stringHash, batchName);
 if (hel == NULL) return -2;
 char *name = hel->name;
-struct batch *batch = findBatchInList(user->curBatches, name);
-if (batch == NULL)
-    batch = findBatchInList(user->oldBatches, name);
+struct batch *batch = findUserBatch(user, name);
 if (batch == NULL) return -2;
 flushResults(batch->name);
 logDebug("paraHub: User %s flushed results batch %s", userName, batchName);
@@ -2392,7 +2706,7 @@ unactivateBatchIfEmpty(batch);
 boolean removeJobId(int id)
 /* Remove job of a given id. */
 {
-struct job *job = jobFind(runningJobs, id);
+struct job *job = findRunningJob(id);
 if (job != NULL)
     {
     logDebug("Removing %s's %s", job->batch->user->name, job->cmd);
@@ -2448,7 +2762,7 @@ batch->queuedCount = 0;
 batch->planCount = 0;
 dlRemove(batch->node);
 dlAddTail(user->oldBatches, batch->node);
-needsPlanning = TRUE;
+batch->isCurrent = FALSE;
 updateUserPriority(user);
 updateUserMaxJob(user);
 updateUserSickNodes(user);
@@ -2469,9 +2783,8 @@ if (batchName != NULL)
     if (user != NULL)
 	{
 	struct batch *batch;
-	batchName = hashStoreName(stringHash, batchName);
-	batch = findBatchInList(user->curBatches, batchName);
-	if (batch != NULL)
+	batch = findUserBatch(user, batchName);
+	if (batch != NULL && batch->isCurrent)
 	    {
             chillABatch(batch);
 	    }
@@ -2485,6 +2798,35 @@ pmSendString(pm, rudpOut, res);
 
 
 
+void jobFinished(struct job *job, char *status, char *uTime, char *sTime,
+	boolean saveResults)
+/* Account for a running job that has finished, writing it to its batch's 
+ * results file if saveResults is set.  Then free the job and try to run
+ * another in its place. */
+{
+struct machine *machine = job->machine;
+if (machine != NULL)
+    {
+    machine->lastChecked = now;
+    if (sameString(status, "0"))
+	machine->goodCount += 1;
+    else
+	machine->errCount += 1;
+    }
+if (saveResults)
+    writeJobResults(job, status, uTime, sTime);
+else
+    tallyJobResult(job, status);
+struct batch *batch = job->batch;
+finishJob(job);
+/* is the batch sick? */
+if (batch->continuousCrashCount >= sickBatchThreshold)
+    {
+    chillABatch(batch);
+    }
+runner(1);
+}
+
 void jobDone(char *line)
 /* Handle job is done message. */
 {
@@ -2496,28 +2838,9 @@ char *sTime = nextWord(&line);
 
 if (sTime != NULL)
     {
-    job = jobFind(runningJobs, atoi(id));
+    job = findRunningJob(atoi(id));
     if (job != NULL)
-	{
-	struct machine *machine = job->machine;
-	if (machine != NULL)
-	    {
-	    machine->lastChecked = now;
-	    if (sameString(status, "0"))
-	        machine->goodCount += 1;
-	    else
-		machine->errCount += 1;
-	    }
-	writeJobResults(job, status, uTime, sTime);
-	struct batch *batch = job->batch;
-	finishJob(job);
-	/* is the batch sick? */
-	if (batch->continuousCrashCount >= sickBatchThreshold)
-	    {
-            chillABatch(batch);
-	    }
-	runner(1);
-	}
+	jobFinished(job, status, uTime, sTime, TRUE);
     }
 }
 
@@ -3001,6 +3324,34 @@ for (i=0; i<initialSpokes; ++i)
     addSpoke();
 }
 
+struct machine *addStartMachine(struct machSpec *ms, char *ipStr, boolean firstTime)
+/* Add machine from the starting machine list.  The first one
+ * sets the default cpu and ram units. */
+{
+if (hashLookup(machineHash, ms->name))
+    errAbort("machine list contains duplicate: %s",  ms->name);
+struct machine *machine = doAddMachine(ms->name, ms->tempDir, ipStr, ms);
+
+// TODO Add a command-line param for these that overrides default?
+/* use first machine in spec list as model node */
+if (firstTime) 
+    {
+    cpuUnit = 1;       /* 1 CPU */
+    if (!optionExists("ramUnit"))
+	ramUnit = ((long long)machine->machSpec->ramSize * 1024 * 1024) / machine->machSpec->cpus;
+    defaultJobCpu = 1;        /* number of cpuUnits in default job usage */  
+    /* number of ramUnits in default job usage, resolves to just 1 currently */
+    if (!optionExists("defaultJobRam"))
+	defaultJobRam = (((long long)machine->machSpec->ramSize * 1024 * 1024) / machine->machSpec->cpus) / ramUnit;
+    }
+
+int c = 0, r = 0;
+readTotalMachineResources(machine, &c, &r);
+maxCpuInCluster = max(maxCpuInCluster, c);
+maxRamInCluster = max(maxRamInCluster, r);
+return machine;
+}
+
 void startMachines(char *fileName)
 /* If they give us a beginning machine list use it here. */
 {
@@ -3013,30 +3364,8 @@ while (lineFileRow(lf, row))
     ms = machSpecLoad(row);
     char ipStr[NI_MAXHOST];
     lookupIp(ms->name, ipStr, sizeof ipStr);
-    if (hashLookup(machineHash, ms->name))
-	errAbort("machine list contains duplicate: %s",  ms->name);
-    struct machine *machine = doAddMachine(ms->name, ms->tempDir, ipStr, ms);
-    hashStoreName(machineHash, ms->name);
-
-    // TODO Add a command-line param for these that overrides default?
-    /* use first machine in spec list as model node */
-    if (firstTime) 
-	{
-	firstTime = FALSE;
-	cpuUnit = 1;       /* 1 CPU */
-	if (!optionExists("ramUnit"))
-    	    ramUnit = ((long long)machine->machSpec->ramSize * 1024 * 1024) / machine->machSpec->cpus;
-	defaultJobCpu = 1;        /* number of cpuUnits in default job usage */  
-	/* number of ramUnits in default job usage, resolves to just 1 currently */
-	if (!optionExists("defaultJobRam"))
-    	    defaultJobRam = (((long long)machine->machSpec->ramSize * 1024 * 1024) / machine->machSpec->cpus) / ramUnit;
-	}
-
-    int c = 0, r = 0;
-    readTotalMachineResources(machine, &c, &r);
-    maxCpuInCluster = max(maxCpuInCluster, c);
-    maxRamInCluster = max(maxRamInCluster, r);
-
+    addStartMachine(ms, ipStr, firstTime);
+    firstTime = FALSE;
     }
 lineFileClose(&lf);
 }
@@ -3139,11 +3468,14 @@ else
     if (!job) return;
     struct batch *batch = job->batch;
     struct user *user = batch->user;
+    jobIdHashRemove(job);
     job->id = atoi(rjm->jobIdString);
+    jobIdHashAdd(job);
     ++batch->runningCount;
     ++user->runningCount;
     dlRemove(batch->node);
     dlAddTail(user->oldBatches, batch->node);
+    batch->isCurrent = FALSE;
     dlAddTail(mach->jobs, job->jobNode);
     job->machine = mach;
     dlAddTail(runningJobs, job->node);
@@ -3409,6 +3741,12 @@ for (;;)
 	 addJobAcknowledge(line, pm, 1);
     else if (sameWord(command, "addJob2"))
 	 addJobAcknowledge(line, pm, 2);
+    else if (sameWord(command, "addJobs"))
+	 addJobsAcknowledge(line, pm, 1);
+    else if (sameWord(command, "addJobs2"))
+	 addJobsAcknowledge(line, pm, 2);
+    else if (sameWord(command, "addCachedFiles"))
+	 addCachedFiles(line);
     else if (sameWord(command, "nodeDown"))
 	 nodeDown(line);
     else if (sameWord(command, "alive"))
@@ -3478,6 +3816,8 @@ else
 hubSubnet = internetParseSubnetCidr(hubSubnetStr);
 }
 
+#ifndef PARASIM
+
 int main(int argc, char *argv[])
 /* Process command line. */
 {
@@ -3499,10 +3839,13 @@ if (optionExists("defaultJobRam"))
 jobCheckPeriod = optionInt("jobCheckPeriod", jobCheckPeriod);
 machineCheckPeriod = optionInt("machineCheckPeriod", machineCheckPeriod);
 initialSpokes = optionInt("spokes",  initialSpokes);
+localityWindow = optionInt("localityWindow", localityWindow);
+machineCachedFiles = optionInt("cachedFiles", machineCachedFiles);
 fillInSubnet();
 paraDaemonize("paraHub");
 startHub(argv[1]);
 return 0;
 }
 
+#endif /* PARASIM */
 
@@ -33,6 +33,9 @@ struct job
     boolean oldPlan;            /* from the old plan */
     time_t lastChecked;		/* Last time we checked machine in seconds past 1972 */
     struct dlNode *hangNode;	/* Job's node in hang list. */
+    char **inputs;		/* Input files job reads, names alloced here. */
+    int inputCount;		/* Number of input files. */
+    int skipCount;		/* Times passed over for jobs with inputs cached. */
     };
 
 struct machine
@@ -51,6 +54,10 @@ struct machine
     char ipStr[NI_MAXHOST];	/* IP address as a string. */
     struct machSpec *machSpec;  /* Machine spec of resources */
     struct slRef *plannedBatches; /* List of planned batches. */
+    struct hash *cachedFiles;	/* Input files recently read here, values are
+				 * nodes in cachedOrder.  NULL if none yet. */
+    struct dlList *cachedOrder;	/* Input file names, least recently used first.
+				 * Names alloced here. */
     };
 
 struct batch
@@ -75,6 +82,7 @@ struct batch
     boolean planning;           /* TRUE if still part of planning */
     int cpu;                    /* number of cpu-units required */
     int ram;                    /* number of ram-units required */
+    boolean isCurrent;          /* TRUE if on user->curBatches rather than oldBatches */
     };
 
 struct user
@@ -85,6 +93,7 @@ struct user
     char *name;			/* User name. Not allocated here. */
     struct dlList *curBatches;	/* Current active batches. */
     struct dlList *oldBatches;	/* Inactive batches. */
+    struct hash *batchHash;	/* Current and old batches keyed by name. */
     int runningCount;		/* Count of jobs currently running. */
     int doneCount;		/* Count of jobs finished. */
     int priority;   		/* Priority of user, 1 is highest priority */
@@ -160,6 +169,47 @@ extern struct cidr *hubSubnet;         /* Subnet to check. */
 void logIt(char *format, ...);
 /* Print message to log file. */
 
+/* Scheduler state and entry points in paraHub.c.  paraSim compiles 
+ * paraHub.c with PARASIM defined and drives these directly. */
+
+extern struct hash *stringHash;	/* Unique strings throughout system. */
+extern struct hash *machineHash;	/* Machines keyed by name. */
+extern struct dlList *freeSpokes;	/* List of free spokes. */
+extern struct dlList *busySpokes;	/* List of busy spokes. */
+extern int initialSpokes;		/* Number of spokes to start with. */
+extern long long ramUnit;		/* Bytes in a ram unit. */
+extern int defaultJobRam;		/* Ram units in default job usage. */
+extern boolean needsPlanning;		/* Situation changed, need new plan. */
+
+void setupLists();
+/* Make up machine, spoke, user and job lists. */
+
+void startSpokes();
+/* Start default number of spokes. */
+
+struct machine *addStartMachine(struct machSpec *ms, char *ipStr, boolean firstTime);
+/* Add machine from the starting machine list.  The first one
+ * sets the default cpu and ram units. */
+
+int addJob(char *userName, char *dir, char *in, char *out, char *results,
+	float cpus, long long ram, char *command);
+/* Add job to queues. */
+
+void runner(int count);
+/* Try to run a couple of jobs. */
+
+void processHeartbeat();
+/* Check that system is ok.  See if we can do anything useful. */
+
+struct job *findRunningJob(int id);
+/* Find job that's running.  Return NULL if it can't be found. */
+
+void jobFinished(struct job *job, char *status, char *uTime, char *sTime,
+	boolean saveResults);
+/* Account for a running job that has finished, writing it to its batch's 
+ * results file if saveResults is set.  Then free the job and try to run
+ * another in its place. */
+
 #define uglyLog logIt
 
 #define MINUTE 60
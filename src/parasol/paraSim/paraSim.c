@@ -0,0 +1,642 @@
+/* paraSim - Replay para.results files through paraHub's scheduler on
+ * simulated machines.
+ *
+ * This links in paraHub.c itself, compiled with PARASIM defined so that
+ * it leaves out main, and replaces the spoke, heartbeat and socket
+ * threads with the simulated versions here.  Time is kept in paraHub's
+ * own 'now' variable, which is moved forward from event to event:
+ * job submissions taken from the results files, jobs finishing after
+ * the run time they had originally, and heartbeats.  Nothing is sent
+ * over the network and no results files are written.
+ *
+ * At the end it reports the wall time the scheduler code took, which
+ * is what would hold up the hub's message loop on a real cluster,
+ * along with utilization, queue wait and per-user fairness for the
+ * simulated run. */
+
+#include "paraCommon.h"
+#include "options.h"
+#include "linefile.h"
+#include "hash.h"
+#include "dlist.h"
+#include "log.h"
+#include "portable.h"
+#include "paraHub.h"
+#include "machSpec.h"
+#include "jobResult.h"
+
+void usage()
+/* Explain usage and exit. */
+{
+errAbort(
+  "paraSim - Replay para.results files through paraHub's scheduler on\n"
+  "simulated machines, and report scheduling overhead, utilization and fairness.\n"
+  "usage:\n"
+  "   paraSim machineList para.results [para.results ...]\n"
+  "Where machineList is in the same format paraHub takes, and each results\n"
+  "file becomes one batch, keeping the users, submission times, run times\n"
+  "and exit statuses recorded in it.\n"
+  "options:\n"
+  "   -heartbeat=N - Seconds between heartbeats, default %d\n"
+  "   -spokes=N - Number of spokes, default %d\n"
+  "   -cpu=N - Number of CPUs each job uses, default paraHub's default\n"
+  "   -ram=N - Amount of ram each job uses, e.g. 500m or 4g, default paraHub's default\n"
+  "   -ramUnit=N - Size of ram unit as for paraHub\n"
+  "   -defaultJobRam=N - Ram units in default job as for paraHub\n"
+  "   -jobOut=file - Write simulated times for each job to file, tab separated:\n"
+  "        user batch jobId submitTime startTime endTime waitSeconds\n"
+  "   -log=file - Write paraHub's log messages here\n"
+  "   -logMinPriority=pri - Minimum log priority, default info\n"
+  , MINUTE/4, initialSpokes
+  );
+}
+
+static struct optionSpec options[] = {
+   {"heartbeat", OPTION_INT},
+   {"spokes", OPTION_INT},
+   {"cpu", OPTION_FLOAT},
+   {"ram", OPTION_STRING},
+   {"ramUnit", OPTION_STRING},
+   {"defaultJobRam", OPTION_INT},
+   {"jobOut", OPTION_STRING},
+   {"log", OPTION_STRING},
+   {"logMinPriority", OPTION_STRING},
+   {NULL, 0},
+};
+
+int heartbeatPeriod = MINUTE/4;	/* Seconds between heartbeats. */
+float jobCpu = 0;		/* CPUs per job, 0 for paraHub default. */
+long long jobRam = 0;		/* Ram per job, 0 for paraHub default. */
+
+struct simJob
+/* A job replayed from a para.results file. */
+    {
+    struct simJob *next;	/* Next in list. */
+    int order;			/* Order read in, breaks ties. */
+    char *user;			/* User who ran it. */
+    char *batch;		/* Results file it came from, which names the batch. */
+    char *dir;			/* Directory results file is in. */
+    char *exe;			/* Executable, stands in for command. */
+    char status[16];		/* Exit status it had originally. */
+    time_t submitTime;		/* Time submitted. */
+    int runTime;		/* Seconds it ran originally. */
+    int recordedWait;		/* Seconds it waited originally. */
+    int hubId;			/* Id paraHub gave it. */
+    int starts;			/* Number of times started. */
+    time_t startTime;		/* Time of last simulated start. */
+    time_t endTime;		/* Time simulated run finished, 0 if not yet. */
+    };
+
+struct hash *simJobHash;	/* simJobs keyed by ascii hub job id. */
+
+struct simEvent
+/* A job finishing. */
+    {
+    time_t time;		/* When it finishes. */
+    struct simJob *job;		/* Job finishing. */
+    int start;			/* Start this finishes, stale if job was restarted. */
+    };
+
+struct simEvent *finishHeap;	/* Heap of finish events, soonest first. */
+int finishCount;		/* Number of events in heap. */
+int finishAlloc;		/* Allocated size of heap. */
+
+boolean eventBefore(struct simEvent *a, struct simEvent *b)
+/* Return TRUE if a should be handled before b. */
+{
+if (a->time != b->time)
+    return a->time < b->time;
+return a->job->order < b->job->order;
+}
+
+void finishPush(struct simJob *job, time_t time)
+/* Add finish event for job to heap. */
+{
+if (finishCount >= finishAlloc)
+    {
+    int newAlloc = max(1024, 2*finishAlloc);
+    ExpandArray(finishHeap, finishAlloc, newAlloc);
+    finishAlloc = newAlloc;
+    }
+int i = finishCount++;
+struct simEvent ev = {time, job, job->starts};
+while (i > 0)
+    {
+    int parent = (i-1)/2;
+    if (!eventBefore(&ev, &finishHeap[parent]))
+        break;
+    finishHeap[i] = finishHeap[parent];
+    i = parent;
+    }
+finishHeap[i] = ev;
+}
+
+struct simEvent finishPop()
+/* Remove and return soonest finish event from heap. */
+{
+struct simEvent top = finishHeap[0];
+struct simEvent last = finishHeap[--finishCount];
+int i = 0;
+for (;;)
+    {
+    int child = 2*i + 1;
+    if (child >= finishCount)
+        break;
+    if (child+1 < finishCount && eventBefore(&finishHeap[child+1], &finishHeap[child]))
+        ++child;
+    if (!eventBefore(&finishHeap[child], &last))
+        break;
+    finishHeap[i] = finishHeap[child];
+    i = child;
+    }
+finishHeap[i] = last;
+return top;
+}
+
+struct hubCost
+/* Wall time spent in paraHub code for one kind of event. */
+    {
+    char *name;			/* Kind of event. */
+    int count;			/* Number of events. */
+    long long totalUsec;	/* Total microseconds. */
+    long long maxUsec;		/* Longest single event. */
+    };
+
+struct hubCost submitCost = {"addJob"};
+struct hubCost doneCost = {"jobDone"};
+struct hubCost beatCost = {"heartbeat"};
+struct hubCost planCost = {"heartbeat+plan"};
+
+long long usecNow()
+/* Return wall clock in microseconds. */
+{
+struct timeval tv;
+gettimeofday(&tv, NULL);
+return tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+void hubCostAdd(struct hubCost *cost, long long startUsec)
+/* Add time since startUsec to cost. */
+{
+long long usec = usecNow() - startUsec;
+cost->count += 1;
+cost->totalUsec += usec;
+if (usec > cost->maxUsec)
+    cost->maxUsec = usec;
+}
+
+/* The rest of paraHub - spokes, heartbeat, message queue and socket
+ * threads.  Spokes deliver to the simulated machines instantly. */
+
+int spokeLastId;	/* Id of last spoke allocated. */
+
+struct spoke *spokeNew()
+/* Get a new spoke. */
+{
+struct spoke *spoke;
+char spokeName[64];
+safef(spokeName, sizeof(spokeName), "spoke_%03d", ++spokeLastId);
+AllocVar(spoke);
+AllocVar(spoke->node);
+spoke->node->val = spoke;
+spoke->name = cloneString(spokeName);
+return spoke;
+}
+
+void spokeFree(struct spoke **pSpoke)
+/* Free spoke. */
+{
+*pSpoke = NULL;
+}
+
+void spokeDone(struct spoke *spoke)
+/* Put spoke back on free list once message is delivered.  Done directly
+ * rather than through paraHub's recycleSpoke, which would call runner
+ * from inside runner. */
+{
+dlRemove(spoke->node);
+dlAddTail(freeSpokes, spoke->node);
+}
+
+void spokeSendMessage(struct spoke *spoke, struct machine *machine, char *message)
+/* Deliver a message to a simulated machine.  All that needs an answer
+ * is hangman's check on a job, which the machine answers by clocking in. */
+{
+int jobId;
+if (sscanf(message, "check %d", &jobId) == 1)
+    {
+    struct job *job = findRunningJob(jobId);
+    if (job != NULL)
+        job->lastClockIn = now;
+    }
+spokeDone(spoke);
+}
+
+struct simJob *simJobFind(int hubId)
+/* Find simJob from paraHub's job id. */
+{
+char idString[16];
+safef(idString, sizeof(idString), "%d", hubId);
+return hashMustFindVal(simJobHash, idString);
+}
+
+void spokeSendJob(struct spoke *spoke, struct machine *machine, struct job *job)
+/* Start job on simulated machine, to finish after its recorded run time. */
+{
+struct simJob *sj = simJobFind(job->id);
+sj->starts += 1;
+sj->startTime = now;
+finishPush(sj, now + sj->runTime);
+spokeDone(spoke);
+}
+
+void startHeartbeat()
+/* Heartbeats are events in the simulation. */
+{
+}
+
+void endHeartbeat()
+/* Heartbeats are events in the simulation. */
+{
+}
+
+void hubMessageQueueInit()
+/* There is no message queue in the simulation. */
+{
+}
+
+struct paraMessage *hubMessageGet()
+/* There is no message queue in the simulation. */
+{
+errAbort("paraSim has no hub message queue");
+return NULL;
+}
+
+void hubMessagePut(struct paraMessage *pm)
+/* There is no message queue in the simulation. */
+{
+pmFree(&pm);
+}
+
+void sockSuckStart(struct rudp *ru)
+/* There is no socket in the simulation. */
+{
+}
+
+int simJobCmp(const void *va, const void *vb)
+/* Compare simJobs by submission time, then by order read. */
+{
+const struct simJob *a = *((struct simJob **)va);
+const struct simJob *b = *((struct simJob **)vb);
+if (a->submitTime != b->submitTime)
+    return a->submitTime < b->submitTime ? -1 : 1;
+return a->order - b->order;
+}
+
+struct simJob *readSimJobs(int fileCount, char *files[])
+/* Read results files into list of simJobs sorted by submission time. */
+{
+struct simJob *list = NULL;
+int order = 0;
+int i;
+for (i=0; i<fileCount; ++i)
+    {
+    char *fileName = files[i];
+    char dir[PATH_LEN], name[FILENAME_LEN], extension[FILEEXT_LEN];
+    splitPath(fileName, dir, name, extension);
+    if (dir[0] == 0)
+        safecpy(dir, sizeof(dir), ".");
+    off_t bookMark = 0;
+    struct jobResult *jr, *jrList = jobResultLoadAll(fileName, &bookMark, fileSize(fileName));
+    for (jr = jrList; jr != NULL; jr = jr->next)
+        {
+	struct simJob *sj;
+	AllocVar(sj);
+	sj->order = order++;
+	sj->user = cloneString(jr->user);
+	sj->batch = cloneString(fileName);
+	sj->dir = cloneString(dir);
+	sj->exe = cloneString(jr->exe);
+	safef(sj->status, sizeof(sj->status), "%d", jr->status);
+	sj->submitTime = jr->submitTime;
+	sj->runTime = max(0, (int)jr->endTime - (int)jr->startTime);
+	sj->recordedWait = max(0, (int)jr->startTime - (int)jr->submitTime);
+	slAddHead(&list, sj);
+	}
+    verbose(2, "%d jobs in %s\n", slCount(jrList), fileName);
+    jobResultFreeList(&jrList);
+    }
+slSort(&list, simJobCmp);
+return list;
+}
+
+void readSimMachines(char *fileName, int *retCpus)
+/* Add machines from machine list to simulated cluster, returning
+ * total CPUs. */
+{
+struct lineFile *lf = lineFileOpen(fileName, TRUE);
+char *row[7];
+boolean firstTime = TRUE;
+int cpus = 0;
+while (lineFileRow(lf, row))
+    {
+    struct machSpec *ms = machSpecLoad(row);
+    cpus += ms->cpus;
+    addStartMachine(ms, "0", firstTime);
+    firstTime = FALSE;
+    }
+lineFileClose(&lf);
+if (firstTime)
+    errAbort("No machines in %s", fileName);
+*retCpus = cpus;
+}
+
+boolean simJobSubmit(struct simJob *sj)
+/* Submit job to paraHub, as its addJob message would.  Returns FALSE
+ * if paraHub refuses it. */
+{
+sj->hubId = addJob(sj->user, sj->dir, "/dev/null", "/dev/null", sj->batch,
+	jobCpu, jobRam, sj->exe);
+if (sj->hubId == 0)
+    {
+    warn("paraHub refused job %d from %s", sj->order, sj->batch);
+    return FALSE;
+    }
+char idString[16];
+safef(idString, sizeof(idString), "%d", sj->hubId);
+hashAdd(simJobHash, idString, sj);
+runner(1);
+return TRUE;
+}
+
+boolean simJobDone(struct simEvent *ev)
+/* Tell paraHub job is done, as its node would.  Returns FALSE if
+ * paraHub has given up on this run of the job. */
+{
+struct simJob *sj = ev->job;
+if (ev->start != sj->starts)
+    return FALSE;	/* Job was restarted since, this run was abandoned. */
+struct job *job = findRunningJob(sj->hubId);
+if (job == NULL)
+    return FALSE;	/* Killed or requeued. */
+sj->endTime = now;
+jobFinished(job, sj->status, "0", "0", FALSE);
+return TRUE;
+}
+
+int simulate(struct simJob *jobList, int jobCount)
+/* Run jobs through scheduler until they have all finished, or
+ * nothing more can be started.  Returns number of jobs finished. */
+{
+struct simJob *pending = jobList;
+time_t nextBeat = jobList->submitTime;
+int submitted = 0, done = 0;
+int idleBeats = 0;
+long long startUsec;
+
+for (;;)
+    {
+    time_t next = nextBeat;
+    if (pending != NULL && pending->submitTime < next)
+        next = pending->submitTime;
+    if (finishCount > 0 && finishHeap[0].time < next)
+        next = finishHeap[0].time;
+    now = next;
+
+    while (finishCount > 0 && finishHeap[0].time == now)
+        {
+	struct simEvent ev = finishPop();
+	startUsec = usecNow();
+	if (simJobDone(&ev))
+	    ++done;
+	hubCostAdd(&doneCost, startUsec);
+	}
+    while (pending != NULL && pending->submitTime == now)
+        {
+	startUsec = usecNow();
+	if (simJobSubmit(pending))
+	    ++submitted;
+	hubCostAdd(&submitCost, startUsec);
+	pending = pending->next;
+	}
+    if (nextBeat == now)
+        {
+	boolean planning = needsPlanning;
+	startUsec = usecNow();
+	processHeartbeat();
+	hubCostAdd(planning ? &planCost : &beatCost, startUsec);
+	nextBeat += heartbeatPeriod;
+
+	/* Stop when there's nothing left to happen. */
+	if (pending == NULL && finishCount == 0)
+	    {
+	    if (done == submitted)
+	        break;
+	    if (++idleBeats >= 2)
+		{
+		warn("%d jobs were never run", submitted - done);
+		break;
+		}
+	    }
+	else
+	    idleBeats = 0;
+	}
+    }
+return done;
+}
+
+void printCost(struct hubCost *cost, FILE *f)
+/* Print out time spent in one kind of event. */
+{
+fprintf(f, "%-16s %9d events %10.3f sec total %9.1f usec mean %9.1f usec max\n",
+	cost->name, cost->count, cost->totalUsec * 1e-6,
+	cost->count ? (double)cost->totalUsec / cost->count : 0.0,
+	(double)cost->maxUsec);
+}
+
+struct userStats
+/* Fairness stats for one user. */
+    {
+    struct userStats *next;
+    char *name;		/* User name. */
+    int jobs;		/* Jobs finished. */
+    double cpuSeconds;	/* CPU seconds used. */
+    double waitSum;	/* Sum of waits. */
+    double slowdownSum;	/* Sum of (wait+run)/run. */
+    };
+
+void report(struct simJob *jobList, int jobCount, int done, int clusterCpus, FILE *f)
+/* Print out utilization, waits and fairness. */
+{
+struct hash *userHash = hashNew(0);
+struct userStats *userList = NULL, *us;
+double *waits, *recordedWaits;
+AllocArray(waits, jobCount);
+AllocArray(recordedWaits, jobCount);
+double cpusPerJob = (jobCpu > 0 ? jobCpu : 1);
+double busy = 0;
+time_t first = jobList->submitTime, last = first;
+time_t recordedLast = first;
+int n = 0;
+struct simJob *sj;
+for (sj = jobList; sj != NULL; sj = sj->next)
+    {
+    recordedLast = max(recordedLast, sj->submitTime + sj->recordedWait + sj->runTime);
+    if (sj->endTime == 0)
+        continue;
+    last = max(last, sj->endTime);
+    double wait = sj->startTime - sj->submitTime;
+    waits[n] = wait;
+    recordedWaits[n] = sj->recordedWait;
+    ++n;
+    busy += cpusPerJob * sj->runTime;
+    us = hashFindVal(userHash, sj->user);
+    if (us == NULL)
+        {
+	AllocVar(us);
+	hashAddSaveName(userHash, sj->user, us, &us->name);
+	slAddHead(&userList, us);
+	}
+    us->jobs += 1;
+    us->cpuSeconds += cpusPerJob * sj->runTime;
+    us->waitSum += wait;
+    us->slowdownSum += (wait + sj->runTime) / max(1, sj->runTime);
+    }
+slReverse(&userList);
+double makespan = last - first;
+double recordedMakespan = recordedLast - first;
+
+fprintf(f, "jobs finished:   %d of %d\n", done, jobCount);
+fprintf(f, "cluster cpus:    %d\n", clusterCpus);
+fprintf(f, "makespan:        %.0f sec simulated, %.0f sec recorded\n", makespan, recordedMakespan);
+if (makespan > 0)
+    {
+    fprintf(f, "utilization:     %.1f%%\n", 100.0 * busy / (clusterCpus * makespan));
+    fprintf(f, "throughput:      %.1f jobs/hour\n", 3600.0 * done / makespan);
+    }
+if (n > 0)
+    {
+    double waitSum = 0, recordedSum = 0;
+    int i;
+    for (i=0; i<n; ++i)
+        {
+	waitSum += waits[i];
+	recordedSum += recordedWaits[i];
+	}
+    doubleSort(n, waits);
+    doubleSort(n, recordedWaits);
+    fprintf(f, "queue wait:      %.1f mean, %.0f median, %.0f 95th, %.0f max sec simulated\n",
+    	waitSum/n, waits[n/2], waits[(int)(0.95*(n-1))], waits[n-1]);
+    fprintf(f, "                 %.1f mean, %.0f median, %.0f 95th, %.0f max sec recorded\n",
+    	recordedSum/n, recordedWaits[n/2], recordedWaits[(int)(0.95*(n-1))],
+	recordedWaits[n-1]);
+    }
+
+/* Jain's index over users' mean slowdown, 1.0 when all users are slowed equally. */
+double sum = 0, sumSq = 0;
+int userCount = 0;
+fprintf(f, "\n%-12s %8s %12s %12s %12s\n", "user", "jobs", "cpuHours", "meanWait", "meanSlowdown");
+for (us = userList; us != NULL; us = us->next)
+    {
+    double slowdown = us->slowdownSum / us->jobs;
+    fprintf(f, "%-12s %8d %12.2f %12.1f %12.2f\n", us->name, us->jobs,
+    	us->cpuSeconds/3600, us->waitSum / us->jobs, slowdown);
+    sum += slowdown;
+    sumSq += slowdown * slowdown;
+    ++userCount;
+    }
+if (userCount > 0)
+    fprintf(f, "fairness:        %.3f (Jain's index of user mean slowdown)\n",
+    	sum * sum / (userCount * sumSq));
+
+fprintf(f, "\nscheduler time:\n");
+printCost(&submitCost, f);
+printCost(&doneCost, f);
+printCost(&beatCost, f);
+printCost(&planCost, f);
+long long total = submitCost.totalUsec + doneCost.totalUsec + beatCost.totalUsec
+	+ planCost.totalUsec;
+fprintf(f, "%-16s %28.3f sec total\n", "all", total * 1e-6);
+freeMem(waits);
+freeMem(recordedWaits);
+hashFree(&userHash);
+}
+
+void writeJobOut(struct simJob *jobList, char *fileName)
+/* Write simulated times for each job. */
+{
+FILE *f = mustOpen(fileName, "w");
+struct simJob *sj;
+for (sj = jobList; sj != NULL; sj = sj->next)
+    {
+    fprintf(f, "%s\t%s\t%d\t%lld\t%lld\t%lld\t", sj->user, sj->batch, sj->hubId,
+    	(long long)sj->submitTime, (long long)sj->startTime, (long long)sj->endTime);
+    if (sj->endTime)
+	fprintf(f, "%lld\n", (long long)(sj->startTime - sj->submitTime));
+    else
+        fprintf(f, "-1\n");
+    }
+carefulClose(&f);
+}
+
+void paraSim(char *machineList, int resultsCount, char *resultsFiles[])
+/* paraSim - Replay para.results files through paraHub's scheduler on
+ * simulated machines. */
+{
+struct simJob *jobList = readSimJobs(resultsCount, resultsFiles);
+int jobCount = slCount(jobList);
+if (jobCount == 0)
+    errAbort("No jobs in results files");
+
+stringHash = newHash(0);
+setupLists();
+machineHash = newHash(0);
+simJobHash = newHash(18);
+int clusterCpus = 0;
+readSimMachines(machineList, &clusterCpus);
+startSpokes();
+needsPlanning = TRUE;
+
+int done = simulate(jobList, jobCount);
+report(jobList, jobCount, done, clusterCpus, stdout);
+if (optionExists("jobOut"))
+    writeJobOut(jobList, optionVal("jobOut", NULL));
+}
+
+int main(int argc, char *argv[])
+/* Process command line. */
+{
+optionInit(&argc, argv, options);
+if (argc < 3)
+    usage();
+heartbeatPeriod = optionInt("heartbeat", heartbeatPeriod);
+if (heartbeatPeriod < 1)
+    errAbort("-heartbeat must be at least 1");
+initialSpokes = optionInt("spokes", initialSpokes);
+jobCpu = optionFloat("cpu", jobCpu);
+if (optionExists("ram"))
+    {
+    jobRam = paraParseRam(optionVal("ram", ""));
+    if (jobRam == -1)
+	errAbort("Invalid RAM expression '%s' in '-ram=' option", optionVal("ram", ""));
+    }
+if (optionExists("ramUnit"))
+    {
+    ramUnit = paraParseRam(optionVal("ramUnit", ""));
+    if (ramUnit == -1)
+	errAbort("Invalid RAM expression '%s' in '-ramUnit=' option", optionVal("ramUnit", ""));
+    }
+if (optionExists("defaultJobRam"))
+    {
+    defaultJobRam = optionInt("defaultJobRam", defaultJobRam);
+    if (defaultJobRam < 1)
+	errAbort("Invalid defaultJobRam specified in option -defaultJobRam=%d", defaultJobRam);
+    }
+if (optionExists("log"))
+    {
+    logOpenFile("paraSim", optionVal("log", NULL));
+    logSetMinPriority(optionVal("logMinPriority", "info"));
+    }
+paraSim(argv[1], argc-2, argv+2);
+return 0;
+}
@@ -43,6 +43,8 @@ errAbort("parasol - parallel job management system for a compute cluster\n\n"
   "   parasol remove machine machineFullHostName \"reason why\"  - Remove machine from pool.\n"
   "   parasol check dead - Check machines marked dead ASAP, some have been fixed.\n"
   "   parasol add spoke  - Add a new spoke daemon.\n"
+  "   parasol add cached machineFullHostName file(s) - Tell hub machine already holds\n"
+  "         these input files locally, so jobs reading them are run there if possible.\n"
   "   parasol [options] add job command-line   - Add job to list.\n"
   "         options:\n"
   "            -in=in - Where to get stdin, default /dev/null\n"
@@ -330,6 +332,28 @@ mustBeRoot();
 commandHub("addSpoke");
 }
 
+void addCachedFiles(char *machine, int fileCount, char *files[])
+/* Tell hub machine already has files, so it prefers it for jobs
+ * that read them. */
+{
+struct dyString *dy = dyStringNew(0);
+int i;
+mustBeRoot();
+dyStringPrintf(dy, "addCachedFiles %s", machine);
+for (i=0; i<fileCount; ++i)
+    {
+    if (dy->stringSize + 1 + strlen(files[i]) >= rudpMaxSize)
+        {
+	commandHub(dy->string);
+	dyStringClear(dy);
+	dyStringPrintf(dy, "addCachedFiles %s", machine);
+	}
+    dyStringPrintf(dy, " %s", files[i]);
+    }
+commandHub(dy->string);
+dyStringFree(&dy);
+}
+
 void removeMachine(char *machine, char *reason)
 /* Tell hub to get rid of machine.
    Log the user and reason.
@@ -559,6 +583,12 @@ if (sameString(command, "add"))
 	}
     else if (sameString(subType, "spoke"))
         addSpoke();
+    else if (sameString(subType, "cached"))
+	{
+	if (argc < 3)
+	    usage();
+	addCachedFiles(argv[1], argc-2, argv+2);
+	}
     else
         usage();
     }
@@ -96,6 +96,10 @@
 #include "localmem.h"
 #include "dnaseq.h"
 #include "dnaLoad.h"
+#include "twoBit.h"
+#include "nib.h"
+#include "fq.h"
+#include "pthreadDoList.h"
 #include "splix.h"
 #include "intValTree.h"
 #include "fa.h"
@@ -106,7 +110,7 @@
 #include "splat.h"
 
 
-char *version = "31";	/* Program version number. */
+char *version = "32";	/* Program version number. */
 
 /* Command line driven variables. */
 static char *over = NULL;
@@ -118,6 +122,8 @@ static char *repeatOutput = NULL;
 static int maxGap = 1;
 static int maxMismatch = 2;
 static boolean memoryMap = FALSE;
+static int threads = 1;
+static int batch = 100000;
 static int tagSize;
 
 static boolean exactOnly;	/* Set to true if maxGap and maxMismatch are both 0. */
@@ -149,7 +155,9 @@ errAbort(
 "   -maxDivergence=N Maximum divergence level between read and genome to map.  Default %d\n"
 "                    Divergence combines gaps and mismatches.  Mismatch=2, gap=3\n"
 "   -mmap - Use memory mapping. Faster just a few reads, but much slower for many reads\n"
-, version, maxRepeat, maxGap, maxMismatch, maxDivergence
+"   -threads=N - Number of threads to align with. Default %d\n"
+"   -batch=N - Number of reads to read in and align at a time. Default %d\n"
+, version, maxRepeat, maxGap, maxMismatch, maxDivergence, threads, batch
 );
 }
 
@@ -163,14 +171,21 @@ static struct optionSpec options[] = {
    {"maxGap", OPTION_INT},
    {"maxMismatch", OPTION_INT},
    {"mmap", OPTION_BOOLEAN},
+   {"threads", OPTION_INT},
+   {"batch", OPTION_INT},
    {NULL, 0},
 };
 
-static FILE *repeatOutputFile = NULL;
 int overArraySize;
 bits64 *overArray;
 
-long exactIndexQueries, hits12, hits18, hits25, hitsFull;
+struct splatStats
+/* Counts of work done at various stages of the search. */
+    {
+    long exactIndexQueries;	/* Number of index lookups. */
+    long hits12, hits18;	/* Index entries looked at and matched. */
+    long hits25, hitsFull;	/* Tags and full alignments found. */
+    };
 
 static int splatTagCmp(const void *va, const void *vb)
 /* Sort tags based on position fields, then divergence. */
@@ -369,11 +384,11 @@ return -1;
 
 static void exactIndexHits(bits16 hex, bits16 *sortedHexes, int slotSize, 
 	bits32 *offsets, int startOffset, int subCount, int gapSize, 
-	int missingQuad, struct lm *lm, struct splatHit **pHitList)
+	int missingQuad, struct lm *lm, struct splatStats *stats, struct splatHit **pHitList)
 /* Look for hits that involve no index mismatches.  Put resultint offsets (plus startOffset)
  * into hitTree. */
 {
-hits12 += slotSize;
+stats->hits12 += slotSize;
 int ix = binaryFindHex(hex, sortedHexes, slotSize);
 if (ix >= 0)
     {
@@ -388,7 +403,7 @@ if (ix >= 0)
 	hit->subCount = subCount;
 	slAddHead(pHitList, hit);
 	ix += 1;
-	++hits18;
+	++stats->hits18;
 	if (sortedHexes[ix] != hex)
 	    break;
 	}
@@ -397,10 +412,10 @@ if (ix >= 0)
 
 static void searchExact(struct splix *splix, int twelvemer, bits16 sixmer, int whichSixmer,
 	int dnaStartOffset, int subCount, int gapSize, int missingQuad,
-	struct lm *lm, struct splatHit **pHitList)
+	struct lm *lm, struct splatStats *stats, struct splatHit **pHitList)
 /* If there's an exact match put DNA offset of match into hitTree. */
 {
-exactIndexQueries += 1;
+stats->exactIndexQueries += 1;
 int slotSize = splix->slotSizes[twelvemer];
 if (slotSize != 0)
     {
@@ -409,13 +424,13 @@ if (slotSize != 0)
     bits16 *hexesSixmer = (bits16*)(slot + whichSixmer*sizeof(bits16)*slotSize);
     bits32 *offsetsSixmer = (bits32*)((8+sizeof(bits32)*whichSixmer)*slotSize + slot);
     exactIndexHits(sixmer, hexesSixmer, slotSize, offsetsSixmer, dnaStartOffset,
-    	subCount, gapSize, missingQuad, lm, pHitList);
+    	subCount, gapSize, missingQuad, lm, stats, pHitList);
     }
 }
 
 static void searchExact12Vary6(struct splix *splix, int twelvemer, bits16 sixmer, int whichSixmer,
 	int dnaStartOffset, int gapSize, int missingQuad, struct lm *lm,
-	struct splatHit **pHitList)
+	struct splatStats *stats, struct splatHit **pHitList)
 /* Search for exact matches to twelvemer and off-by-ones to sixmer. */
 {
 bits16 oneOff = sixmer;
@@ -426,13 +441,13 @@ for (baseIx = 0; baseIx<6; ++baseIx)
     {
     oneOff ^= toggle1;
     searchExact(splix, twelvemer, oneOff, whichSixmer, dnaStartOffset,
-    	1, gapSize, missingQuad, lm, pHitList);
+    	1, gapSize, missingQuad, lm, stats, pHitList);
     oneOff ^= toggle2;
     searchExact(splix, twelvemer, oneOff, whichSixmer, dnaStartOffset, 
-    	1, gapSize, missingQuad, lm, pHitList);
+    	1, gapSize, missingQuad, lm, stats, pHitList);
     oneOff ^= toggle1;
     searchExact(splix, twelvemer, oneOff, whichSixmer, dnaStartOffset, 
-    	1, gapSize, missingQuad, lm, pHitList);
+    	1, gapSize, missingQuad, lm, stats, pHitList);
     oneOff ^= toggle2;	/* Restore base to unmutated form. */
     toggle1 <<= 2;	/* Move on to next base. */
     toggle2 <<= 2;	/* Move on to next base. */
@@ -441,7 +456,7 @@ for (baseIx = 0; baseIx<6; ++baseIx)
 
 static void searchVary12Exact6(struct splix *splix, int twelvemer, bits16 sixmer, int whichSixmer,
 	int dnaStartOffset, int gapSize, int missingQuad, 
-	struct lm *lm, struct splatHit **pHitList)
+	struct lm *lm, struct splatStats *stats, struct splatHit **pHitList)
 /* Search for exact matches to twelvemer and off-by-ones to sixmer. */
 {
 bits32 oneOff = twelvemer;
@@ -452,13 +467,13 @@ for (baseIx = 0; baseIx<12; ++baseIx)
     {
     oneOff ^= toggle1;
     searchExact(splix, oneOff, sixmer, whichSixmer, dnaStartOffset, 
-    	1, gapSize, missingQuad, lm, pHitList);
+    	1, gapSize, missingQuad, lm, stats, pHitList);
     oneOff ^= toggle2;
     searchExact(splix, oneOff, sixmer, whichSixmer, dnaStartOffset, 
-    	1, gapSize, missingQuad, lm, pHitList);
+    	1, gapSize, missingQuad, lm, stats, pHitList);
     oneOff ^= toggle1;
     searchExact(splix, oneOff, sixmer, whichSixmer, dnaStartOffset, 
-    	1, gapSize, missingQuad, lm, pHitList);
+    	1, gapSize, missingQuad, lm, stats, pHitList);
     oneOff ^= toggle2;	/* Restore base to unmutated form. */
     toggle1 <<= 2;	/* Move on to next base. */
     toggle2 <<= 2;	/* Move on to next base. */
@@ -833,7 +848,7 @@ else
 
 void splatHitsOneStrand(struct dnaSeq *qSeq, bits64 bases25, 
 	char strand, int tagPosition, struct splix *splix, int maxGap,
-	struct lm *lm, struct splatHit **pHitList)
+	struct lm *lm, struct splatStats *stats, struct splatHit **pHitList)
 /* Look through index for hits to query tag on one strand. 
  * Input:
  *   qSeq - entire query sequence, reverse complimented if on - strand
@@ -854,42 +869,42 @@ dnaToBinary(qSeq->dna + tagPosition, maxGap,
 	&firstHex, &lastHex, &twoAfterFirstHex, &twoBeforeLastHex);
 
 int secondHalfPos = -12 - maxGap;
-searchExact(splix, firstHalf, after1, 2, 0, 0, 0, 3, lm, pHitList);
+searchExact(splix, firstHalf, after1, 2, 0, 0, 0, 3, lm, stats, pHitList);
 if (!exactOnly)
     {
-    searchExact(splix, firstHalf, after2, 3, 0, 0, 0, 2, lm, pHitList);
-    searchExact(splix, secondHalf, before1, 0, secondHalfPos, 0, 0, 1, lm, pHitList);
-    searchExact(splix, secondHalf, before2, 1, secondHalfPos, 0, 0, 0, lm, pHitList);
+    searchExact(splix, firstHalf, after2, 3, 0, 0, 0, 2, lm, stats, pHitList);
+    searchExact(splix, secondHalf, before1, 0, secondHalfPos, 0, 0, 1, lm, stats, pHitList);
+    searchExact(splix, secondHalf, before2, 1, secondHalfPos, 0, 0, 0, lm, stats, pHitList);
     }
 if (maxMismatch > 1)
     {
-    searchVary12Exact6(splix, firstHalf, after1, 2, 0, 0, 3, lm, pHitList);
-    searchVary12Exact6(splix, firstHalf, after2, 3, 0, 0, 2, lm, pHitList);
-    searchVary12Exact6(splix, secondHalf, before1, 0, secondHalfPos, 0, 1, lm, pHitList);
-    searchVary12Exact6(splix, secondHalf, before2, 1, secondHalfPos, 0, 0, lm, pHitList);
-    searchExact12Vary6(splix, firstHalf, after1, 2, 0, 0, 3, lm, pHitList);
-    searchExact12Vary6(splix, firstHalf, after2, 3, 0, 0, 2, lm, pHitList);
-    searchExact12Vary6(splix, secondHalf, before1, 0, secondHalfPos, 0, 1, lm, pHitList);
-    searchExact12Vary6(splix, secondHalf, before2, 1, secondHalfPos, 0, 0, lm, pHitList);
+    searchVary12Exact6(splix, firstHalf, after1, 2, 0, 0, 3, lm, stats, pHitList);
+    searchVary12Exact6(splix, firstHalf, after2, 3, 0, 0, 2, lm, stats, pHitList);
+    searchVary12Exact6(splix, secondHalf, before1, 0, secondHalfPos, 0, 1, lm, stats, pHitList);
+    searchVary12Exact6(splix, secondHalf, before2, 1, secondHalfPos, 0, 0, lm, stats, pHitList);
+    searchExact12Vary6(splix, firstHalf, after1, 2, 0, 0, 3, lm, stats, pHitList);
+    searchExact12Vary6(splix, firstHalf, after2, 3, 0, 0, 2, lm, stats, pHitList);
+    searchExact12Vary6(splix, secondHalf, before1, 0, secondHalfPos, 0, 1, lm, stats, pHitList);
+    searchExact12Vary6(splix, secondHalf, before2, 1, secondHalfPos, 0, 0, lm, stats, pHitList);
     }
 
 /* Look at single base indels with few mismatches */
 if (maxGap > 0)
     {
-    searchExact(splix, secondHalf, twoAfterFirstHex, 0, secondHalfPos-maxGap, 0, -1, 1, lm, pHitList);
-    searchExact(splix, secondHalf, firstHex, 0, secondHalfPos+maxGap, 0, 1, 1, lm, pHitList);
-    searchExact(splix, firstHalf, twoBeforeLastHex, 3, 0, 0, -1, 2, lm, pHitList);
-    searchExact(splix, firstHalf, lastHex, 3, 0, 0, 1, 2, lm, pHitList);
+    searchExact(splix, secondHalf, twoAfterFirstHex, 0, secondHalfPos-maxGap, 0, -1, 1, lm, stats, pHitList);
+    searchExact(splix, secondHalf, firstHex, 0, secondHalfPos+maxGap, 0, 1, 1, lm, stats, pHitList);
+    searchExact(splix, firstHalf, twoBeforeLastHex, 3, 0, 0, -1, 2, lm, stats, pHitList);
+    searchExact(splix, firstHalf, lastHex, 3, 0, 0, 1, 2, lm, stats, pHitList);
     if (maxMismatch > 1)
 	{
-	searchExact12Vary6(splix, secondHalf, twoAfterFirstHex, 0, secondHalfPos-maxGap, -1, 1, lm, pHitList);
-	searchExact12Vary6(splix, secondHalf, firstHex, 0, secondHalfPos+maxGap, 1, 1, lm, pHitList);
-	searchExact12Vary6(splix, firstHalf, twoBeforeLastHex, 3, 0, -1, 2, lm, pHitList);
-	searchExact12Vary6(splix, firstHalf, lastHex, 3, 0, 1, 2, lm, pHitList);
-	searchVary12Exact6(splix, secondHalf, twoAfterFirstHex, 0, secondHalfPos-maxGap, -1, 1, lm, pHitList);
-	searchVary12Exact6(splix, secondHalf, firstHex, 0, secondHalfPos+maxGap, 1, 1, lm, pHitList);
-	searchVary12Exact6(splix, firstHalf, twoBeforeLastHex, 3, 0, -1, 2, lm, pHitList);
-	searchVary12Exact6(splix, firstHalf, lastHex, 3, 0, 1, 2, lm, pHitList);
+	searchExact12Vary6(splix, secondHalf, twoAfterFirstHex, 0, secondHalfPos-maxGap, -1, 1, lm, stats, pHitList);
+	searchExact12Vary6(splix, secondHalf, firstHex, 0, secondHalfPos+maxGap, 1, 1, lm, stats, pHitList);
+	searchExact12Vary6(splix, firstHalf, twoBeforeLastHex, 3, 0, -1, 2, lm, stats, pHitList);
+	searchExact12Vary6(splix, firstHalf, lastHex, 3, 0, 1, 2, lm, stats, pHitList);
+	searchVary12Exact6(splix, secondHalf, twoAfterFirstHex, 0, secondHalfPos-maxGap, -1, 1, lm, stats, pHitList);
+	searchVary12Exact6(splix, secondHalf, firstHex, 0, secondHalfPos+maxGap, 1, 1, lm, stats, pHitList);
+	searchVary12Exact6(splix, firstHalf, twoBeforeLastHex, 3, 0, -1, 2, lm, stats, pHitList);
+	searchVary12Exact6(splix, firstHalf, lastHex, 3, 0, 1, 2, lm, stats, pHitList);
 	}
     }
 }
@@ -957,11 +972,11 @@ return newList;
 
 static void splatOneStrand(struct dnaSeq *qSeq, bits64 bases25, char strand,
 	int tagPosition, struct splix *splix, int maxGap, 
-	struct lm *lm, struct splatTag **pTagList)
+	struct lm *lm, struct splatStats *stats, struct splatTag **pTagList)
 /* Align one query strand against index, filter, and write out results */
 {
 struct splatHit *hitList = NULL;
-splatHitsOneStrand(qSeq, bases25, strand, tagPosition, splix, maxGap, lm, &hitList);
+splatHitsOneStrand(qSeq, bases25, strand, tagPosition, splix, maxGap, lm, stats, &hitList);
 struct splatTag *tagList = NULL;
 int hitCount = slCount(hitList);
 verbose(2, " %d hits on %c strand\n", hitCount, strand);
@@ -982,8 +997,10 @@ if (hitCount > 0)
 }
 
 static void splatOne(struct dnaSeq *qSeqF, struct splix *splix, int maxGap, 
-	struct axtScoreScheme *scoreScheme, FILE *f, int *retMapCount, boolean *retIsRepeat)
-/* Align one query sequence against index, filter, and write out results.
+	struct axtScoreScheme *scoreScheme, struct splatStats *stats, FILE *f, FILE *repeatF,
+	int *retMapCount, boolean *retIsRepeat)
+/* Align one query sequence against index, filter, and write out results to f, or
+ * if it maps too many places to repeatF if that is non-NULL.
  * Returns the number of mappings. */
 {
 /* Local memory pool for hits and tags for this sequence. */
@@ -1008,18 +1025,18 @@ bits64 bases25f = basesToBits64(qSeqF->dna, 25);
 boolean isRepeatingOver = overCheck(bases25f, overArraySize, overArray);
 if (!isRepeatingOver)
     {
-    splatOneStrand(qSeqF, bases25f, '+', 0, splix, maxGap, lm, &tagList);
+    splatOneStrand(qSeqF, bases25f, '+', 0, splix, maxGap, lm, stats, &tagList);
     int tagPosition = qSeqR->size - desiredSize;
     bits64 bases25r = basesToBits64(qSeqR->dna + tagPosition, 25);
     isRepeatingOver = overCheck(bases25r, overArraySize, overArray);
     if (!isRepeatingOver)
-	splatOneStrand(qSeqR, bases25r, '-', tagPosition, splix, maxGap, lm, &tagList);
+	splatOneStrand(qSeqR, bases25r, '-', tagPosition, splix, maxGap, lm, stats, &tagList);
     }
 verbose(2, " %d tags\n", slCount(tagList));
 if (isRepeatingOver)
     {
-    if (repeatOutputFile != NULL)
-	faWriteNext(repeatOutputFile, qSeqF->name, qSeqF->dna, qSeqF->size);
+    if (repeatF != NULL)
+	faWriteNext(repeatF, qSeqF->name, qSeqF->dna, qSeqF->size);
     isRepeat = TRUE;
     }
 else if (tagList != NULL)
@@ -1033,18 +1050,18 @@ else if (tagList != NULL)
 
     /* Count up mappings, and output either to repeat file or to mapping file. */
     outputCount = slCount(tagList);
-    hits25 += outputCount;
+    stats->hits25 += outputCount;
     isRepeat = (outputCount > maxRepeat);
     if (isRepeat)
         {
-	if (repeatOutputFile != NULL)
-	    faWriteNext(repeatOutputFile, qSeqF->name, qSeqF->dna, qSeqF->size);
+	if (repeatF != NULL)
+	    faWriteNext(repeatF, qSeqF->name, qSeqF->dna, qSeqF->size);
 	outputCount = 0;
 	}
     else
         {
 	struct splatAlign *aliList = splatExtendTags(tagList, qSeqF, qSeqR, splix, scoreScheme);
-	hitsFull += slCount(aliList);
+	stats->hitsFull += slCount(aliList);
 	slSort(&aliList, splatAlignCmpScore);
 	splatOutList(aliList, out, qSeqF, qSeqR, splix, f);
 	splatAlignFreeList(&aliList);
@@ -1059,41 +1076,216 @@ lmCleanup(&lm);
 }
 
 
-void splat(char *target, char *query, char *output)
-/* splat - Speedy Local Alignment Tool. */
+struct splatReader
+/* Reads queries in batches.  Handles fastq itself and other formats via dnaLoad. */
+    {
+    struct lineFile *lf;	/* Open fasta or fastq file, or NULL. */
+    boolean isFastq;		/* True if lf is fastq rather than fasta. */
+    struct dnaLoad *dl;		/* Loader for 2bit, nib and lists of files, or NULL. */
+    };
+
+static struct splatReader *splatReaderOpen(char *fileName)
+/* Open up file of queries, figuring out what format it is in. */
 {
-struct axtScoreScheme *scoreScheme = axtScoreSchemeSimpleDna(2, 2, 2, 2);
-struct dnaLoad *qLoad = dnaLoadOpen(query);
-if (over != NULL)
+struct splatReader *reader;
+AllocVar(reader);
+if (!twoBitIsFile(fileName) && !nibIsFile(fileName))
     {
-    overRead(over, maxRepeat+1, &overArraySize, &overArray);
+    struct lineFile *lf = lineFileOpen(fileName, TRUE);
+    char *line;
+    if (lineFileNextReal(lf, &line))
+        {
+	lineFileReuse(lf);
+	if (line[0] == '@')
+	    reader->isFastq = TRUE;
+	else if (line[0] != '>')
+	    lineFileClose(&lf);
+	}
+    reader->lf = lf;
     }
-struct splix *splix = splixRead(target, memoryMap);
-verboseTime(1, "Loaded %s", target);
-FILE *f = mustOpen(output, "w");
+if (reader->lf == NULL)
+    reader->dl = dnaLoadOpen(fileName);
+return reader;
+}
+
+static void splatReaderClose(struct splatReader **pReader)
+/* Close up reader and free resources. */
+{
+struct splatReader *reader = *pReader;
+if (reader != NULL)
+    {
+    lineFileClose(&reader->lf);
+    dnaLoadClose(&reader->dl);
+    freez(pReader);
+    }
+}
+
+static struct dnaSeq *splatReaderNext(struct splatReader *reader)
+/* Return next query sequence, or NULL at end of file. */
+{
+if (reader->dl != NULL)
+    return dnaLoadNext(reader->dl);
+if (reader->isFastq)
+    {
+    struct fq *fq = fqReadNext(reader->lf);
+    if (fq == NULL)
+        return NULL;
+    char *name = firstWordInLine(fq->header + 1);
+    struct dnaSeq *seq = newDnaSeq(fq->dna, strlen(fq->dna), name);
+    fq->dna = NULL;
+    fqFree(&fq);
+    return seq;
+    }
+DNA *dna;
+char *name;
+int size;
+if (!faMixedSpeedReadNext(reader->lf, &dna, &size, &name))
+    return NULL;
+return newDnaSeq(cloneStringZ(dna, size), size, name);
+}
+
+struct splatChunk
+/* A group of reads aligned together in one thread.  Output is saved in memory so
+ * that it can be written in the same order as the input. */
+    {
+    struct splatChunk *next;
+    struct dnaSeq *seqList;	/* Reads to align. */
+    char *outBuf;		/* Alignment output. */
+    size_t outSize;		/* Size of alignment output. */
+    char *repeatBuf;		/* Reads that map too many places in fasta format. */
+    size_t repeatSize;		/* Size of repeatBuf. */
+    struct splatStats stats;	/* Work done aligning these reads. */
+    int readCount, mapCount, uniqCount, repeatCount;	/* Read counts for summary. */
+    };
+
+#define splatChunkSize 1000	/* Reads per chunk. */
+
+struct splatContext
+/* Things the same for all reads, shared between threads. */
+    {
+    struct splix *splix;	/* Index to search. */
+    struct axtScoreScheme *scoreScheme;	/* Scoring for extensions. */
+    };
+
+static void splatChunkFree(struct splatChunk **pChunk)
+/* Free up chunk and the reads in it. */
+{
+struct splatChunk *chunk = *pChunk;
+if (chunk != NULL)
+    {
+    dnaSeqFreeList(&chunk->seqList);
+    freeMem(chunk->outBuf);
+    freeMem(chunk->repeatBuf);
+    freez(pChunk);
+    }
+}
+
+static struct splatChunk *splatReadBatch(struct splatReader *reader, int maxCount)
+/* Read up to maxCount queries, divided into chunks.  Returns NULL at end of file. */
+{
+struct splatChunk *chunkList = NULL, *chunk = NULL;
+int count;
+for (count = 0; count < maxCount; ++count)
+    {
+    struct dnaSeq *seq = splatReaderNext(reader);
+    if (seq == NULL)
+        break;
+    if (chunk == NULL || chunk->readCount >= splatChunkSize)
+        {
+	AllocVar(chunk);
+	slAddHead(&chunkList, chunk);
+	}
+    slAddHead(&chunk->seqList, seq);
+    chunk->readCount += 1;
+    }
+for (chunk = chunkList; chunk != NULL; chunk = chunk->next)
+    slReverse(&chunk->seqList);
+slReverse(&chunkList);
+return chunkList;
+}
+
+static FILE *openMemOut(char **pBuf, size_t *pSize)
+/* Open a FILE that writes to memory, which will be in *pBuf after it is closed. */
+{
+FILE *f = open_memstream(pBuf, pSize);
+if (f == NULL)
+    errnoAbort("Couldn't open memory stream");
+return f;
+}
+
+static void splatChunkAlign(void *item, void *context)
+/* Align all the reads in a chunk.  Called in parallel by pthreadDoList. */
+{
+struct splatChunk *chunk = item;
+struct splatContext *sc = context;
+FILE *f = openMemOut(&chunk->outBuf, &chunk->outSize);
+FILE *repeatF = NULL;
 if (repeatOutput != NULL)
-    repeatOutputFile = mustOpen(repeatOutput, "w");
-splatOutHeader(target, query, out, f);
+    repeatF = openMemOut(&chunk->repeatBuf, &chunk->repeatSize);
 struct dnaSeq *qSeq;
-int uniqCount = 0, totalMap = 0, totalRepeat = 0, totalReads = 0;
-while ((qSeq = dnaLoadNext(qLoad)) != NULL)
+for (qSeq = chunk->seqList; qSeq != NULL; qSeq = qSeq->next)
     {
     verbose(2, "Processing %s\n", qSeq->name);
     toUpperN(qSeq->dna, qSeq->size);
     int mapCount = 0;
     boolean isRepeat = FALSE;
-    splatOne(qSeq, splix, maxGap, scoreScheme, f, &mapCount, &isRepeat);
+    splatOne(qSeq, sc->splix, maxGap, sc->scoreScheme, &chunk->stats, f, repeatF, 
+    	&mapCount, &isRepeat);
     verbose(2, " %d mappings\n", mapCount);
     if (mapCount > 0)
         {
-	++totalMap;
+	++chunk->mapCount;
 	if (mapCount == 1)
-	    ++uniqCount;
+	    ++chunk->uniqCount;
 	}
     if (isRepeat)
-        ++totalRepeat;
-    dnaSeqFree(&qSeq);
-    ++totalReads;
+        ++chunk->repeatCount;
+    }
+carefulClose(&f);
+carefulClose(&repeatF);
+}
+
+void splat(char *target, char *query, char *output)
+/* splat - Speedy Local Alignment Tool. */
+{
+struct splatContext context;
+context.scoreScheme = axtScoreSchemeSimpleDna(2, 2, 2, 2);
+struct splatReader *reader = splatReaderOpen(query);
+if (over != NULL)
+    overRead(over, maxRepeat+1, &overArraySize, &overArray);
+struct splix *splix = context.splix = splixRead(target, memoryMap);
+verboseTime(1, "Loaded %s", target);
+FILE *f = mustOpen(output, "w");
+FILE *repeatOutputFile = NULL;
+if (repeatOutput != NULL)
+    repeatOutputFile = mustOpen(repeatOutput, "w");
+splatOutHeader(target, query, out, f);
+
+/* Read queries a batch at a time, align them in parallel, and write out results in 
+ * the same order as the queries. */
+struct splatStats stats;
+ZeroVar(&stats);
+int uniqCount = 0, totalMap = 0, totalRepeat = 0, totalReads = 0;
+struct splatChunk *chunkList, *chunk;
+while ((chunkList = splatReadBatch(reader, batch)) != NULL)
+    {
+    pthreadDoList(threads, chunkList, splatChunkAlign, &context);
+    while ((chunk = slPopHead(&chunkList)) != NULL)
+        {
+	mustWrite(f, chunk->outBuf, chunk->outSize);
+	if (repeatOutputFile != NULL)
+	    mustWrite(repeatOutputFile, chunk->repeatBuf, chunk->repeatSize);
+	totalReads += chunk->readCount;
+	totalMap += chunk->mapCount;
+	uniqCount += chunk->uniqCount;
+	totalRepeat += chunk->repeatCount;
+	stats.exactIndexQueries += chunk->stats.exactIndexQueries;
+	stats.hits12 += chunk->stats.hits12;
+	stats.hits18 += chunk->stats.hits18;
+	stats.hits25 += chunk->stats.hits25;
+	stats.hitsFull += chunk->stats.hitsFull;
+	splatChunkFree(&chunk);
+	}
     }
 verboseTime(1, "Alignment");
 
@@ -1114,11 +1306,11 @@ verbose(1, "%d (%5.2f%%) mapped uniquely\n",
     uniqCount, 100.0 * uniqCount / totalReads);
 
 verbose(1, "%ld index queries, %ld hits12, %ld hits18, %ld hits25, %ld hitsFull\n", 
-	exactIndexQueries, hits12, hits18, hits25, hitsFull);
+	stats.exactIndexQueries, stats.hits12, stats.hits18, stats.hits25, stats.hitsFull);
 
 /* Clean up. */
 splixFree(&splix);
-dnaLoadClose(&qLoad);
+splatReaderClose(&reader);
 carefulClose(&f);
 carefulClose(&repeatOutputFile);
 }
@@ -1141,6 +1333,12 @@ maxMismatch = optionInt("maxMismatch", maxMismatch);
 exactOnly = (maxGap == 0 && maxMismatch == 0);
 tagSize = maxGap + splixMinQuerySize;
 memoryMap = optionExists("mmap");
+threads = optionInt("threads", threads);
+batch = optionInt("batch", batch);
+if (threads < 1)
+    errAbort("-threads must be at least 1");
+if (batch < 1)
+    errAbort("-batch must be at least 1");
 if (maxGap > 1)
     errAbort("Sorry, for now maxGap must be just 0 or 1");
 dnaUtilOpen();
@@ -6,9 +6,9 @@
 #include "hash.h"
 #include "options.h"
 #include "sqlNum.h"
-#include "localmem.h"
 #include "dnaLoad.h"
 #include "dnaseq.h"
+#include "sais.h"
 #include "sufa.h"
 
 
@@ -26,20 +26,6 @@ errAbort(
   );
 }
 
-/* Base values in _alphabetical_ order. Unfortunately the ones in dnautil.h are not.... */
-#define SUFA_A 0
-#define SUFA_C 1
-#define SUFA_G 2
-#define SUFA_T 3
-
-/* Hex conversions to assist debugging:
- * 0=AA 1=AC 2=AG 3=AT 4=CA 5=CC 6=CG 7=CT
- * 8=GA 9=GC A=GG B=GT C=TA D=TC E=TG F=TT
- */
-
-/* Table to convert letters to one of the above values. */
-int baseToVal[256];
-
 static struct optionSpec options[] = {
    {NULL, 0},
 };
@@ -51,22 +37,9 @@ struct chromInfo
     char *name;		/* Chromosome/contig name. */
     bits32 size;	/* Chromosome size. */
     bits32 offset;	/* Chromosome offset in total DNA */
-    bits32 basesIndexed; /* Bases actually indexed. */
     struct dnaSeq *seq;	/* Chromosome sequence. */
     };
 
-struct sufaOneBaseListy
-/* Temporary structure to store information on one base.  This will get compressed to a
- * smaller structure.  The motivation for this is that we can make a list out of these
- * as we go.  When we're done we can compress it into an array. */
-    {
-    struct sufaOneBaseListy *next;
-    bits32 dnaOffset;	/* Offset to start in dna. */
-    bits32 nextTwelve;	/* Next twelve bases in binary representation. */
-    };
-
-#define sufaSlotCount (1<<(12*2))
-
 bits64 roundUpTo4(bits64 x)
 /* Round x up to next multiple of 4 */
 {
@@ -87,118 +60,20 @@ for (i=0; i<size; i+=2)
     fprintf(f, "%c%c ", s[i], s[i+1]);
 }
 
-struct chromInfo *indexChromPass1(struct dnaSeq *seq, bits32 chromOffset, struct lm *lm,
-	struct sufaOneBaseListy **listyIndex)
-/* Create a sufaOneBaseListy for each base in seq, and hang it in appropriate slot
- * in listyIndex. */
+struct chromInfo *chromInfoFromSeq(struct dnaSeq *seq, bits32 chromOffset)
+/* Create a chromInfo for seq, which is at chromOffset in all DNA. */
 {
-int baseIx;
-DNA *dna = seq->dna;
-int seqSize = seq->size;
-int basesIndexed = 0;
-int maskTil = 0;
-
 struct chromInfo *chrom;
 AllocVar(chrom);
 chrom->name = cloneString(seq->name);
 chrom->size = seq->size;
 chrom->offset = chromOffset;
 chrom->seq = seq;
-
-/* Store six bases at a time: two sets of six before and after our middle set of 12 */
-bits32 twelve1 = 0, twelve2 = 0;
-
-/* Preload the hex arrays with the first 23 bases. */
-for (baseIx=0; baseIx<11; ++baseIx)
-    {
-    int baseLetter = dna[baseIx];
-    if (baseLetter == 'N')
-        maskTil = baseIx + 24;
-    twelve1 <<= 2;
-    twelve1 += baseToVal[baseLetter];
-    }
-for (baseIx=11; baseIx<23; ++baseIx)
-    {
-    int baseLetter = dna[baseIx];
-    if (baseLetter == 'N')
-        maskTil = baseIx + 24;
-    twelve2 <<= 2;
-    twelve2 += baseToVal[baseLetter];
-    }
-    
-/* Do the middle part of the sequence where there are no end conditions to consider. */
-for (baseIx = 23; baseIx < seqSize; ++baseIx)
-    {
-    int baseLetter = dna[baseIx];
-    if (baseLetter == 'N')
-        maskTil = baseIx + 24;
-    twelve1 = (twelve1 << 2) + (twelve2>>22);
-    twelve2 = (twelve2 << 2) + baseToVal[baseLetter];
-    twelve1 &= 0xFFFFFF;
-    twelve2 &= 0xFFFFFF;
-    if (baseIx >= maskTil)
-	{
-	struct sufaOneBaseListy *temp;
-	lmAllocVar(lm, temp);
-	temp->dnaOffset = baseIx - 23 + chromOffset;
-	temp->nextTwelve = twelve2;
-	slAddHead(&listyIndex[twelve1], temp);
-	++basesIndexed;
-	}
-    }
-chrom->basesIndexed = basesIndexed;
 return chrom;
 }
 
-char *globalAllDna;	/* Copy of all DNA for sort function. */
-
-static int cmpAfter16(const void *va, const void *vb)
-/* Compare to sort, assuming first 16 bases already match. */
-{
-const struct sufaOneBaseListy *a = *((struct sufaOneBaseListy **)va);
-const struct sufaOneBaseListy *b = *((struct sufaOneBaseListy **)vb);
-return strcmp(globalAllDna + a->dnaOffset + 16, globalAllDna + b->dnaOffset + 16);
-}
-
-void finishAndWriteOneSlot(struct sufaOneBaseListy **listyIndex, int slotIx, DNA *allDna,
-	FILE *f)
-/* Do additional sorting and write results to file. */
-{
-struct sufaOneBaseListy *el, *nextEl, *slotList = listyIndex[slotIx];
-if (slotList != NULL)
-    {
-    /* Do in affect a secondary bucket sort on the 13-16th bases. */
-    struct sufaOneBaseListy *buckets[256];
-    int bucketIx;
-    for (bucketIx = 0; bucketIx < ArraySize(buckets); bucketIx += 1)
-        buckets[bucketIx] = NULL;
-    for (el = slotList; el != NULL; el = nextEl)
-        {
-	nextEl = el->next;
-	bucketIx = (el->nextTwelve >> 16);
-	slAddHead(&buckets[bucketIx], el);
-	}
-
-    for (bucketIx = 0; bucketIx < ArraySize(buckets); ++bucketIx )
-        {
-	struct sufaOneBaseListy *bucketList = buckets[bucketIx];
-	if (bucketList != NULL)
-	    {
-	    if (bucketList->next == NULL)
-	        writeOne(f, bucketList->dnaOffset);
-	    else
-	        {
-		slSort(&bucketList, cmpAfter16);
-		for (el = bucketList; el != NULL; el = el->next)
-		    writeOne(f, el->dnaOffset);
-		}
-	    }
-	}
-    }
-}
-
 void sufaWriteMerged(struct chromInfo *chromList, DNA *allDna,
-	struct sufaOneBaseListy **listyIndex, bits64 totalBasesIndexed, char *output)
+	bits32 *suffixArray, bits64 totalBasesIndexed, char *output)
 /* Write out a file that contains a single splix that is the merger of
  * all of the individual splixes in list. */
 {
@@ -255,11 +130,8 @@ mustWrite(f, allDna, dnaDiskSize);
 zeroPad(f, header->dnaDiskSize - dnaDiskSize);
 verbose(1, "Wrote %lld bases of DNA in including zero padding\n", header->dnaDiskSize);
 
-/* Calculate and write suffix array. */
-int slotCount = sufaSlotCount;
-int slotIx;
-for (slotIx=0; slotIx < slotCount; ++slotIx)
-    finishAndWriteOneSlot(listyIndex, slotIx, allDna, f);
+/* Write suffix array. */
+mustWrite(f, suffixArray, totalBasesIndexed*sizeof(bits32));
 verbose(1, "Wrote %lld suffix array positions\n", totalBasesIndexed);
 
 carefulClose(&f);
@@ -274,21 +146,12 @@ bits64 maxGenomeSize = 1024LL*1024*1024*4;
 if (estimatedGenomeSize >= maxGenomeSize)
     errAbort("Can only handle genomes up to 4000 meg, sorry.");
 
-/* Fill out baseToVal array - A is already done. */
-baseToVal[(int)'C'] = baseToVal[(int)'c'] = SUFA_C;
-baseToVal[(int)'G'] = baseToVal[(int)'g'] = SUFA_G;
-baseToVal[(int)'T'] = baseToVal[(int)'t'] = SUFA_T;
-
-struct lm *lm = lmInit(0);
 struct hash *uniqHash = hashNew(0);
 struct chromInfo *chrom, *chromList = NULL;
 bits64 chromOffset = 1;	/* Space for zero at beginning. */
-DNA *allDna = globalAllDna = needHugeMem(estimatedGenomeSize);
+DNA *allDna = needHugeMem(estimatedGenomeSize);
 allDna[0] = 0;
 
-struct sufaOneBaseListy **listyIndex;
-AllocArray(listyIndex, sufaSlotCount);
-bits32 totalBasesIndexed = 0;
 int inputIx;
 for (inputIx=0; inputIx<inCount; ++inputIx)
     {
@@ -305,20 +168,23 @@ for (inputIx=0; inputIx<inCount; ++inputIx)
 		     "(including one base pad before and after each chromosome.)", 
 		     estimatedGenomeSize, currentSize);
 	hashAddUnique(uniqHash, seq->name, NULL);
-	chrom = indexChromPass1(seq, chromOffset, lm, listyIndex);
+	chrom = chromInfoFromSeq(seq, chromOffset);
 	memcpy(allDna + chromOffset, seq->dna, seq->size + 1);
 	chromOffset = currentSize;
-	totalBasesIndexed += chrom->basesIndexed;
 	slAddHead(&chromList, chrom);
 	dnaSeqFree(&seq);
 	}
     dnaLoadClose(&dl);
     }
-verbose(1, "Indexed %lld bases\n", (long long)totalBasesIndexed);
 slReverse(&chromList);
-sufaWriteMerged(chromList, allDna, listyIndex, totalBasesIndexed, output);
-lmCleanup(&lm);
-freez(&listyIndex);
+
+/* Sort suffixes that have 24 bases before the end of their chromosome and no N's in
+ * those bases. */
+bits32 *suffixArray = needHugeMem((chromOffset+1) * sizeof(bits32));
+bits64 totalBasesIndexed = saisDnaIndex(allDna, chromOffset, 24, 24, suffixArray);
+verbose(1, "Indexed %lld bases\n", totalBasesIndexed);
+sufaWriteMerged(chromList, allDna, suffixArray, totalBasesIndexed, output);
+freez(&suffixArray);
 }
 
 int main(int argc, char *argv[])
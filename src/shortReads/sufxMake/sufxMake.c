@@ -8,6 +8,7 @@
 #include "sqlNum.h"
 #include "dnaLoad.h"
 #include "dnaseq.h"
+#include "sais.h"
 #include "sufx.h"
 
 
@@ -25,20 +26,6 @@ errAbort(
   );
 }
 
-/* Base values in _alphabetical_ order. Unfortunately the ones in dnautil.h are not.... */
-#define SUFX_A 0
-#define SUFX_C 1
-#define SUFX_G 2
-#define SUFX_T 3
-
-/* Hex conversions to assist debugging:
- * 0=AA 1=AC 2=AG 3=AT 4=CA 5=CC 6=CG 7=CT
- * 8=GA 9=GC A=GG B=GT C=TA D=TC E=TG F=TT
- */
-
-/* Table to convert letters to one of the above values. */
-int baseToVal[256];
-
 static struct optionSpec options[] = {
    {NULL, 0},
 };
@@ -54,8 +41,6 @@ struct chromInfo
     };
 
 
-#define sufxSlotCount (1<<(12*2))
-
 bits64 roundUpTo4(bits64 x)
 /* Round x up to next multiple of 4 */
 {
@@ -76,185 +61,18 @@ for (i=0; i<size; i+=2)
     fprintf(f, "%c%c ", s[i], s[i+1]);
 }
 
-struct chromInfo *indexChromPass1(struct dnaSeq *seq, bits32 chromOffset, 
-	bits32 *offsetArray, bits32 *listArray, bits32 *twelvemerIndex)
-/* Create a sufxOneBaseListy for each base in seq, and hang it in appropriate slot
- * in listyIndex. */
+struct chromInfo *chromInfoFromSeq(struct dnaSeq *seq, bits32 chromOffset)
+/* Create a chromInfo for seq, which is at chromOffset in all DNA. */
 {
-bits32 baseIx;
-DNA *dna = seq->dna;
-bits32 seqSize = seq->size;
-bits32 maskTil = 0;
-
 struct chromInfo *chrom;
 AllocVar(chrom);
 chrom->name = cloneString(seq->name);
 chrom->size = seq->size;
 chrom->offset = chromOffset;
 chrom->seq = seq;
-
-verbose(2, "   start short initial loop\n");
-/* Preload the twelvemer with the first 11 bases. */
-bits32 twelve = 0;
-for (baseIx=0; baseIx<11; ++baseIx)
-    {
-    int baseLetter = dna[baseIx];
-    if (baseLetter == 'N')
-        maskTil = baseIx + 12;
-    twelve <<= 2;
-    twelve += baseToVal[baseLetter];
-    }
-
-verbose(2, "   start main loop\n");
-/* Do the middle part of the sequence where there are no end conditions to consider. */
-bits32 freePos = chromOffset;
-for (baseIx = 11; baseIx < seqSize; ++baseIx)
-    {
-    int baseLetter = dna[baseIx];
-    if (baseLetter == 'N')
-        maskTil = baseIx + 12;
-    twelve = (twelve << 2) + baseToVal[baseLetter];
-    twelve &= 0xFFFFFF;
-    if (baseIx >= maskTil)
-	{
-	offsetArray[freePos] = baseIx - 11 + chromOffset;
-	listArray[freePos] = twelvemerIndex[twelve];
-	twelvemerIndex[twelve] = freePos;
-	++freePos;
-	}
-    }
-verbose(2, "   end main loop\n");
 return chrom;
 }
 
-char *globalAllDna;	/* Copy of all DNA for sort function. */
-
-static int cmpAfter16(const void *va, const void *vb)
-/* Compare to sort, assuming first 16 bases already match. */
-{
-bits32 a = *((bits32 *)va);
-bits32 b = *((bits32 *)vb);
-return strcmp(globalAllDna + a + 16, globalAllDna + b + 16);
-}
-
-static int binary4(DNA *dna)
-/* Return next 4 bases in binary format.  Return -1 if there is an N. */
-{
-bits32 packedDna = 0;
-int i;
-for (i=0; i<4; ++i)
-    {
-    int baseLetter = dna[i];
-    if (baseLetter == 'N')
-        return -1;
-    packedDna <<= 2;
-    packedDna += baseToVal[baseLetter];
-    }
-return packedDna;
-}
-
-void sortAndWriteOffsets(bits32 firstIx, bits32 *offsetArray, bits32 *listArray, 
-	DNA *allDna, FILE *f)
-/* Set up and do a qsort on list that starts at firstIx.  Write result to file. */
-{
-/* Count up length of list. */
-int listSize = 0;
-bits32 listIx;
-for (listIx = firstIx; listIx != 0; listIx = listArray[listIx])
-    ++listSize;
-
-/* Get an array to hold all offsets in list, hopefully a small one on stack,
- * but if need be a big one on heap */
-bits32 smallArray[32], *bigArray = NULL, *sortArray;
-if (listSize <= ArraySize(smallArray))
-    sortArray = smallArray;
-else
-    AllocArray(sortArray, listSize);
-
-/* Copy list to array for sorting. */
-int sortIx;
-for (sortIx=0, listIx=firstIx; listIx != 0; ++sortIx, listIx=listArray[listIx])
-    sortArray[sortIx] = offsetArray[listIx];
-
-/* Do the qsort.  I hope I got the cmp function right! */
-qsort(sortArray, listSize, sizeof(sortArray[0]), cmpAfter16);
-
-/* Write out sorted result. */
-mustWrite(f, sortArray, listSize * sizeof(bits32));
-
-/* Clean up. */
-if (bigArray)
-    freeMem(bigArray);
-}
-
-
-bits64 finishAndWriteOneSlot(bits32 *offsetArray, bits32 *listArray, bits32 *twelvemerIndex,
-	bits32 slotIx, DNA *allDna, FILE *f)
-/* Do additional sorting and write results to file.  Return amount actually written. */
-{
-bits64 basesIndexed = 0;
-bits32 elIx, nextElIx, slotFirstIx = twelvemerIndex[slotIx];
-if (slotFirstIx != 0)
-    {
-    /* Do in affect a secondary bucket sort on the 13-16th bases. */
-    bits32 buckets[256];
-    bits32 bucketIx;
-    for (bucketIx = 0; bucketIx < ArraySize(buckets); bucketIx += 1)
-        buckets[bucketIx] = 0;
-    for (elIx = slotFirstIx; elIx != 0; elIx = nextElIx)
-        {
-	nextElIx = listArray[elIx];
-	int bucketIx = binary4(allDna + offsetArray[elIx] + 12U);
-	if (bucketIx >= 0)
-	    {
-	    listArray[elIx] = buckets[bucketIx];
-	    buckets[bucketIx] = elIx;
-	    ++basesIndexed;
-	    }
-	}
-
-    /* Do final sorting within buckets. */
-    for (bucketIx = 0; bucketIx < ArraySize(buckets); ++bucketIx )
-        {
-	bits32 firstIx = buckets[bucketIx];
-	if (firstIx != 0)
-	    {
-	    bits32 secondIx = listArray[firstIx];
-	    if (secondIx == 0)
-	        {
-		/* Special case for size one list, there are lots of these! */
-	        writeOne(f, offsetArray[firstIx]);
-		}
-	    else
-	        {
-		if (listArray[secondIx] == 0)
-		    {
-		    bits32 firstOffset = offsetArray[firstIx];
-		    bits32 secondOffset = offsetArray[secondIx];
-		    /* Special case for size two list.  There are still quite a few of these. */
-		    if (strcmp(allDna+firstOffset, allDna+secondOffset) < 0)
-		        {
-			writeOne(f, secondOffset);
-			writeOne(f, firstOffset);
-			}
-		    else
-		        {
-			writeOne(f, firstOffset);
-			writeOne(f, secondOffset);
-			}
-		    }
-		else
-		    {
-		    /* Three or more - do it the hard way... */
-		    sortAndWriteOffsets(firstIx, offsetArray, listArray, allDna, f);
-		    }
-		}
-	    }
-	}
-    }
-return basesIndexed;
-}
-
 void sufxFillInTraverseArray(char *dna, bits32 *suffixArray, bits64 arraySize, bits32 *traverseArray)
 /* Fill in the bits that will help us traverse the array as if it were a tree. */
 {
@@ -299,10 +117,9 @@ for (stackIx=0; stackIx < depth; ++stackIx)
 
 
 void sufxWriteMerged(struct chromInfo *chromList, DNA *allDna,
-	bits32 *offsetArray, bits32 *listArray, bits32 *twelvemerIndex, char *output)
+	bits32 *suffixArray, bits64 arraySize, char *output)
 /* Write out a file that contains a single splix that is the merger of
- * all of the individual splixes in list.   As a side effect will replace
- * offsetArray with suffix array and listArray with traverse array */
+ * all of the individual splixes in list. */
 {
 FILE *f = mustOpen(output, "w+");
 
@@ -347,29 +164,12 @@ mustWrite(f, allDna, dnaDiskSize);
 zeroPad(f, header->dnaDiskSize - dnaDiskSize);
 verbose(1, "Wrote %lld bases of DNA including zero padding\n", header->dnaDiskSize);
 
-/* Calculate and write suffix array. */
-bits64 arraySize = 0;
-off_t suffixArrayFileOffset = ftello(f);
-int slotCount = sufxSlotCount;
-int slotIx;
-for (slotIx=0; slotIx < slotCount; ++slotIx)
-    arraySize += finishAndWriteOneSlot(offsetArray, listArray, twelvemerIndex, slotIx, allDna, f);
+/* Write suffix array. */
+mustWrite(f, suffixArray, arraySize*sizeof(bits32));
 verbose(1, "Wrote %lld suffix array positions\n", arraySize);
 
-/* Now we're done with the offsetArray and listArray buffers, so use them for the
- * next phase. */
-bits32 *suffixArray = offsetArray;
-offsetArray = NULL;	/* Help make some errors more obvious */
-bits32 *traverseArray = listArray;
-listArray = NULL;	/* Help make some errors more obvious */
-
-/* Read the suffix array back from the file. */
-fseeko(f, suffixArrayFileOffset, SEEK_SET);
-mustRead(f, suffixArray, arraySize*sizeof(bits32));
-verbose(1, "Read suffix array back in\n");
-
 /* Calculate traverse array */
-memset(traverseArray, 0, arraySize*sizeof(bits32));
+bits32 *traverseArray = needHugeZeroedMem(arraySize*sizeof(bits32));
 sufxFillInTraverseArray(allDna, suffixArray, arraySize, traverseArray);
 verbose(1, "Filled in traverseArray\n");
 
@@ -403,39 +203,12 @@ bits64 maxGenomeSize = 1024LL*1024*1024*4;
 if (estimatedGenomeSize >= maxGenomeSize)
     errAbort("Can only handle genomes up to 4000 meg, sorry.");
 
-/* Fill out baseToVal array - A is already done. */
-baseToVal[(int)'C'] = baseToVal[(int)'c'] = SUFX_C;
-baseToVal[(int)'G'] = baseToVal[(int)'g'] = SUFX_G;
-baseToVal[(int)'T'] = baseToVal[(int)'t'] = SUFX_T;
-
 struct hash *uniqHash = hashNew(0);
 struct chromInfo *chrom, *chromList = NULL;
 bits64 chromOffset = 1;	/* Space for zero at beginning. */
-DNA *allDna = globalAllDna = needHugeMem(estimatedGenomeSize);
+DNA *allDna = needHugeMem(estimatedGenomeSize);
 allDna[0] = 0;
 
-/* Allocate index array, and offset and list arrays. */
-bits32 *twelvemerIndex;
-AllocArray(twelvemerIndex, sufxSlotCount);
-
-/* Where normally we'd keep some sort of structure with a next element to form a list
- * of matching positions in each slot of our index,  to conserve memory we'll do this
- * with two parallel arrays.  Because we're such cheapskates in terms of memory we'll
- * (and still using 9*genomeSize bytes of RAM) we'll use these arrays for two different
- * purposes.   
- *     In the first phase they will together be used to form linked lists of
- * offsets, and the twelvemer index will point to the first item in each list.  In this
- * phase the offsetArray contains offsets into the allDna structure, and the listArray
- * contains the next pointers for the list.  After the first phase we write out the
- * suffix array to disk.
- *     In the second phase we read the suffix array back into the offsetArray, and
- * use the listArray for the traverseArray.  We write out the traverse array to finish
- * things up. */
-
-bits32 *offsetArray = needHugeMem(estimatedGenomeSize * sizeof(bits32));
-bits32 *listArray = needHugeZeroedMem(estimatedGenomeSize * sizeof(bits32));;
-verbose(1, "Allocated buffers: %lld bytes total\n", 9LL*estimatedGenomeSize + sufxSlotCount*4);
-
 int inputIx;
 for (inputIx=0; inputIx<inCount; ++inputIx)
     {
@@ -452,9 +225,7 @@ for (inputIx=0; inputIx<inCount; ++inputIx)
 		     "(including one base pad before and after each chromosome.)", 
 		     estimatedGenomeSize, currentSize);
 	hashAddUnique(uniqHash, seq->name, NULL);
-	verbose(2, "  About to do first pass index\n");
-	chrom = indexChromPass1(seq, chromOffset, offsetArray, listArray, twelvemerIndex);
-	verbose(2, "  Done first pass index\n");
+	chrom = chromInfoFromSeq(seq, chromOffset);
 	memcpy(allDna + chromOffset, seq->dna, seq->size + 1);
 	verbose(2, "  Done copy to allDna + %lld, size %d, totalSize %lld\n", chromOffset, seq->size+1, currentSize);
 	chromOffset = currentSize;
@@ -463,9 +234,14 @@ for (inputIx=0; inputIx<inCount; ++inputIx)
 	}
     dnaLoadClose(&dl);
     }
-verbose(1, "Done big bucket sort\n");
 slReverse(&chromList);
-sufxWriteMerged(chromList, allDna, offsetArray, listArray, twelvemerIndex, output);
+
+/* Sort suffixes that have 12 bases before the end of their chromosome and no N's in
+ * their first 16 bases. */
+bits32 *suffixArray = needHugeMem((chromOffset+1) * sizeof(bits32));
+bits64 arraySize = saisDnaIndex(allDna, chromOffset, 12, 16, suffixArray);
+verbose(1, "Sorted %lld suffixes\n", arraySize);
+sufxWriteMerged(chromList, allDna, suffixArray, arraySize, output);
 }
 
 int main(int argc, char *argv[])
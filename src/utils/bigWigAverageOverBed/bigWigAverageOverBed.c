@@ -18,6 +18,7 @@ char *bedOut = NULL;
 char *statsRa = NULL;
 int sampleAroundCenter = 0;
 boolean tsv = FALSE;
+boolean stream = FALSE;
 
 void usage()
 /* Explain usage and exit. */
@@ -40,6 +41,9 @@ errAbort(
   "                     than the usual sample in the bed item.\n"
   "   -minMax - include two additional columns containing the min and max observed in the area.\n"
   "   -tsv - include a TSV header for input to other tools.\n"
+  "   -stream - sort bed by position and make a single pass through the bigWig, decompressing\n"
+  "             each data block just once.  Fastest for dense sets of regions such as promoters\n"
+  "             or tiled windows.  Output is in sorted order.\n"
   );
 }
 
@@ -49,6 +53,7 @@ static struct optionSpec options[] = {
    {"sampleAroundCenter", OPTION_INT},
    {"minMax", OPTION_BOOLEAN},
    {"tsv", OPTION_BOOLEAN},
+   {"stream", OPTION_BOOLEAN},
    {NULL, 0},
 };
 
@@ -68,29 +73,45 @@ for (bed = bedList; bed != NULL; bed = bed->next)
 hashFree(&hash);
 }
 
-void addBigWigIntervalInfo(struct bbiFile *bbi, struct lm *lm, char *chrom, int start, int end,
+float *floatBuf = NULL;	/* Per-base values of region being averaged. */
+int floatBufSize = 0;	/* Allocated size of floatBuf */
+
+void addBigWigIntervalInfo(struct bbiFile *bbi, char *chrom, int start, int end,
     int *pSumSize, int *pSumCoverage, double *pSumVal, double *pMin, double *pMax)
-/* Read in interval from bigBed and add it sums. */
+/* Read in interval from bigWig and add it sums. */
 {
-struct bbiInterval *iv, *ivList = bigWigIntervalQuery(bbi, chrom, start, end, lm);
 *pSumSize += (end - start);
-double maxVal = *pMax, minVal = *pMin;
-for (iv = ivList; iv != NULL; iv = iv->next)
+if (start < 0 || start >= end)
+    return;
+
+/* Fetch a window at a time into a flat array and summarize that, so huge beds
+ * don't need a huge buffer. */
+struct bbiSummaryElement sum;
+ZeroVar(&sum);
+int windowStart;
+for (windowStart = start; windowStart < end; windowStart += bbiMaxFloatSummaryBases)
     {
-    int cov1 = rangeIntersection(iv->start, iv->end, start, end);
-    if (cov1 > 0)
-	{
-	*pSumCoverage += cov1;
-	double val = iv->val;
-	if (maxVal < val)
-	    maxVal = val;
-	if (minVal > val)
-	    minVal = val;
-	*pSumVal += cov1 * val;
+    int windowEnd = min(end, windowStart + bbiMaxFloatSummaryBases);
+    int windowSize = windowEnd - windowStart;
+    if (windowSize > floatBufSize)
+        {
+	freeMem(floatBuf);
+	floatBufSize = max(windowSize, 2*floatBufSize);
+	floatBufSize = min(floatBufSize, bbiMaxFloatSummaryBases);
+	floatBuf = needLargeMem(floatBufSize * sizeof(float));
 	}
+    if (bigWigFloatQuery(bbi, chrom, windowStart, windowEnd, floatBuf) > 0)
+	bbiSummarizeFloats(floatBuf, windowSize, &sum);
+    }
+if (sum.validCount > 0)
+    {
+    *pSumCoverage += sum.validCount;
+    *pSumVal += sum.sumData;
+    if (*pMax < sum.maxVal)
+	*pMax = sum.maxVal;
+    if (*pMin > sum.minVal)
+	*pMin = sum.minVal;
     }
-*pMin = minVal;
-*pMax = maxVal;
 }
 	
 int countBlocks(struct bed *bedList, int fieldCount)
@@ -131,6 +152,27 @@ sumCoverage += coverage;
 sumSize += size;
 }
 
+void outputOneAverage(FILE *f, FILE *bedF, struct bed *bed, int fieldCount, 
+    boolean outputMinMax, int size, int coverage, double sum, double minVal, double maxVal)
+/* Print out result for one bed, fudging mean to 0 if no coverage at all, and add it
+ * to the overall sums. */
+{
+double mean = 0;
+if (coverage > 0)
+     mean = sum/coverage;
+fprintf(f, "%s\t%d\t%d\t%g\t%g\t%g", bed->name, size, coverage, sum, sum/size, mean);
+if (outputMinMax)
+    {
+    if (coverage > 0)
+	fprintf(f, "\t%g\t%g", minVal, maxVal);
+    else
+	fprintf(f, "\t0\t0");       // put out zeros for min/max if no coverage
+    }
+fputc('\n', f);
+optionallyPrintBedPlus(bedF, bed, fieldCount, mean, outputMinMax, minVal, maxVal);
+updateSums(sum, coverage, size);
+}
+
 long long bbiTotalChromSize(struct bbiFile *bbi)
 /* Return sum of sizes of all chromosomes */
 {
@@ -165,7 +207,6 @@ void averageFetchingEachBlock(struct bbiFile *bbi, struct bed *bedList, int fiel
 	int outputMinMax, FILE *f, FILE *bedF)
 /* Do the averaging fetching each block from bedList from bigWig.  Fastest for short bedList. */
 {
-struct lm *lm = lmInit(0);
 struct bed *bed;
 for (bed = bedList; bed != NULL; bed = bed->next)
     {
@@ -178,13 +219,13 @@ for (bed = bedList; bed != NULL; bed = bed->next)
         {
 	int center = (bed->chromStart + bed->chromEnd)/2;
 	int left = center - (sampleAroundCenter/2);
-	addBigWigIntervalInfo(bbi, lm, bed->chrom, left, left+sampleAroundCenter, 
+	addBigWigIntervalInfo(bbi, bed->chrom, left, left+sampleAroundCenter, 
 		&size, &coverage, &sum, &minVal, &maxVal);
 	}
     else
 	{
 	if (fieldCount < 12)
-	    addBigWigIntervalInfo(bbi, lm, bed->chrom, bed->chromStart, bed->chromEnd, 
+	    addBigWigIntervalInfo(bbi, bed->chrom, bed->chromStart, bed->chromEnd, 
 		    &size, &coverage, &sum, &minVal, &maxVal);
 	else
 	    {
@@ -193,27 +234,14 @@ for (bed = bedList; bed != NULL; bed = bed->next)
 		{
 		int start = bed->chromStart + bed->chromStarts[i];
 		int end = start + bed->blockSizes[i];
-		addBigWigIntervalInfo(bbi, lm, bed->chrom, start, end, &size, &coverage, &sum, 
+		addBigWigIntervalInfo(bbi, bed->chrom, start, end, &size, &coverage, &sum, 
 		    &minVal, &maxVal);
 		}
 	    }
 	}
 
-    /* Print out result, fudging mean to 0 if no coverage at all. */
-    double mean = 0;
-    if (coverage > 0)
-	 mean = sum/coverage;
-    fprintf(f, "%s\t%d\t%d\t%g\t%g\t%g", bed->name, size, coverage, sum, sum/size, mean);
-    if (outputMinMax)
-        {
-        if (coverage > 0)
-            fprintf(f, "\t%g\t%g", minVal, maxVal);
-        else
-            fprintf(f, "\t0\t0");       // put out zeros for min/max if no coverage
-        }
-    fputc('\n', f);
-    optionallyPrintBedPlus(bedF, bed, fieldCount, mean, outputMinMax, minVal, maxVal);
-    updateSums(sum, coverage, size);
+    outputOneAverage(f, bedF, bed, fieldCount, outputMinMax, 
+	size, coverage, sum, minVal, maxVal);
     }
 }
 
@@ -348,6 +376,186 @@ for (bedList = *pBedList; bedList != NULL; bedList = nextChrom)
 verbose(1, "\n");
 }
 
+struct bedSums
+/* Sums accumulated over one bed while streaming. */
+    {
+    struct bed *bed;	/* Bed we are summing over. */
+    int size;		/* Sum of sizes of pieces. */
+    int coverage;	/* Bases in pieces covered by bigWig. */
+    double sum;		/* Sum of bigWig values over covered bases. */
+    double minVal, maxVal;	/* Extreme values seen. */
+    };
+
+struct bedPiece
+/* A range we are averaging over - an exon, the whole bed, or the part around its center. */
+    {
+    struct bedPiece *next;	/* Next in active list. */
+    int start, end;		/* Range covered, half open. */
+    struct bedSums *sums;	/* Sums for the bed this is part of. */
+    };
+
+int bedPieceCmpStart(const void *va, const void *vb)
+/* Compare bedPieces by start. */
+{
+const struct bedPiece *a = va;
+const struct bedPiece *b = vb;
+return a->start - b->start;
+}
+
+int bedCmpChromStart(const void *va, const void *vb)
+/* Compare beds by chromosome, with chr4 before chr14, and then by start. */
+{
+int dif = bedCmpChrom(va, vb);
+if (dif == 0)
+    {
+    const struct bed *a = *((struct bed **)va);
+    const struct bed *b = *((struct bed **)vb);
+    dif = a->chromStart - b->chromStart;
+    }
+return dif;
+}
+
+struct pieceSweep
+/* Keeps track of which pieces are overlapped as we go through bigWig items in order. */
+    {
+    struct bedPiece *pieces;	/* All pieces on chromosome, sorted by start. */
+    int pieceCount;		/* Number of pieces. */
+    int nextPiece;		/* Index of first piece not yet in active list. */
+    struct bedPiece *activeList;	/* Pieces that may overlap current item. */
+    };
+
+void pieceSweepAdd(void *context, bits32 start, bits32 end, float val)
+/* Add bigWig item to all the pieces it overlaps.  Items must come in order of start.
+ * A BigWigItemFunc with a pieceSweep for context. */
+{
+struct pieceSweep *sweep = context;
+/* Bring in pieces that start before item ends. */
+while (sweep->nextPiece < sweep->pieceCount && sweep->pieces[sweep->nextPiece].start < end)
+    {
+    /* Link directly rather than with slAddHead, which writes through a struct slList
+     * pointer that the optimizer may not see alias the reads of activeList below. */
+    struct bedPiece *piece = &sweep->pieces[sweep->nextPiece++];
+    piece->next = sweep->activeList;
+    sweep->activeList = piece;
+    }
+
+/* Drop pieces that end before item, and add item to the ones it overlaps. */
+struct bedPiece *piece, **pPiece = &sweep->activeList;
+while ((piece = *pPiece) != NULL)
+    {
+    if (piece->end <= start)
+        *pPiece = piece->next;
+    else
+        {
+	int cov1 = rangeIntersection(start, end, piece->start, piece->end);
+	if (cov1 > 0)
+	    {
+	    struct bedSums *sums = piece->sums;
+	    sums->coverage += cov1;
+	    sums->sum += cov1 * val;
+	    if (sums->maxVal < val)
+	        sums->maxVal = val;
+	    if (sums->minVal > val)
+	        sums->minVal = val;
+	    }
+	pPiece = &piece->next;
+	}
+    }
+}
+
+void averageStreaming(struct bbiFile *bbi, struct bed **pBedList, int fieldCount, 
+	int outputMinMax, FILE *f, FILE *bedF)
+/* Do the averaging by sorting bedList by position, and then making a single sweep through
+ * the bigWig data on each chromosome.  Each data block is read and decompressed just once,
+ * and only blocks near a bed are read at all. */
+{
+slSort(pBedList, bedCmpChromStart);
+
+struct bed *bed, *bedList, *nextChrom;
+for (bedList = *pBedList; bedList != NULL; bedList = nextChrom)
+    {
+    char *chrom = bedList->chrom;
+    nextChrom = nextChromInList(bedList);
+    verbose(2, "Processing %s\n", chrom);
+
+    /* Make up sums for each bed, and pieces for each region we sample. */
+    int bedCount = 0, pieceCount = 0;
+    for (bed = bedList; bed != nextChrom; bed = bed->next)
+        {
+	++bedCount;
+	pieceCount += ((fieldCount < 12 || sampleAroundCenter > 0) ? 1 : bed->blockCount);
+	}
+    struct bedSums *sumsArray, *sums;
+    struct bedPiece *pieces;
+    AllocArray(sumsArray, bedCount);
+    AllocArray(pieces, pieceCount);
+    int pieceIx = 0;
+    for (bed = bedList, sums = sumsArray; bed != nextChrom; bed = bed->next, ++sums)
+        {
+	sums->bed = bed;
+	sums->minVal = BIGDOUBLE;
+	sums->maxVal = -BIGDOUBLE;
+	if (sampleAroundCenter > 0)
+	    {
+	    int center = (bed->chromStart + bed->chromEnd)/2;
+	    int left = center - (sampleAroundCenter/2);
+	    sums->size += sampleAroundCenter;
+	    if (left >= 0)
+		{
+		pieces[pieceIx].start = left;
+		pieces[pieceIx].end = left + sampleAroundCenter;
+		pieces[pieceIx++].sums = sums;
+		}
+	    }
+	else if (fieldCount < 12)
+	    {
+	    sums->size += bed->chromEnd - bed->chromStart;
+	    pieces[pieceIx].start = bed->chromStart;
+	    pieces[pieceIx].end = bed->chromEnd;
+	    pieces[pieceIx++].sums = sums;
+	    }
+	else
+	    {
+	    int i;
+	    for (i=0; i<bed->blockCount; ++i)
+		{
+		int start = bed->chromStart + bed->chromStarts[i];
+		int end = start + bed->blockSizes[i];
+		sums->size += end - start;
+		pieces[pieceIx].start = start;
+		pieces[pieceIx].end = end;
+		pieces[pieceIx++].sums = sums;
+		}
+	    }
+	}
+    pieceCount = pieceIx;
+    qsort(pieces, pieceCount, sizeof(pieces[0]), bedPieceCmpStart);
+
+    /* Sweep through data in windows made of overlapping pieces, so we don't 
+     * bother reading blocks in big gaps between beds. */
+    struct pieceSweep sweep = {pieces, pieceCount, 0, NULL};
+    bits64 lastOffset = 0;
+    int i = 0;
+    while (i < pieceCount)
+        {
+	int windowStart = pieces[i].start, windowEnd = pieces[i].end;
+	for (++i; i < pieceCount && pieces[i].start <= windowEnd; ++i)
+	    windowEnd = max(windowEnd, pieces[i].end);
+	lastOffset = bigWigItemSweep(bbi, chrom, windowStart, windowEnd, lastOffset, 
+		pieceSweepAdd, &sweep);
+	}
+
+    /* Output results in sorted bed order. */
+    for (sums = sumsArray; sums < sumsArray + bedCount; ++sums)
+        outputOneAverage(f, bedF, sums->bed, fieldCount, outputMinMax, 
+	    sums->size, sums->coverage, sums->sum, sums->minVal, sums->maxVal);
+    freeMem(sumsArray);
+    freeMem(pieces);
+    verboseDot();
+    }
+verbose(1, "\n");
+}
+
 void bigWigAverageOverBed(char *inBw, char *inBed, char *outTab)
 /* bigWigAverageOverBed - Compute average score of big wig over each bed, which may have introns. */
 {
@@ -383,7 +591,9 @@ if (bedOut != NULL)
 int blockCount = countBlocks(bedList, fieldCount);
 verbose(2, "Got %d blocks, if >= 3000 will use chromosome-at-a-time method\n", blockCount);
 
-if (blockCount < 3000)
+if (stream)
+    averageStreaming(bbi, &bedList, fieldCount, minMax, f, bedF);
+else if (blockCount < 3000)
     averageFetchingEachBlock(bbi, bedList, fieldCount, minMax, f, bedF);
 else
     averageFetchingEachChrom(bbi, &bedList, fieldCount, minMax, f, bedF);
@@ -404,6 +614,7 @@ bedOut = optionVal("bedOut", bedOut);
 statsRa = optionVal("stats", statsRa);
 sampleAroundCenter = optionInt("sampleAroundCenter", sampleAroundCenter);
 tsv = optionExists("tsv");
+stream = optionExists("stream");
 bigWigAverageOverBed(argv[1], argv[2], argv[3]);
 return 0;
 }
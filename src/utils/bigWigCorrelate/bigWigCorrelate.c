@@ -13,11 +13,15 @@
 #include "bigBed.h"
 #include "bigWig.h"
 #include "genomeRangeTree.h"
+#include "synQueue.h"
+#include "pthreadDoList.h"
 
 char *restrictFile = NULL;
 double threshold = FLT_MAX;
 boolean rootNames = FALSE;
 boolean ignoreMissing = FALSE;
+int threads = 1;
+int tileSize = 4000000;
 
 void usage()
 /* Explain usage and exit. */
@@ -35,6 +39,9 @@ errAbort(
   "                names when using listOfFiles\n"
   "   -ignoreMissing - if set do not correlate where either side is missing data\n"
   "                Normally missing data is treated as zeros\n"
+  "   -threads=N - number of threads to use. Default %d\n"
+  "   -tileSize=N - number of bases each thread works on at once. Default %d\n"
+  , threads, tileSize
   );
 }
 
@@ -44,61 +51,97 @@ static struct optionSpec options[] = {
    {"threshold", OPTION_DOUBLE},
    {"rootNames", OPTION_BOOLEAN},
    {"ignoreMissing", OPTION_BOOLEAN},
+   {"threads", OPTION_INT},
+   {"tileSize", OPTION_INT},
    {NULL, 0},
 };
 
-static void addBwCorrelations(struct bbiChromInfo *chrom, struct genomeRangeTree *targetGrt,
-    struct bigWigValsOnChrom *aVals, struct bigWigValsOnChrom *bVals,
-    struct bbiFile *aBbi, struct bbiFile *bBbi, 
-    double aThreshold, double bThreshold, struct correlate *c)
-/* Find bits of a and b that overlap and also overlap with targetRanges.  Do correlations there */
+struct corrTile
+/* A piece of a chromosome to correlate in a single thread. */
+    {
+    struct corrTile *next;
+    char *chrom;		/* Chromosome tile is on. */
+    int start, end;		/* Range covered by tile, half open. */
+    boolean restricted;		/* If TRUE only correlate in rangeList. */
+    struct range *rangeList;	/* First restricting range that may overlap tile. */
+    struct correlate *c;	/* Correlation within tile. */
+    };
+
+struct corrReader
+/* A pair of open bigWigs and buffers to read them into.  Each thread borrows one of these
+ * from a pool while working on a tile. */
+    {
+    struct bbiFile *aBbi, *bBbi;	/* Files to correlate. */
+    float *aBuf, *bBuf;			/* Per-base values, tileSize big. */
+    };
+
+static void correlateFloats(struct correlate *c, float *a, float *b, int start, int end)
+/* Add a[start]..a[end-1] and b[start]..b[end-1] to correlation, skipping or zeroing
+ * missing (NaN) data as requested, and clipping to threshold. */
 {
-struct rbTree *targetRanges = NULL;
 boolean useMissing = !ignoreMissing;
-if (targetGrt != NULL)
-    targetRanges = genomeRangeTreeFindRangeTree(targetGrt, chrom->name);
-if (bigWigValsOnChromFetchData(aVals, chrom->name, aBbi) &&
-    bigWigValsOnChromFetchData(bVals, chrom->name, bBbi) )
+int i;
+for (i=start; i<end; ++i)
     {
-    double *a = aVals->valBuf, *b = bVals->valBuf;
-    Bits *aCov = aVals->covBuf, *bCov = bVals->covBuf;
-    if (targetRanges == NULL)
-	{
-	int i, end = chrom->size;
-	for (i=0; i<end; ++i)
-	    {
-	    if (useMissing || (bitReadOne(aCov,i) && bitReadOne(bCov,i)))
-		{
-		double aVal = a[i], bVal = b[i];
-		if (aVal > aThreshold) aVal = aThreshold;
-		if (bVal > bThreshold) bVal = bThreshold;
-		correlateNext(c, aVal, bVal);
-		}
-	    }
+    double aVal = a[i], bVal = b[i];
+    if (isnan(aVal) || isnan(bVal))
+        {
+	if (!useMissing)
+	    continue;
+	if (isnan(aVal)) aVal = 0;
+	if (isnan(bVal)) bVal = 0;
 	}
+    if (aVal > threshold) aVal = threshold;
+    if (bVal > threshold) bVal = threshold;
+    correlateNext(c, aVal, bVal);
+    }
+}
+
+static void correlateOneTile(void *item, void *context)
+/* Fetch data for both files in tile and correlate it. */
+{
+struct corrTile *tile = item;
+struct synQueue *readerPool = context;
+struct corrReader *reader = synQueueGet(readerPool);
+struct correlate *c = tile->c = correlateNew();
+int start = tile->start, end = tile->end;
+
+/* Restricting ranges let us fetch less data. */
+struct range *range;
+if (tile->restricted)
+    {
+    range = tile->rangeList;
+    if (range == NULL || range->start >= end)
+        {
+	synQueuePut(readerPool, reader);
+	return;
+	}
+    start = max(start, range->start);
+    for (; range->next != NULL && range->next->start < tile->end; range = range->next)
+        ;
+    end = min(end, range->end);
+    }
+
+float *a = reader->aBuf, *b = reader->bBuf;
+int aCount = bigWigFloatQuery(reader->aBbi, tile->chrom, start, end, a);
+int bCount = bigWigFloatQuery(reader->bBbi, tile->chrom, start, end, b);
+if (aCount > 0 || bCount > 0 || !ignoreMissing)
+    {
+    if (!tile->restricted)
+	correlateFloats(c, a, b, 0, end - start);
     else
 	{
-	struct range *range, *rangeList = rangeTreeList(targetRanges);
-	for (range = rangeList; range != NULL; range = range->next)
+	for (range = tile->rangeList; range != NULL && range->start < end; range = range->next)
 	    {
-	    int start = range->start, end = range->end;
-	    int i;
-	    for (i=start; i<end; ++i)
-		{
-		if (useMissing || (bitReadOne(aCov,i) && bitReadOne(bCov,i)))
-		    {
-		    double aVal = a[i], bVal = b[i];
-		    if (aVal > aThreshold) aVal = aThreshold;
-		    if (bVal > bThreshold) bVal = bThreshold;
-		    correlateNext(c, aVal, bVal);
-		    }
-		}
+	    int s = max(start, range->start), e = min(end, range->end);
+	    if (s < e)
+		correlateFloats(c, a, b, s - start, e - start);
 	    }
 	}
     }
+synQueuePut(readerPool, reader);
 }
 
-
 struct genomeRangeTree *grtFromBigBed(char *fileName)
 /* Return genome range tree for simple (unblocked) bed */
 {
@@ -128,20 +171,75 @@ struct correlate *bigWigCorrelate(char *aFileName, char *bFileName)
 struct genomeRangeTree *targetGrt = NULL;
 if (restrictFile)
     targetGrt = grtFromBigBed(restrictFile);
-struct bbiFile *aBbi = bigWigFileOpen(aFileName);
-struct bbiFile *bBbi = bigWigFileOpen(bFileName);
-struct correlate *c = correlateNew();
+
+/* Open up each file once for each thread. */
+struct synQueue *readerPool = synQueueNew();
+struct corrReader *readers;
+AllocArray(readers, threads);
+int i;
+for (i=0; i<threads; ++i)
+    {
+    struct corrReader *reader = &readers[i];
+    reader->aBbi = bigWigFileOpen(aFileName);
+    reader->bBbi = bigWigFileOpen(bFileName);
+    reader->aBuf = needHugeMem(tileSize * sizeof(float));
+    reader->bBuf = needHugeMem(tileSize * sizeof(float));
+    synQueuePutUnprotected(readerPool, reader);
+    }
+
+/* Make up tiles on chromosomes in both files. */
+struct bbiFile *aBbi = readers[0].aBbi, *bBbi = readers[0].bBbi;
 struct bbiChromInfo *chrom, *chromList = bbiChromList(aBbi);
-struct bigWigValsOnChrom *aVals = bigWigValsOnChromNew();
-struct bigWigValsOnChrom *bVals = bigWigValsOnChromNew();
+struct corrTile *tileList = NULL, *tile;
+struct lm *lm = lmInit(0);
 for (chrom = chromList; chrom != NULL; chrom = chrom->next)
     {
-    addBwCorrelations(chrom, targetGrt, aVals, bVals, aBbi, bBbi, threshold, threshold, c);
+    if (bbiChromSize(bBbi, chrom->name) <= 0)
+        continue;
+    struct rbTree *targetRanges = NULL;
+    struct range *range = NULL;
+    if (targetGrt != NULL)
+        targetRanges = genomeRangeTreeFindRangeTree(targetGrt, chrom->name);
+    if (targetRanges != NULL)
+	range = rangeTreeList(targetRanges);
+    bits32 start, end;
+    for (start = 0; start < chrom->size; start = end)
+        {
+	end = min(chrom->size, (bits64)start + tileSize);
+	while (range != NULL && range->end <= start)
+	    range = range->next;
+	lmAllocVar(lm, tile);
+	tile->chrom = chrom->name;
+	tile->start = start;
+	tile->end = end;
+	tile->restricted = (targetRanges != NULL);
+	tile->rangeList = range;
+	slAddHead(&tileList, tile);
+	}
+    }
+slReverse(&tileList);
+
+/* Correlate tiles in parallel and add them up in order. */
+pthreadDoList(threads, tileList, correlateOneTile, readerPool);
+struct correlate *c = correlateNew();
+for (tile = tileList; tile != NULL; tile = tile->next)
+    {
+    correlateAdd(c, tile->c);
+    correlateFree(&tile->c);
+    }
+
+lmCleanup(&lm);
+bbiChromInfoFreeList(&chromList);
+for (i=0; i<threads; ++i)
+    {
+    struct corrReader *reader = &readers[i];
+    bbiFileClose(&reader->aBbi);
+    bbiFileClose(&reader->bBbi);
+    freeMem(reader->aBuf);
+    freeMem(reader->bBuf);
     }
-bigWigValsOnChromFree(&aVals);
-bigWigValsOnChromFree(&bVals);
-bbiFileClose(&aBbi);
-bbiFileClose(&bBbi);
+freeMem(readers);
+synQueueFree(&readerPool);
 genomeRangeTreeFree(&targetGrt);
 return c;
 }
@@ -195,6 +293,12 @@ restrictFile = optionVal("restrict", restrictFile);
 threshold = optionDouble("threshold", threshold);
 rootNames = optionExists("rootNames");
 ignoreMissing = optionExists("ignoreMissing");
+threads = optionInt("threads", threads);
+tileSize = optionInt("tileSize", tileSize);
+if (threads < 1)
+    errAbort("-threads must be at least 1");
+if (tileSize < 1)
+    errAbort("-tileSize must be at least 1");
 if (argc == 3)
     bigWigCorrelatePair(argv[1], argv[2]);
 else
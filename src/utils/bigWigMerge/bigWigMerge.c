@@ -10,15 +10,26 @@
 #include "bbiFile.h"
 #include "bigWig.h"
 #include "obscure.h"
+#include "synQueue.h"
+#include "pthreadDoList.h"
 
 /* version history -
- *    v2 - added -inList option to avoid huge command lines when merging lots of files. */
+ *    v2 - added -inList option to avoid huge command lines when merging lots of files.
+ *    v3 - work a tile at a time rather than a chromosome at a time, added -threads. */
+
+double clThreshold = 0.0;
+double clAdjust = 0.0;
+double clClip = BIGDOUBLE;
+boolean clInList = FALSE;
+boolean clMax = FALSE;
+int clThreads = 1;
+int clTileSize = 4000000;
 
 void usage()
 /* Explain usage and exit. */
 {
 errAbort(
-  "bigWigMerge v2 - Merge together multiple bigWigs into a single output bedGraph.\n"
+  "bigWigMerge v3 - Merge together multiple bigWigs into a single output bedGraph.\n"
   "You'll have to run bedGraphToBigWig to make the output bigWig.\n"
   "The signal values are just added together to merge them\n"
   "usage:\n"
@@ -29,21 +40,20 @@ errAbort(
   "   -clip=NNN.N - values higher than this are clipped to this value\n"
   "   -inList - input file are lists of file names of bigWigs\n"
   "   -max - merged value is maximum from input files rather than sum\n"
+  "   -threads=N - number of threads to merge with. Default %d\n"
+  "   -tileSize=N - number of bases merged at once by each thread. Default %d\n"
+  , clThreads, clTileSize
   );
 }
 
-double clThreshold = 0.0;
-double clAdjust = 0.0;
-double clClip = BIGDOUBLE;
-boolean clInList = FALSE;
-boolean clMax = FALSE;
-
 static struct optionSpec options[] = {
    {"threshold", OPTION_DOUBLE},
    {"adjust", OPTION_DOUBLE},
    {"clip", OPTION_DOUBLE},
    {"inList", OPTION_BOOLEAN},
    {"max", OPTION_BOOLEAN},
+   {"threads", OPTION_INT},
+   {"tileSize", OPTION_INT},
    {NULL, 0},
 };
 
@@ -133,6 +143,144 @@ freeMem(words);
 freeMem(buf);
 }
 
+struct mergeTile
+/* A piece of a chromosome to be merged by a single thread. */
+    {
+    struct mergeTile *next;
+    struct bbiChromInfo *chrom;	/* Chromosome tile is on. */
+    int start, end;		/* Range of chromosome covered, half open. */
+    double *buf;		/* Merged value for each base in tile. */
+    };
+
+struct mergeReader
+/* Handles on all the input bigWigs.  Each thread borrows one of these from a pool while
+ * working on a tile, so threads never share a handle. */
+    {
+    struct bbiFile **files;	/* One per input file, opened when first needed. */
+    };
+
+struct mergeContext
+/* Data shared between all threads doing merging. */
+    {
+    struct bbiFile *inFileList;	/* List of input bigWigs. */
+    struct synQueue *readerPool;	/* Readers not in use by a thread. */
+    };
+
+static void addToBuf(double *buf, int start, int end, double val)
+/* Add val to buf[start] through buf[end-1]. */
+{
+int i;
+for (i=start; i<end; ++i)
+    buf[i] += val;
+}
+
+static void maxIntoBuf(double *buf, int start, int end, double val)
+/* Set buf[start] through buf[end-1] to the max of what they are and val. */
+{
+int i;
+for (i=start; i<end; ++i)
+    if (buf[i] < val)
+        buf[i] = val;
+}
+
+static void mergeOneTile(void *item, void *context)
+/* Add together data from all input files in tile. */
+{
+struct mergeTile *tile = item;
+struct mergeContext *mc = context;
+struct mergeReader *reader = synQueueGet(mc->readerPool);
+int tileSize = tile->end - tile->start;
+double *buf = tile->buf;
+int i;
+for (i=0; i<tileSize; ++i)
+    buf[i] = 0.0;
+
+/* Loop through each input file grabbing data and merging it in. Do the files
+ * in the same order for each tile, so that sums come out just as they would 
+ * a chromosome at a time. */
+struct bbiFile *inFile;
+for (inFile = mc->inFileList, i=0; inFile != NULL; inFile = inFile->next, ++i)
+    {
+    struct lm *lm = lmInit(0);
+    if (reader->files[i] == NULL)
+        reader->files[i] = bigWigFileOpen(inFile->fileName);
+    struct bbiInterval *ivList = bigWigIntervalQuery(reader->files[i], tile->chrom->name, 
+    	tile->start, tile->end, lm);
+    verbose(3, "Got %d intervals in %s\n", slCount(ivList), inFile->fileName);
+    struct bbiInterval *iv;
+    for (iv = ivList; iv != NULL; iv = iv->next)
+	{
+	double val = iv->val;
+	if (val > clClip)
+	    val = clClip;
+	int start = iv->start - tile->start, end = iv->end - tile->start;
+	if (clMax)
+	    maxIntoBuf(buf, start, end, val);
+	else
+	    addToBuf(buf, start, end, val);
+	}
+    lmCleanup(&lm);
+    }
+synQueuePut(mc->readerPool, reader);
+}
+
+struct mergeRun
+/* A run of bases with the same value waiting to be output. It may span tiles. */
+    {
+    char *chrom;	/* Chromosome run is on, NULL if no run yet. */
+    int start, end;	/* Range covered by run. */
+    double val;		/* Merged value before adjustment. */
+    };
+
+static void flushRun(FILE *f, struct mergeRun *run)
+/* Output run as a bedGraph item if it passes threshold, and clear it. */
+{
+if (run->chrom != NULL)
+    {
+    double val = run->val + clAdjust;
+    if (val > clThreshold)
+	fprintf(f, "%s\t%d\t%d\t%g\n", run->chrom, run->start, run->end, val);
+    run->chrom = NULL;
+    }
+}
+
+static void outputTile(FILE *f, struct mergeTile *tile, struct mergeRun *run)
+/* Output each range of same values in tile, continuing run from previous tile 
+ * if it has the same value. */
+{
+char *chrom = tile->chrom->name;
+double *buf = tile->buf;
+int tileSize = tile->end - tile->start;
+int i, sameCount;
+for (i=0; i<tileSize; i += sameCount)
+    {
+    sameCount = doublesTheSame(buf+i, tileSize-i);
+    int start = tile->start + i;
+    if (run->chrom == chrom && run->end == start && run->val == buf[i])
+        run->end += sameCount;
+    else
+        {
+	flushRun(f, run);
+	run->chrom = chrom;
+	run->start = start;
+	run->end = start + sameCount;
+	run->val = buf[i];
+	}
+    }
+}
+
+static void mergeAndOutputBatch(struct mergeTile **pBatchList, struct mergeContext *mc,
+    FILE *f, struct mergeRun *run)
+/* Merge a batch of tiles in parallel, output them in order, and empty batch. */
+{
+slReverse(pBatchList);
+pthreadDoList(clThreads, *pBatchList, mergeOneTile, mc);
+struct mergeTile *tile;
+for (tile = *pBatchList; tile != NULL; tile = tile->next)
+    outputTile(f, tile, run);
+*pBatchList = NULL;
+}
+
 void bigWigMerge(int inCount, char *inFiles[], char *outFile)
 /* bigWigMerge - Merge together multiple bigWigs into a single one.. */
 {
@@ -152,71 +300,75 @@ for (i=0; i<inCount; ++i)
 	}
     }
 
+/* Set up context shared by threads.  The first reader uses the files already open, 
+ * the others open their own as they need them. */
+struct mergeContext mc;
+mc.inFileList = inFileList;
+int inFileCount = slCount(inFileList);
+mc.readerPool = synQueueNew();
+struct mergeReader *readers;
+AllocArray(readers, clThreads);
+for (i=0; i<clThreads; ++i)
+    {
+    AllocArray(readers[i].files, inFileCount);
+    synQueuePutUnprotected(mc.readerPool, &readers[i]);
+    }
+for (inFile = inFileList, i=0; inFile != NULL; inFile = inFile->next, ++i)
+    readers[0].files[i] = inFile;
+
 FILE *f = mustOpen(outFile, "w");
 
 struct bbiChromInfo *chrom, *chromList = getAllChroms(inFileList);
 verbose(1, "Got %d chromosomes from %d bigWigs\nProcessing", 
-	slCount(chromList), slCount(inFileList));
-double *mergeBuf = NULL;
-int mergeBufSize = 0;
+	slCount(chromList), inFileCount);
+
+/* Allocate a tile for each thread.  We'll do a batch of tiles in parallel, output
+ * them in order, and then reuse them for the next batch, which keeps memory bounded. */
+struct mergeTile *tiles, *batchList = NULL;
+AllocArray(tiles, clThreads);
+for (i=0; i<clThreads; ++i)
+    tiles[i].buf = needHugeMem(clTileSize * sizeof(double));
+int batchCount = 0;
+
+struct mergeRun run;
+ZeroVar(&run);
 for (chrom = chromList; chrom != NULL; chrom = chrom->next)
     {
-    struct lm *lm = lmInit(0);
-
-    /* Make sure merge buffer is big enough. */
-    int chromSize = chrom->size;
     verboseDot();
-    verbose(2, "Processing %s (%d bases)\n", chrom->name, chromSize);
-    if (chromSize > mergeBufSize)
-        {
-	mergeBufSize = chromSize;
-	freeMem(mergeBuf);
-	mergeBuf = needHugeMem(mergeBufSize * sizeof(double));
-	}
-    int i;
-    for (i=0; i<chromSize; ++i)
-        mergeBuf[i] = 0.0;
-
-    /* Loop through each input file grabbing data and merging it in. */
-    for (inFile = inFileList; inFile != NULL; inFile = inFile->next)
+    verbose(2, "Processing %s (%d bases)\n", chrom->name, (int)chrom->size);
+    bits32 start, end;
+    for (start = 0; start < chrom->size; start = end)
         {
-	struct bbiInterval *ivList = bigWigIntervalQuery(inFile, chrom->name, 0, chromSize, lm);
-	verbose(3, "Got %d intervals in %s\n", slCount(ivList), inFile->fileName);
-	struct bbiInterval *iv;
-	for (iv = ivList; iv != NULL; iv = iv->next)
+	end = min(chrom->size, (bits64)start + clTileSize);
+	struct mergeTile *tile = &tiles[batchCount++];
+	tile->chrom = chrom;
+	tile->start = start;
+	tile->end = end;
+	slAddHead(&batchList, tile);
+	if (batchCount == clThreads)
 	    {
-	    double val = iv->val;
-	    if (val > clClip)
-	        val = clClip;
-	    int end = iv->end;
-	    for (i=iv->start; i < end; ++i)
-                {
-                if (clMax)
-                    {
-                    if (mergeBuf[i] < val) 
-                        mergeBuf[i] = val;
-                    }
-                else
-                    mergeBuf[i] += val;
-                }
+	    mergeAndOutputBatch(&batchList, &mc, f, &run);
+	    batchCount = 0;
 	    }
 	}
-
-
-    /* Output each range of same values as a bedGraph item */
-    int sameCount;
-    for (i=0; i<chromSize; i += sameCount)
-        {
-	sameCount = doublesTheSame(mergeBuf+i, chromSize-i);
-	double val = mergeBuf[i] + clAdjust;
-	if (val > clThreshold)
-	    fprintf(f, "%s\t%d\t%d\t%g\n", chrom->name, i, i + sameCount, val);
-	}
-
-    lmCleanup(&lm);
     }
+mergeAndOutputBatch(&batchList, &mc, f, &run);
+flushRun(f, &run);
 verbose(1, "\n");
 
+for (i=0; i<clThreads; ++i)
+    freeMem(tiles[i].buf);
+freeMem(tiles);
+for (i=1; i<clThreads; ++i)
+    {
+    int j;
+    for (j=0; j<inFileCount; ++j)
+        bbiFileClose(&readers[i].files[j]);
+    }
+for (i=0; i<clThreads; ++i)
+    freeMem(readers[i].files);
+freeMem(readers);
+synQueueFree(&mc.readerPool);
 carefulClose(&f);
 }
 
@@ -229,6 +381,12 @@ clAdjust = optionDouble("adjust", clAdjust);
 clClip = optionDouble("clip", clClip);
 clInList = optionExists("inList");
 clMax = optionExists("max");
+clThreads = optionInt("threads", clThreads);
+clTileSize = optionInt("tileSize", clTileSize);
+if (clThreads < 1)
+    errAbort("-threads must be at least 1");
+if (clTileSize < 1)
+    errAbort("-tileSize must be at least 1");
 int minArgs = 4;
 if (clInList)
     minArgs -= 1;
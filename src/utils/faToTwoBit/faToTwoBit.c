@@ -10,6 +10,7 @@
 #include "dnautil.h"
 #include "fa.h"
 #include "twoBit.h"
+#include "pthreadDoList.h"
 
 
 void usage()
@@ -26,7 +27,9 @@ errAbort(
   "   -stripVersion    Strip off version number after '.' for GenBank accessions.\n"
   "   -ignoreDups      Convert first sequence only if there are duplicate sequence\n"
   "                    names.  Use 'twoBitDup' to find duplicate sequences.\n"
-  "   -namePrefix=XX.  add XX. to start of sequence name in 2bit."
+  "   -namePrefix=XX.  add XX. to start of sequence name in 2bit.\n"
+  "   -threads=N       Number of threads to pack sequence with (default 1).  Big\n"
+  "                    sequences are split into pieces that are packed in parallel.\n"
   );
 }
 
@@ -35,6 +38,14 @@ boolean noMask = FALSE;
 boolean stripVersion = FALSE;
 boolean ignoreDups = FALSE;
 boolean useLong = FALSE;
+int threads = 1;
+
+/* With more than one thread, sequences are packed in pieces of at most this many
+ * bases, which must be a multiple of 4 so pieces start on a byte boundary.  Pieces
+ * are read ahead until there are about windowBases per thread, then packed in
+ * parallel.  With one thread each sequence is packed as soon as it is read. */
+#define pieceSize (8*1024*1024)
+#define windowBases (4LL*pieceSize)
 
 static struct optionSpec options[] = {
    {"noMask", OPTION_BOOLEAN},
@@ -42,6 +53,7 @@ static struct optionSpec options[] = {
    {"ignoreDups", OPTION_BOOLEAN},
    {"long", OPTION_BOOLEAN},
    {"namePrefix", OPTION_STRING},
+   {"threads", OPTION_INT},
    {NULL, 0},
 };
 
@@ -64,12 +76,122 @@ for (i=0; i<size; ++i)
 }
 
 	    
+struct seqPiece
+/* A sequence, or a piece of a big one, to pack in a thread. */
+    {
+    struct seqPiece *next;
+    struct dnaSeq seq;		/* Bases of piece.  Name is that of the whole sequence. */
+    int pieceCount;		/* Number of pieces in sequence if first piece, else 0. */
+    struct twoBit *twoBit;	/* Packed piece. */
+    };
+
+static void packPiece(void *item, void *context)
+/* Clean up bases of a piece and pack them.  Called in parallel by pthreadDoList. */
+{
+struct seqPiece *piece = item;
+struct dnaSeq *seq = &piece->seq;
+if (noMask)
+    faToDna(seq->dna, seq->size);
+else
+    unknownToN(seq->dna, seq->size);
+piece->twoBit = twoBitFromDnaSeq(seq, !noMask);
+freez(&seq->dna);
+}
+
+static void addBlocks(bits32 *starts, bits32 *sizes, bits32 *pCount,
+	bits32 *pieceStarts, bits32 *pieceSizes, bits32 pieceCount, bits32 offset)
+/* Add blocks from a piece that begins at offset to the end of starts and sizes,
+ * joining the first one to the last block so far if they touch. */
+{
+bits32 count = *pCount, i;
+for (i=0; i<pieceCount; ++i)
+    {
+    bits32 start = pieceStarts[i] + offset;
+    if (count > 0 && starts[count-1] + sizes[count-1] == start)
+        sizes[count-1] += pieceSizes[i];
+    else
+        {
+	starts[count] = start;
+	sizes[count] = pieceSizes[i];
+	++count;
+	}
+    }
+*pCount = count;
+}
+
+static struct twoBit *joinPieces(struct seqPiece *first)
+/* Join packed pieces of a sequence, starting with first, into one twoBit. */
+{
+if (first->pieceCount == 1)
+    {
+    struct twoBit *twoBit = first->twoBit;
+    first->twoBit = NULL;
+    return twoBit;
+    }
+struct twoBit *twoBit;
+struct seqPiece *piece;
+int i;
+bits32 nCount = 0, maskCount = 0;
+AllocVar(twoBit);
+twoBit->name = cloneString(first->twoBit->name);
+for (i=0, piece=first; i<first->pieceCount; ++i, piece=piece->next)
+    {
+    twoBit->size += piece->twoBit->size;
+    nCount += piece->twoBit->nBlockCount;
+    maskCount += piece->twoBit->maskBlockCount;
+    }
+AllocArray(twoBit->data, (twoBit->size + 3)/4);
+if (nCount > 0)
+    {
+    AllocArray(twoBit->nStarts, nCount);
+    AllocArray(twoBit->nSizes, nCount);
+    }
+if (maskCount > 0)
+    {
+    AllocArray(twoBit->maskStarts, maskCount);
+    AllocArray(twoBit->maskSizes, maskCount);
+    }
+bits32 offset = 0;
+for (i=0, piece=first; i<first->pieceCount; ++i, piece=piece->next)
+    {
+    struct twoBit *part = piece->twoBit;
+    memcpy(twoBit->data + offset/4, part->data, (part->size + 3)/4);
+    addBlocks(twoBit->nStarts, twoBit->nSizes, &twoBit->nBlockCount,
+    	part->nStarts, part->nSizes, part->nBlockCount, offset);
+    addBlocks(twoBit->maskStarts, twoBit->maskSizes, &twoBit->maskBlockCount,
+    	part->maskStarts, part->maskSizes, part->maskBlockCount, offset);
+    offset += part->size;
+    twoBitFree(&piece->twoBit);
+    }
+return twoBit;
+}
+
+static void packWindow(struct seqPiece **pPieceList, struct twoBit **pTwoBitList)
+/* Pack pieces in parallel, then join them into sequences, add them to
+ * twoBitList in reverse order, and free the pieces. */
+{
+struct seqPiece *piece;
+slReverse(pPieceList);
+pthreadDoList(threads, *pPieceList, packPiece, NULL);
+for (piece = *pPieceList; piece != NULL; piece = piece->next)
+    if (piece->pieceCount > 0)
+        slAddHead(pTwoBitList, joinPieces(piece));
+while ((piece = slPopHead(pPieceList)) != NULL)
+    {
+    if (piece->pieceCount > 0)
+        freeMem(piece->seq.name);
+    freeMem(piece);
+    }
+}
+
 void faToTwoBit(char *inFiles[], int inFileCount, char *outFile)
 /* Convert inFiles in fasta format to outfile in 2 bit 
  * format. */
 {
 struct twoBit *twoBitList = NULL, *twoBit;
+struct seqPiece *pieceList = NULL;
 int i;
+long long windowBaseCount = 0;
 struct hash *uniqHash = newHash(18);
 FILE *f;
 
@@ -109,15 +231,41 @@ for (i=0; i<inFileCount; ++i)
                 continue;
             }
 	hashAdd(uniqHash, seq.name, NULL);
-	if (noMask)
-	    faToDna(seq.dna, seq.size);
-	else
-	    unknownToN(seq.dna, seq.size);
-	twoBit = twoBitFromDnaSeq(&seq, !noMask);
-	slAddHead(&twoBitList, twoBit);
+	if (threads == 1)
+	    {
+	    if (noMask)
+		faToDna(seq.dna, seq.size);
+	    else
+		unknownToN(seq.dna, seq.size);
+	    twoBit = twoBitFromDnaSeq(&seq, !noMask);
+	    slAddHead(&twoBitList, twoBit);
+	    continue;
+	    }
+
+	/* Copy sequence out of the line file's buffer in pieces to be packed later. */
+	char *name = cloneString(seq.name);
+	int pieceCount = (seq.size + pieceSize - 1)/pieceSize, start;
+	for (start = 0; start < seq.size; start += pieceSize)
+	    {
+	    struct seqPiece *piece;
+	    AllocVar(piece);
+	    piece->seq.name = name;
+	    piece->seq.size = min(pieceSize, seq.size - start);
+	    piece->seq.dna = cloneStringZ(seq.dna + start, piece->seq.size);
+	    piece->pieceCount = (start == 0 ? pieceCount : 0);
+	    slAddHead(&pieceList, piece);
+	    }
+	windowBaseCount += seq.size;
+	if (windowBaseCount >= windowBases * threads)
+	    {
+	    packWindow(&pieceList, &twoBitList);
+	    windowBaseCount = 0;
+	    }
 	}
     lineFileClose(&lf);
     }
+if (pieceList != NULL)
+    packWindow(&pieceList, &twoBitList);
 slReverse(&twoBitList);
 f = mustOpen(outFile, "wb");
 twoBitWriteHeaderExt(twoBitList, f, useLong);
@@ -139,6 +287,9 @@ stripVersion = optionExists("stripVersion");
 ignoreDups = optionExists("ignoreDups");
 useLong = optionExists("long");
 namePrefix = optionVal("namePrefix", namePrefix);
+threads = optionInt("threads", threads);
+if (threads < 1 || threads > 256)
+    errAbort("-threads must be between 1 and 256");
 dnaUtilOpen();
 faToTwoBit(argv+1, argc-2, argv[argc-1]);
 return 0;
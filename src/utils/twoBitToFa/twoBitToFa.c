@@ -12,6 +12,8 @@
 #include "bPlusTree.h"
 #include "basicBed.h"
 #include "udc.h"
+#include "pthreadWrap.h"
+#include "pthreadDoList.h"
 
 
 void usage()
@@ -33,6 +35,9 @@ errAbort(
   "   -bed=input.bed  Grab sequences specified by input.bed. Will exclude introns.\n"
   "   -bedPos         With -bed, use chrom:start-end as the fasta ID in output.fa.\n"
   "   -udcDir=/dir/to/cache  Place to put cache for remote bigBed/bigWigs.\n"
+  "   -threads=N      Number of threads to unpack sequence with (default 1).  Big\n"
+  "                   sequences are split into pieces that are unpacked in parallel.\n"
+  "                   Output is in the same order as with one thread.\n"
   "\n"
   "Input file can be a URL\n"
   "Sequence and range may also be specified as part of the input\n"
@@ -56,6 +61,16 @@ bool noMask = FALSE;  /* convert seq to upper case */
 char *clBpt = NULL;	/* External index file. */
 char *clBed = NULL;	/* Bed file that specifies bounds of sequences. */
 bool clBedPos = FALSE;
+int threads = 1;	/* Number of threads to unpack with. */
+
+/* Sequences are unpacked in pieces of at most this many bases, which must be a
+ * multiple of the 50 bases per line, so pieces can be formatted separately.
+ * Pieces are queued until there are about windowPieces per thread, or until
+ * windowBases per thread, then unpacked in parallel and written in order. */
+#define pieceSize (50*200*1024)
+#define windowPieces 256
+#define windowBases (4LL*pieceSize)
+#define basesPerLine 50
 
 static struct optionSpec options[] = {
    {"seq", OPTION_STRING},
@@ -67,35 +82,164 @@ static struct optionSpec options[] = {
    {"bed", OPTION_STRING},
    {"bedPos", OPTION_BOOLEAN},
    {"udcDir", OPTION_STRING},
+   {"threads", OPTION_INT},
    {NULL, 0},
 };
 
-void outputOne(struct twoBitFile *tbf, char *seqSpec, FILE *f, 
-	int start, int end)
-/* Output sequence. */
+struct faPiece
+/* A sequence, or a piece of a big one, to unpack and format in a thread. */
+    {
+    struct faPiece *next;
+    char *seqName;	/* Name of sequence in twoBit file. */
+    char *header;	/* Fasta header line for first piece of a sequence, else NULL. */
+    int start, end;	/* Range of sequence to unpack. */
+    char *text;		/* Formatted fasta. */
+    size_t textSize;	/* Size of text. */
+    };
+
+struct faWindow
+/* Pieces waiting to be unpacked, and twoBitFiles for threads to read them with. */
+    {
+    struct faPiece *pieceList;		/* Pieces in reverse order. */
+    int pieceCount;			/* Number of pieces. */
+    long long baseCount;		/* Number of bases in pieces. */
+    FILE *f;				/* Output file. */
+    char *fileName;			/* twoBit file name. */
+    struct twoBitFile *freeFiles;	/* Open twoBitFiles not in use by a thread. */
+    pthread_mutex_t mutex;		/* Protects freeFiles. */
+    };
+
+static struct twoBitFile *openTwoBit(char *fileName)
+/* Open twoBit file, with external index if there is one. */
+{
+if (clBpt != NULL)
+    return twoBitOpenExternalBptIndex(fileName, clBpt);
+else
+    return twoBitOpen(fileName);
+}
+
+static struct twoBitFile *grabTwoBit(struct faWindow *win)
+/* Get an open twoBitFile that no other thread is using. */
+{
+struct twoBitFile *tbf;
+pthreadMutexLock(&win->mutex);
+tbf = slPopHead(&win->freeFiles);
+pthreadMutexUnlock(&win->mutex);
+if (tbf == NULL)
+    tbf = openTwoBit(win->fileName);
+return tbf;
+}
+
+static void releaseTwoBit(struct faWindow *win, struct twoBitFile *tbf)
+/* Let other threads use tbf. */
 {
-struct dnaSeq *seq = twoBitReadSeqFrag(tbf, seqSpec, start, end);
+pthreadMutexLock(&win->mutex);
+slAddHead(&win->freeFiles, tbf);
+pthreadMutexUnlock(&win->mutex);
+}
+
+static char *formatFa(char *header, DNA *dna, int size, size_t *retSize)
+/* Return dna formatted as fasta with basesPerLine bases per line, preceded by
+ * header line if header is non-NULL.  Put size of formatted text in retSize. */
+{
+int headerSize = (header == NULL ? 0 : strlen(header) + 2);
+size_t textSize = headerSize + size + (size + basesPerLine - 1)/basesPerLine;
+char *text = needLargeMem(textSize + 1), *pt = text;
+if (header != NULL)
+    pt += sprintf(pt, ">%s\n", header);
+int i;
+for (i=0; i<size; i += basesPerLine)
+    {
+    int lineSize = min(basesPerLine, size - i);
+    memcpy(pt, dna + i, lineSize);
+    pt += lineSize;
+    *pt++ = '\n';
+    }
+*retSize = pt - text;
+return text;
+}
+
+static void unpackPiece(void *item, void *context)
+/* Read and format one piece.  Called in parallel by pthreadDoList. */
+{
+struct faPiece *piece = item;
+struct faWindow *win = context;
+struct twoBitFile *tbf = grabTwoBit(win);
+struct dnaSeq *seq = twoBitReadSeqFrag(tbf, piece->seqName, piece->start, piece->end);
+releaseTwoBit(win, tbf);
 if (noMask)
     toUpperN(seq->dna, seq->size);
-faWriteNext(f, seq->name, seq->dna, seq->size);
+piece->text = formatFa(piece->header, seq->dna, seq->size, &piece->textSize);
 dnaSeqFree(&seq);
 }
 
-static void processAllSeqs(struct twoBitFile *tbf, FILE *outFile)
+static void flushWindow(struct faWindow *win)
+/* Unpack queued pieces in parallel, and write them out in order. */
+{
+struct faPiece *piece;
+slReverse(&win->pieceList);
+pthreadDoList(threads, win->pieceList, unpackPiece, win);
+while ((piece = slPopHead(&win->pieceList)) != NULL)
+    {
+    mustWrite(win->f, piece->text, piece->textSize);
+    freeMem(piece->text);
+    freeMem(piece->seqName);
+    freeMem(piece->header);
+    freeMem(piece);
+    }
+win->pieceCount = 0;
+win->baseCount = 0;
+}
+
+void outputOne(struct twoBitFile *tbf, char *seqSpec, struct faWindow *win,
+	int start, int end)
+/* Queue up sequence for output, flushing queue if it is getting big. */
+{
+/* Check range here, where an error can be reported, rather than in a thread. */
+int seqSize = twoBitSeqSize(tbf, seqSpec);
+if (end == 0)
+    end = seqSize;
+if (end > seqSize)
+    errAbort("twoBitReadSeqFrag in %s end (%d) >= seqSize (%d)", seqSpec, end, seqSize);
+if (end - start < 1)
+    errAbort("twoBitReadSeqFrag in %s start (%d) >= end (%d)", seqSpec, start, end);
+char header[512];
+if (end - start == seqSize)
+    safef(header, sizeof(header), "%s", seqSpec);
+else
+    safef(header, sizeof(header), "%s:%d-%d", seqSpec, start, end);
+int pieceStart;
+for (pieceStart = start; pieceStart < end; pieceStart += pieceSize)
+    {
+    struct faPiece *piece;
+    AllocVar(piece);
+    piece->seqName = cloneString(seqSpec);
+    piece->header = (pieceStart == start ? cloneString(header) : NULL);
+    piece->start = pieceStart;
+    piece->end = min(end, pieceStart + pieceSize);
+    slAddHead(&win->pieceList, piece);
+    win->pieceCount += 1;
+    win->baseCount += piece->end - piece->start;
+    if (win->pieceCount >= windowPieces * threads || win->baseCount >= windowBases * threads)
+        flushWindow(win);
+    }
+}
+
+static void processAllSeqs(struct twoBitFile *tbf, struct faWindow *win)
 /* get all sequences in a file */
 {
 struct twoBitIndex *index;
 for (index = tbf->indexList; index != NULL; index = index->next)
-    outputOne(tbf, index->name, outFile, 0, 0);
+    outputOne(tbf, index->name, win, 0, 0);
 }
 
 static void processSeqSpecs(struct twoBitFile *tbf, struct twoBitSeqSpec *tbss,
-                            FILE *outFile)
+                            struct faWindow *win)
 /* process list of twoBitSeqSpec objects */
 {
 struct twoBitSeqSpec *s;
 for (s = tbss; s != NULL; s = s->next)
-    outputOne(tbf, s->name, outFile, s->start, s->end);
+    outputOne(tbf, s->name, win, s->start, s->end);
 }
 
 struct dnaSeq *twoBitAndBedToSeq(struct twoBitFile *tbf, struct bed *bed)
@@ -179,20 +323,33 @@ else
 if (tbs == NULL)
     errAbort("%s is not a twoBit file", inName);
 
-if (tbs->seqs != NULL && clBpt != NULL)
-    tbf = twoBitOpenExternalBptIndex(tbs->fileName, clBpt);
-else
-    tbf = twoBitOpen(tbs->fileName);
+if (tbs->seqs == NULL)
+    clBpt = NULL;	/* External index is only used to find sequences named. */
+tbf = openTwoBit(tbs->fileName);
 if (clBed != NULL)
     {
     processSeqsFromBed(tbf, clBed, outFile);
     }
 else
     {
+    /* Threads read with their own twoBitFiles, starting with ours when we
+     * aren't using it. */
+    struct faWindow win;
+    ZeroVar(&win);
+    win.f = outFile;
+    win.fileName = tbs->fileName;
+    win.freeFiles = tbf;
+    pthreadMutexInit(&win.mutex);
     if (tbs->seqs == NULL)
-	processAllSeqs(tbf, outFile);
+	processAllSeqs(tbf, &win);
     else
-	processSeqSpecs(tbf, tbs->seqs, outFile);
+	processSeqSpecs(tbf, tbs->seqs, &win);
+    flushWindow(&win);
+    struct twoBitFile *extra;
+    while ((extra = slPopHead(&win.freeFiles)) != NULL)
+        if (extra != tbf)
+	    twoBitClose(&extra);
+    pthreadMutexDestroy(&win.mutex);
     }
 twoBitSpecFree(&tbs);
 carefulClose(&outFile);
@@ -213,6 +370,9 @@ clBpt = optionVal("bpt", clBpt);
 clBed = optionVal("bed", clBed);
 clBedPos = optionExists("bedPos");
 noMask = optionExists("noMask");
+threads = optionInt("threads", threads);
+if (threads < 1 || threads > 256)
+    errAbort("-threads must be between 1 and 256");
 udcSetDefaultDir(optionVal("udcDir", udcDefaultDir()));
 
 if (clBedPos && !clBed) 
@@ -24,6 +24,7 @@ errAbort(
   "                   are ignored, i.e. genotypes are trusted more than AC/AN.\n"
   "   -rename         Replace the ID value with a comma-separated list of\n"
   "                   <ref><pos><alt> names, one for each alt (after -minAc)\n"
+  "   -threads=N      Inflate bgzip compressed input.vcf.gz with N threads.\n"
   );
 }
 
@@ -32,6 +33,7 @@ static struct optionSpec options[] = {
     { "excludeVcf", OPTION_STRING },
     { "minAc", OPTION_INT },
     { "rename", OPTION_BOOLEAN },
+    { "threads", OPTION_INT },
     {NULL, 0},
 };
 
@@ -385,6 +387,10 @@ int main(int argc, char *argv[])
 optionInit(&argc, argv, options);
 if (argc != 2)
     usage();
+int threads = optionInt("threads", 0);
+if (threads < 0 || threads > 256)
+    errAbort("-threads must be between 0 and 256");
+lineFileSetDecompressThreads(threads);
 vcfFilter(argv[1]);
 return 0;
 }